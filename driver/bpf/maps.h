@@ -106,6 +106,19 @@ struct bpf_map_def __bpf_section("maps") rtt_static_map = {
         .max_entries = 65535,
 };
 
+#ifdef BPF_SUPPORTS_RINGBUF
+/*
+ * Alternative to perf_map: a single ring buffer shared by all the CPUs.
+ * Userspace looks it up by type, and sets its size.
+ */
+struct bpf_map_def __bpf_section("maps") ringbuf_map = {
+	.type = BPF_MAP_TYPE_RINGBUF,
+	.key_size = 0,
+	.value_size = 0,
+	.max_entries = 0,
+};
+#endif
+
 #endif // __KERNEL__
 
 #endif
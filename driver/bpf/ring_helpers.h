@@ -58,6 +58,29 @@ static __always_inline int push_evt_frame(void *ctx,
 
 	fixup_evt_len(data->buf, data->state->tail_ctx.len);
 
+#ifdef BPF_SUPPORTS_RINGBUF
+	if (data->settings->ringbuf_enabled) {
+		unsigned long len = data->state->tail_ctx.len;
+		u16 cpu = bpf_get_smp_processor_id();
+		int res;
+
+		/*
+		 * The record header of the ring buffer doesn't say which
+		 * CPU the event comes from, so it follows the event
+		 */
+		memcpy(&data->buf[len & SCRATCH_SIZE_HALF], &cpu, sizeof(cpu));
+
+		res = bpf_ringbuf_output(&ringbuf_map,
+					 data->buf,
+					 (len + sizeof(cpu)) & SCRATCH_SIZE_MAX,
+					 0);
+		if (res)
+			return PPM_FAILURE_BUFFER_FULL;
+
+		return PPM_SUCCESS;
+	}
+#endif
+
 #ifdef BPF_FORBIDS_ZERO_ACCESS
 	int res = bpf_perf_event_output(ctx,
 					&perf_map,
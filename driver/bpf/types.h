@@ -262,6 +262,7 @@ struct sysdig_bpf_settings {
 	bool is_dropping;
 	bool tracers_enabled;
 	bool skb_capture;
+	bool ringbuf_enabled;
 	uint16_t fullcapture_port_range_start;
 	uint16_t fullcapture_port_range_end;
 	uint16_t statsd_port;
@@ -151,9 +151,10 @@ static int record_event_consumer(struct ppm_consumer_t *consumer,
 static void record_event_all_consumers(enum ppm_event_type event_type,
                                        enum syscall_flags drop_flags,
                                        struct event_data_t *event_datap);
-static int init_ring_buffer(struct ppm_ring_buffer_context *ring);
+static int init_ring_buffer(struct ppm_ring_buffer_context *ring, u32 buffer_size);
 static void free_ring_buffer(struct ppm_ring_buffer_context *ring);
 static void reset_ring_buffer(struct ppm_ring_buffer_context *ring);
+static int resize_ring_buffers(struct ppm_consumer_t *consumer, u32 buffer_size);
 #if (LINUX_VERSION_CODE < KERNEL_VERSION(4, 4, 0))
 void ppm_task_cputime_adjusted(struct task_struct *p, cputime_t *ut, cputime_t *st);
 #endif
@@ -488,6 +489,7 @@ static int ppm_open(struct inode *inode, struct file *filp)
 		}
 
 		consumer->consumer_id = consumer_id;
+		consumer->rings_used = false;
 
 		/*
 		 * Initialize the ring buffers array
@@ -531,7 +533,11 @@ static int ppm_open(struct inode *inode, struct file *filp)
 
 			pr_info("initializing ring buffer for CPU %u\n", cpu);
 
-			if (!init_ring_buffer(ring)) {
+			/*
+			 * The consumer can pick another size with
+			 * PPM_IOCTL_SET_RING_BUF_SIZE before mapping the rings
+			 */
+			if (!init_ring_buffer(ring, RING_BUF_SIZE)) {
 				pr_err("can't initialize the ring buffer for CPU %u\n", cpu);
 				ret = -ENOMEM;
 				goto err_init_ring_buffer;
@@ -1002,12 +1008,40 @@ cleanup_ioctl_procinfo:
 		}
 
 		ring->capture_enabled = true;
+		consumer->rings_used = true;
 
 		vpr_info("PPM_IOCTL_ENABLE_CAPTURE for ring %d, consumer %p\n", ring_no, consumer_id);
 
 		ret = 0;
 		goto cleanup_ioctl;
 	}
+	case PPM_IOCTL_SET_RING_BUF_SIZE:
+	{
+		u32 buffer_size = (u32)arg;
+
+		vpr_info("PPM_IOCTL_SET_RING_BUF_SIZE, consumer %p, size %u\n", consumer_id, buffer_size);
+
+		if (buffer_size < MIN_RING_BUF_SIZE ||
+		    buffer_size > MAX_RING_BUF_SIZE ||
+		    buffer_size < 2 * PAGE_SIZE ||
+		    (buffer_size & (buffer_size - 1)) != 0) {
+			pr_err("invalid ring buffer size %u, must be a power of two between %u and %u\n",
+			       buffer_size,
+			       MIN_RING_BUF_SIZE,
+			       MAX_RING_BUF_SIZE);
+			ret = -EINVAL;
+			goto cleanup_ioctl;
+		}
+
+		if (consumer->rings_used) {
+			pr_err("the ring buffer size of consumer %p can't change after its rings are mapped or capturing\n", consumer_id);
+			ret = -EBUSY;
+			goto cleanup_ioctl;
+		}
+
+		ret = resize_ring_buffers(consumer, buffer_size);
+		goto cleanup_ioctl;
+	}
 	case PPM_IOCTL_DISABLE_DROPPING_MODE:
 	{
 		struct event_data_t event_data;
@@ -1352,33 +1386,38 @@ static int ppm_mmap(struct file *filp, struct vm_area_struct *vma)
 		       length,
 		       PAGE_SIZE);
 
+		/*
+		 * Retrieve the ring structure for this CPU
+		 */
+		ring = per_cpu_ptr(consumer->ring_buffers, ring_no);
+		if (!ring) {
+			ASSERT(false);
+			ret = -ENODEV;
+			goto cleanup_mmap;
+		}
+
+		/*
+		 * From now on userspace reads the buffers with their size
+		 */
+		consumer->rings_used = true;
+
 		/*
 		 * Enforce ring buffer size
 		 */
-		if (RING_BUF_SIZE < 2 * PAGE_SIZE) {
+		if (ring->buffer_size < 2 * PAGE_SIZE) {
 			pr_err("Ring buffer size too small (%ld bytes, must be at least %ld bytes\n",
-			       (long)RING_BUF_SIZE,
+			       (long)ring->buffer_size,
 			       (long)PAGE_SIZE);
 			ret = -EIO;
 			goto cleanup_mmap;
 		}
 
-		if (RING_BUF_SIZE / PAGE_SIZE * PAGE_SIZE != RING_BUF_SIZE) {
+		if (ring->buffer_size / PAGE_SIZE * PAGE_SIZE != ring->buffer_size) {
 			pr_err("Ring buffer size is not a multiple of the page size\n");
 			ret = -EIO;
 			goto cleanup_mmap;
 		}
 
-		/*
-		 * Retrieve the ring structure for this CPU
-		 */
-		ring = per_cpu_ptr(consumer->ring_buffers, ring_no);
-		if (!ring) {
-			ASSERT(false);
-			ret = -ENODEV;
-			goto cleanup_mmap;
-		}
-
 		if (length <= PAGE_SIZE) {
 			/*
 			 * When the size requested by the user is smaller than a page, we assume
@@ -1400,7 +1439,7 @@ static int ppm_mmap(struct file *filp, struct vm_area_struct *vma)
 
 			ret = 0;
 			goto cleanup_mmap;
-		} else if (length == RING_BUF_SIZE * 2) {
+		} else if (length == (long)ring->buffer_size * 2) {
 			long mlength;
 
 			/*
@@ -1843,16 +1882,16 @@ static int record_event_consumer(struct ppm_consumer_t *consumer,
 	if (ttail > head)
 		freespace = ttail - head - 1;
 	else
-		freespace = RING_BUF_SIZE + ttail - head - 1;
+		freespace = ring->buffer_size + ttail - head - 1;
 
-	usedspace = RING_BUF_SIZE - freespace - 1;
-	delta_from_end = RING_BUF_SIZE + (2 * PAGE_SIZE) - head - 1;
+	usedspace = ring->buffer_size - freespace - 1;
+	delta_from_end = ring->buffer_size + (2 * PAGE_SIZE) - head - 1;
 
-	ASSERT(freespace <= RING_BUF_SIZE);
-	ASSERT(usedspace <= RING_BUF_SIZE);
-	ASSERT(ttail <= RING_BUF_SIZE);
-	ASSERT(head <= RING_BUF_SIZE);
-	ASSERT(delta_from_end < RING_BUF_SIZE + (2 * PAGE_SIZE));
+	ASSERT(freespace <= ring->buffer_size);
+	ASSERT(usedspace <= ring->buffer_size);
+	ASSERT(ttail <= ring->buffer_size);
+	ASSERT(head <= ring->buffer_size);
+	ASSERT(delta_from_end < ring->buffer_size + (2 * PAGE_SIZE));
 	ASSERT(delta_from_end > (2 * PAGE_SIZE) - 1);
 #ifdef _HAS_SOCKETCALL
 	/*
@@ -2024,20 +2063,20 @@ static int record_event_consumer(struct ppm_consumer_t *consumer,
 
 		next = head + event_size;
 
-		if (unlikely(next >= RING_BUF_SIZE)) {
+		if (unlikely(next >= ring->buffer_size)) {
 			/*
 			 * If something has been written in the cushion space at the end of
 			 * the buffer, copy it to the beginning and wrap the head around.
 			 * Note, we don't check that the copy fits because we assume that
 			 * filler_callback failed if the space was not enough.
 			 */
-			if (next > RING_BUF_SIZE) {
+			if (next > ring->buffer_size) {
 				memcpy(ring->buffer,
-				ring->buffer + RING_BUF_SIZE,
-				next - RING_BUF_SIZE);
+				ring->buffer + ring->buffer_size,
+				next - ring->buffer_size);
 			}
 
-			next -= RING_BUF_SIZE;
+			next -= ring->buffer_size;
 		}
 
 		/*
@@ -2070,7 +2109,7 @@ static int record_event_consumer(struct ppm_consumer_t *consumer,
 		vpr_info("consumer:%p CPU:%d, use:%d%%, ev:%llu, dr_buf:%llu, dr_pf:%llu, pr:%llu, cs:%llu\n",
 			   consumer->consumer_id,
 		       smp_processor_id(),
-		       (usedspace * 100) / RING_BUF_SIZE,
+		       (usedspace * 100) / ring->buffer_size,
 		       ring_info->n_evts,
 		       ring_info->n_drops_buffer,
 		       ring_info->n_drops_pf,
@@ -2491,7 +2530,7 @@ TRACEPOINT_PROBE(net_dev_xmit_probe, struct sk_buff *skb, int rc, struct net_dev
 }
 #endif
 
-static int init_ring_buffer(struct ppm_ring_buffer_context *ring)
+static int init_ring_buffer(struct ppm_ring_buffer_context *ring, u32 buffer_size)
 {
 	unsigned int j;
 
@@ -2509,13 +2548,14 @@ static int init_ring_buffer(struct ppm_ring_buffer_context *ring)
 	 * Note how we allocate 2 additional pages: they are used as additional overflow space for
 	 * the event data generation functions, so that they always operate on a contiguous buffer.
 	 */
-	ring->buffer = vmalloc(RING_BUF_SIZE + 2 * PAGE_SIZE);
+	ring->buffer_size = buffer_size;
+	ring->buffer = vmalloc(ring->buffer_size + 2 * PAGE_SIZE);
 	if (ring->buffer == NULL) {
 		pr_err("Error allocating ring memory\n");
 		goto init_ring_err;
 	}
 
-	for (j = 0; j < RING_BUF_SIZE + 2 * PAGE_SIZE; j++)
+	for (j = 0; j < ring->buffer_size + 2 * PAGE_SIZE; j++)
 		ring->buffer[j] = 0;
 
 	/*
@@ -2533,7 +2573,7 @@ static int init_ring_buffer(struct ppm_ring_buffer_context *ring)
 	reset_ring_buffer(ring);
 	atomic_set(&ring->preempt_count, 0);
 
-	pr_info("CPU buffer initialized, size=%d\n", RING_BUF_SIZE);
+	pr_info("CPU buffer initialized, size=%u\n", ring->buffer_size);
 
 	return 1;
 
@@ -2560,6 +2600,42 @@ static void free_ring_buffer(struct ppm_ring_buffer_context *ring)
 	}
 }
 
+/*
+ * Replace the buffers of all the rings of a consumer with ones of another
+ * size. The rings must not be mapped or capturing yet, so that nothing
+ * reads or writes the old buffers.
+ */
+static int resize_ring_buffers(struct ppm_consumer_t *consumer, u32 buffer_size)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu) {
+		struct ppm_ring_buffer_context *ring = per_cpu_ptr(consumer->ring_buffers, cpu);
+		char *buffer;
+
+		if (ring->buffer == NULL || ring->buffer_size == buffer_size)
+			continue;
+
+		buffer = vmalloc(buffer_size + 2 * PAGE_SIZE);
+		if (buffer == NULL) {
+			pr_err("Error allocating ring memory\n");
+			return -ENOMEM;
+		}
+
+		memset(buffer, 0, buffer_size + 2 * PAGE_SIZE);
+
+		vfree((void *)ring->buffer);
+		ring->buffer = buffer;
+		ring->buffer_size = buffer_size;
+		ring->info->head = 0;
+		ring->info->tail = 0;
+
+		pr_info("CPU buffer resized, size=%u\n", ring->buffer_size);
+	}
+
+	return 0;
+}
+
 static void reset_ring_buffer(struct ppm_ring_buffer_context *ring)
 {
 	/*
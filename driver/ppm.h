@@ -58,6 +58,7 @@ struct ppm_ring_buffer_context {
 	bool capture_enabled;
 	struct ppm_ring_buffer_info *info;
 	char *buffer;
+	u32 buffer_size;	/* Size of buffer, without the overflow pages. */
 #ifndef WDIG
 	nanoseconds last_print_time;
 #endif
@@ -88,6 +89,7 @@ struct ppm_consumer_t {
 	uint16_t fullcapture_port_range_start;
 	uint16_t fullcapture_port_range_end;
 	uint16_t statsd_port;
+	bool rings_used;	/* mapped or capturing, the ring size can't change anymore */
 };
 #endif // UDIG
 
@@ -1502,6 +1502,7 @@ struct ppm_evt_hdr {
 #define PPM_IOCTL_GET_PROBE_VERSION _IO(PPM_IOCTL_MAGIC, 21)
 #define PPM_IOCTL_SET_FULLCAPTURE_PORT_RANGE _IO(PPM_IOCTL_MAGIC, 22)
 #define PPM_IOCTL_SET_STATSD_PORT _IO(PPM_IOCTL_MAGIC, 23)
+#define PPM_IOCTL_SET_RING_BUF_SIZE _IO(PPM_IOCTL_MAGIC, 24)
 #endif // CYGWING_AGENT
 
 extern const struct ppm_name_value socket_families[];
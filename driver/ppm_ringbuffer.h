@@ -14,7 +14,14 @@ or GPL2.txt for full copies of the license.
 #include <linux/types.h>
 #endif
 
+/*
+ * Default size of the per-CPU ring buffers. Consumers can pick a different
+ * one, as long as it's a power of two between MIN_RING_BUF_SIZE and
+ * MAX_RING_BUF_SIZE, and not smaller than two pages.
+ */
 static const __u32 RING_BUF_SIZE = 8 * 1024 * 1024;
+static const __u32 MIN_RING_BUF_SIZE = 64 * 1024;
+static const __u32 MAX_RING_BUF_SIZE = 1024 * 1024 * 1024;
 static const __u32 MIN_USERSPACE_READ_SIZE = 128 * 1024;
 
 /*
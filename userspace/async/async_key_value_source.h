@@ -16,6 +16,7 @@ limitations under the License.
 */
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <functional>
@@ -25,6 +26,7 @@ limitations under the License.
 #include <set>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 #include <stdint.h>
 
 namespace sysdig
@@ -61,6 +63,14 @@ namespace sysdig
  *     specified ttl time, then this component will prune the stored value.</li>
  * </ol>
  *
+ * By default a single async thread runs run_impl(), so the lookups are
+ * serial. With set_max_concurrency(), up to that many threads run it at
+ * once, each one working on a different key: a key dequeued while another
+ * thread is still looking it up is dropped, since that lookup will store
+ * its value. run_impl() must then be safe to run concurrently;
+ * get_worker_id() tells the workers apart, e.g. to give each one its own
+ * connection.
+ *
  * @tparam key_type   The type of the keys for which concrete subclasses will
  *                    query.  This type must have a valid operator==().
  * @tparam value_type The type of value that concrete subclasses will
@@ -84,6 +94,30 @@ public:
         typedef std::function<void(const key_type& key,
 			           const value_type& value)> callback_handler;
 
+	/**
+	 * A histogram of lookup latencies, in milliseconds. Bucket 0 counts
+	 * the latencies below 1ms, bucket i those in [2^(i-1), 2^i) ms, and
+	 * the last bucket everything above.
+	 */
+	struct latency_histogram
+	{
+		const static uint32_t NUM_BUCKETS = 16;
+
+		latency_histogram():
+			m_buckets(),
+			m_count(0),
+			m_total_ms(0),
+			m_max_ms(0)
+		{ }
+
+		void add(uint64_t ms);
+
+		uint64_t m_buckets[NUM_BUCKETS];
+		uint64_t m_count;
+		uint64_t m_total_ms;
+		uint64_t m_max_ms;
+	};
+
 	/**
 	 * Initialize this new async_key_value_source, which will block
 	 * synchronously for the given max_wait_ms for value collection.
@@ -116,6 +150,30 @@ public:
 	 */
 	uint64_t get_ttl() const;
 
+	/**
+	 * Set the maximum number of lookups in flight at once, i.e. the
+	 * number of async threads. It must be called before the first
+	 * lookup().
+	 */
+	void set_max_concurrency(uint32_t max_concurrency);
+
+	/**
+	 * Returns the maximum number of lookups in flight at once.
+	 */
+	uint32_t get_max_concurrency() const;
+
+	/**
+	 * Returns the histogram of the time requests spent queued, from the
+	 * time they were due to the time a worker dequeued them.
+	 */
+	latency_histogram get_queue_latency() const;
+
+	/**
+	 * Returns the histogram of the time spent by the workers on each
+	 * lookup, from dequeue_next_key() to store_value().
+	 */
+	latency_histogram get_lookup_latency() const;
+
 	/**
 	 * Lookup value(s) based on the given key.  This method will block
 	 * the caller for up the max_wait_ms time specified at construction
@@ -258,6 +316,12 @@ protected:
 	 */
 	std::chrono::steady_clock::time_point get_deadline() const;
 
+	/**
+	 * The index, between 0 and get_max_concurrency() - 1, of the async
+	 * thread calling this method, UINT32_MAX for any other thread.
+	 */
+	static uint32_t get_worker_id();
+
 private:
 	/**
 	 * Holds information associated with a single lookup() request.
@@ -302,10 +366,32 @@ private:
 	typedef std::map<const key_type, lookup_request> value_map;
 
 	/**
-	 * The entry point of the async thread, which blocks waiting for work
-	 * and dispatches work to run_impl().
+	 * The key an async thread is looking up, if any.
+	 */
+	struct worker_state
+	{
+		worker_state():
+			m_busy(false),
+			m_key(),
+			m_dequeue_time()
+		{ }
+
+		bool m_busy;
+		key_type m_key;
+		std::chrono::time_point<std::chrono::steady_clock> m_dequeue_time;
+	};
+
+	/**
+	 * The entry point of the async threads, which block waiting for work
+	 * and dispatch work to run_impl().
 	 */
-	void run();
+	void run(uint32_t worker_id);
+
+	/**
+	 * Whether a thread other than the given one is looking up the key.
+	 * This method expects that the caller is holding m_mutex.
+	 */
+	bool is_in_flight(const key_type& key, uint32_t worker_id) const;
 
 	/**
 	 * Remove any entries that are older than the time-to-live.
@@ -314,10 +400,13 @@ private:
 
 	uint64_t m_max_wait_ms;
 	uint64_t m_ttl_ms;
-	std::thread m_thread;
-	bool m_running;
+	uint32_t m_max_concurrency;
+	std::vector<std::thread> m_threads;
+	std::atomic<uint32_t> m_num_running;
 	bool m_terminate;
 
+	static thread_local uint32_t s_worker_id;
+
 	/**
 	 * Protects the state of instances of this class.  This protected does
 	 * not extend to subclasses (i.e., this mutex should not be held when
@@ -335,6 +424,11 @@ private:
 	std::priority_queue<queue_item_t, std::vector<queue_item_t>, std::greater<queue_item_t>> m_request_queue;
 	std::set<key_type> m_request_set;
 	value_map m_value_map;
+
+	/** Indexed by worker id. */
+	std::vector<worker_state> m_workers;
+	latency_histogram m_queue_latency;
+	latency_histogram m_lookup_latency;
 };
 
 
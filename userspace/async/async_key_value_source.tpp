@@ -28,14 +28,34 @@ limitations under the License.
 namespace sysdig
 {
 
+template<typename key_type, typename value_type>
+thread_local uint32_t async_key_value_source<key_type, value_type>::s_worker_id = UINT32_MAX;
+
+template<typename key_type, typename value_type>
+void async_key_value_source<key_type, value_type>::latency_histogram::add(uint64_t ms)
+{
+	uint32_t bucket = 0;
+
+	while(bucket < NUM_BUCKETS - 1 && ms >= (1ULL << bucket))
+	{
+		bucket++;
+	}
+
+	m_buckets[bucket]++;
+	m_count++;
+	m_total_ms += ms;
+	m_max_ms = std::max(m_max_ms, ms);
+}
+
 template<typename key_type, typename value_type>
 async_key_value_source<key_type, value_type>::async_key_value_source(
 		const uint64_t max_wait_ms,
 		const uint64_t ttl_ms) noexcept:
 	m_max_wait_ms(max_wait_ms),
 	m_ttl_ms(ttl_ms),
-	m_thread(),
-	m_running(false),
+	m_max_concurrency(1),
+	m_threads(),
+	m_num_running(0),
 	m_terminate(false),
 	m_mutex(),
 	m_queue_not_empty_condition(),
@@ -69,6 +89,46 @@ uint64_t async_key_value_source<key_type, value_type>::get_ttl() const
 	return m_ttl_ms;
 }
 
+template<typename key_type, typename value_type>
+void async_key_value_source<key_type, value_type>::set_max_concurrency(uint32_t max_concurrency)
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+
+	m_max_concurrency = std::max(max_concurrency, 1u);
+}
+
+template<typename key_type, typename value_type>
+uint32_t async_key_value_source<key_type, value_type>::get_max_concurrency() const
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+
+	return m_max_concurrency;
+}
+
+template<typename key_type, typename value_type>
+typename async_key_value_source<key_type, value_type>::latency_histogram
+async_key_value_source<key_type, value_type>::get_queue_latency() const
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+
+	return m_queue_latency;
+}
+
+template<typename key_type, typename value_type>
+typename async_key_value_source<key_type, value_type>::latency_histogram
+async_key_value_source<key_type, value_type>::get_lookup_latency() const
+{
+	std::lock_guard<std::mutex> guard(m_mutex);
+
+	return m_lookup_latency;
+}
+
+template<typename key_type, typename value_type>
+uint32_t async_key_value_source<key_type, value_type>::get_worker_id()
+{
+	return s_worker_id;
+}
+
 template<typename key_type, typename value_type>
 void async_key_value_source<key_type, value_type>::stop()
 {
@@ -77,24 +137,27 @@ void async_key_value_source<key_type, value_type>::stop()
 	{
 		std::unique_lock<std::mutex> guard(m_mutex);
 
-		if(m_running)
+		if(!m_threads.empty())
 		{
 			m_terminate = true;
 			join_needed = true;
 
-			// The async thread might be waiting for new events
-			// so wake it up
-			m_queue_not_empty_condition.notify_one();
+			// The async threads might be waiting for new events
+			// so wake them up
+			m_queue_not_empty_condition.notify_all();
 		}
 	} // Drop the mutex before join()
 
 	if (join_needed)
 	{
-		m_thread.join();
+		for(auto& thread : m_threads)
+		{
+			thread.join();
+		}
 
-		// Remove any pointers from the thread to this object
+		// Remove any pointers from the threads to this object
 		// (just to be safe)
-		m_thread = std::thread();
+		m_threads.clear();
 	}
 }
 
@@ -104,13 +167,14 @@ bool async_key_value_source<key_type, value_type>::is_running() const
 	// Since this is for information only and it's ok to race, we
 	// explicitly do not lock here.
 
-	return m_running;
+	return m_num_running > 0;
 }
 
 template<typename key_type, typename value_type>
-void async_key_value_source<key_type, value_type>::run()
+void async_key_value_source<key_type, value_type>::run(uint32_t worker_id)
 {
-	m_running = true;
+	s_worker_id = worker_id;
+	m_num_running++;
 
 	while(!m_terminate)
 	{
@@ -146,7 +210,7 @@ void async_key_value_source<key_type, value_type>::run()
 		}
 	}
 
-	m_running = false;
+	m_num_running--;
 }
 
 template<typename key_type, typename value_type>
@@ -158,9 +222,13 @@ bool async_key_value_source<key_type, value_type>::lookup_delayed(
 {
 	std::unique_lock<std::mutex> guard(m_mutex);
 
-	if(!m_running && !m_thread.joinable())
+	if(m_threads.empty())
 	{
-		m_thread = std::thread(&async_key_value_source::run, this);
+		m_workers.resize(m_max_concurrency);
+		for(uint32_t j = 0; j < m_max_concurrency; j++)
+		{
+			m_threads.emplace_back(&async_key_value_source::run, this, j);
+		}
 	}
 
 	typename value_map::iterator itr = m_value_map.find(key);
@@ -246,25 +314,66 @@ bool async_key_value_source<key_type, value_type>::lookup(
 	return lookup_delayed(key, value, std::chrono::milliseconds::zero(), handler);
 }
 
+template<typename key_type, typename value_type>
+bool async_key_value_source<key_type, value_type>::is_in_flight(const key_type& key,
+								 uint32_t worker_id) const
+{
+	for(uint32_t j = 0; j < m_workers.size(); j++)
+	{
+		if(j != worker_id && m_workers[j].m_busy && m_workers[j].m_key == key)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
 template<typename key_type, typename value_type>
 bool async_key_value_source<key_type, value_type>::dequeue_next_key(key_type& key)
 {
 	std::lock_guard<std::mutex> guard(m_mutex);
-	bool key_found = false;
+	const auto now = std::chrono::steady_clock::now();
+	uint32_t worker_id = s_worker_id;
+
+	// Whatever this thread was looking up before is over
+	if(worker_id < m_workers.size())
+	{
+		m_workers[worker_id].m_busy = false;
+	}
 
-	if(!m_request_queue.empty())
+	while(!m_request_queue.empty())
 	{
 		auto top_element = m_request_queue.top();
-		if(top_element.first < std::chrono::steady_clock::now())
+		if(top_element.first >= now)
+		{
+			break;
+		}
+
+		m_request_queue.pop();
+		m_request_set.erase(top_element.second);
+
+		// Another thread will store the value of this key
+		if(is_in_flight(top_element.second, worker_id))
 		{
-			key_found = true;
-			key = std::move(top_element.second);
-			m_request_queue.pop();
-			m_request_set.erase(key);
+			continue;
 		}
+
+		m_queue_latency.add(std::chrono::duration_cast<std::chrono::milliseconds>(
+				now - top_element.first).count());
+
+		if(worker_id < m_workers.size())
+		{
+			m_workers[worker_id].m_busy = true;
+			m_workers[worker_id].m_key = top_element.second;
+			m_workers[worker_id].m_dequeue_time = now;
+		}
+
+		key = std::move(top_element.second);
+		return true;
 	}
 
-	return key_found;
+	return false;
 }
 
 template<typename key_type, typename value_type>
@@ -283,6 +392,15 @@ void async_key_value_source<key_type, value_type>::store_value(
 {
 	std::lock_guard<std::mutex> guard(m_mutex);
 
+	if(s_worker_id < m_workers.size() &&
+	   m_workers[s_worker_id].m_busy &&
+	   m_workers[s_worker_id].m_key == key)
+	{
+		m_workers[s_worker_id].m_busy = false;
+		m_lookup_latency.add(std::chrono::duration_cast<std::chrono::milliseconds>(
+				std::chrono::steady_clock::now() - m_workers[s_worker_id].m_dequeue_time).count());
+	}
+
 	typename value_map::iterator itr = m_value_map.find(key);
 	if(itr == m_value_map.end())
 	{
@@ -16,12 +16,22 @@ limitations under the License.
 */
 
 #include <stdio.h>
+#include <string.h>
 #include <signal.h>
+#include <sys/time.h>
 #include <scap.h>
 
 uint64_t g_nevts = 0;
+uint64_t g_start_ts = 0;
 scap_t* g_h = NULL;
 
+static uint64_t get_time_ns()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * (uint64_t)1000000000 + tv.tv_usec * 1000;
+}
+
 static void signal_callback(int signal)
 {
 	scap_stats s;
@@ -35,6 +45,17 @@ static void signal_callback(int signal)
 	printf("Number of preemptions: %" PRIu64 "\n", s.n_preemptions);
 	printf("Number of events skipped due to the tid being in a set of suppressed tids: %" PRIu64 "\n", s.n_suppressed);
 	printf("Number of threads currently being suppressed: %" PRIu64 "\n", s.n_tids_suppressed);
+	printf("Ring buffer size: %" PRIu64 "\n", s.ring_buffer_size);
+
+	double secs = (get_time_ns() - g_start_ts) / 1000000000.0;
+	if(secs > 0)
+	{
+		printf("Events per second: %.0f\n", g_nevts / secs);
+	}
+	if(s.n_evts > 0)
+	{
+		printf("Drop rate: %.3f%%\n", s.n_drops * 100.0 / s.n_evts);
+	}
 	exit(0);
 }
 
@@ -44,6 +65,20 @@ int main(int argc, char** argv)
 	int32_t res;
 	scap_evt* ev;
 	uint16_t cpuid;
+	scap_open_args args;
+
+	//
+	// Usage: scap-open [-r]
+	// -r uses the BPF ring buffer shared by all the CPUs, instead of the
+	// per-CPU perf buffers. The BPF probe is taken from SYSDIG_BPF_PROBE.
+	//
+	memset(&args, 0, sizeof(args));
+	args.mode = SCAP_MODE_LIVE;
+	args.import_users = true;
+	args.proc_scan_timeout_ms = SCAP_PROC_SCAN_TIMEOUT_NONE;
+	args.proc_scan_log_interval_ms = SCAP_PROC_SCAN_LOG_NONE;
+	args.ring_buffer_size = SCAP_RING_BUFFER_SIZE_DEFAULT;
+	args.bpf_ringbuf = argc > 1 && strcmp(argv[1], "-r") == 0;
 
 	if(signal(SIGINT, signal_callback) == SIG_ERR)
 	{
@@ -51,13 +86,15 @@ int main(int argc, char** argv)
 		return -1;
 	}
 
-	g_h = scap_open_live(error, &res);
+	g_h = scap_open(args, error, &res);
 	if(g_h == NULL)
 	{
 		fprintf(stderr, "%s (%d)\n", error, res);
 		return -1;
 	}
-	
+
+	g_start_ts = get_time_ns();
+
 	while(1)
 	{
 		res = scap_next(g_h, &ev, &cpuid);
@@ -141,9 +141,12 @@ struct scap
 	void* m_proc_callback_context;
 	struct ppm_proclist_info* m_driver_procinfo;
 	bool refresh_proc_table_when_saving;
+	// the tables were loaded from a state snapshot instead of the system
+	bool m_state_snapshot_loaded;
 	uint32_t m_fd_lookup_limit;
 	uint64_t m_unexpected_block_readsize;
 	uint32_t m_ncpus;
+	uint32_t m_ring_buffer_size; // size of each per-CPU ring buffer, kmod and bpf
 	// Abstraction layer for windows
 #if CYGWING_AGENT || _WIN32
 	wh_t* m_whh;
@@ -162,6 +165,16 @@ struct scap
 		int m_bpf_event_fd[BPF_PROGS_MAX];
 		int m_bpf_map_fds[BPF_MAPS_MAX];
 		int m_bpf_prog_array_map_idx;
+		// the BPF ring buffer shared by all the CPUs, when used instead
+		// of the per-CPU perf buffers
+		bool m_bpf_ringbuf;
+		int m_bpf_ringbuf_map_idx;
+		uint32_t m_bpf_ringbuf_size;
+		uint64_t* m_bpf_ringbuf_consumer_pos;
+		uint64_t* m_bpf_ringbuf_producer_pos;
+		char* m_bpf_ringbuf_data;
+		uint64_t m_bpf_ringbuf_cons; // position after the last event returned
+		uint16_t* m_bpf_cpu_to_dev; // device index of each online CPU
 	};
 
 	// The set of process names that are suppressed
@@ -187,6 +200,7 @@ typedef enum ppm_dumper_type
 {
 	DT_FILE = 0,
 	DT_MEM = 1,
+	DT_MANAGED_BUF = 2,
 }ppm_dumper_type;
 
 struct scap_dumper
@@ -198,6 +212,26 @@ struct scap_dumper
 	uint8_t* m_targetbufend;
 };
 
+//
+// Reads the metadata blocks of a capture file in memory, in chunks of
+// up to SCAP_BLOCK_READER_BUF_SIZE bytes, so that their fields are
+// decoded from the buffer instead of with a gzread() each
+//
+#define SCAP_BLOCK_READER_BUF_SIZE (8 * 1024 * 1024)
+
+typedef struct scap_block_reader
+{
+	gzFile m_f;
+	uint8_t* m_buf;
+	size_t m_bufsize;
+	// valid bytes in m_buf
+	size_t m_len;
+	// next byte to decode in m_buf
+	size_t m_pos;
+	// bytes of the current block still in the file
+	size_t m_remaining;
+} scap_block_reader;
+
 struct scap_ns_socket_list
 {
 	int64_t net_ns;
@@ -254,9 +288,20 @@ uint32_t scap_fd_info_len(scap_fdinfo* fdi);
 // Write the given fd info to disk
 int32_t scap_fd_write_to_disk(scap_t* handle, scap_fdinfo* fdi, scap_dumper_t* dumper, uint32_t len);
 // Populate the given fd by reading the info from disk
-uint32_t scap_fd_read_from_disk(scap_t* handle, OUT scap_fdinfo* fdi, OUT size_t* nbytes, uint32_t block_type, gzFile f);
+uint32_t scap_fd_read_from_disk(scap_t* handle, OUT scap_fdinfo* fdi, OUT size_t* nbytes, uint32_t block_type, scap_block_reader* r);
+// Start reading a block of block_length bytes from the file
+int32_t scap_block_reader_begin(scap_t* handle, scap_block_reader* r, uint32_t block_length);
+// Copy up to len bytes of the block into target, or skip them if target
+// is NULL. Returns less than len at the end of the block or of the file.
+size_t scap_block_read(scap_block_reader* r, OUT void* target, size_t len);
 // Parse the headers of a trace file and load the tables
 int32_t scap_read_init(scap_t* handle, gzFile f);
+// Load the tables of a capture file into a live handle, instead of
+// scanning the system. The file must have been written by
+// scap_state_snapshot_open() during this boot, at most max_age_ns ago
+// (0 means no limit): the boot id is kept in the reserved1 and reserved2
+// fields of its machine info, the creation time in reserved3.
+int32_t scap_read_state(scap_t* handle, const char* fname, uint64_t max_age_ns);
 // Add the file descriptor info pointed by fdi to the fd table for process pi.
 // Note: silently skips if fdi->type is SCAP_FD_UNKNOWN.
 int32_t scap_add_fd_to_proc_table(scap_t* handle, scap_threadinfo* pi, scap_fdinfo* fdi, char *error);
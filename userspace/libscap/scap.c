@@ -87,6 +87,41 @@ static int32_t copy_comms(scap_t *handle, const char **suppressed_comms)
 	return SCAP_SUCCESS;
 }
 
+//
+// Load the process, fd, user and interface tables from a state snapshot
+// instead of scanning the system. The threads go to the callback right
+// away, like the ones of a /proc scan would. On failure the tables are
+// left empty, to be filled from the system.
+//
+static void scap_load_state_snapshot(scap_t* handle, const char* state_snapshot, uint64_t max_age_ms, bool import_users)
+{
+	handle->m_state_snapshot_loaded = false;
+
+	if(state_snapshot == NULL)
+	{
+		return;
+	}
+
+	if(scap_read_state(handle, state_snapshot, max_age_ms * 1000000) != SCAP_SUCCESS)
+	{
+		if(handle->m_debug_log_fn != NULL)
+		{
+			char msg[SCAP_LASTERR_SIZE + 64];
+			snprintf(msg, sizeof(msg), "not using the state snapshot: %s", handle->m_lasterr);
+			handle->m_debug_log_fn(msg);
+		}
+		return;
+	}
+
+	handle->m_state_snapshot_loaded = true;
+
+	if(!import_users && handle->m_userlist != NULL)
+	{
+		scap_free_userlist(handle->m_userlist);
+		handle->m_userlist = NULL;
+	}
+}
+
 #if !defined(HAS_CAPTURE) || defined(CYGWING_AGENT) || defined(_WIN32)
 scap_t* scap_open_live_int(char *error, int32_t *rc,
 			   proc_entry_callback proc_callback,
@@ -96,7 +131,11 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 			   const char **suppressed_comms,
 			   void(*debug_log_fn)(const char* msg),
 			   uint64_t proc_scan_timeout_ms,
-			   uint64_t proc_scan_log_interval_ms)
+			   uint64_t proc_scan_log_interval_ms,
+			   uint32_t ring_buffer_size,
+			   bool bpf_ringbuf,
+			   const char *state_snapshot,
+			   uint64_t state_snapshot_max_age_ms)
 {
 	snprintf(error, SCAP_LASTERR_SIZE, "live capture not supported on %s", PLATFORM_NAME);
 	*rc = SCAP_NOT_SUPPORTED;
@@ -141,6 +180,31 @@ static uint32_t get_max_consumers()
 	return 0;
 }
 
+//
+// The kernel module allocates the ring buffers of a consumer with the
+// default size when it first opens the devices. Another size is set on
+// all the rings of the consumer, i.e. of this thread, through its first
+// device, before any ring is mapped.
+//
+static int32_t set_driver_ring_buffer_size(scap_t *handle, int fd, uint32_t size, char *error)
+{
+	if(size == RING_BUF_SIZE)
+	{
+		// also works with the drivers that only support the default
+		return SCAP_SUCCESS;
+	}
+
+	if(ioctl(fd, PPM_IOCTL_SET_RING_BUF_SIZE, size) != 0)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't set the ring buffer size of the " PROBE_NAME " module to %"PRIu32": %s",
+			 size,
+			 errno == ENOTTY ? "the module doesn't support it" : scap_strerror(handle, errno));
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
 #ifndef _WIN32
 scap_t* scap_open_live_int(char *error, int32_t *rc,
 			   proc_entry_callback proc_callback,
@@ -150,7 +214,11 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 			   const char **suppressed_comms,
 			   void(*debug_log_fn)(const char* msg),
 			   uint64_t proc_scan_timeout_ms,
-			   uint64_t proc_scan_log_interval_ms)
+			   uint64_t proc_scan_log_interval_ms,
+			   uint32_t ring_buffer_size,
+			   bool bpf_ringbuf,
+			   const char *state_snapshot,
+			   uint64_t state_snapshot_max_age_ms)
 {
 	uint32_t j;
 	char filename[SCAP_MAX_PATH_SIZE];
@@ -213,6 +281,25 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 		handle->m_bpf = false;
 	}
 
+	if(ring_buffer_size == SCAP_RING_BUFFER_SIZE_DEFAULT)
+	{
+		ring_buffer_size = handle->m_bpf ? getpagesize() * BPF_RING_BUF_SIZE_PAGES : RING_BUF_SIZE;
+	}
+
+	if(ring_buffer_size < MIN_RING_BUF_SIZE ||
+	   ring_buffer_size > MAX_RING_BUF_SIZE ||
+	   ring_buffer_size < 2 * (uint32_t)getpagesize() ||
+	   (ring_buffer_size & (ring_buffer_size - 1)) != 0)
+	{
+		scap_close(handle);
+		snprintf(error, SCAP_LASTERR_SIZE, "invalid ring buffer size %"PRIu32", it must be a power of two between %"PRIu32" and %"PRIu32" bytes, and at least two pages",
+			 ring_buffer_size, MIN_RING_BUF_SIZE, MAX_RING_BUF_SIZE);
+		*rc = SCAP_FAILURE;
+		return NULL;
+	}
+
+	handle->m_ring_buffer_size = ring_buffer_size;
+
 	handle->m_ncpus = sysconf(_SC_NPROCESSORS_CONF);
 	if(handle->m_ncpus == -1)
 	{
@@ -275,10 +362,16 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 	handle->m_win_descs_handle = NULL;
 #endif
 
+	//
+	// Load the tables from the snapshot, if any
+	//
+	scap_load_state_snapshot(handle, state_snapshot, state_snapshot_max_age_ms, import_users);
+
 	//
 	// Create the interface list
 	//
-	if((*rc = scap_create_iflist(handle)) != SCAP_SUCCESS)
+	if(!handle->m_state_snapshot_loaded &&
+	   (*rc = scap_create_iflist(handle)) != SCAP_SUCCESS)
 	{
 		scap_close(handle);
 		snprintf(error, SCAP_LASTERR_SIZE, "error creating the interface list");
@@ -288,7 +381,11 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 	//
 	// Create the user list
 	//
-	if(import_users)
+	if(handle->m_state_snapshot_loaded)
+	{
+		// loaded with the snapshot
+	}
+	else if(import_users)
 	{
 		if((*rc = scap_create_userlist(handle)) != SCAP_SUCCESS)
 		{
@@ -328,6 +425,8 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 	//
 	if(handle->m_bpf)
 	{
+		handle->m_bpf_ringbuf = bpf_ringbuf;
+
 		if((*rc = scap_bpf_load(handle, bpf_probe)) != SCAP_SUCCESS)
 		{
 			snprintf(error, SCAP_LASTERR_SIZE, "%s", handle->m_lasterr);
@@ -337,13 +436,13 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 	}
 	else
 	{
-		int len;
+		size_t len;
 		uint32_t all_scanned_devs;
 
 		//
 		// Allocate the device descriptors.
 		//
-		len = RING_BUF_SIZE * 2;
+		len = (size_t)handle->m_ring_buffer_size * 2;
 
 		for(j = 0, all_scanned_devs = 0; j < handle->m_ndevs && all_scanned_devs < handle->m_ncpus; ++all_scanned_devs)
 		{
@@ -384,6 +483,15 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 				return NULL;
 			}
 
+			if(j == 0 &&
+			   (*rc = set_driver_ring_buffer_size(handle, handle->m_devs[j].m_fd, handle->m_ring_buffer_size, error)) != SCAP_SUCCESS)
+			{
+				// scap_close() only closes the mapped devices
+				close(handle->m_devs[j].m_fd);
+				scap_close(handle);
+				return NULL;
+			}
+
 			//
 			// Map the ring buffer
 			//
@@ -443,11 +551,12 @@ scap_t* scap_open_live_int(char *error, int32_t *rc,
 	}
 
 	//
-	// Create the process list
+	// Create the process list, unless it comes from the snapshot
 	//
 	error[0] = '\0';
 	snprintf(filename, sizeof(filename), "%s/proc", scap_get_host_root());
-	if((*rc = scap_proc_scan_proc_dir(handle, filename, error)) != SCAP_SUCCESS)
+	if(!handle->m_state_snapshot_loaded &&
+	   (*rc = scap_proc_scan_proc_dir(handle, filename, error)) != SCAP_SUCCESS)
 	{
 		scap_close(handle);
 		snprintf(error, SCAP_LASTERR_SIZE, "scap_open_live_int() error creating the process list. Make sure you have root credentials.");
@@ -817,7 +926,7 @@ scap_t* scap_open_offline_fd(int fd, char *error, int32_t *rc)
 
 scap_t* scap_open_live(char *error, int32_t *rc)
 {
-	return scap_open_live_int(error, rc, NULL, NULL, true, NULL, NULL, NULL, SCAP_PROC_SCAN_TIMEOUT_NONE, SCAP_PROC_SCAN_LOG_NONE);
+	return scap_open_live_int(error, rc, NULL, NULL, true, NULL, NULL, NULL, SCAP_PROC_SCAN_TIMEOUT_NONE, SCAP_PROC_SCAN_LOG_NONE, SCAP_RING_BUFFER_SIZE_DEFAULT, false, NULL, 0);
 }
 
 scap_t* scap_open_nodriver_int(char *error, int32_t *rc,
@@ -826,7 +935,9 @@ scap_t* scap_open_nodriver_int(char *error, int32_t *rc,
 			       bool import_users,
 			       void(*debug_log_fn)(const char* msg),
 			       uint64_t proc_scan_timeout_ms,
-			       uint64_t proc_scan_log_interval_ms)
+			       uint64_t proc_scan_log_interval_ms,
+			       const char *state_snapshot,
+			       uint64_t state_snapshot_max_age_ms)
 {
 #if !defined(HAS_CAPTURE)
 	snprintf(error, SCAP_LASTERR_SIZE, "live capture not supported on %s", PLATFORM_NAME);
@@ -892,10 +1003,16 @@ scap_t* scap_open_nodriver_int(char *error, int32_t *rc,
 	handle->m_win_descs_handle = NULL;
 #endif
 
+	//
+	// Load the tables from the snapshot, if any
+	//
+	scap_load_state_snapshot(handle, state_snapshot, state_snapshot_max_age_ms, import_users);
+
 	//
 	// Create the interface list
 	//
-	if((*rc = scap_create_iflist(handle)) != SCAP_SUCCESS)
+	if(!handle->m_state_snapshot_loaded &&
+	   (*rc = scap_create_iflist(handle)) != SCAP_SUCCESS)
 	{
 		scap_close(handle);
 		snprintf(error, SCAP_LASTERR_SIZE, "error creating the interface list");
@@ -905,7 +1022,11 @@ scap_t* scap_open_nodriver_int(char *error, int32_t *rc,
 	//
 	// Create the user list
 	//
-	if(import_users)
+	if(handle->m_state_snapshot_loaded)
+	{
+		// loaded with the snapshot
+	}
+	else if(import_users)
 	{
 		if((*rc = scap_create_userlist(handle)) != SCAP_SUCCESS)
 		{
@@ -928,17 +1049,19 @@ scap_t* scap_open_nodriver_int(char *error, int32_t *rc,
 	handle->refresh_proc_table_when_saving = true;
 
 	//
-	// Create the process list
+	// Create the process list, unless it comes from the snapshot
 	//
 	error[0] = '\0';
 	snprintf(filename, sizeof(filename), "%s/proc", scap_get_host_root());
-	if((*rc = scap_proc_scan_proc_dir(handle, filename, error)) != SCAP_SUCCESS)
+	if(!handle->m_state_snapshot_loaded &&
+	   (*rc = scap_proc_scan_proc_dir(handle, filename, error)) != SCAP_SUCCESS)
 	{
 		scap_close(handle);
 		snprintf(error, SCAP_LASTERR_SIZE, "scap_open_live() error creating the process list. Make sure you have root credentials.");
 		return NULL;
 	}
 
+	*rc = SCAP_SUCCESS;
 	return handle;
 #endif // HAS_CAPTURE
 }
@@ -1000,7 +1123,11 @@ scap_t* scap_open(scap_open_args args, char *error, int32_t *rc)
 						args.suppressed_comms,
 						args.debug_log_fn,
 						args.proc_scan_timeout_ms,
-						args.proc_scan_log_interval_ms);
+						args.proc_scan_log_interval_ms,
+						args.ring_buffer_size,
+						args.bpf_ringbuf,
+						args.state_snapshot,
+						args.state_snapshot_max_age_ms);
 		}
 #else
 		snprintf(error,	SCAP_LASTERR_SIZE, "scap_open: live mode currently not supported on windows. Use nodriver mode instead.");
@@ -1013,7 +1140,9 @@ scap_t* scap_open(scap_open_args args, char *error, int32_t *rc)
 					      args.import_users,
 					      args.debug_log_fn,
 					      args.proc_scan_timeout_ms,
-					      args.proc_scan_log_interval_ms);
+					      args.proc_scan_log_interval_ms,
+					      args.state_snapshot,
+					      args.state_snapshot_max_age_ms);
 	case SCAP_MODE_NONE:
 		// error
 		break;
@@ -1100,7 +1229,7 @@ void scap_close(scap_t* handle)
 					if(handle->m_devs[j].m_buffer != MAP_FAILED)
 					{
 						munmap(handle->m_devs[j].m_bufinfo, sizeof(struct ppm_ring_buffer_info));
-						munmap(handle->m_devs[j].m_buffer, RING_BUF_SIZE * 2);
+						munmap(handle->m_devs[j].m_buffer, (size_t)handle->m_ring_buffer_size * 2);
 						close(handle->m_devs[j].m_fd);
 					}
 				}
@@ -1215,9 +1344,9 @@ uint32_t scap_get_ndevs(scap_t* handle)
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT)
 
 #ifndef _WIN32
-static inline void get_buf_pointers(struct ppm_ring_buffer_info* bufinfo, uint32_t* phead, uint32_t* ptail, uint64_t* pread_size)
+static inline void get_buf_pointers(struct ppm_ring_buffer_info* bufinfo, uint32_t buffer_size, uint32_t* phead, uint32_t* ptail, uint64_t* pread_size)
 #else
-void get_buf_pointers(struct ppm_ring_buffer_info* bufinfo, uint32_t* phead, uint32_t* ptail, uint64_t* pread_size)
+void get_buf_pointers(struct ppm_ring_buffer_info* bufinfo, uint32_t buffer_size, uint32_t* phead, uint32_t* ptail, uint64_t* pread_size)
 #endif
 {
 	*phead = bufinfo->head;
@@ -1225,7 +1354,7 @@ void get_buf_pointers(struct ppm_ring_buffer_info* bufinfo, uint32_t* phead, uin
 
 	if(*ptail > *phead)
 	{
-		*pread_size = RING_BUF_SIZE - *ptail + *phead;
+		*pread_size = buffer_size - *ptail + *phead;
 	}
 	else
 	{
@@ -1263,13 +1392,13 @@ static void scap_advance_tail(scap_t* handle, uint32_t cpuid)
 	__sync_synchronize();
 #endif
 
-	if(ttail < RING_BUF_SIZE)
+	if(ttail < handle->m_ring_buffer_size)
 	{
 		handle->m_devs[cpuid].m_bufinfo->tail = ttail;
 	}
 	else
 	{
-		handle->m_devs[cpuid].m_bufinfo->tail = ttail - RING_BUF_SIZE;
+		handle->m_devs[cpuid].m_bufinfo->tail = ttail - handle->m_ring_buffer_size;
 	}
 
 	handle->m_devs[cpuid].m_lastreadsize = 0;
@@ -1292,6 +1421,7 @@ int32_t scap_readbuf(scap_t* handle, uint32_t cpuid, OUT char** buf, OUT uint32_
 	// Read the pointers.
 	//
 	get_buf_pointers(handle->m_devs[cpuid].m_bufinfo,
+	                 handle->m_ring_buffer_size,
 	                 &thead,
 	                 &ttail,
 	                 &read_size);
@@ -1328,7 +1458,7 @@ static uint64_t buf_size_used(scap_t* handle, uint32_t cpu)
 		uint32_t thead;
 		uint32_t ttail;
 
-		get_buf_pointers(handle->m_devs[cpu].m_bufinfo, &thead, &ttail, &read_size);
+		get_buf_pointers(handle->m_devs[cpu].m_bufinfo, handle->m_ring_buffer_size, &thead, &ttail, &read_size);
 	}
 
 	return read_size;
@@ -1416,6 +1546,33 @@ static int32_t scap_next_live(scap_t* handle, OUT scap_evt** pevent, OUT uint16_
 	scap_evt* pe = NULL;
 	uint32_t ndevs = handle->m_ndevs;
 
+#ifndef _WIN32
+	if(handle->m_bpf_ringbuf)
+	{
+		//
+		// A single ring buffer shared by all the CPUs: the records come
+		// out in the order they were reserved, when each event is
+		// submitted, while the timestamp is taken when it starts. Events
+		// of different CPUs can therefore be slightly out of timestamp
+		// order; those of a given thread never are.
+		//
+		int32_t res = scap_bpf_ringbuf_next(handle, pevent, pcpuid);
+
+		if(res == SCAP_TIMEOUT)
+		{
+			usleep(handle->m_buffer_empty_wait_time_us);
+			handle->m_buffer_empty_wait_time_us = MIN(handle->m_buffer_empty_wait_time_us * 2,
+								  BUFFER_EMPTY_WAIT_TIME_US_MAX);
+		}
+		else
+		{
+			handle->m_buffer_empty_wait_time_us = BUFFER_EMPTY_WAIT_TIME_US_START;
+		}
+
+		return res;
+	}
+#endif
+
 	*pcpuid = 65535;
 
 	for(j = 0; j < ndevs; j++)
@@ -1621,6 +1778,13 @@ uint64_t scap_max_buf_used(scap_t* handle)
 	uint64_t i;
 	uint64_t max = 0;
 
+#ifndef _WIN32
+	if(handle->m_bpf_ringbuf)
+	{
+		return scap_bpf_ringbuf_used(handle);
+	}
+#endif
+
 	for(i = 0; i < handle->m_ndevs; i++)
 	{
 		uint64_t size = buf_size_used(handle, (uint32_t)i);
@@ -1633,6 +1797,27 @@ uint64_t scap_max_buf_used(scap_t* handle)
 #endif
 }
 
+uint64_t scap_get_buf_size(scap_t* handle)
+{
+#if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT)
+	if(handle->m_mode != SCAP_MODE_LIVE || handle->m_udig)
+	{
+		return 0;
+	}
+
+#ifndef _WIN32
+	if(handle->m_bpf_ringbuf)
+	{
+		return handle->m_bpf_ringbuf_size;
+	}
+#endif
+
+	return handle->m_ring_buffer_size;
+#else
+	return 0;
+#endif
+}
+
 int32_t scap_next(scap_t* handle, OUT scap_evt** pevent, OUT uint16_t* pcpuid)
 {
 	int32_t res = SCAP_FAILURE;
@@ -1707,6 +1892,7 @@ int32_t scap_get_stats(scap_t* handle, OUT scap_stats* stats)
 	stats->n_preemptions = 0;
 	stats->n_suppressed = handle->m_num_suppressed_evts;
 	stats->n_tids_suppressed = HASH_COUNT(handle->m_suppressed_tids);
+	stats->ring_buffer_size = handle->m_mode == SCAP_MODE_LIVE ? handle->m_ring_buffer_size : 0;
 
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT)
 	if(handle->m_bpf)
@@ -2493,6 +2679,11 @@ const char *scap_get_bpf_probe_from_env()
 	return getenv(SYSDIG_BPF_PROBE_ENV);
 }
 
+bool scap_state_snapshot_loaded(scap_t *handle)
+{
+	return handle->m_state_snapshot_loaded;
+}
+
 bool scap_get_bpf_enabled(scap_t *handle)
 {
 	if(handle)
@@ -2529,6 +2720,38 @@ int32_t scap_suppress_events_comm(scap_t *handle, const char *comm)
 	return SCAP_SUCCESS;
 }
 
+int32_t scap_suppress_tid(scap_t *handle, int64_t tid)
+{
+	scap_tid *stid;
+	HASH_FIND_INT64(handle->m_suppressed_tids, &tid, stid);
+
+	if(stid != NULL)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	stid = (scap_tid *) calloc(sizeof(scap_tid), 1);
+	if(stid == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't add tid to suppressed hash table");
+		return SCAP_FAILURE;
+	}
+
+	stid->tid = tid;
+	int32_t uth_status = SCAP_SUCCESS;
+
+	HASH_ADD_INT64(handle->m_suppressed_tids, tid, stid);
+
+	if(uth_status != SCAP_SUCCESS)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't add tid to suppressed hash table");
+		free(stid);
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
 bool scap_check_suppressed_tid(scap_t *handle, int64_t tid)
 {
 	scap_tid *stid;
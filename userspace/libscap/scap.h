@@ -96,6 +96,12 @@ struct iovec;
 //
 #define SCAP_PROC_SCAN_LOG_NONE 0
 
+//
+// Value for ring_buffer_size field in scap_open_args, to use the default
+// size of the driver
+//
+#define SCAP_RING_BUFFER_SIZE_DEFAULT 0
+
 
 /*!
   \brief Statistics about an in progress capture
@@ -110,6 +116,7 @@ typedef struct scap_stats
 	uint64_t n_preemptions; ///< Number of preemptions.
 	uint64_t n_suppressed; ///< Number of events skipped due to the tid being in a set of suppressed tids
 	uint64_t n_tids_suppressed; ///< Number of threads currently being suppressed
+	uint64_t ring_buffer_size; ///< Size in bytes of each per-CPU ring buffer, 0 if not a live capture
 }scap_stats;
 
 /*!
@@ -321,6 +328,10 @@ typedef struct scap_open_args
 	void(*debug_log_fn)(const char* msg); // Function which SCAP may use to log a debug message
 	uint64_t proc_scan_timeout_ms; // Timeout in msec, after which so-far-successful scan of /proc should be cut short with success return
 	uint64_t proc_scan_log_interval_ms; // Interval for logging progress messages from /proc scan
+	uint32_t ring_buffer_size; ///< Size in bytes of each per-CPU ring buffer of live kmod and BPF captures: a power of two, between 64 KB (or two pages) and 1 GB, or SCAP_RING_BUFFER_SIZE_DEFAULT.
+	bool bpf_ringbuf; ///< If true, BPF captures use a single ring buffer shared by all the CPUs (BPF_MAP_TYPE_RINGBUF, kernel 5.8+), of ring_buffer_size bytes per CPU, instead of the per-CPU perf buffers. The events then come in the order they were submitted: those of a thread are in timestamp order, those of different CPUs may be slightly out of it.
+	const char* state_snapshot; ///< If not NULL, a file written by a previous live capture (with scap_state_snapshot_open(), without events), whose process, fd, user and interface tables are loaded instead of scanning the system. If it can't be loaded, was written before the last reboot or is too old, the system is scanned.
+	uint64_t state_snapshot_max_age_ms; ///< The state_snapshot is ignored if it was written more than this ago. 0 means no limit.
 }scap_open_args;
 
 
@@ -657,6 +668,12 @@ const char* scap_getlasterr(scap_t* handle);
  */
 uint64_t scap_max_buf_used(scap_t* handle);
 
+/*!
+ * \brief returns the size of each of the driver queues measured by
+ *        scap_max_buf_used(), 0 if the capture is not live
+ */
+uint64_t scap_get_buf_size(scap_t* handle);
+
 /*!
   \brief Get the next event from the from the given capture instance
 
@@ -743,6 +760,39 @@ int64_t scap_get_readfile_offset(scap_t* handle);
 */
 scap_dumper_t* scap_dump_open(scap_t *handle, const char *fname, compression_mode compress, bool skip_proc_scan);
 
+/*!
+  \brief Open a state snapshot for writing, see scap_open_args.state_snapshot
+
+  Like scap_dump_open() without compression and without the process
+  table, but the file also records the boot id of the system and its
+  creation time, so that it's not loaded after a reboot or when too old.
+
+  \param handle Handle to the capture instance.
+  \param fname The name of the snapshot file.
+
+  \return Dump handle, or NULL if the file can't be opened or the boot id
+  can't be read.
+*/
+scap_dumper_t* scap_state_snapshot_open(scap_t *handle, const char *fname);
+
+/*!
+  \brief Open a trace file for writing, without writing the file header
+         and the process, fd, interface and user tables.
+
+  The caller must write them before any event, for example by appending,
+  with \ref scap_dump_append, a dump opened with \ref scap_managed_dump_open.
+  This function doesn't use the capture instance, so it can be called
+  from any thread.
+
+  \param fname The name of the trace file.
+  \param compress The compression mode.
+  \param error Pointer to a buffer that will contain the error string in case
+    the function fails. The buffer must have size SCAP_LASTERR_SIZE.
+
+  \return Dump handle that can be used to identify this specific dump instance.
+*/
+scap_dumper_t* scap_dump_open_raw(const char *fname, compression_mode compress, char *error);
+
 /*!
   \brief Open a trace file for writing, using the provided fd.
 
@@ -996,6 +1046,12 @@ const char *scap_get_bpf_probe_from_env();
 
 bool scap_get_bpf_enabled(scap_t* handle);
 
+/*!
+  \brief return whether the tables of the live capture were loaded from
+  scap_open_args.state_snapshot, rather than from the system.
+*/
+bool scap_state_snapshot_loaded(scap_t* handle);
+
 /*!
   \brief stop returning events for all subsequently spawned
   processes with the provided comm, as well as their children.
@@ -1008,6 +1064,14 @@ bool scap_get_bpf_enabled(scap_t* handle);
 
 int32_t scap_suppress_events_comm(scap_t* handle, const char *comm);
 
+/*!
+  \brief stop returning events for the provided tid. The suppression
+  ends when the thread exits, or when it forks or execs with a comm
+  that isn't suppressed.
+*/
+
+int32_t scap_suppress_tid(scap_t *handle, int64_t tid);
+
 /*!
   \brief return whether the provided tid is currently being suppressed.
 */
@@ -1038,6 +1102,12 @@ uint32_t scap_event_get_sentinel_begin(scap_evt* e);
 // The returned pointer must be freed via scap_proc_free by the caller.
 struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_sockets);
 
+// Read the fd table of a process from /proc, without going through the
+// proc callback. Only tid, pid and fdlist of the returned threadinfo are
+// set; it must be freed via scap_proc_free by the caller. Returns NULL
+// if the process is gone.
+struct scap_threadinfo* scap_proc_read_fds(scap_t* handle, int64_t pid, bool scan_sockets);
+
 // Check if the given thread exists in ;proc
 bool scap_is_thread_alive(scap_t* handle, int64_t pid, int64_t tid, const char* comm);
 
@@ -1066,6 +1136,10 @@ uint64_t scap_get_unexpected_block_readsize(scap_t* handle);
 int32_t scap_proc_add(scap_t* handle, uint64_t tid, scap_threadinfo* tinfo);
 int32_t scap_fd_add(scap_t *handle, scap_threadinfo* tinfo, uint64_t fd, scap_fdinfo* fdinfo);
 scap_dumper_t *scap_memory_dump_open(scap_t *handle, uint8_t* targetbuf, uint64_t targetbufsize);
+scap_dumper_t *scap_managed_dump_open(scap_t *handle, uint64_t initial_size, bool write_header);
+int32_t scap_dump_append(scap_dumper_t *d, scap_dumper_t *src, char *error);
+int32_t scap_dump_to_buffer(scap_t *handle, uint8_t *buf, uint64_t buflen, scap_evt *e, uint16_t cpuid, uint32_t flags, uint32_t *written);
+int32_t scap_dump_raw(scap_t *handle, scap_dumper_t *d, const uint8_t *buf, uint32_t len);
 #ifdef USE_ZLIB
 int32_t compr(uint8_t* dest, uint64_t* destlen, const uint8_t* source, uint64_t sourcelen, int level);
 #endif
@@ -24,6 +24,7 @@ limitations under the License.
 #include <sys/socket.h>
 #include <sys/syscall.h>
 #include <sys/utsname.h>
+#include <unistd.h>
 #include <gelf.h>
 #include <fcntl.h>
 #include <errno.h>
@@ -60,8 +61,6 @@ struct bpf_map_data {
 	struct bpf_map_def def;
 };
 
-static const int BUF_SIZE_PAGES = 2048;
-
 static const int BPF_LOG_SIZE = 1 << 18;
 
 static char* license;
@@ -370,6 +369,12 @@ static int32_t load_maps(scap_t *handle, struct bpf_map_data *maps, int nr_maps)
 			maps[j].def.max_entries = handle->m_ncpus;
 		}
 
+		if(maps[j].def.type == BPF_MAP_TYPE_RINGBUF)
+		{
+			// the smallest size possible, if it's not used
+			maps[j].def.max_entries = handle->m_bpf_ringbuf ? handle->m_bpf_ringbuf_size : getpagesize();
+		}
+
 		handle->m_bpf_map_fds[j] = bpf_map_create(maps[j].def.type,
 							  maps[j].def.key_size,
 							  maps[j].def.value_size,
@@ -388,6 +393,10 @@ static int32_t load_maps(scap_t *handle, struct bpf_map_data *maps, int nr_maps)
 		{
 			handle->m_bpf_prog_array_map_idx = j;
 		}
+		else if(maps[j].def.type == BPF_MAP_TYPE_RINGBUF)
+		{
+			handle->m_bpf_ringbuf_map_idx = j;
+		}
 	}
 
 	return SCAP_SUCCESS;
@@ -809,10 +818,10 @@ cleanup:
 
 static void *perf_event_mmap(scap_t *handle, int fd)
 {
-	int page_size = getpagesize();
-	int ring_size = page_size * BUF_SIZE_PAGES;
-	int header_size = page_size;
-	int total_size = ring_size * 2 + header_size;
+	size_t page_size = getpagesize();
+	size_t ring_size = handle->m_ring_buffer_size;
+	size_t header_size = page_size;
+	size_t total_size = ring_size * 2 + header_size;
 
 	//
 	// All this playing with MAP_FIXED might be very very wrong, revisit
@@ -1209,14 +1218,47 @@ int32_t scap_bpf_enable_tracers_capture(scap_t* handle)
 	return SCAP_SUCCESS;
 }
 
+static int32_t ringbuf_mmap(scap_t *handle)
+{
+	size_t page_size = getpagesize();
+	int fd = handle->m_bpf_map_fds[handle->m_bpf_ringbuf_map_idx];
+	void *p;
+
+	//
+	// The consumer position is on the first page, the only writable one,
+	// followed by the producer position and by the data, mapped twice
+	//
+	p = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if(p == MAP_FAILED)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "ring buffer mmap (1): %s", scap_strerror(handle, errno));
+		return SCAP_FAILURE;
+	}
+
+	handle->m_bpf_ringbuf_consumer_pos = p;
+
+	p = mmap(NULL, page_size + (size_t)handle->m_bpf_ringbuf_size * 2, PROT_READ, MAP_SHARED, fd, page_size);
+	if(p == MAP_FAILED)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "ring buffer mmap (2): %s", scap_strerror(handle, errno));
+		return SCAP_FAILURE;
+	}
+
+	handle->m_bpf_ringbuf_producer_pos = p;
+	handle->m_bpf_ringbuf_data = (char *)p + page_size;
+	handle->m_bpf_ringbuf_cons = *handle->m_bpf_ringbuf_consumer_pos;
+
+	return SCAP_SUCCESS;
+}
+
 int32_t scap_bpf_close(scap_t *handle)
 {
 	int j;
 
-	int page_size = getpagesize();
-	int ring_size = page_size * BUF_SIZE_PAGES;
-	int header_size = page_size;
-	int total_size = ring_size * 2 + header_size;
+	size_t page_size = getpagesize();
+	size_t ring_size = handle->m_ring_buffer_size;
+	size_t header_size = page_size;
+	size_t total_size = ring_size * 2 + header_size;
 
 	for(j = 0; j < handle->m_ndevs; j++)
 	{
@@ -1237,6 +1279,22 @@ int32_t scap_bpf_close(scap_t *handle)
 		}
 	}
 
+	if(handle->m_bpf_ringbuf_consumer_pos != NULL)
+	{
+		munmap(handle->m_bpf_ringbuf_consumer_pos, page_size);
+		handle->m_bpf_ringbuf_consumer_pos = NULL;
+	}
+
+	if(handle->m_bpf_ringbuf_producer_pos != NULL)
+	{
+		munmap(handle->m_bpf_ringbuf_producer_pos, page_size + (size_t)handle->m_bpf_ringbuf_size * 2);
+		handle->m_bpf_ringbuf_producer_pos = NULL;
+		handle->m_bpf_ringbuf_data = NULL;
+	}
+
+	free(handle->m_bpf_cpu_to_dev);
+	handle->m_bpf_cpu_to_dev = NULL;
+
 	for(j = 0; j < sizeof(handle->m_bpf_event_fd) / sizeof(handle->m_bpf_event_fd[0]); ++j)
 	{
 		if(handle->m_bpf_event_fd[j] > 0)
@@ -1389,6 +1447,7 @@ static int32_t set_default_settings(scap_t *handle)
 	settings.is_dropping = false;
 	settings.tracers_enabled = false;
 	settings.skb_capture = false;
+	settings.ringbuf_enabled = handle->m_bpf_ringbuf;
 	settings.fullcapture_port_range_start = 0;
 	settings.fullcapture_port_range_end = 0;
 	settings.statsd_port = 8125;
@@ -1422,6 +1481,7 @@ int32_t scap_bpf_load(scap_t *handle, const char *bpf_probe)
 	}
 
 	handle->m_bpf_prog_array_map_idx = -1;
+	handle->m_bpf_ringbuf_map_idx = -1;
 
 	if(!bpf_probe)
 	{
@@ -1429,11 +1489,40 @@ int32_t scap_bpf_load(scap_t *handle, const char *bpf_probe)
 		return SCAP_FAILURE;
 	}
 
+	if(handle->m_bpf_ringbuf)
+	{
+		//
+		// The shared ring buffer gets the memory of the per-CPU ones
+		//
+		uint64_t size = handle->m_ring_buffer_size;
+
+		while(size < (uint64_t)handle->m_ring_buffer_size * handle->m_ndevs &&
+		      size < BPF_RINGBUF_MAX_SIZE)
+		{
+			size <<= 1;
+		}
+
+		handle->m_bpf_ringbuf_size = (uint32_t)size;
+
+		handle->m_bpf_cpu_to_dev = calloc(handle->m_ncpus, sizeof(uint16_t));
+		if(handle->m_bpf_cpu_to_dev == NULL)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error allocating the CPU table");
+			return SCAP_FAILURE;
+		}
+	}
+
 	if(load_bpf_file(handle, bpf_probe) != SCAP_SUCCESS)
 	{
 		return SCAP_FAILURE;
 	}
 
+	if(handle->m_bpf_ringbuf && handle->m_bpf_ringbuf_map_idx == -1)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "the BPF probe doesn't support the ring buffer, it must be built for kernel 5.8 or later");
+		return SCAP_FAILURE;
+	}
+
 	if(populate_syscall_routing_table_map(handle) != SCAP_SUCCESS)
 	{
 		return SCAP_FAILURE;
@@ -1504,6 +1593,13 @@ int32_t scap_bpf_load(scap_t *handle, const char *bpf_probe)
 			return SCAP_FAILURE;
 		}
 
+		if(handle->m_bpf_ringbuf)
+		{
+			handle->m_bpf_cpu_to_dev[j] = online_cpu;
+			++online_cpu;
+			continue;
+		}
+
 		pmu_fd = sys_perf_event_open(&attr, -1, j, -1, 0);
 		if(pmu_fd < 0)
 		{
@@ -1543,6 +1639,11 @@ int32_t scap_bpf_load(scap_t *handle, const char *bpf_probe)
 		return SCAP_FAILURE;
 	}
 
+	if(handle->m_bpf_ringbuf && ringbuf_mmap(handle) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
 	if(set_default_settings(handle) != SCAP_SUCCESS)
 	{
 		return SCAP_FAILURE;
@@ -1631,6 +1732,7 @@ int32_t scap_bpf_disable_skb_capture(scap_t *handle)
 	}
 
 	settings.skb_capture = false;
+	settings.ringbuf_enabled = handle->m_bpf_ringbuf;
 	memset(settings.if_name, 0, 16);
 	if(bpf_map_update_elem(handle->m_bpf_map_fds[SYSDIG_SETTINGS_MAP], &k, &settings, BPF_ANY) != 0)
 	{
@@ -18,6 +18,7 @@ limitations under the License.
 #define _SCAP_BPF_H
 
 #include "compat/perf_event.h"
+#include "compat/bpf.h"
 
 struct perf_event_sample {
 	struct perf_event_header header;
@@ -31,6 +32,12 @@ struct perf_lost_sample {
 	uint64_t lost;
 };
 
+// default size of the perf ring buffers, in pages
+static const int BPF_RING_BUF_SIZE_PAGES = 2048;
+
+// largest size of the ring buffer shared by all the CPUs
+static const uint32_t BPF_RINGBUF_MAX_SIZE = 1024 * 1024 * 1024;
+
 int32_t scap_bpf_load(scap_t *handle, const char *bpf_probe);
 int32_t scap_bpf_start_capture(scap_t *handle);
 int32_t scap_bpf_stop_capture(scap_t *handle);
@@ -196,4 +203,66 @@ static inline int32_t scap_bpf_readbuf(scap_t *handle, uint32_t cpuid, char **bu
 	return scap_bpf_advance_to_evt(handle, cpuid, false, p, buf, len);
 }
 
+static inline uint64_t scap_bpf_ringbuf_used(scap_t *handle)
+{
+	return __atomic_load_n(handle->m_bpf_ringbuf_producer_pos, __ATOMIC_ACQUIRE) -
+	       handle->m_bpf_ringbuf_cons;
+}
+
+//
+// Return the next event from the ring buffer shared by all the CPUs. The
+// space of the event returned by the previous call is given back to the
+// producers first: the caller is done with it.
+//
+static inline int32_t scap_bpf_ringbuf_next(scap_t *handle, scap_evt **pevent, uint16_t *pcpuid)
+{
+	uint64_t cons = handle->m_bpf_ringbuf_cons;
+	uint64_t prod;
+
+	__atomic_store_n(handle->m_bpf_ringbuf_consumer_pos, cons, __ATOMIC_RELEASE);
+
+	prod = __atomic_load_n(handle->m_bpf_ringbuf_producer_pos, __ATOMIC_ACQUIRE);
+
+	while(cons < prod)
+	{
+		uint32_t *hdr = (uint32_t *)(handle->m_bpf_ringbuf_data + (cons & (handle->m_bpf_ringbuf_size - 1)));
+		uint32_t len = __atomic_load_n(hdr, __ATOMIC_ACQUIRE);
+		scap_evt *evt;
+
+		if(len & BPF_RINGBUF_BUSY_BIT)
+		{
+			// reserved, but not committed yet
+			break;
+		}
+
+		cons += ((len & ~(BPF_RINGBUF_BUSY_BIT | BPF_RINGBUF_DISCARD_BIT)) + BPF_RINGBUF_HDR_SZ + 7) & ~7;
+
+		if(len & BPF_RINGBUF_DISCARD_BIT)
+		{
+			continue;
+		}
+
+		//
+		// The data is mapped twice, so the record is contiguous even
+		// if it wraps around. The probe appends the CPU id to the event.
+		//
+		evt = (scap_evt *)((char *)hdr + BPF_RINGBUF_HDR_SZ);
+		ASSERT(evt->len + sizeof(uint16_t) <= (len & ~BPF_RINGBUF_DISCARD_BIT));
+
+		*pevent = evt;
+		*pcpuid = handle->m_bpf_cpu_to_dev[*(uint16_t *)((char *)evt + evt->len) % handle->m_ncpus];
+		handle->m_bpf_ringbuf_cons = cons;
+		return SCAP_SUCCESS;
+	}
+
+	if(cons != handle->m_bpf_ringbuf_cons)
+	{
+		// only discarded records
+		__atomic_store_n(handle->m_bpf_ringbuf_consumer_pos, cons, __ATOMIC_RELEASE);
+		handle->m_bpf_ringbuf_cons = cons;
+	}
+
+	return SCAP_TIMEOUT;
+}
+
 #endif
@@ -1305,6 +1305,59 @@ struct scap_threadinfo* scap_proc_get(scap_t* handle, int64_t tid, bool scan_soc
 #endif // HAS_CAPTURE
 }
 
+struct scap_threadinfo* scap_proc_read_fds(scap_t* handle, int64_t pid, bool scan_sockets)
+{
+#if !defined(HAS_CAPTURE) || defined(_WIN32)
+	return NULL;
+#else
+	struct scap_ns_socket_list* sockets_by_ns = NULL;
+	proc_entry_callback proc_callback = handle->m_proc_callback;
+	struct scap_threadinfo* tinfo;
+	char procdir[SCAP_MAX_PATH_SIZE];
+	int32_t res;
+
+	if(handle->m_mode == SCAP_MODE_CAPTURE)
+	{
+		return NULL;
+	}
+
+	tinfo = scap_proc_alloc(handle);
+	if(tinfo == NULL)
+	{
+		return NULL;
+	}
+	tinfo->tid = pid;
+	tinfo->pid = pid;
+
+	if(!scan_sockets)
+	{
+		sockets_by_ns = (void*)-1;
+	}
+
+	//
+	// Keep the fds in the returned table rather than handing them to
+	// the callback
+	//
+	snprintf(procdir, sizeof(procdir), "%s/proc/%" PRId64 "/", scap_get_host_root(), pid);
+	handle->m_proc_callback = NULL;
+	res = scap_fd_scan_fd_dir(handle, procdir, tinfo, &sockets_by_ns, NULL, handle->m_lasterr);
+	handle->m_proc_callback = proc_callback;
+
+	if(sockets_by_ns != NULL && sockets_by_ns != (void*)-1)
+	{
+		scap_fd_free_ns_sockets_list(handle, &sockets_by_ns);
+	}
+
+	if(res != SCAP_SUCCESS)
+	{
+		scap_proc_free(handle, tinfo);
+		return NULL;
+	}
+
+	return tinfo;
+#endif // HAS_CAPTURE
+}
+
 bool scap_is_thread_alive(scap_t* handle, int64_t pid, int64_t tid, const char* comm)
 {
 #if !defined(HAS_CAPTURE)
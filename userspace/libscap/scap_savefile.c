@@ -21,6 +21,7 @@ limitations under the License.
 
 #ifndef WIN32
 #include <unistd.h>
+#include <sys/time.h>
 #include <sys/uio.h>
 #else
 struct iovec {
@@ -48,6 +49,34 @@ int scap_dump_write(scap_dumper_t *d, void* buf, unsigned len)
 	{
 		return gzwrite(d->m_f, buf, len);
 	}
+	else if(d->m_type == DT_MANAGED_BUF)
+	{
+		if(d->m_targetbufcurpos + len >= d->m_targetbufend)
+		{
+			uint64_t size = d->m_targetbufend - d->m_targetbuf;
+			uint64_t used = d->m_targetbufcurpos - d->m_targetbuf;
+			uint8_t* newbuf;
+
+			while(used + len >= size)
+			{
+				size *= 2;
+			}
+
+			newbuf = (uint8_t*)realloc(d->m_targetbuf, size);
+			if(newbuf == NULL)
+			{
+				return -1;
+			}
+
+			d->m_targetbuf = newbuf;
+			d->m_targetbufcurpos = newbuf + used;
+			d->m_targetbufend = newbuf + size;
+		}
+
+		memcpy(d->m_targetbufcurpos, buf, len);
+		d->m_targetbufcurpos += len;
+		return len;
+	}
 	else
 	{
 		if(d->m_targetbufcurpos + len < d->m_targetbufend)
@@ -919,9 +948,11 @@ static scap_dumper_t *scap_dump_open_gzfile(scap_t *handle, gzFile gzfile, const
 }
 
 //
-// Open a "savefile" for writing.
+// Open the gzFile for a "savefile", "-" being the standard output.
+// On failure, returns NULL and sets error, which must be at least
+// SCAP_LASTERR_SIZE bytes long.
 //
-scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mode compress, bool skip_proc_scan)
+static gzFile scap_dump_gzopen(const char **fname, compression_mode compress, char *error)
 {
 	gzFile f = NULL;
 	int fd = -1;
@@ -937,11 +968,11 @@ scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mod
 		break;
 	default:
 		ASSERT(false);
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid compression mode");
+		snprintf(error, SCAP_LASTERR_SIZE, "invalid compression mode");
 		return NULL;
 	}
 
-	if(fname[0] == '-' && fname[1] == '\0')
+	if((*fname)[0] == '-' && (*fname)[1] == '\0')
 	{
 #ifndef	WIN32
 		fd = dup(STDOUT_FILENO);
@@ -951,12 +982,12 @@ scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mod
 		if(fd != -1)
 		{
 			f = gzdopen(fd, mode);
-			fname = "standard output";
+			*fname = "standard output";
 		}
 	}
 	else
 	{
-		f = gzopen(fname, mode);
+		f = gzopen(*fname, mode);
 	}
 
 	if(f == NULL)
@@ -968,13 +999,61 @@ scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mod
 		}
 #endif
 
-		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open %s", fname);
+		snprintf(error, SCAP_LASTERR_SIZE, "can't open %s", *fname);
+		return NULL;
+	}
+
+	return f;
+}
+
+//
+// Open a "savefile" for writing.
+//
+scap_dumper_t *scap_dump_open(scap_t *handle, const char *fname, compression_mode compress, bool skip_proc_scan)
+{
+	gzFile f = scap_dump_gzopen(&fname, compress, handle->m_lasterr);
+
+	if(f == NULL)
+	{
 		return NULL;
 	}
 
 	return scap_dump_open_gzfile(handle, f, fname, skip_proc_scan);
 }
 
+//
+// Open a "savefile" for writing, without writing the file header and
+// the tables. The caller is responsible for writing them before any
+// event, typically by appending a managed dumper that contains them.
+// Doesn't need the capture handle, so it's safe to call it from any
+// thread.
+//
+scap_dumper_t *scap_dump_open_raw(const char *fname, compression_mode compress, char *error)
+{
+	gzFile f = scap_dump_gzopen(&fname, compress, error);
+
+	if(f == NULL)
+	{
+		return NULL;
+	}
+
+	scap_dumper_t* res = (scap_dumper_t*)malloc(sizeof(scap_dumper_t));
+	if(res == NULL)
+	{
+		gzclose(f);
+		snprintf(error, SCAP_LASTERR_SIZE, "scap_dump_open_raw memory allocation failure");
+		return NULL;
+	}
+
+	res->m_f = f;
+	res->m_type = DT_FILE;
+	res->m_targetbuf = NULL;
+	res->m_targetbufcurpos = NULL;
+	res->m_targetbufend = NULL;
+
+	return res;
+}
+
 //
 // Open a savefile for writing, using the provided fd
 scap_dumper_t* scap_dump_open_fd(scap_t *handle, int fd, compression_mode compress, bool skip_proc_scan)
@@ -1044,6 +1123,84 @@ scap_dumper_t *scap_memory_dump_open(scap_t *handle, uint8_t* targetbuf, uint64_
 	return res;
 }
 
+//
+// Open a memory "savefile" whose buffer is allocated by libscap, and
+// grown as needed. If write_header is false, only the events are
+// written: the buffer can then be appended to another dump.
+//
+scap_dumper_t *scap_managed_dump_open(scap_t *handle, uint64_t initial_size, bool write_header)
+{
+	if(initial_size == 0)
+	{
+		initial_size = 1;
+	}
+
+	scap_dumper_t* res = (scap_dumper_t*)malloc(sizeof(scap_dumper_t));
+	if(res == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "scap_managed_dump_open memory allocation failure (1)");
+		return NULL;
+	}
+
+	res->m_f = NULL;
+	res->m_type = DT_MANAGED_BUF;
+	res->m_targetbuf = (uint8_t*)malloc(initial_size);
+	if(res->m_targetbuf == NULL)
+	{
+		free(res);
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "scap_managed_dump_open memory allocation failure (2)");
+		return NULL;
+	}
+
+	res->m_targetbufcurpos = res->m_targetbuf;
+	res->m_targetbufend = res->m_targetbuf + initial_size;
+
+	if(write_header)
+	{
+		//
+		// Like for the other memory dumps, don't scan /proc: the tables
+		// are expected to come from the caller
+		//
+		bool tmp_refresh_proc_table_when_saving = handle->refresh_proc_table_when_saving;
+		handle->refresh_proc_table_when_saving = false;
+
+		if(scap_setup_dump(handle, res, "") != SCAP_SUCCESS)
+		{
+			free(res->m_targetbuf);
+			free(res);
+			res = NULL;
+		}
+
+		handle->refresh_proc_table_when_saving = tmp_refresh_proc_table_when_saving;
+	}
+
+	return res;
+}
+
+//
+// Append what has been written so far to a memory dump to another dump
+//
+int32_t scap_dump_append(scap_dumper_t *d, scap_dumper_t *src, char *error)
+{
+	unsigned len;
+
+	if(src->m_type == DT_FILE)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't append a file dump");
+		return SCAP_FAILURE;
+	}
+
+	len = (unsigned)(src->m_targetbufcurpos - src->m_targetbuf);
+
+	if(len != 0 && scap_dump_write(d, src->m_targetbuf, len) != (int)len)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "error writing to file (8)");
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
 //
 // Close a "savefile" opened with scap_dump_open
 //
@@ -1053,6 +1210,10 @@ void scap_dump_close(scap_dumper_t *d)
 	{
 		gzclose(d->m_f);
 	}
+	else if(d->m_type == DT_MANAGED_BUF)
+	{
+		free(d->m_targetbuf);
+	}
 
 	free(d);
 }
@@ -1160,6 +1321,44 @@ int32_t scap_dump(scap_t *handle, scap_dumper_t *d, scap_evt *e, uint16_t cpuid,
 	return SCAP_SUCCESS;
 }
 
+//
+// Serialize an event into a caller buffer, in the format used by
+// scap_dump, so that it can later be written with scap_dump_raw.
+// Fails, leaving the buffer partially written, if it's too small.
+//
+int32_t scap_dump_to_buffer(scap_t *handle, uint8_t *buf, uint64_t buflen, scap_evt *e, uint16_t cpuid, uint32_t flags, uint32_t *written)
+{
+	scap_dumper_t d;
+
+	d.m_f = NULL;
+	d.m_type = DT_MEM;
+	d.m_targetbuf = buf;
+	d.m_targetbufcurpos = buf;
+	d.m_targetbufend = buf + buflen;
+
+	if(scap_dump(handle, &d, e, cpuid, flags) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	*written = (uint32_t)(d.m_targetbufcurpos - buf);
+	return SCAP_SUCCESS;
+}
+
+//
+// Write events serialized with scap_dump_to_buffer to a dump file
+//
+int32_t scap_dump_raw(scap_t *handle, scap_dumper_t *d, const uint8_t *buf, uint32_t len)
+{
+	if(scap_dump_write(d, (void*)buf, len) != (int)len)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "error writing to file (9)");
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 ///////////////////////////////////////////////////////////////////////////////
 // READ FUNCTIONS
@@ -1184,20 +1383,111 @@ static int32_t scap_read_machine_info(scap_t *handle, gzFile f, uint32_t block_l
 	return SCAP_SUCCESS;
 }
 
+//
+// The block reader
+//
+int32_t scap_block_reader_begin(scap_t *handle, scap_block_reader *r, uint32_t block_length)
+{
+	size_t bufsize = block_length < SCAP_BLOCK_READER_BUF_SIZE ? block_length : SCAP_BLOCK_READER_BUF_SIZE;
+
+	// the previous block was consumed entirely
+	ASSERT(r->m_pos == r->m_len && r->m_remaining == 0);
+
+	if(bufsize > r->m_bufsize)
+	{
+		uint8_t *buf = (uint8_t *)realloc(r->m_buf, bufsize);
+		if(buf == NULL)
+		{
+			snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "memory allocation error in scap_block_reader_begin");
+			return SCAP_FAILURE;
+		}
+
+		r->m_buf = buf;
+		r->m_bufsize = bufsize;
+	}
+
+	r->m_len = 0;
+	r->m_pos = 0;
+	r->m_remaining = block_length;
+	return SCAP_SUCCESS;
+}
+
+//
+// Bring the next chunk of the block to memory. Returns false at the end
+// of the block, or if the file is truncated.
+//
+static bool scap_block_reader_fill(scap_block_reader *r)
+{
+	size_t toread = r->m_remaining < r->m_bufsize ? r->m_remaining : r->m_bufsize;
+	int readsize;
+
+	if(toread == 0)
+	{
+		return false;
+	}
+
+	readsize = (int)gzread(r->m_f, r->m_buf, (unsigned int)toread);
+	if(readsize <= 0)
+	{
+		r->m_remaining = 0;
+		return false;
+	}
+
+	r->m_len = (size_t)readsize;
+	r->m_pos = 0;
+	// after a short read, the rest of the block is not there
+	r->m_remaining = ((size_t)readsize == toread) ? r->m_remaining - toread : 0;
+	return true;
+}
+
+size_t scap_block_read(scap_block_reader *r, OUT void *target, size_t len)
+{
+	size_t nread = 0;
+
+	while(nread < len)
+	{
+		size_t n;
+
+		if(r->m_pos == r->m_len && !scap_block_reader_fill(r))
+		{
+			break;
+		}
+
+		n = r->m_len - r->m_pos;
+		if(n > len - nread)
+		{
+			n = len - nread;
+		}
+
+		if(target != NULL)
+		{
+			memcpy((uint8_t *)target + nread, r->m_buf + r->m_pos, n);
+		}
+
+		r->m_pos += n;
+		nread += n;
+	}
+
+	return nread;
+}
+
 //
 // Parse a process list block
 //
-static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_length, uint32_t block_type)
+static int32_t scap_read_proclist(scap_t *handle, scap_block_reader *r, uint32_t block_length, uint32_t block_type)
 {
 	size_t readsize;
 	size_t subreadsize = 0;
 	size_t totreadsize = 0;
 	size_t padding_len;
 	uint16_t stlen;
-	uint32_t padding;
 	int32_t uth_status = SCAP_SUCCESS;
 	uint32_t toread;
-	int fseekres;
+
+	if(scap_block_reader_begin(handle, r, block_length) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
 
 	while(((int32_t)block_length - (int32_t)totreadsize) >= 4)
 	{
@@ -1242,7 +1532,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		case PL_BLOCK_TYPE_V8:
 			break;
 		case PL_BLOCK_TYPE_V9:
-			readsize = gzread(f, &(sub_len), sizeof(uint32_t));
+			readsize = scap_block_read(r, &(sub_len), sizeof(uint32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 			subreadsize += readsize;
@@ -1256,7 +1546,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// tid
 		//
-		readsize = gzread(f, &(tinfo.tid), sizeof(uint64_t));
+		readsize = scap_block_read(r, &(tinfo.tid), sizeof(uint64_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 		subreadsize += readsize;
@@ -1264,7 +1554,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// pid
 		//
-		readsize = gzread(f, &(tinfo.pid), sizeof(uint64_t));
+		readsize = scap_block_read(r, &(tinfo.pid), sizeof(uint64_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 		subreadsize += readsize;
@@ -1272,7 +1562,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// ptid
 		//
-		readsize = gzread(f, &(tinfo.ptid), sizeof(uint64_t));
+		readsize = scap_block_read(r, &(tinfo.ptid), sizeof(uint64_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 		subreadsize += readsize;
@@ -1292,7 +1582,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		case PL_BLOCK_TYPE_V7:
 		case PL_BLOCK_TYPE_V8:
 		case PL_BLOCK_TYPE_V9:
-			readsize = gzread(f, &(tinfo.sid), sizeof(uint64_t));
+			readsize = scap_block_read(r, &(tinfo.sid), sizeof(uint64_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 			subreadsize += readsize;
@@ -1321,7 +1611,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 			break;
 		case PL_BLOCK_TYPE_V8:
 		case PL_BLOCK_TYPE_V9:
-			readsize = gzread(f, &(tinfo.vpgid), sizeof(uint64_t));
+			readsize = scap_block_read(r, &(tinfo.vpgid), sizeof(uint64_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 			subreadsize += readsize;
@@ -1335,7 +1625,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// comm
 		//
-		readsize = gzread(f, &(stlen), sizeof(uint16_t));
+		readsize = scap_block_read(r, &(stlen), sizeof(uint16_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 		if(stlen > SCAP_MAX_PATH_SIZE)
@@ -1346,7 +1636,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 		subreadsize += readsize;
 
-		readsize = gzread(f, tinfo.comm, stlen);
+		readsize = scap_block_read(r, tinfo.comm, stlen);
 		CHECK_READ_SIZE(readsize, stlen);
 
 		// the string is not null-terminated on file
@@ -1357,7 +1647,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// exe
 		//
-		readsize = gzread(f, &(stlen), sizeof(uint16_t));
+		readsize = scap_block_read(r, &(stlen), sizeof(uint16_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 		if(stlen > SCAP_MAX_PATH_SIZE)
@@ -1368,7 +1658,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 		subreadsize += readsize;
 
-		readsize = gzread(f, tinfo.exe, stlen);
+		readsize = scap_block_read(r, tinfo.exe, stlen);
 		CHECK_READ_SIZE(readsize, stlen);
 
 		// the string is not null-terminated on file
@@ -1394,7 +1684,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// exepath
 			//
-			readsize = gzread(f, &(stlen), sizeof(uint16_t));
+			readsize = scap_block_read(r, &(stlen), sizeof(uint16_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 			if(stlen > SCAP_MAX_PATH_SIZE)
@@ -1405,7 +1695,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 			subreadsize += readsize;
 
-			readsize = gzread(f, tinfo.exepath, stlen);
+			readsize = scap_block_read(r, tinfo.exepath, stlen);
 			CHECK_READ_SIZE(readsize, stlen);
 
 			// the string is not null-terminated on file
@@ -1423,7 +1713,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// args
 		//
-		readsize = gzread(f, &(stlen), sizeof(uint16_t));
+		readsize = scap_block_read(r, &(stlen), sizeof(uint16_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 		if(stlen > SCAP_MAX_ARGS_SIZE)
@@ -1434,7 +1724,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 		subreadsize += readsize;
 
-		readsize = gzread(f, tinfo.args, stlen);
+		readsize = scap_block_read(r, tinfo.args, stlen);
 		CHECK_READ_SIZE(readsize, stlen);
 
 		// the string is not null-terminated on file
@@ -1446,7 +1736,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// cwd
 		//
-		readsize = gzread(f, &(stlen), sizeof(uint16_t));
+		readsize = scap_block_read(r, &(stlen), sizeof(uint16_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 		if(stlen > SCAP_MAX_PATH_SIZE)
@@ -1457,7 +1747,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 		subreadsize += readsize;
 
-		readsize = gzread(f, tinfo.cwd, stlen);
+		readsize = scap_block_read(r, tinfo.cwd, stlen);
 		CHECK_READ_SIZE(readsize, stlen);
 
 		// the string is not null-terminated on file
@@ -1468,7 +1758,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// fdlimit
 		//
-		readsize = gzread(f, &(tinfo.fdlimit), sizeof(uint64_t));
+		readsize = scap_block_read(r, &(tinfo.fdlimit), sizeof(uint64_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 		subreadsize += readsize;
@@ -1476,7 +1766,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// flags
 		//
-		readsize = gzread(f, &(tinfo.flags), sizeof(uint32_t));
+		readsize = scap_block_read(r, &(tinfo.flags), sizeof(uint32_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 		subreadsize += readsize;
@@ -1484,7 +1774,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// uid
 		//
-		readsize = gzread(f, &(tinfo.uid), sizeof(uint32_t));
+		readsize = scap_block_read(r, &(tinfo.uid), sizeof(uint32_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 		subreadsize += readsize;
@@ -1492,7 +1782,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// gid
 		//
-		readsize = gzread(f, &(tinfo.gid), sizeof(uint32_t));
+		readsize = scap_block_read(r, &(tinfo.gid), sizeof(uint32_t));
 		CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 		subreadsize += readsize;
@@ -1515,7 +1805,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// vmsize_kb
 			//
-			readsize = gzread(f, &(tinfo.vmsize_kb), sizeof(uint32_t));
+			readsize = scap_block_read(r, &(tinfo.vmsize_kb), sizeof(uint32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 			subreadsize += readsize;
@@ -1523,7 +1813,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// vmrss_kb
 			//
-			readsize = gzread(f, &(tinfo.vmrss_kb), sizeof(uint32_t));
+			readsize = scap_block_read(r, &(tinfo.vmrss_kb), sizeof(uint32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 			subreadsize += readsize;
@@ -1531,7 +1821,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// vmswap_kb
 			//
-			readsize = gzread(f, &(tinfo.vmswap_kb), sizeof(uint32_t));
+			readsize = scap_block_read(r, &(tinfo.vmswap_kb), sizeof(uint32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 			subreadsize += readsize;
@@ -1539,7 +1829,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// pfmajor
 			//
-			readsize = gzread(f, &(tinfo.pfmajor), sizeof(uint64_t));
+			readsize = scap_block_read(r, &(tinfo.pfmajor), sizeof(uint64_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 			subreadsize += readsize;
@@ -1547,7 +1837,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// pfminor
 			//
-			readsize = gzread(f, &(tinfo.pfminor), sizeof(uint64_t));
+			readsize = scap_block_read(r, &(tinfo.pfminor), sizeof(uint64_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 			subreadsize += readsize;
@@ -1564,7 +1854,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 				//
 				// env
 				//
-				readsize = gzread(f, &(stlen), sizeof(uint16_t));
+				readsize = scap_block_read(r, &(stlen), sizeof(uint16_t));
 				CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 				if(stlen > SCAP_MAX_ENV_SIZE)
@@ -1575,7 +1865,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 				subreadsize += readsize;
 
-				readsize = gzread(f, tinfo.env, stlen);
+				readsize = scap_block_read(r, tinfo.env, stlen);
 				CHECK_READ_SIZE(readsize, stlen);
 
 				// the string is not null-terminated on file
@@ -1595,7 +1885,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 				//
 				// vtid
 				//
-				readsize = gzread(f, &(tinfo.vtid), sizeof(int64_t));
+				readsize = scap_block_read(r, &(tinfo.vtid), sizeof(int64_t));
 				CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 				subreadsize += readsize;
@@ -1603,7 +1893,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 				//
 				// vpid
 				//
-				readsize = gzread(f, &(tinfo.vpid), sizeof(int64_t));
+				readsize = scap_block_read(r, &(tinfo.vpid), sizeof(int64_t));
 				CHECK_READ_SIZE(readsize, sizeof(uint64_t));
 
 				subreadsize += readsize;
@@ -1611,7 +1901,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 				//
 				// cgroups
 				//
-				readsize = gzread(f, &(stlen), sizeof(uint16_t));
+				readsize = scap_block_read(r, &(stlen), sizeof(uint16_t));
 				CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 				if(stlen > SCAP_MAX_CGROUPS_SIZE)
@@ -1623,7 +1913,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 				subreadsize += readsize;
 
-				readsize = gzread(f, tinfo.cgroups, stlen);
+				readsize = scap_block_read(r, tinfo.cgroups, stlen);
 				CHECK_READ_SIZE(readsize, stlen);
 
 				subreadsize += readsize;
@@ -1634,7 +1924,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 				   block_type == PL_BLOCK_TYPE_V8 ||
 				   block_type == PL_BLOCK_TYPE_V9)
 				{
-					readsize = gzread(f, &(stlen), sizeof(uint16_t));
+					readsize = scap_block_read(r, &(stlen), sizeof(uint16_t));
 					CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 					if(stlen > SCAP_MAX_PATH_SIZE)
@@ -1645,7 +1935,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 					subreadsize += readsize;
 
-					readsize = gzread(f, tinfo.root, stlen);
+					readsize = scap_block_read(r, tinfo.root, stlen);
 					CHECK_READ_SIZE(readsize, stlen);
 
 					// the string is not null-terminated on file
@@ -1675,7 +1965,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		if(sub_len && (subreadsize + sizeof(int32_t)) <= sub_len)
 		{
-			readsize = gzread(f, &(tinfo.loginuid), sizeof(int32_t));
+			readsize = scap_block_read(r, &(tinfo.loginuid), sizeof(int32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 			subreadsize += readsize;
 		}
@@ -1721,8 +2011,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 				return SCAP_FAILURE;
 			}
 			toread = sub_len - subreadsize;
-			fseekres = (int)gzseek(f, (long)toread, SEEK_CUR);
-			if(fseekres == -1)
+			if(scap_block_read(r, NULL, toread) != toread)
 			{
 				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Can't skip %u bytes.",
 				         (unsigned int)toread);
@@ -1746,7 +2035,7 @@ static int32_t scap_read_proclist(scap_t *handle, gzFile f, uint32_t block_lengt
 	}
 	padding_len = block_length - totreadsize;
 
-	readsize = (size_t)gzread(f, &padding, (unsigned int)padding_len);
+	readsize = scap_block_read(r, NULL, padding_len);
 	CHECK_READ_SIZE(readsize, padding_len);
 
 	return SCAP_SUCCESS;
@@ -2118,17 +2407,15 @@ scap_read_iflist_error:
 //
 // Parse a user list block
 //
-static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_length, uint32_t block_type)
+static int32_t scap_read_userlist(scap_t *handle, scap_block_reader *r, uint32_t block_length, uint32_t block_type)
 {
 	size_t readsize;
 	size_t totreadsize = 0;
 	size_t subreadsize = 0;
 	size_t padding_len;
-	uint32_t padding;
 	uint8_t type;
 	uint16_t stlen;
 	uint32_t toread;
-	int fseekres;
 
 	//
 	// If the list of users was already allocated for this handle (for example because this is
@@ -2156,6 +2443,11 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 	handle->m_userlist->users = NULL;
 	handle->m_userlist->groups = NULL;
 
+	if(scap_block_reader_begin(handle, r, block_length) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
 	//
 	// Import the blocks
 	//
@@ -2167,7 +2459,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// len
 			//
-			readsize = gzread(f, &(sub_len), sizeof(uint32_t));
+			readsize = scap_block_read(r, &(sub_len), sizeof(uint32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 			subreadsize += readsize;
@@ -2176,7 +2468,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 		//
 		// type
 		//
-		readsize = gzread(f, &(type), sizeof(type));
+		readsize = scap_block_read(r, &(type), sizeof(type));
 		CHECK_READ_SIZE(readsize, sizeof(type));
 
 		subreadsize += readsize;
@@ -2198,7 +2490,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// uid
 			//
-			readsize = gzread(f, &(puser->uid), sizeof(uint32_t));
+			readsize = scap_block_read(r, &(puser->uid), sizeof(uint32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 			subreadsize += readsize;
@@ -2206,7 +2498,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// gid
 			//
-			readsize = gzread(f, &(puser->gid), sizeof(uint32_t));
+			readsize = scap_block_read(r, &(puser->gid), sizeof(uint32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 			subreadsize += readsize;
@@ -2214,7 +2506,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// name
 			//
-			readsize = gzread(f, &(stlen), sizeof(uint16_t));
+			readsize = scap_block_read(r, &(stlen), sizeof(uint16_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 			if(stlen >= MAX_CREDENTIALS_STR_LEN)
@@ -2225,7 +2517,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 			subreadsize += readsize;
 
-			readsize = gzread(f, puser->name, stlen);
+			readsize = scap_block_read(r, puser->name, stlen);
 			CHECK_READ_SIZE(readsize, stlen);
 
 			// the string is not null-terminated on file
@@ -2236,7 +2528,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// homedir
 			//
-			readsize = gzread(f, &(stlen), sizeof(uint16_t));
+			readsize = scap_block_read(r, &(stlen), sizeof(uint16_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 			if(stlen >= MAX_CREDENTIALS_STR_LEN)
@@ -2247,7 +2539,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 			subreadsize += readsize;
 
-			readsize = gzread(f, puser->homedir, stlen);
+			readsize = scap_block_read(r, puser->homedir, stlen);
 			CHECK_READ_SIZE(readsize, stlen);
 
 			// the string is not null-terminated on file
@@ -2258,7 +2550,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// shell
 			//
-			readsize = gzread(f, &(stlen), sizeof(uint16_t));
+			readsize = scap_block_read(r, &(stlen), sizeof(uint16_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 			if(stlen >= MAX_CREDENTIALS_STR_LEN)
@@ -2269,7 +2561,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 			subreadsize += readsize;
 
-			readsize = gzread(f, puser->shell, stlen);
+			readsize = scap_block_read(r, puser->shell, stlen);
 			CHECK_READ_SIZE(readsize, stlen);
 
 			// the string is not null-terminated on file
@@ -2303,7 +2595,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// gid
 			//
-			readsize = gzread(f, &(pgroup->gid), sizeof(uint32_t));
+			readsize = scap_block_read(r, &(pgroup->gid), sizeof(uint32_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint32_t));
 
 			subreadsize += readsize;
@@ -2311,7 +2603,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 			//
 			// name
 			//
-			readsize = gzread(f, &(stlen), sizeof(uint16_t));
+			readsize = scap_block_read(r, &(stlen), sizeof(uint16_t));
 			CHECK_READ_SIZE(readsize, sizeof(uint16_t));
 
 			if(stlen >= MAX_CREDENTIALS_STR_LEN)
@@ -2322,7 +2614,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 
 			subreadsize += readsize;
 
-			readsize = gzread(f, pgroup->name, stlen);
+			readsize = scap_block_read(r, pgroup->name, stlen);
 			CHECK_READ_SIZE(readsize, stlen);
 
 			// the string is not null-terminated on file
@@ -2349,8 +2641,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 				return SCAP_FAILURE;
 			}
 			toread = sub_len - subreadsize;
-			fseekres = (int)gzseek(f, (long)toread, SEEK_CUR);
-			if(fseekres == -1)
+			if(scap_block_read(r, NULL, toread) != toread)
 			{
 				snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "corrupted input file. Can't skip %u bytes.",
 				         (unsigned int)toread);
@@ -2374,7 +2665,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 	}
 	padding_len = block_length - totreadsize;
 
-	readsize = gzread(f, &padding, (unsigned int)padding_len);
+	readsize = scap_block_read(r, NULL, padding_len);
 	CHECK_READ_SIZE(readsize, padding_len);
 
 	return SCAP_SUCCESS;
@@ -2383,7 +2674,7 @@ static int32_t scap_read_userlist(scap_t *handle, gzFile f, uint32_t block_lengt
 //
 // Parse a process list block
 //
-static int32_t scap_read_fdlist(scap_t *handle, gzFile f, uint32_t block_length, uint32_t block_type)
+static int32_t scap_read_fdlist(scap_t *handle, scap_block_reader *r, uint32_t block_length, uint32_t block_type)
 {
 	size_t readsize;
 	size_t totreadsize = 0;
@@ -2394,12 +2685,16 @@ static int32_t scap_read_fdlist(scap_t *handle, gzFile f, uint32_t block_length,
 	//  uint16_t stlen;
 	uint64_t tid;
 	int32_t uth_status = SCAP_SUCCESS;
-	uint32_t padding;
+
+	if(scap_block_reader_begin(handle, r, block_length) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
 
 	//
 	// Read the tid
 	//
-	readsize = gzread(f, &tid, sizeof(tid));
+	readsize = scap_block_read(r, &tid, sizeof(tid));
 	CHECK_READ_SIZE(readsize, sizeof(tid));
 	totreadsize += readsize;
 
@@ -2423,7 +2718,7 @@ static int32_t scap_read_fdlist(scap_t *handle, gzFile f, uint32_t block_length,
 
 	while(((int32_t)block_length - (int32_t)totreadsize) >= 4)
 	{
-		if(scap_fd_read_from_disk(handle, &fdi, &readsize, block_type, f) != SCAP_SUCCESS)
+		if(scap_fd_read_from_disk(handle, &fdi, &readsize, block_type, r) != SCAP_SUCCESS)
 		{
 			return SCAP_FAILURE;
 		}
@@ -2476,7 +2771,7 @@ static int32_t scap_read_fdlist(scap_t *handle, gzFile f, uint32_t block_length,
 	}
 	padding_len = block_length - totreadsize;
 
-	readsize = gzread(f, &padding, (unsigned int)padding_len);
+	readsize = scap_block_read(r, NULL, padding_len);
 	CHECK_READ_SIZE(readsize, padding_len);
 
 	return SCAP_SUCCESS;
@@ -2485,8 +2780,9 @@ static int32_t scap_read_fdlist(scap_t *handle, gzFile f, uint32_t block_length,
 //
 // Parse the headers of a trace file and load the tables
 //
-int32_t scap_read_init(scap_t *handle, gzFile f)
+static int32_t scap_read_blocks(scap_t *handle, scap_block_reader *r, bool need_events)
 {
+	gzFile f = r->m_f;
 	block_header bh;
 	section_header_block sh;
 	uint32_t bt;
@@ -2541,6 +2837,11 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 		// If we don't find the event block header,
 		// it means there is no event in the file.
 		//
+		if(readsize == 0 && !need_events && found_mi && found_il && found_ul)
+		{
+			break;
+		}
+
 		if (readsize == 0 && !found_ev && found_mi && found_pl &&
 			found_il && found_fdl && found_ul)
 		{
@@ -2575,7 +2876,7 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 		case PL_BLOCK_TYPE_V3_INT:
 			found_pl = 1;
 
-			if(scap_read_proclist(handle, f, bh.block_total_length - sizeof(block_header) - 4, bh.block_type) != SCAP_SUCCESS)
+			if(scap_read_proclist(handle, r, bh.block_total_length - sizeof(block_header) - 4, bh.block_type) != SCAP_SUCCESS)
 			{
 				return SCAP_FAILURE;
 			}
@@ -2585,7 +2886,7 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 		case FDL_BLOCK_TYPE_V2:
 			found_fdl = 1;
 
-			if(scap_read_fdlist(handle, f, bh.block_total_length - sizeof(block_header) - 4, bh.block_type) != SCAP_SUCCESS)
+			if(scap_read_fdlist(handle, r, bh.block_total_length - sizeof(block_header) - 4, bh.block_type) != SCAP_SUCCESS)
 			{
 				return SCAP_FAILURE;
 			}
@@ -2625,7 +2926,7 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 		case UL_BLOCK_TYPE_V2:
 			found_ul = 1;
 
-			if(scap_read_userlist(handle, f, bh.block_total_length - sizeof(block_header) - 4, bh.block_type) != SCAP_SUCCESS)
+			if(scap_read_userlist(handle, r, bh.block_total_length - sizeof(block_header) - 4, bh.block_type) != SCAP_SUCCESS)
 			{
 				return SCAP_FAILURE;
 			}
@@ -2687,6 +2988,223 @@ int32_t scap_read_init(scap_t *handle, gzFile f)
 	return SCAP_SUCCESS;
 }
 
+static int32_t scap_read_sections(scap_t *handle, gzFile f, bool need_events)
+{
+	scap_block_reader reader;
+	int32_t res;
+
+	memset(&reader, 0, sizeof(reader));
+	reader.m_f = f;
+
+	res = scap_read_blocks(handle, &reader, need_events);
+
+	free(reader.m_buf);
+	return res;
+}
+
+int32_t scap_read_init(scap_t *handle, gzFile f)
+{
+	return scap_read_sections(handle, f, true);
+}
+
+//
+// Room left for the file name in the error messages below
+//
+#define BOOT_ID_PATH_PRINT_LEN ((int)(SCAP_LASTERR_SIZE - 32))
+
+//
+// Read the boot id of the running system, as two 64 bit halves
+//
+static int32_t scap_get_boot_id(uint64_t *boot_id, char *error)
+{
+#if defined(HAS_CAPTURE) && !defined(_WIN32) && !defined(CYGWING_AGENT)
+	char filename[SCAP_MAX_PATH_SIZE];
+	char line[64];
+	char hex[33];
+	uint32_t j;
+	uint32_t n = 0;
+	FILE *f;
+
+	snprintf(filename, sizeof(filename), "%s/proc/sys/kernel/random/boot_id", scap_get_host_root());
+	f = fopen(filename, "r");
+	if(f == NULL)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "can't open %.*s", BOOT_ID_PATH_PRINT_LEN, filename);
+		return SCAP_FAILURE;
+	}
+
+	if(fgets(line, sizeof(line), f) == NULL)
+	{
+		fclose(f);
+		snprintf(error, SCAP_LASTERR_SIZE, "can't read %.*s", BOOT_ID_PATH_PRINT_LEN, filename);
+		return SCAP_FAILURE;
+	}
+	fclose(f);
+
+	// the boot id is a uuid, e.g. 8d2c5b4e-0b6f-4f6a-9d3e-2f1a7c9b0e11
+	for(j = 0; line[j] != '\0' && n < sizeof(hex) - 1; j++)
+	{
+		if(line[j] != '-' && line[j] != '\n')
+		{
+			hex[n++] = line[j];
+		}
+	}
+	hex[n] = '\0';
+
+	if(n != 32 ||
+	   sscanf(hex, "%16" SCNx64 "%16" SCNx64, &boot_id[0], &boot_id[1]) != 2)
+	{
+		snprintf(error, SCAP_LASTERR_SIZE, "invalid boot id in %.*s", BOOT_ID_PATH_PRINT_LEN, filename);
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+#else
+	snprintf(error, SCAP_LASTERR_SIZE, "boot id not supported on %s", PLATFORM_NAME);
+	return SCAP_NOT_SUPPORTED;
+#endif
+}
+
+static uint64_t scap_state_snapshot_now_ns()
+{
+#ifndef WIN32
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * (uint64_t) 1000000000 + tv.tv_usec * 1000;
+#else
+	return 0;
+#endif
+}
+
+scap_dumper_t *scap_state_snapshot_open(scap_t *handle, const char *fname)
+{
+	scap_machine_info machine_info = handle->m_machine_info;
+	scap_dumper_t *d;
+	uint64_t boot_id[2];
+
+	if(scap_get_boot_id(boot_id, handle->m_lasterr) != SCAP_SUCCESS)
+	{
+		return NULL;
+	}
+
+	//
+	// Stamp the machine info of the file, checked by scap_read_state()
+	//
+	handle->m_machine_info.reserved1 = boot_id[0];
+	handle->m_machine_info.reserved2 = boot_id[1];
+	handle->m_machine_info.reserved3 = scap_state_snapshot_now_ns();
+	d = scap_dump_open(handle, fname, SCAP_COMPRESSION_NONE, true);
+	handle->m_machine_info = machine_info;
+
+	return d;
+}
+
+//
+// Check that a state snapshot was written by this boot of the system,
+// at most max_age_ns ago
+//
+static int32_t scap_check_state_snapshot(scap_t *handle, const scap_machine_info *snapshot_info, uint64_t max_age_ns)
+{
+	uint64_t boot_id[2];
+	uint64_t now;
+
+	if(scap_get_boot_id(boot_id, handle->m_lasterr) != SCAP_SUCCESS)
+	{
+		return SCAP_FAILURE;
+	}
+
+	if(snapshot_info->reserved1 != boot_id[0] || snapshot_info->reserved2 != boot_id[1])
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "state snapshot written before the last boot");
+		return SCAP_FAILURE;
+	}
+
+	now = scap_state_snapshot_now_ns();
+	if(snapshot_info->reserved3 == 0 || snapshot_info->reserved3 > now)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "invalid state snapshot creation time");
+		return SCAP_FAILURE;
+	}
+
+	if(max_age_ns != 0 && now - snapshot_info->reserved3 > max_age_ns)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "state snapshot too old (%" PRIu64 " s)",
+			 (now - snapshot_info->reserved3) / 1000000000);
+		return SCAP_FAILURE;
+	}
+
+	return SCAP_SUCCESS;
+}
+
+int32_t scap_read_state(scap_t *handle, const char *fname, uint64_t max_age_ns)
+{
+	gzFile f;
+	int32_t res;
+	scap_machine_info machine_info = handle->m_machine_info;
+	proc_entry_callback proc_callback = handle->m_proc_callback;
+	scap_threadinfo *tinfo;
+	scap_threadinfo *ttinfo;
+	scap_fdinfo *fdi;
+	scap_fdinfo *tfdi;
+
+	f = gzopen(fname, "rb");
+	if(f == NULL)
+	{
+		snprintf(handle->m_lasterr, SCAP_LASTERR_SIZE, "can't open state snapshot %s", fname);
+		return SCAP_FAILURE;
+	}
+
+	//
+	// Load everything in the tables first, so that nothing reaches the
+	// callback if the file turns out to be corrupted or stale. The
+	// machine info is the one of the live system.
+	//
+	handle->m_proc_callback = NULL;
+	res = scap_read_sections(handle, f, false);
+	if(res == SCAP_SUCCESS)
+	{
+		res = scap_check_state_snapshot(handle, &handle->m_machine_info, max_age_ns);
+	}
+	handle->m_proc_callback = proc_callback;
+	handle->m_machine_info = machine_info;
+	gzclose(f);
+
+	if(res != SCAP_SUCCESS)
+	{
+		scap_proc_free_table(handle);
+		if(handle->m_addrlist)
+		{
+			scap_free_iflist(handle->m_addrlist);
+			handle->m_addrlist = NULL;
+		}
+		if(handle->m_userlist)
+		{
+			scap_free_userlist(handle->m_userlist);
+			handle->m_userlist = NULL;
+		}
+		return res;
+	}
+
+	if(proc_callback == NULL)
+	{
+		return SCAP_SUCCESS;
+	}
+
+	HASH_ITER(hh, handle->m_proclist, tinfo, ttinfo)
+	{
+		proc_callback(handle->m_proc_callback_context, handle, tinfo->tid, tinfo, NULL);
+
+		HASH_ITER(hh, tinfo->fdlist, fdi, tfdi)
+		{
+			proc_callback(handle->m_proc_callback_context, handle, tinfo->tid, tinfo, fdi);
+		}
+	}
+
+	scap_proc_free_table(handle);
+
+	return SCAP_SUCCESS;
+}
+
 //
 // Read an event from disk
 //
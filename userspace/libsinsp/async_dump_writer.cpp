@@ -0,0 +1,304 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "async_dump_writer.h"
+#include "sinsp.h"
+#include "sinsp_int.h"
+
+using namespace libsinsp;
+
+//
+// Extra room allocated in each chunk, so that the event that crosses
+// the chunk size doesn't need to grow the buffer
+//
+#define ASYNC_DUMP_CHUNK_SLACK (64 * 1024)
+
+async_dump_writer::async_dump_writer(sinsp* inspector,
+				     uint32_t chunk_size,
+				     uint32_t max_pending_chunks):
+	m_inspector(inspector),
+	m_chunk_size(chunk_size ? chunk_size : 1),
+	m_chunk(NULL),
+	m_failed(false),
+	m_written_bytes(0),
+	m_writer_files(0),
+	m_n_items_pushed(0),
+	m_n_items_done(0),
+	m_n_files(0),
+	m_n_chunks(0),
+	m_n_blocked(0),
+	m_last_open_ns(0),
+	m_max_open_ns(0)
+{
+	m_queue.set_capacity(max_pending_chunks ? max_pending_chunks : 1);
+	m_worker = std::thread(&async_dump_writer::run, this);
+}
+
+async_dump_writer::~async_dump_writer()
+{
+	close();
+
+	queue_item item = {CMD_STOP, NULL, NULL, false};
+	m_queue.push(item);
+	m_worker.join();
+}
+
+void async_dump_writer::open(const std::string& filename, bool compress)
+{
+	check_error();
+
+	uint64_t start = sinsp_utils::get_current_time_ns();
+
+	if(m_chunk != NULL)
+	{
+		push_chunk();
+	}
+
+	//
+	// Render the header of the new file in its first chunk, from the
+	// inspector tables; the events will be appended to it
+	//
+	scap_dumper_t* chunk = new_chunk(true);
+
+	try
+	{
+		m_inspector->m_thread_manager->dump_threads_to_file(chunk);
+		m_inspector->m_container_manager.dump_containers(chunk);
+	}
+	catch(...)
+	{
+		scap_dump_close(chunk);
+		throw;
+	}
+
+	queue_item item = {CMD_OPEN, NULL, new std::string(filename), compress};
+	push(item);
+
+	m_chunk = chunk;
+	m_n_files++;
+
+	m_last_open_ns = sinsp_utils::get_current_time_ns() - start;
+	if(m_last_open_ns > m_max_open_ns)
+	{
+		m_max_open_ns = m_last_open_ns;
+	}
+}
+
+void async_dump_writer::dump(scap_evt* pevt, uint16_t cpuid, uint32_t flags)
+{
+	check_error();
+
+	if(m_chunk == NULL)
+	{
+		throw sinsp_exception("dumper not opened yet");
+	}
+
+	if(scap_dump(m_inspector->m_h, m_chunk, pevt, cpuid, flags) != SCAP_SUCCESS)
+	{
+		throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
+	}
+
+	if(scap_dump_get_offset(m_chunk) >= m_chunk_size)
+	{
+		push_chunk();
+		m_chunk = new_chunk(false);
+	}
+}
+
+void async_dump_writer::close()
+{
+	if(m_chunk == NULL)
+	{
+		return;
+	}
+
+	push_chunk();
+
+	queue_item item = {CMD_CLOSE, NULL, NULL, false};
+	push(item);
+}
+
+void async_dump_writer::flush()
+{
+	if(m_chunk != NULL && scap_dump_get_offset(m_chunk) != 0)
+	{
+		push_chunk();
+		m_chunk = new_chunk(false);
+	}
+
+	{
+		std::unique_lock<std::mutex> lock(m_done_mutex);
+		m_done_cond.wait(lock, [this] { return m_n_items_done.load() >= m_n_items_pushed; });
+	}
+
+	check_error();
+}
+
+int64_t async_dump_writer::written_bytes() const
+{
+	//
+	// Until the writer thread gets to the file opened last, the size
+	// it publishes belongs to the previous one
+	//
+	if(m_writer_files.load() != m_n_files)
+	{
+		return 0;
+	}
+
+	return m_written_bytes;
+}
+
+async_dump_writer::stats async_dump_writer::get_stats() const
+{
+	stats res;
+
+	res.m_n_files = m_n_files;
+	res.m_n_chunks = m_n_chunks;
+	res.m_n_blocked = m_n_blocked;
+	res.m_last_open_ns = m_last_open_ns;
+	res.m_max_open_ns = m_max_open_ns;
+
+	return res;
+}
+
+void async_dump_writer::push(const queue_item& item)
+{
+	if(!m_queue.try_push(item))
+	{
+		m_n_blocked++;
+		m_queue.push(item);
+	}
+
+	m_n_items_pushed++;
+}
+
+void async_dump_writer::push_chunk()
+{
+	queue_item item = {CMD_WRITE, m_chunk, NULL, false};
+	m_chunk = NULL;
+	push(item);
+}
+
+scap_dumper_t* async_dump_writer::new_chunk(bool write_header)
+{
+	scap_dumper_t* chunk = scap_managed_dump_open(m_inspector->m_h,
+						      m_chunk_size + ASYNC_DUMP_CHUNK_SLACK,
+						      write_header);
+	if(chunk == NULL)
+	{
+		throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
+	}
+
+	return chunk;
+}
+
+void async_dump_writer::check_error()
+{
+	if(m_failed.load())
+	{
+		std::lock_guard<std::mutex> lock(m_error_mutex);
+		throw sinsp_exception(m_error);
+	}
+}
+
+void async_dump_writer::set_error(const std::string& error)
+{
+	std::lock_guard<std::mutex> lock(m_error_mutex);
+	if(!m_failed)
+	{
+		m_error = error;
+		m_failed = true;
+	}
+}
+
+void async_dump_writer::run()
+{
+	scap_dumper_t* file = NULL;
+	char error[SCAP_LASTERR_SIZE];
+
+	while(true)
+	{
+		queue_item item;
+		m_queue.pop(item);
+
+		switch(item.m_cmd)
+		{
+		case CMD_OPEN:
+			if(file != NULL)
+			{
+				scap_dump_close(file);
+				file = NULL;
+			}
+
+			if(!m_failed)
+			{
+				file = scap_dump_open_raw(item.m_filename->c_str(),
+							  item.m_compress ? SCAP_COMPRESSION_GZIP : SCAP_COMPRESSION_NONE,
+							  error);
+				if(file == NULL)
+				{
+					set_error(error);
+				}
+			}
+
+			m_written_bytes = 0;
+			m_writer_files++;
+			delete item.m_filename;
+			break;
+		case CMD_WRITE:
+			if(file != NULL && !m_failed)
+			{
+				if(scap_dump_append(file, item.m_chunk, error) != SCAP_SUCCESS)
+				{
+					set_error(error);
+				}
+				else
+				{
+					m_written_bytes = scap_dump_get_offset(file);
+				}
+			}
+
+			scap_dump_close(item.m_chunk);
+			m_n_chunks++;
+			break;
+		case CMD_CLOSE:
+			if(file != NULL)
+			{
+				scap_dump_close(file);
+				file = NULL;
+			}
+			break;
+		case CMD_STOP:
+			ASSERT(file == NULL);
+			item_done();
+			return;
+		}
+
+		item_done();
+	}
+}
+
+void async_dump_writer::item_done()
+{
+	m_n_items_done++;
+	{
+		// so that flush() can't miss the notification between its
+		// check and its wait
+		std::lock_guard<std::mutex> lock(m_done_mutex);
+	}
+	m_done_cond.notify_all();
+}
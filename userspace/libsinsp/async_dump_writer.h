@@ -0,0 +1,153 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "scap.h"
+#include "tbb/concurrent_queue.h"
+
+class sinsp;
+
+namespace libsinsp
+{
+
+//
+// Writes capture files from a background thread.
+//
+// The capture thread only serializes events, uncompressed, into memory
+// chunks; compressing them, writing them to disk, closing the finished
+// files and creating the new ones all happen on the writer thread.
+//
+// When a new file is opened, the file header and the thread, fd,
+// container, interface and user tables are rendered into the first
+// chunk of the file by the capture thread, from the inspector state:
+// this is a memory copy, without any /proc scan, compression or I/O, so
+// rolling over to a new file only stalls the event loop for the time
+// it takes to walk the tables.
+//
+// Errors are reported by the writer thread, and thrown as
+// sinsp_exception by the next call to open() or dump().
+//
+class async_dump_writer
+{
+public:
+	struct stats
+	{
+		uint64_t m_n_files;
+		uint64_t m_n_chunks;
+		uint64_t m_n_blocked;       // times dump() had to wait for the writer
+		uint64_t m_last_open_ns;    // time spent in the last open()
+		uint64_t m_max_open_ns;     // longest time spent in open()
+	};
+
+	async_dump_writer(sinsp* inspector,
+			  uint32_t chunk_size = 1024 * 1024,
+			  uint32_t max_pending_chunks = 64);
+	~async_dump_writer();
+
+	//
+	// Start writing to a new file. The current one, if any, is closed
+	// in the background.
+	//
+	void open(const std::string& filename, bool compress);
+
+	void dump(scap_evt* pevt, uint16_t cpuid, uint32_t flags);
+
+	//
+	// Close the current file, in the background
+	//
+	void close();
+
+	//
+	// Wait until everything has been written to disk
+	//
+	void flush();
+
+	//
+	// Compressed size of the current file, as of the last chunk written
+	//
+	int64_t written_bytes() const;
+
+	bool is_open() const
+	{
+		return m_chunk != NULL;
+	}
+
+	stats get_stats() const;
+
+private:
+	enum command
+	{
+		CMD_OPEN,
+		CMD_WRITE,
+		CMD_CLOSE,
+		CMD_STOP
+	};
+
+	struct queue_item
+	{
+		command m_cmd;
+		scap_dumper_t* m_chunk;
+		std::string* m_filename;
+		bool m_compress;
+	};
+
+	void run();
+	void item_done();
+	void push(const queue_item& item);
+	void push_chunk();
+	scap_dumper_t* new_chunk(bool write_header);
+	void check_error();
+	void set_error(const std::string& error);
+
+	sinsp* m_inspector;
+	uint32_t m_chunk_size;
+
+	// the chunk being filled by the capture thread
+	scap_dumper_t* m_chunk;
+
+	tbb::concurrent_bounded_queue<queue_item> m_queue;
+	std::thread m_worker;
+
+	std::atomic<bool> m_failed;
+	std::mutex m_error_mutex;
+	std::string m_error;
+
+	// size of the file being written, and number of files opened, as
+	// seen by the writer thread
+	std::atomic<int64_t> m_written_bytes;
+	std::atomic<uint64_t> m_writer_files;
+	uint64_t m_n_items_pushed;
+	std::atomic<uint64_t> m_n_items_done;
+	// signaled by the writer thread after each item, for flush()
+	std::mutex m_done_mutex;
+	std::condition_variable m_done_cond;
+
+	uint64_t m_n_files;
+	std::atomic<uint64_t> m_n_chunks;
+	uint64_t m_n_blocked;
+	uint64_t m_last_open_ns;
+	uint64_t m_max_open_ns;
+};
+
+}  // namespace libsinsp
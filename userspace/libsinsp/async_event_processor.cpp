@@ -0,0 +1,342 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "async_event_processor.h"
+#include "sinsp_int.h"
+
+using namespace libsinsp;
+
+async_event_processor::async_event_processor(event_processor& processor,
+					     uint32_t queue_size,
+					     backpressure_policy policy,
+					     uint32_t sample_ratio):
+	m_processor(processor),
+	m_queue_size(queue_size ? queue_size : 1),
+	m_policy(policy),
+	m_sample_ratio(sample_ratio ? sample_ratio : 1),
+	m_sample_count(0),
+	m_running(true),
+	m_n_enqueued(0),
+	m_n_dropped(0),
+	m_n_sampled_out(0),
+	m_n_blocked(0),
+	m_n_processed(0),
+	m_max_queue_depth(0),
+	m_n_items_pushed(0),
+	m_n_items_done(0)
+{
+	m_queue.set_capacity(m_queue_size);
+	m_worker = std::thread(&async_event_processor::run, this);
+}
+
+async_event_processor::~async_event_processor()
+{
+	stop();
+}
+
+void async_event_processor::on_capture_start()
+{
+	flush();
+	m_processor.on_capture_start();
+}
+
+void async_event_processor::add_chisel_metric(statsd_metric* metric)
+{
+	m_processor.add_chisel_metric(metric);
+}
+
+sinsp_threadinfo* async_event_processor::build_threadinfo(sinsp* inspector)
+{
+	return m_processor.build_threadinfo(inspector);
+}
+
+void async_event_processor::process_event(sinsp_evt* evt, event_return rc)
+{
+	if(!m_running)
+	{
+		return;
+	}
+
+	if(evt == NULL)
+	{
+		// timeouts are only a hint, don't wait for them
+		queue_item item = {NULL, rc, false};
+		enqueue(item, rc == EVENT_RETURN_EOF);
+		return;
+	}
+
+	if(m_policy != BP_BLOCK)
+	{
+		// don't bother copying events that can't be queued
+		std::ptrdiff_t depth = m_queue.size();
+		if(depth >= (std::ptrdiff_t)m_queue_size)
+		{
+			m_n_dropped++;
+			return;
+		}
+
+		if(m_policy == BP_SAMPLE &&
+		   depth >= (std::ptrdiff_t)m_queue_size / 2 &&
+		   (m_sample_count++ % m_sample_ratio) != 0)
+		{
+			m_n_sampled_out++;
+			return;
+		}
+	}
+
+	event_copy* copy = get_free_event();
+	if(!sinsp_evt::evtcpy(copy->m_evt, *evt))
+	{
+		m_free_events.push(copy);
+		m_n_dropped++;
+		return;
+	}
+	snapshot_thread(copy);
+
+	queue_item item = {copy, EVENT_RETURN_NONE, false};
+	if(m_policy == BP_BLOCK)
+	{
+		enqueue(item, true);
+	}
+	else if(m_queue.try_push(item))
+	{
+		m_n_items_pushed++;
+	}
+	else
+	{
+		m_free_events.push(copy);
+		m_n_dropped++;
+		return;
+	}
+
+	m_n_enqueued++;
+
+	std::ptrdiff_t depth = m_queue.size();
+	if(depth > (std::ptrdiff_t)m_max_queue_depth.load())
+	{
+		m_max_queue_depth = (uint32_t)depth;
+	}
+}
+
+void async_event_processor::enqueue(const queue_item& item, bool wait)
+{
+	if(!m_queue.try_push(item))
+	{
+		if(!wait)
+		{
+			return;
+		}
+
+		m_n_blocked++;
+		m_queue.push(item);
+	}
+
+	m_n_items_pushed++;
+}
+
+void async_event_processor::flush()
+{
+	std::unique_lock<std::mutex> lock(m_done_mutex);
+	m_done_cond.wait(lock, [this] { return m_n_items_done.load() >= m_n_items_pushed; });
+}
+
+void async_event_processor::stop()
+{
+	if(!m_running)
+	{
+		return;
+	}
+
+	queue_item item = {NULL, EVENT_RETURN_NONE, true};
+	m_queue.push(item);
+	m_worker.join();
+	m_running = false;
+}
+
+async_event_processor::stats async_event_processor::get_stats() const
+{
+	stats res;
+	std::ptrdiff_t depth = m_queue.size();
+
+	res.m_n_enqueued = m_n_enqueued;
+	res.m_n_dropped = m_n_dropped;
+	res.m_n_sampled_out = m_n_sampled_out;
+	res.m_n_blocked = m_n_blocked;
+	res.m_n_processed = m_n_processed;
+	res.m_queue_depth = depth > 0 ? (uint32_t)depth : 0;
+	res.m_max_queue_depth = m_max_queue_depth;
+
+	return res;
+}
+
+void async_event_processor::run()
+{
+	while(true)
+	{
+		queue_item item;
+		m_queue.pop(item);
+
+		if(item.m_stop)
+		{
+			break;
+		}
+
+		try
+		{
+			m_processor.process_event(item.m_copy ? &item.m_copy->m_evt : NULL, item.m_rc);
+		}
+		catch(const std::exception& e)
+		{
+			g_logger.format(sinsp_logger::SEV_ERROR,
+					"async_event_processor: event processing failed: %s",
+					e.what());
+		}
+
+		if(item.m_copy != NULL)
+		{
+			m_free_events.push(item.m_copy);
+			m_n_processed++;
+		}
+
+		m_n_items_done++;
+		{
+			// so that flush() can't miss the notification between
+			// its check and its wait
+			std::lock_guard<std::mutex> lock(m_done_mutex);
+		}
+		m_done_cond.notify_all();
+	}
+}
+
+async_event_processor::event_copy* async_event_processor::get_free_event()
+{
+	event_copy* copy = NULL;
+
+	if(m_free_events.try_pop(copy))
+	{
+		return copy;
+	}
+
+	m_events.emplace_back(new event_copy());
+	return m_events.back().get();
+}
+
+std::shared_ptr<sinsp_threadinfo> async_event_processor::snapshot_parents(event_copy* copy,
+									  sinsp_threadinfo* tinfo,
+									  const sinsp_container_info::ptr_t& container)
+{
+	sinsp_evt& evt = copy->m_evt;
+
+	m_ancestors.clear();
+	sinsp_threadinfo::visitor_func_t visitor = [this](sinsp_threadinfo* ptinfo)
+	{
+		m_ancestors.push_back(ptinfo);
+		return true;
+	};
+	tinfo->traverse_parent_state(visitor);
+
+	while(copy->m_parents.size() < m_ancestors.size())
+	{
+		copy->m_parents.push_back(std::make_shared<sinsp_threadinfo>(evt.m_inspector));
+	}
+
+	//
+	// Linked from the farthest ancestor down, each with its own
+	// container: most share the one of the thread, so the container
+	// table is only looked up when the id changes along the chain
+	//
+	std::shared_ptr<sinsp_threadinfo> parent;
+	const std::string* container_id = &tinfo->m_container_id;
+	sinsp_container_info::ptr_t parent_container = container;
+	for(size_t j = m_ancestors.size(); j-- > 0;)
+	{
+		sinsp_threadinfo* ptinfo = m_ancestors[j];
+		if(ptinfo->m_container_id != *container_id)
+		{
+			container_id = &ptinfo->m_container_id;
+			parent_container = ptinfo->get_container_info();
+		}
+
+		std::shared_ptr<sinsp_threadinfo>& snapshot = copy->m_parents[j];
+		snapshot->copy_process_state(*ptinfo);
+		snapshot->set_snapshot_state(parent, parent_container);
+		parent = snapshot;
+	}
+
+	return parent;
+}
+
+void async_event_processor::snapshot_thread(event_copy* copy)
+{
+	sinsp_evt& evt = copy->m_evt;
+	sinsp_threadinfo* tinfo = evt.m_tinfo;
+	if(tinfo == NULL)
+	{
+		return;
+	}
+
+	//
+	// The snapshots are reused with their slot, so after the first few
+	// events copying a thread doesn't allocate, unless its strings grow
+	//
+	sinsp_container_info::ptr_t container = tinfo->get_container_info();
+
+	std::shared_ptr<sinsp_threadinfo> main_snapshot;
+	std::shared_ptr<sinsp_threadinfo> parent;
+	sinsp_threadinfo* main_tinfo = tinfo->get_main_thread();
+	if(main_tinfo != NULL && main_tinfo != tinfo)
+	{
+		if(!copy->m_main_tinfo)
+		{
+			copy->m_main_tinfo = std::make_shared<sinsp_threadinfo>(evt.m_inspector);
+		}
+		sinsp_container_info::ptr_t main_container =
+			main_tinfo->m_container_id == tinfo->m_container_id ?
+			container : main_tinfo->get_container_info();
+
+		main_snapshot = copy->m_main_tinfo;
+		main_snapshot->copy_process_state(*main_tinfo);
+		main_snapshot->set_snapshot_state(snapshot_parents(copy, main_tinfo, main_container),
+						  main_container);
+
+		// a thread is parented like its process, almost always
+		sinsp_threadinfo* ptinfo = tinfo->get_parent_thread();
+		if(ptinfo == main_tinfo)
+		{
+			parent = main_snapshot;
+		}
+		else if(!m_ancestors.empty() && ptinfo == m_ancestors[0])
+		{
+			parent = copy->m_parents[0];
+		}
+	}
+	else
+	{
+		parent = snapshot_parents(copy, tinfo, container);
+	}
+
+	if(!copy->m_tinfo)
+	{
+		copy->m_tinfo = std::make_shared<sinsp_threadinfo>(evt.m_inspector);
+	}
+	copy->m_tinfo->copy_process_state(*tinfo, main_snapshot);
+	copy->m_tinfo->set_snapshot_state(parent, container);
+
+	// drop the reference to the live thread taken by evtcpy()
+	evt.m_tinfo_ref = copy->m_tinfo;
+	evt.m_tinfo = copy->m_tinfo.get();
+}
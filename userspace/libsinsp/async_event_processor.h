@@ -0,0 +1,170 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "sinsp.h"
+#include "tbb/concurrent_queue.h"
+
+namespace libsinsp
+{
+
+//
+// Runs an external event processor on its own thread.
+//
+// Register an async_event_processor with sinsp instead of the real
+// processor: every event is copied (sinsp_evt::evtcpy) into a pooled
+// sinsp_evt and handed to the wrapped processor through a bounded
+// queue, so a slow processor no longer stalls the draining of the
+// capture buffers.
+//
+// The copies own the event data, the fdinfo and a snapshot of the
+// threadinfo, of its main thread, of the parents of its process and of
+// their containers, taken by the capture thread when the event is
+// queued: the wrapped processor reads them as they were when the event
+// was captured, and get_parent_thread(), get_main_thread() and
+// get_container_info() on the snapshots never reach the live tables.
+// The snapshots have an empty fd table, so the fd must be read from the
+// event, and any other inspector state (e.g. the user table) is still
+// live and updated concurrently by the capture thread.
+//
+// When the queue is full the behavior depends on the policy:
+// - BP_BLOCK: the capture thread waits for room in the queue
+// - BP_DROP: the event is dropped
+// - BP_SAMPLE: like BP_DROP, but as soon as the queue is more than
+//   half full only one event every sample_ratio is queued, to spread
+//   the losses instead of dropping whole bursts
+//
+// Timeout notifications are dropped, rather than waited for, whenever
+// the queue is full; EOF is always delivered, after all queued events.
+//
+class async_event_processor : public event_processor
+{
+public:
+	enum backpressure_policy
+	{
+		BP_BLOCK,
+		BP_DROP,
+		BP_SAMPLE
+	};
+
+	struct stats
+	{
+		uint64_t m_n_enqueued;
+		uint64_t m_n_dropped;     // queue full, or event could not be copied
+		uint64_t m_n_sampled_out; // skipped by BP_SAMPLE before the queue was full
+		uint64_t m_n_blocked;     // times BP_BLOCK had to wait for room
+		uint64_t m_n_processed;
+		uint32_t m_queue_depth;
+		uint32_t m_max_queue_depth;
+	};
+
+	async_event_processor(event_processor& processor,
+			      uint32_t queue_size = 4096,
+			      backpressure_policy policy = BP_BLOCK,
+			      uint32_t sample_ratio = 10);
+	virtual ~async_event_processor();
+
+	void on_capture_start() override;
+	void process_event(sinsp_evt* evt, event_return rc) override;
+	void add_chisel_metric(statsd_metric* metric) override;
+	sinsp_threadinfo* build_threadinfo(sinsp* inspector) override;
+
+	//
+	// Wait until every queued event has been processed. Like
+	// process_event(), must be called from the capture thread.
+	//
+	void flush();
+
+	//
+	// Process the queued events, then stop the worker thread.
+	// Called by the destructor.
+	//
+	void stop();
+
+	stats get_stats() const;
+
+private:
+	// a pooled event copy, with the snapshots of its thread
+	struct event_copy
+	{
+		sinsp_evt m_evt;
+		std::shared_ptr<sinsp_threadinfo> m_tinfo;
+		std::shared_ptr<sinsp_threadinfo> m_main_tinfo;
+		// the parents of the process, nearest first; only the first
+		// ones are used when the chain is shorter than earlier ones
+		std::vector<std::shared_ptr<sinsp_threadinfo>> m_parents;
+	};
+
+	struct queue_item
+	{
+		event_copy* m_copy;
+		event_return m_rc;
+		bool m_stop;
+	};
+
+	void run();
+	event_copy* get_free_event();
+	void snapshot_thread(event_copy* copy);
+	std::shared_ptr<sinsp_threadinfo> snapshot_parents(event_copy* copy,
+							   sinsp_threadinfo* tinfo,
+							   const sinsp_container_info::ptr_t& container);
+	void enqueue(const queue_item& item, bool wait);
+
+	event_processor& m_processor;
+	uint32_t m_queue_size;
+	backpressure_policy m_policy;
+	uint32_t m_sample_ratio;
+	uint64_t m_sample_count;
+
+	tbb::concurrent_bounded_queue<queue_item> m_queue;
+
+	// pooled event copies; allocated and owned by the capture thread,
+	// returned through m_free_events by the worker
+	std::vector<std::unique_ptr<event_copy>> m_events;
+	tbb::concurrent_queue<event_copy*> m_free_events;
+
+	// the live parents being snapshotted, kept to reuse its storage
+	std::vector<sinsp_threadinfo*> m_ancestors;
+
+	std::thread m_worker;
+	bool m_running;
+
+	std::atomic<uint64_t> m_n_enqueued;
+	std::atomic<uint64_t> m_n_dropped;
+	std::atomic<uint64_t> m_n_sampled_out;
+	std::atomic<uint64_t> m_n_blocked;
+	std::atomic<uint64_t> m_n_processed;
+	std::atomic<uint32_t> m_max_queue_depth;
+
+	// queue items (events and notifications) pushed by the capture
+	// thread and completed by the worker, for flush(); the worker
+	// signals m_done_cond after each item
+	uint64_t m_n_items_pushed;
+	std::atomic<uint64_t> m_n_items_done;
+	std::mutex m_done_mutex;
+	std::condition_variable m_done_cond;
+};
+
+}  // namespace libsinsp
@@ -0,0 +1,616 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <algorithm>
+#include <cstring>
+
+#include "capture_index.h"
+#include "sinsp.h"
+#include "sinsp_int.h"
+#include "filter.h"
+#include "filterchecks.h"
+
+using namespace libsinsp;
+
+//
+// The index file is a header followed by one record per block and, if
+// the writer closed it, an end record with the end of the last block.
+// Integers are in host order, like in the capture files. Version 2
+// added the positions of the events changing the state.
+//
+#define CAPTURE_INDEX_MAGIC 0x58494353   // "SCIX"
+#define CAPTURE_INDEX_VERSION 3
+#define CAPTURE_INDEX_RECORD_BLOCK 1
+#define CAPTURE_INDEX_RECORD_END 2
+
+#define CAPTURE_INDEX_EVTTYPE_WORDS ((PPM_EVENT_MAX + 63) / 64)
+
+namespace
+{
+template<typename T>
+void write_val(std::ofstream& out, T val)
+{
+	out.write((const char*)&val, sizeof(val));
+}
+
+template<typename T>
+bool read_val(std::ifstream& in, T* val)
+{
+	return (bool)in.read((char*)val, sizeof(*val));
+}
+
+//
+// The filter values of a string check
+//
+std::vector<std::string> string_values(const unordered_set<filter_value_t, g_hash_membuf, g_equal_to_membuf>& members)
+{
+	std::vector<std::string> res;
+
+	for(const auto& it : members)
+	{
+		// strings are parsed with their terminator
+		res.push_back(std::string((const char*)it.first, strnlen((const char*)it.first, it.second)));
+	}
+
+	return res;
+}
+
+//
+// The events the parsers need to keep the threads, fds and containers
+// up to date, the same ones the load shedder keeps
+//
+bool modifies_state(uint16_t type)
+{
+	return type < PPM_EVENT_MAX &&
+		(g_infotables.m_event_info[type].flags & (EF_MODIFIES_STATE | EF_CREATES_FD | EF_DESTROYS_FD));
+}
+}
+
+capture_index::query::query():
+	m_start_ts(0),
+	m_end_ts(UINT64_MAX)
+{
+}
+
+capture_index::capture_index(uint32_t block_evts):
+	m_block_evts(block_evts ? block_evts : 1),
+	m_end_offset(0),
+	m_has_query(false),
+	m_last_tid(-1)
+{
+	m_cur.m_nevts = 0;
+}
+
+void capture_index::open(const std::string& path)
+{
+	m_out.open(path, std::ios::binary | std::ios::trunc);
+	if(!m_out)
+	{
+		throw sinsp_exception("can't open capture index " + path + ": " + strerror(errno));
+	}
+
+	m_path = path;
+	write_val<uint32_t>(m_out, CAPTURE_INDEX_MAGIC);
+	write_val<uint32_t>(m_out, CAPTURE_INDEX_VERSION);
+	write_val<uint32_t>(m_out, m_block_evts);
+}
+
+void capture_index::add(uint64_t offset, sinsp_evt* evt, bool in_file)
+{
+	uint64_t ts = evt->get_ts();
+	uint16_t type = evt->get_type();
+	int64_t tid = evt->get_tid();
+
+	if(m_cur.m_nevts == 0)
+	{
+		m_cur.m_offset = offset;
+		m_cur.m_start_ts = ts;
+		m_cur.m_end_ts = ts;
+		m_cur.m_evttypes.assign(CAPTURE_INDEX_EVTTYPE_WORDS, 0);
+		m_cur.m_state_offsets.clear();
+		m_last_tid = -1;
+	}
+
+	if(ts < m_cur.m_start_ts)
+	{
+		m_cur.m_start_ts = ts;
+	}
+	if(ts > m_cur.m_end_ts)
+	{
+		m_cur.m_end_ts = ts;
+	}
+
+	if(type < PPM_EVENT_MAX)
+	{
+		m_cur.m_evttypes[type / 64] |= 1ULL << (type % 64);
+	}
+
+	if(in_file && modifies_state(type))
+	{
+		m_cur.m_state_offsets.push_back(offset);
+	}
+
+	// consecutive events of the same thread are common
+	if(tid != m_last_tid || m_cur_tids.empty())
+	{
+		m_last_tid = tid;
+		m_cur_tids.insert(tid);
+		sinsp_threadinfo* tinfo = evt->get_thread_info(false);
+		m_cur_containers.insert(tinfo != NULL ? tinfo->m_container_id : CAPTURE_INDEX_NO_THREAD_INFO);
+	}
+
+	if(++m_cur.m_nevts == m_block_evts)
+	{
+		flush_block();
+	}
+}
+
+void capture_index::flush_block()
+{
+	m_cur.m_tids.assign(m_cur_tids.begin(), m_cur_tids.end());
+	m_cur.m_containers.assign(m_cur_containers.begin(), m_cur_containers.end());
+	m_blocks.push_back(m_cur);
+
+	if(m_out.is_open())
+	{
+		write_block(m_cur);
+	}
+
+	m_cur.m_nevts = 0;
+	m_cur_tids.clear();
+	m_cur_containers.clear();
+}
+
+void capture_index::write_block(const block& b)
+{
+	write_val<uint32_t>(m_out, CAPTURE_INDEX_RECORD_BLOCK);
+	write_val<uint64_t>(m_out, b.m_offset);
+	write_val<uint64_t>(m_out, b.m_start_ts);
+	write_val<uint64_t>(m_out, b.m_end_ts);
+	write_val<uint32_t>(m_out, b.m_nevts);
+
+	write_val<uint32_t>(m_out, (uint32_t)b.m_evttypes.size());
+	for(uint64_t word : b.m_evttypes)
+	{
+		write_val<uint64_t>(m_out, word);
+	}
+
+	write_val<uint32_t>(m_out, (uint32_t)b.m_tids.size());
+	for(int64_t tid : b.m_tids)
+	{
+		write_val<int64_t>(m_out, tid);
+	}
+
+	write_val<uint32_t>(m_out, (uint32_t)b.m_containers.size());
+	for(const auto& id : b.m_containers)
+	{
+		write_val<uint32_t>(m_out, (uint32_t)id.size());
+		m_out.write(id.data(), id.size());
+	}
+
+	write_val<uint32_t>(m_out, (uint32_t)b.m_state_offsets.size());
+	for(uint64_t offset : b.m_state_offsets)
+	{
+		write_val<uint64_t>(m_out, offset);
+	}
+
+	// a reader of a capture being written sees complete blocks
+	m_out.flush();
+
+	if(!m_out)
+	{
+		throw sinsp_exception("error writing capture index " + m_path);
+	}
+}
+
+void capture_index::write_end()
+{
+	write_val<uint32_t>(m_out, CAPTURE_INDEX_RECORD_END);
+	write_val<uint64_t>(m_out, m_end_offset);
+	m_out.flush();
+
+	if(!m_out)
+	{
+		throw sinsp_exception("error writing capture index " + m_path);
+	}
+}
+
+void capture_index::close(uint64_t end_offset)
+{
+	if(m_cur.m_nevts != 0)
+	{
+		flush_block();
+	}
+
+	m_end_offset = end_offset;
+
+	if(m_out.is_open())
+	{
+		write_end();
+		m_out.close();
+	}
+}
+
+void capture_index::load(const std::string& path)
+{
+	std::ifstream in(path, std::ios::binary);
+	if(!in)
+	{
+		throw sinsp_exception("can't open capture index " + path + ": " + strerror(errno));
+	}
+
+	uint32_t magic;
+	uint32_t version;
+	if(!read_val(in, &magic) || !read_val(in, &version) || !read_val(in, &m_block_evts) ||
+	   magic != CAPTURE_INDEX_MAGIC || version != CAPTURE_INDEX_VERSION)
+	{
+		throw sinsp_exception("invalid capture index " + path);
+	}
+
+	m_blocks.clear();
+	m_end_offset = 0;
+
+	//
+	// A truncated record at the end, left by a writer that didn't
+	// finish, is ignored
+	//
+	uint32_t record;
+	while(read_val(in, &record))
+	{
+		if(record == CAPTURE_INDEX_RECORD_END)
+		{
+			read_val(in, &m_end_offset);
+			break;
+		}
+		else if(record != CAPTURE_INDEX_RECORD_BLOCK)
+		{
+			throw sinsp_exception("invalid capture index " + path);
+		}
+
+		block b;
+		uint32_t n;
+
+		if(!read_val(in, &b.m_offset) || !read_val(in, &b.m_start_ts) ||
+		   !read_val(in, &b.m_end_ts) || !read_val(in, &b.m_nevts) ||
+		   !read_val(in, &n) || n > CAPTURE_INDEX_EVTTYPE_WORDS * 4)
+		{
+			break;
+		}
+
+		b.m_evttypes.resize(n);
+		if(n && !in.read((char*)b.m_evttypes.data(), n * sizeof(uint64_t)))
+		{
+			break;
+		}
+
+		if(!read_val(in, &n) || n > b.m_nevts)
+		{
+			break;
+		}
+
+		b.m_tids.resize(n);
+		if(n && !in.read((char*)b.m_tids.data(), n * sizeof(int64_t)))
+		{
+			break;
+		}
+
+		if(!read_val(in, &n) || n > b.m_nevts)
+		{
+			break;
+		}
+
+		bool complete = true;
+		for(uint32_t j = 0; j < n && complete; j++)
+		{
+			uint32_t len;
+			if(!read_val(in, &len) || len > SCAP_MAX_PATH_SIZE)
+			{
+				complete = false;
+				break;
+			}
+
+			std::string id(len, '\0');
+			complete = (bool)in.read(&id[0], len);
+			b.m_containers.push_back(id);
+		}
+
+		if(!complete || !read_val(in, &n) || n > b.m_nevts)
+		{
+			break;
+		}
+
+		b.m_state_offsets.resize(n);
+		if(n && !in.read((char*)b.m_state_offsets.data(), n * sizeof(uint64_t)))
+		{
+			break;
+		}
+
+		m_blocks.push_back(b);
+	}
+}
+
+void capture_index::build(const std::string& capture_filename,
+			  const std::string& path,
+			  uint32_t block_evts)
+{
+	sinsp inspector;
+	capture_index index(block_evts);
+
+	inspector.open(capture_filename);
+	index.open(path);
+
+	while(true)
+	{
+		sinsp_evt* evt;
+		uint64_t offset = scap_ftell(inspector.m_h);
+		int32_t res = inspector.next(&evt);
+
+		if(res == SCAP_EOF)
+		{
+			break;
+		}
+		else if(res == SCAP_TIMEOUT)
+		{
+			continue;
+		}
+		else if(res != SCAP_SUCCESS)
+		{
+			throw sinsp_exception(inspector.getlasterr());
+		}
+
+		// the events generated while reading don't move the file
+		index.add(offset, evt, scap_ftell(inspector.m_h) != offset);
+	}
+
+	index.close(scap_ftell(inspector.m_h));
+	inspector.close();
+}
+
+void capture_index::set_query(const query& q)
+{
+	m_query = q;
+	m_has_query = true;
+}
+
+void capture_index::clear_query()
+{
+	m_query = query();
+	m_has_query = false;
+}
+
+int32_t capture_index::find_block(uint64_t offset) const
+{
+	auto it = std::upper_bound(m_blocks.begin(), m_blocks.end(), offset,
+				   [](uint64_t off, const block& b) { return off < b.m_offset; });
+
+	return (int32_t)(it - m_blocks.begin()) - 1;
+}
+
+bool capture_index::has_evttype(const block& b, uint16_t type) const
+{
+	return type / 64 < b.m_evttypes.size() &&
+		(b.m_evttypes[type / 64] & (1ULL << (type % 64)));
+}
+
+bool capture_index::may_match(const block& b, gen_event_filter_check* filter) const
+{
+	if(m_has_query)
+	{
+		if(b.m_end_ts < m_query.m_start_ts || b.m_start_ts > m_query.m_end_ts)
+		{
+			return false;
+		}
+
+		if(!m_query.m_tids.empty() &&
+		   std::none_of(b.m_tids.begin(), b.m_tids.end(),
+				[this](int64_t tid) { return m_query.m_tids.count(tid) != 0; }))
+		{
+			return false;
+		}
+
+		// the events without thread info when indexed may be in any container
+		if(!m_query.m_containers.empty() &&
+		   std::none_of(b.m_containers.begin(), b.m_containers.end(),
+				[this](const std::string& id)
+				{
+					return m_query.m_containers.count(id) != 0 || id == CAPTURE_INDEX_NO_THREAD_INFO;
+				}))
+		{
+			return false;
+		}
+
+		if(!m_query.m_evttypes.empty() &&
+		   std::none_of(m_query.m_evttypes.begin(), m_query.m_evttypes.end(),
+				[this, &b](uint16_t type) { return has_evttype(b, type); }))
+		{
+			return false;
+		}
+	}
+
+	return filter == NULL || (match_check(b, filter) & MATCH_TRUE);
+}
+
+//
+// The possible results of a check on the events of the block, as a
+// mask of MATCH_FALSE and MATCH_TRUE
+//
+uint32_t capture_index::match_check(const block& b, gen_event_filter_check* chk) const
+{
+#ifdef HAS_FILTERING
+	gen_event_filter_expression* expr = dynamic_cast<gen_event_filter_expression*>(chk);
+
+	if(expr != NULL)
+	{
+		//
+		// Follow gen_event_filter_expression::compare(), short circuits
+		// included, with every possible value of each check
+		//
+		uint32_t res = 0;
+		uint32_t cur = MATCH_TRUE;
+
+		for(uint32_t j = 0; j < expr->m_checks.size(); j++)
+		{
+			gen_event_filter_check* c = expr->m_checks[j];
+			uint32_t m;
+
+			if(j != 0)
+			{
+				if(c->m_boolop == BO_OR || c->m_boolop == BO_ORNOT)
+				{
+					res |= cur & MATCH_TRUE;
+					if(!(cur & MATCH_FALSE))
+					{
+						return res;
+					}
+				}
+				else
+				{
+					res |= cur & MATCH_FALSE;
+					if(!(cur & MATCH_TRUE))
+					{
+						return res;
+					}
+				}
+			}
+
+			m = match_check(b, c);
+			if(c->m_boolop & BO_NOT)
+			{
+				m = ((m & MATCH_TRUE) ? MATCH_FALSE : 0) | ((m & MATCH_FALSE) ? MATCH_TRUE : 0);
+			}
+
+			cur = m;
+		}
+
+		return res | cur;
+	}
+
+	sinsp_filter_check* fchk = dynamic_cast<sinsp_filter_check*>(chk);
+	if(fchk == NULL || fchk->m_field == NULL)
+	{
+		return MATCH_ANY;
+	}
+
+	const char* name = fchk->m_field->m_name;
+	cmpop op = fchk->m_cmpop;
+
+	if(strcmp(name, "evt.rawtime") == 0 && fchk->m_val_storages_members.size() == 1)
+	{
+		uint64_t val = *(uint64_t*)fchk->m_val_storages_members.begin()->first;
+
+		switch(op)
+		{
+		case CO_LT:
+			return b.m_start_ts >= val ? MATCH_FALSE : b.m_end_ts < val ? MATCH_TRUE : MATCH_ANY;
+		case CO_LE:
+			return b.m_start_ts > val ? MATCH_FALSE : b.m_end_ts <= val ? MATCH_TRUE : MATCH_ANY;
+		case CO_GT:
+			return b.m_end_ts <= val ? MATCH_FALSE : b.m_start_ts > val ? MATCH_TRUE : MATCH_ANY;
+		case CO_GE:
+			return b.m_end_ts < val ? MATCH_FALSE : b.m_start_ts >= val ? MATCH_TRUE : MATCH_ANY;
+		case CO_EQ:
+			return (val < b.m_start_ts || val > b.m_end_ts) ? MATCH_FALSE : MATCH_ANY;
+		default:
+			return MATCH_ANY;
+		}
+	}
+
+	if(op != CO_EQ && op != CO_IN)
+	{
+		return MATCH_ANY;
+	}
+
+	if(strcmp(name, "evt.type") == 0)
+	{
+		//
+		// The generic events take the name of their syscall
+		//
+		const ppm_event_info* etable = g_infotables.m_event_info;
+		const ppm_syscall_desc* stable = g_infotables.m_syscall_info_table;
+		uint32_t nmatching = 0;
+		uint32_t ntypes = 0;
+
+		for(uint32_t type = 0; type < PPM_EVENT_MAX; type++)
+		{
+			ntypes += has_evttype(b, type);
+		}
+
+		for(const auto& val : string_values(fchk->m_val_storages_members))
+		{
+			for(uint32_t type = 0; type < PPM_EVENT_MAX; type++)
+			{
+				if(type != PPME_GENERIC_E && type != PPME_GENERIC_X &&
+				   has_evttype(b, type) && val == etable[type].name)
+				{
+					nmatching++;
+				}
+			}
+
+			for(uint32_t sc = 0; sc < PPM_SC_MAX; sc++)
+			{
+				if(stable[sc].name != NULL && val == stable[sc].name &&
+				   (has_evttype(b, PPME_GENERIC_E) || has_evttype(b, PPME_GENERIC_X)))
+				{
+					return MATCH_ANY;
+				}
+			}
+		}
+
+		return nmatching == 0 ? MATCH_FALSE : nmatching == ntypes ? MATCH_TRUE : MATCH_ANY;
+	}
+
+	if(strcmp(name, "thread.tid") == 0)
+	{
+		uint32_t nmatching = 0;
+
+		for(const auto& it : fchk->m_val_storages_members)
+		{
+			int64_t tid = *(int64_t*)it.first;
+			nmatching += std::binary_search(b.m_tids.begin(), b.m_tids.end(), tid);
+		}
+
+		return nmatching == 0 ? MATCH_FALSE : nmatching == b.m_tids.size() ? MATCH_TRUE : MATCH_ANY;
+	}
+
+	if(strcmp(name, "container.id") == 0)
+	{
+		//
+		// The events that had no thread info when indexed may have one
+		// when read, in the host or not, or still have none and match
+		// no container id
+		//
+		if(std::binary_search(b.m_containers.begin(), b.m_containers.end(),
+				      CAPTURE_INDEX_NO_THREAD_INFO))
+		{
+			return MATCH_ANY;
+		}
+
+		uint32_t nmatching = 0;
+
+		for(const auto& val : string_values(fchk->m_val_storages_members))
+		{
+			// the index keeps the host as an empty id
+			std::string id = val == "host" ? "" : val;
+			nmatching += std::binary_search(b.m_containers.begin(), b.m_containers.end(), id);
+		}
+
+		return nmatching == 0 ? MATCH_FALSE : nmatching == b.m_containers.size() ? MATCH_TRUE : MATCH_ANY;
+	}
+#endif
+
+	return MATCH_ANY;
+}
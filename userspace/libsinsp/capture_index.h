@@ -0,0 +1,170 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+class sinsp_evt;
+class gen_event_filter_check;
+
+namespace libsinsp
+{
+
+#define CAPTURE_INDEX_DEFAULT_BLOCK_EVTS 16384
+
+// the container of the events without thread info, never a container id
+#define CAPTURE_INDEX_NO_THREAD_INFO "\x01"
+
+//
+// A side index of a capture file. The events are grouped in blocks of
+// consecutive events, and for each block the index keeps its position
+// in the file, its time range, and the thread ids, container ids and
+// event types of its events.
+//
+// The index is written next to the capture, either by sinsp_dumper
+// (see sinsp_dumper::enable_index()), one block at a time, or by
+// build() in one pass over an existing capture. When it's registered
+// with sinsp::set_capture_index(), sinsp::next() seeks over the blocks
+// that can't match the filter of the inspector or the query of the
+// index. In a block that can't match, the events changing the state
+// (threads, fds, containers) are parsed anyway, without being returned,
+// so that the later events, e.g. the ones matching container.id or
+// proc.name, still find the state they depend on. The index keeps their
+// positions, and the rest of the block is skipped.
+//
+class capture_index
+{
+public:
+	struct block
+	{
+		uint64_t m_offset;      // file position of the first event
+		uint64_t m_start_ts;
+		uint64_t m_end_ts;
+		uint32_t m_nevts;
+		std::vector<uint64_t> m_evttypes;  // bitmap, by event type
+		std::vector<int64_t> m_tids;       // sorted
+		std::vector<std::string> m_containers;  // sorted, "" is the host, see CAPTURE_INDEX_NO_THREAD_INFO
+		std::vector<uint64_t> m_state_offsets;  // positions of the events changing the state
+	};
+
+	//
+	// What the events of interest look like. Empty sets match anything.
+	//
+	struct query
+	{
+		query();
+
+		uint64_t m_start_ts;
+		uint64_t m_end_ts;
+		std::set<int64_t> m_tids;
+		std::set<std::string> m_containers;
+		std::set<uint16_t> m_evttypes;
+	};
+
+	capture_index(uint32_t block_evts = CAPTURE_INDEX_DEFAULT_BLOCK_EVTS);
+
+	static std::string default_path(const std::string& capture_filename)
+	{
+		return capture_filename + ".idx";
+	}
+
+	//
+	// Writing. If a path was opened, each block is appended to it as
+	// soon as it's complete. end_offset is the file position after the
+	// last event. An event not read from the file at offset, e.g. a
+	// container event generated by the inspector, can't be replayed
+	// for its state. Throw sinsp_exception on I/O errors.
+	//
+	void open(const std::string& path);
+	void add(uint64_t offset, sinsp_evt* evt, bool in_file = true);
+	void close(uint64_t end_offset);
+
+	//
+	// Read the index file of a capture, or create it in one pass
+	//
+	void load(const std::string& path);
+	static void build(const std::string& capture_filename,
+			  const std::string& path,
+			  uint32_t block_evts = CAPTURE_INDEX_DEFAULT_BLOCK_EVTS);
+
+	const std::vector<block>& get_blocks() const
+	{
+		return m_blocks;
+	}
+
+	//
+	// The file position after the last block, 0 if the index was not
+	// closed (e.g. the writer crashed) and the last block may be partial
+	//
+	uint64_t get_end_offset() const
+	{
+		return m_end_offset;
+	}
+
+	void set_query(const query& q);
+	void clear_query();
+
+	//
+	// Whether the events of the block can match the query of the index
+	// and the given filter (NULL for none). Only the checks on
+	// evt.type, evt.rawtime, thread.tid and container.id are used, the
+	// others are assumed to match.
+	//
+	bool may_match(const block& b, gen_event_filter_check* filter) const;
+
+	//
+	// The index of the block containing the given file position, -1 if
+	// it's before the first one
+	//
+	int32_t find_block(uint64_t offset) const;
+
+private:
+	enum match
+	{
+		MATCH_FALSE = 1,
+		MATCH_TRUE = 2,
+		MATCH_ANY = 3,
+	};
+
+	void flush_block();
+	void write_block(const block& b);
+	void write_end();
+	uint32_t match_check(const block& b, gen_event_filter_check* chk) const;
+	bool has_evttype(const block& b, uint16_t type) const;
+
+	uint32_t m_block_evts;
+	std::vector<block> m_blocks;
+	uint64_t m_end_offset;
+	bool m_has_query;
+	query m_query;
+
+	// the block being built
+	block m_cur;
+	std::set<int64_t> m_cur_tids;
+	std::set<std::string> m_cur_containers;
+	int64_t m_last_tid;
+
+	std::string m_path;
+	std::ofstream m_out;
+};
+
+}  // namespace libsinsp
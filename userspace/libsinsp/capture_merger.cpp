@@ -0,0 +1,419 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <cstring>
+
+#include "capture_merger.h"
+#include "sinsp.h"
+#include "sinsp_int.h"
+
+using namespace libsinsp;
+
+//
+// The read-ahead memory of each file is split in this many chunks
+//
+#define CAPTURE_READAHEAD_CHUNKS 4
+#define CAPTURE_READAHEAD_MIN_CHUNK_SIZE (64 * 1024)
+
+///////////////////////////////////////////////////////////////////////////////
+// capture_readahead implementation
+///////////////////////////////////////////////////////////////////////////////
+capture_readahead::capture_readahead(const std::string& filename, uint64_t readahead_bytes):
+	m_filename(filename),
+	m_chunk_size(readahead_bytes / CAPTURE_READAHEAD_CHUNKS),
+	m_h(NULL),
+	m_stop(false),
+	m_res(SCAP_SUCCESS),
+	m_done(false),
+	m_pos(0)
+{
+	if(m_chunk_size < CAPTURE_READAHEAD_MIN_CHUNK_SIZE)
+	{
+		m_chunk_size = CAPTURE_READAHEAD_MIN_CHUNK_SIZE;
+	}
+
+	m_queue.set_capacity(CAPTURE_READAHEAD_CHUNKS);
+}
+
+capture_readahead::~capture_readahead()
+{
+	stop();
+}
+
+void capture_readahead::start()
+{
+	char error[SCAP_LASTERR_SIZE];
+	int32_t rc;
+
+	m_h = scap_open_offline(m_filename.c_str(), error, &rc);
+	if(m_h == NULL)
+	{
+		throw sinsp_exception(m_filename + ": " + error);
+	}
+
+	m_thread = std::thread(&capture_readahead::run, this);
+}
+
+void capture_readahead::stop()
+{
+	if(m_thread.joinable())
+	{
+		m_stop = true;
+		m_queue.abort();
+		m_thread.join();
+	}
+
+	chunk* c = NULL;
+	while(m_queue.try_pop(c))
+	{
+		delete c;
+	}
+
+	if(m_h != NULL)
+	{
+		scap_close(m_h);
+		m_h = NULL;
+	}
+
+	m_cur.reset();
+	m_last.reset();
+	m_done = true;
+}
+
+void capture_readahead::run()
+{
+	int32_t res = SCAP_SUCCESS;
+
+	try
+	{
+		while(res == SCAP_SUCCESS && !m_stop)
+		{
+			std::unique_ptr<chunk> c(new chunk());
+			c->m_data.reserve(m_chunk_size + 4096);
+
+			while(c->m_data.size() < m_chunk_size)
+			{
+				scap_evt* pevt;
+				uint16_t cpuid;
+
+				res = scap_next(m_h, &pevt, &cpuid);
+				if(res == SCAP_TIMEOUT)
+				{
+					res = SCAP_SUCCESS;
+					continue;
+				}
+				else if(res != SCAP_SUCCESS)
+				{
+					break;
+				}
+
+				uint32_t offset = (uint32_t)c->m_data.size();
+				c->m_data.insert(c->m_data.end(), (char*)pevt, (char*)pevt + pevt->len);
+				c->m_evts.emplace_back(offset, cpuid);
+			}
+
+			if(!c->m_evts.empty())
+			{
+				m_queue.push(c.get());
+				c.release();
+			}
+		}
+
+		if(res == SCAP_UNEXPECTED_BLOCK)
+		{
+			m_lasterr = m_filename + ": concatenated captures are not supported";
+			res = SCAP_FAILURE;
+		}
+		else if(res != SCAP_SUCCESS && res != SCAP_EOF)
+		{
+			m_lasterr = m_filename + ": " + scap_getlasterr(m_h);
+		}
+
+		m_res = res;
+		m_queue.push(NULL);
+	}
+	catch(const tbb::user_abort&)
+	{
+		// stopped while waiting for the consumer
+	}
+}
+
+int32_t capture_readahead::fill()
+{
+	if(m_cur != NULL && m_pos < m_cur->m_evts.size())
+	{
+		return SCAP_SUCCESS;
+	}
+
+	if(m_done)
+	{
+		return m_res;
+	}
+
+	chunk* c = NULL;
+	m_queue.pop(c);
+
+	if(c == NULL)
+	{
+		m_done = true;
+		m_cur.reset();
+		return m_res;
+	}
+
+	m_cur.reset(c);
+	m_pos = 0;
+	return SCAP_SUCCESS;
+}
+
+int32_t capture_readahead::next(scap_evt** pevt, uint16_t* pcpuid)
+{
+	m_last.reset();
+
+	int32_t res = fill();
+	if(res != SCAP_SUCCESS)
+	{
+		return res;
+	}
+
+	const std::pair<uint32_t, uint16_t>& e = m_cur->m_evts[m_pos++];
+	*pevt = (scap_evt*)(m_cur->m_data.data() + e.first);
+	*pcpuid = e.second;
+
+	if(m_pos == m_cur->m_evts.size())
+	{
+		m_last = std::move(m_cur);
+	}
+
+	return SCAP_SUCCESS;
+}
+
+int32_t capture_readahead::next_ts(uint64_t* ts)
+{
+	int32_t res = fill();
+	if(res != SCAP_SUCCESS)
+	{
+		return res;
+	}
+
+	*ts = ((scap_evt*)(m_cur->m_data.data() + m_cur->m_evts[m_pos].first))->ts;
+	return SCAP_SUCCESS;
+}
+
+std::string capture_readahead::get_lasterr()
+{
+	return m_lasterr;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// capture_merger implementation
+///////////////////////////////////////////////////////////////////////////////
+capture_merger::capture_merger(const std::vector<std::string>& filenames,
+			       state_mode mode,
+			       uint64_t readahead_bytes):
+	m_mode(mode),
+	m_last_idx(0),
+	m_pending(false)
+{
+	if(filenames.empty())
+	{
+		throw sinsp_exception("no capture files to merge");
+	}
+
+	for(const auto& filename : filenames)
+	{
+		m_readers.emplace_back(new capture_readahead(filename, readahead_bytes));
+
+		if(m_mode == STATE_PER_FILE || m_inspectors.empty())
+		{
+			m_inspectors.emplace_back(new sinsp());
+		}
+	}
+
+	m_seen.resize(m_readers.size(), false);
+}
+
+capture_merger::~capture_merger()
+{
+	close();
+}
+
+void capture_merger::open()
+{
+	//
+	// The inspectors load the tables of their file, the readers provide
+	// the events
+	//
+	for(uint32_t j = 0; j < m_inspectors.size(); j++)
+	{
+		m_inspectors[j]->open(m_readers[j]->get_filename());
+		m_inspectors[j]->m_event_source = m_mode == STATE_PER_FILE ?
+			(raw_event_source*)m_readers[j].get() :
+			(raw_event_source*)this;
+	}
+
+	m_seen[0] = true;
+
+	for(uint32_t j = 0; j < m_readers.size(); j++)
+	{
+		m_readers[j]->start();
+	}
+
+	for(uint32_t j = 0; j < m_readers.size(); j++)
+	{
+		if(push_reader(j) == SCAP_FAILURE)
+		{
+			throw sinsp_exception(m_readers[j]->get_lasterr());
+		}
+	}
+
+	m_pending = false;
+}
+
+void capture_merger::close()
+{
+	for(auto& inspector : m_inspectors)
+	{
+		inspector->m_event_source = NULL;
+		inspector->close();
+	}
+
+	for(auto& reader : m_readers)
+	{
+		reader->stop();
+	}
+
+	m_heap = decltype(m_heap)();
+	m_pending = false;
+}
+
+sinsp* capture_merger::get_inspector(uint32_t file_idx)
+{
+	if(m_mode == STATE_SHARED)
+	{
+		return m_inspectors[0].get();
+	}
+
+	return m_inspectors.at(file_idx).get();
+}
+
+int32_t capture_merger::push_reader(uint32_t idx)
+{
+	uint64_t ts;
+	int32_t res = m_readers[idx]->next_ts(&ts);
+
+	if(res == SCAP_SUCCESS)
+	{
+		m_heap.push(heap_entry(ts, idx));
+	}
+	else if(res != SCAP_EOF)
+	{
+		m_lasterr = m_readers[idx]->get_lasterr();
+	}
+
+	return res;
+}
+
+int32_t capture_merger::next(sinsp_evt** evt)
+{
+	if(m_mode == STATE_SHARED)
+	{
+		return m_inspectors[0]->next(evt);
+	}
+
+	//
+	// The file of the last event goes back in the heap with its next
+	// timestamp, now that its inspector is done with the previous one
+	//
+	if(m_pending)
+	{
+		m_pending = false;
+		if(push_reader(m_last_idx) == SCAP_FAILURE)
+		{
+			return SCAP_FAILURE;
+		}
+	}
+
+	if(m_heap.empty())
+	{
+		return SCAP_EOF;
+	}
+
+	m_last_idx = m_heap.top().second;
+	m_heap.pop();
+	m_pending = true;
+
+	int32_t res = m_inspectors[m_last_idx]->next(evt);
+	if(res == SCAP_EOF)
+	{
+		// the other files go on
+		return SCAP_TIMEOUT;
+	}
+	else if(res != SCAP_SUCCESS && res != SCAP_TIMEOUT)
+	{
+		m_lasterr = m_inspectors[m_last_idx]->getlasterr();
+	}
+
+	return res;
+}
+
+int32_t capture_merger::next(scap_evt** pevt, uint16_t* pcpuid)
+{
+	if(m_pending)
+	{
+		m_pending = false;
+		if(push_reader(m_last_idx) == SCAP_FAILURE)
+		{
+			return SCAP_FAILURE;
+		}
+	}
+
+	if(m_heap.empty())
+	{
+		return SCAP_EOF;
+	}
+
+	m_last_idx = m_heap.top().second;
+	m_heap.pop();
+	m_pending = true;
+
+	if(!m_seen[m_last_idx])
+	{
+		import_threads(m_last_idx);
+	}
+
+	return m_readers[m_last_idx]->next(pevt, pcpuid);
+}
+
+void capture_merger::import_threads(uint32_t idx)
+{
+	m_seen[idx] = true;
+
+	//
+	// The reader thread doesn't touch the tables of its handle once
+	// the file is open
+	//
+	scap_threadinfo* table = scap_get_proc_table(m_readers[idx]->get_handle());
+	if(table != NULL)
+	{
+		m_inspectors[0]->merge_thread_table(table);
+	}
+}
+
+std::string capture_merger::get_lasterr()
+{
+	return m_lasterr;
+}
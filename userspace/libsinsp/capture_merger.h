@@ -0,0 +1,199 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "scap.h"
+#include "tbb/concurrent_queue.h"
+
+class sinsp;
+class sinsp_evt;
+
+namespace libsinsp
+{
+
+//
+// Where sinsp::next() takes the raw events from, instead of its own
+// scap handle. The event returned by next() must stay valid until the
+// following call.
+//
+class raw_event_source
+{
+public:
+	virtual ~raw_event_source() = default;
+
+	// SCAP_SUCCESS, SCAP_EOF, or SCAP_FAILURE with get_lasterr() set
+	virtual int32_t next(scap_evt** pevt, uint16_t* pcpuid) = 0;
+	virtual std::string get_lasterr() = 0;
+};
+
+//
+// Reads a capture file ahead of its consumer, in a thread of its own,
+// keeping up to readahead_bytes of events in memory. The events are
+// copied in chunks, so that the queue is touched once per chunk rather
+// than once per event.
+//
+class capture_readahead : public raw_event_source
+{
+public:
+	capture_readahead(const std::string& filename, uint64_t readahead_bytes);
+	~capture_readahead();
+
+	//
+	// Open the file and start reading it. Throws sinsp_exception if the
+	// file can't be opened.
+	//
+	void start();
+	void stop();
+
+	int32_t next(scap_evt** pevt, uint16_t* pcpuid) override;
+	std::string get_lasterr() override;
+
+	//
+	// The timestamp of the event the next call of next() returns,
+	// waiting for the reader if needed
+	//
+	int32_t next_ts(uint64_t* ts);
+
+	scap_t* get_handle()
+	{
+		return m_h;
+	}
+
+	const std::string& get_filename() const
+	{
+		return m_filename;
+	}
+
+private:
+	struct chunk
+	{
+		std::vector<char> m_data;
+		// offset in m_data and cpu of each event
+		std::vector<std::pair<uint32_t, uint16_t>> m_evts;
+	};
+
+	void run();
+	int32_t fill();
+
+	std::string m_filename;
+	uint64_t m_chunk_size;
+	scap_t* m_h;
+	std::thread m_thread;
+	std::atomic<bool> m_stop;
+
+	//
+	// The reader ends the queue with a NULL chunk, after setting m_res
+	// and m_lasterr
+	//
+	tbb::concurrent_bounded_queue<chunk*> m_queue;
+	int32_t m_res;
+	std::string m_lasterr;
+
+	// consumer side: the chunk being read, and the one holding the
+	// last event returned, kept until the following call
+	bool m_done;
+	std::unique_ptr<chunk> m_cur;
+	uint32_t m_pos;
+	std::unique_ptr<chunk> m_last;
+};
+
+//
+// Reads several capture files at once, merging their events in
+// timestamp order with a heap keyed on the next event of each file.
+// Every file is read ahead in parallel by a capture_readahead.
+//
+// With STATE_PER_FILE (captures of different hosts) each file gets an
+// inspector of its own, with the state tables of that file, and
+// get_inspector() tells which one parsed the last event. With
+// STATE_SHARED (files rolled by cycle_writer) a single inspector parses
+// all the events: the tables come from the first file, and the threads
+// of each following file are added, if missing, when its first event
+// is read.
+//
+// The inspectors can be configured between the constructor and open().
+//
+class capture_merger : public raw_event_source
+{
+public:
+	enum state_mode
+	{
+		STATE_PER_FILE = 0,
+		STATE_SHARED = 1,
+	};
+
+	capture_merger(const std::vector<std::string>& filenames,
+		       state_mode mode = STATE_PER_FILE,
+		       uint64_t readahead_bytes = 8 * 1024 * 1024);
+	~capture_merger();
+
+	void open();
+	void close();
+
+	//
+	// Like sinsp::next(), for the merged stream
+	//
+	int32_t next(sinsp_evt** evt);
+
+	//
+	// The inspector of the given file, or the shared one
+	//
+	sinsp* get_inspector(uint32_t file_idx);
+
+	//
+	// The file of the last event returned by next()
+	//
+	uint32_t get_file_idx() const
+	{
+		return m_last_idx;
+	}
+
+	uint32_t get_num_files() const
+	{
+		return (uint32_t)m_readers.size();
+	}
+
+	int32_t next(scap_evt** pevt, uint16_t* pcpuid) override;
+	std::string get_lasterr() override;
+
+private:
+	typedef std::pair<uint64_t, uint32_t> heap_entry;
+
+	int32_t push_reader(uint32_t idx);
+	void import_threads(uint32_t idx);
+
+	state_mode m_mode;
+	std::vector<std::unique_ptr<capture_readahead>> m_readers;
+	std::vector<std::unique_ptr<sinsp>> m_inspectors;
+	std::vector<bool> m_seen;
+	std::priority_queue<heap_entry, std::vector<heap_entry>, std::greater<heap_entry>> m_heap;
+	uint32_t m_last_idx;
+	bool m_pending;
+	std::string m_lasterr;
+};
+
+}  // namespace libsinsp
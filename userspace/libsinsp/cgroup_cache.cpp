@@ -0,0 +1,126 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <functional>
+
+#include "cgroup_cache.h"
+
+using namespace libsinsp;
+
+cgroup_cache::cgroup_cache(size_t max_entries):
+	m_max_entries(max_entries ? max_entries : 1),
+	m_hits(0),
+	m_misses(0)
+{
+}
+
+size_t cgroup_cache::hash(const cgroups_t& cgroups)
+{
+	std::hash<std::string> hasher;
+	size_t h = cgroups.size();
+
+	for(const auto& it : cgroups)
+	{
+		h = h * 31 + hasher(it.second);
+	}
+
+	return h;
+}
+
+std::unordered_multimap<size_t, cgroup_cache::lru_t::iterator>::iterator cgroup_cache::lookup(const cgroups_t& cgroups, size_t h)
+{
+	auto range = m_entries.equal_range(h);
+
+	for(auto it = range.first; it != range.second; ++it)
+	{
+		if(it->second->m_cgroups == cgroups)
+		{
+			return it;
+		}
+	}
+
+	return m_entries.end();
+}
+
+const std::string* cgroup_cache::find(const cgroups_t& cgroups)
+{
+	auto it = lookup(cgroups, hash(cgroups));
+
+	if(it == m_entries.end())
+	{
+		m_misses++;
+		return NULL;
+	}
+
+	m_hits++;
+	m_lru.splice(m_lru.begin(), m_lru, it->second);
+	return &it->second->m_container_id;
+}
+
+void cgroup_cache::insert(const cgroups_t& cgroups, const std::string& container_id)
+{
+	size_t h = hash(cgroups);
+	auto it = lookup(cgroups, h);
+
+	if(it != m_entries.end())
+	{
+		it->second->m_container_id = container_id;
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+		return;
+	}
+
+	if(m_entries.size() >= m_max_entries)
+	{
+		remove(m_lru.back().m_cgroups);
+	}
+
+	m_lru.push_front(entry{cgroups, container_id});
+	m_entries.emplace(h, m_lru.begin());
+}
+
+void cgroup_cache::remove(const cgroups_t& cgroups)
+{
+	auto it = lookup(cgroups, hash(cgroups));
+
+	if(it != m_entries.end())
+	{
+		m_lru.erase(it->second);
+		m_entries.erase(it);
+	}
+}
+
+void cgroup_cache::remove_container(const std::string& container_id)
+{
+	for(auto it = m_entries.begin(); it != m_entries.end();)
+	{
+		if(it->second->m_container_id == container_id)
+		{
+			m_lru.erase(it->second);
+			it = m_entries.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+void cgroup_cache::clear()
+{
+	m_entries.clear();
+	m_lru.clear();
+}
@@ -0,0 +1,96 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace libsinsp
+{
+
+#define CGROUP_CACHE_DEFAULT_SIZE 4096
+
+//
+// The container id the engines found for a set of cgroups, so that the
+// threads forked in the same cgroups don't go through the pattern
+// matching of every engine again. An empty id means that no engine
+// matched. The least recently used entries are evicted past max_entries.
+//
+class cgroup_cache
+{
+public:
+	typedef std::vector<std::pair<std::string, std::string>> cgroups_t;
+
+	cgroup_cache(size_t max_entries = CGROUP_CACHE_DEFAULT_SIZE);
+
+	//
+	// The container id of the cgroups, or NULL if they are not cached
+	//
+	const std::string* find(const cgroups_t& cgroups);
+
+	void insert(const cgroups_t& cgroups, const std::string& container_id);
+	void remove(const cgroups_t& cgroups);
+
+	//
+	// Drop the entries of a container that went away
+	//
+	void remove_container(const std::string& container_id);
+
+	void clear();
+
+	size_t size() const
+	{
+		return m_entries.size();
+	}
+
+	uint64_t get_hits() const
+	{
+		return m_hits;
+	}
+
+	uint64_t get_misses() const
+	{
+		return m_misses;
+	}
+
+private:
+	struct entry
+	{
+		cgroups_t m_cgroups;
+		std::string m_container_id;
+	};
+
+	typedef std::list<entry> lru_t;
+
+	static size_t hash(const cgroups_t& cgroups);
+	std::unordered_multimap<size_t, lru_t::iterator>::iterator lookup(const cgroups_t& cgroups, size_t h);
+
+	size_t m_max_entries;
+	// most recently used first
+	lru_t m_lru;
+	// by hash of the cgroups
+	std::unordered_multimap<size_t, lru_t::iterator> m_entries;
+	uint64_t m_hits;
+	uint64_t m_misses;
+};
+
+}  // namespace libsinsp
@@ -16,6 +16,8 @@ limitations under the License.
 */
 
 #include <algorithm>
+#include <cstdio>
+#include <fstream>
 
 #ifdef HAS_CAPTURE
 #include "container_engine/cri.h"
@@ -36,13 +38,22 @@ limitations under the License.
 #include "sinsp.h"
 #include "sinsp_int.h"
 #include "container.h"
+#include "parsers.h"
 #include "utils.h"
 
 using namespace libsinsp;
 
+namespace
+{
+const uint32_t CONTAINER_SNAPSHOT_VERSION = 1;
+}
+
 sinsp_container_manager::sinsp_container_manager(sinsp* inspector, bool static_container, const std::string static_id, const std::string static_name, const std::string static_image) :
 	m_inspector(inspector),
 	m_last_flush_time_ns(0),
+	m_snapshot_interval_ns(DEFAULT_CONTAINER_SNAPSHOT_INTERVAL_S * ONE_SECOND_IN_NS),
+	m_last_snapshot_time_ns(0),
+	m_snapshot_writing(false),
 	m_static_container(static_container),
 	m_static_id(static_id),
 	m_static_name(static_name),
@@ -52,6 +63,7 @@ sinsp_container_manager::sinsp_container_manager(sinsp* inspector, bool static_c
 
 sinsp_container_manager::~sinsp_container_manager()
 {
+	wait_snapshot_writer();
 }
 
 bool sinsp_container_manager::remove_inactive_containers()
@@ -84,23 +96,48 @@ bool sinsp_container_manager::remove_inactive_containers()
 			return true;
 		});
 
-		auto containers = m_containers.lock();
-		for(auto it = containers->begin(); it != containers->end();)
+		std::lock_guard<std::mutex> addresses_guard(m_addresses_mutex);
+		bool addresses_changed = false;
 		{
-			if(containers_in_use.find(it->first) == containers_in_use.end())
+			auto containers = m_containers.lock();
+			for(auto it = containers->begin(); it != containers->end();)
 			{
-				sinsp_container_info::ptr_t container = it->second;
-				for(const auto &remove_cb : m_remove_callbacks)
+				if(containers_in_use.find(it->first) == containers_in_use.end())
+				{
+					sinsp_container_info::ptr_t container = it->second;
+
+					// containers restored from the snapshot but never
+					// confirmed by their runtime were never announced either
+					if(m_unvalidated.erase(it->first) == 0)
+					{
+						for(const auto &remove_cb : m_remove_callbacks)
+						{
+							remove_cb(*container);
+						}
+					}
+					m_cgroup_cache.remove_container(it->first);
+					// a new container could get the id back
+					m_inspector->unsuppress_events_container(it->first);
+					update_address(it->first, 0, true);
+					addresses_changed = true;
+					containers->erase(it++);
+				}
+				else
 				{
-					remove_cb(*container);
+					++it;
 				}
-				containers->erase(it++);
 			}
-			else
+
+			if(addresses_changed)
 			{
-				++it;
+				publish_containers(*containers);
 			}
 		}
+
+		if(addresses_changed)
+		{
+			publish_addresses();
+		}
 	}
 
 	return res;
@@ -108,9 +145,11 @@ bool sinsp_container_manager::remove_inactive_containers()
 
 sinsp_container_info::ptr_t sinsp_container_manager::get_container(const string& container_id) const
 {
-	auto containers = m_containers.lock();
-	auto it = containers->find(container_id);
-	if(it != containers->end())
+	// no copy of the snapshot pointer, so no reference count to update
+	libsinsp::read_copy_update<const map_ptr_t>::read_guard snapshot(m_published);
+	const container_map& containers = **snapshot.get();
+	auto it = containers.find(container_id);
+	if(it != containers.end())
 	{
 		return it->second;
 	}
@@ -136,14 +175,60 @@ bool sinsp_container_manager::resolve_container(sinsp_threadinfo* tinfo, bool qu
 		create_engines();
 	}
 
-	for(auto &eng : m_container_engines)
+	//
+	// The threads in the same cgroups as a known container, or in
+	// cgroups no engine matched, skip the pattern matching of the
+	// engines. A container whose metadata is not complete yet goes
+	// through the engines, so that they keep track of its lookup.
+	//
+	bool use_cache = !matches && !m_static_container && !tinfo->m_cgroups.empty();
+	const std::string* cached = use_cache ? m_cgroup_cache.find(tinfo->m_cgroups) : NULL;
+
+	if(cached != NULL && !cached->empty())
 	{
-		matches = matches || eng->resolve(tinfo, query_os_for_missing_info);
+		sinsp_container_info::ptr_t container = get_container(*cached);
+		if(container && container->is_successful())
+		{
+			tinfo->m_container_id = *cached;
+			matches = true;
+		}
+		else
+		{
+			cached = NULL;
+		}
+	}
 
+	std::shared_ptr<libsinsp::container_engine::container_engine_base> matching_engine;
+	for(auto &eng : m_container_engines)
+	{
 		if(matches)
 		{
 			break;
 		}
+
+		if(cached != NULL && eng->matches_cgroups_only())
+		{
+			continue;
+		}
+
+		matches = eng->resolve(tinfo, query_os_for_missing_info);
+		if(matches)
+		{
+			matching_engine = eng;
+		}
+	}
+
+	if(use_cache && cached == NULL)
+	{
+		if(matching_engine && matching_engine->matches_cgroups_only() &&
+		   !tinfo->m_container_id.empty())
+		{
+			m_cgroup_cache.insert(tinfo->m_cgroups, tinfo->m_container_id);
+		}
+		else if(!matches && tinfo->m_container_id.empty())
+		{
+			m_cgroup_cache.insert(tinfo->m_cgroups, "");
+		}
 	}
 
 	// Also possibly set the category for the threadinfo
@@ -293,15 +378,25 @@ bool sinsp_container_manager::container_to_sinsp_event(const string& json, sinsp
 
 sinsp_container_manager::map_ptr_t sinsp_container_manager::get_containers() const
 {
-	return m_containers.lock();
+	libsinsp::read_copy_update<const map_ptr_t>::read_guard snapshot(m_published);
+	return *snapshot.get();
 }
 
 void sinsp_container_manager::add_container(const sinsp_container_info::ptr_t& container_info, sinsp_threadinfo *thread)
 {
 	set_lookup_status(container_info->m_id, container_info->m_type, container_info->m_lookup_state);
 	{
-		auto containers = m_containers.lock();
-		(*containers)[container_info->m_id] = container_info;
+		std::lock_guard<std::mutex> addresses_guard(m_addresses_mutex);
+		{
+			auto containers = m_containers.lock();
+			(*containers)[container_info->m_id] = container_info;
+			update_address(container_info->m_id, container_info->m_container_ip, false);
+			publish_containers(*containers);
+
+			// the runtime answered for a restored container
+			m_unvalidated.erase(container_info->m_id);
+		}
+		publish_addresses();
 	}
 
 	for(const auto &new_cb : m_new_callbacks)
@@ -312,9 +407,53 @@ void sinsp_container_manager::add_container(const sinsp_container_info::ptr_t& c
 
 void sinsp_container_manager::replace_container(const sinsp_container_info::ptr_t& container_info)
 {
-	auto containers = m_containers.lock();
-	ASSERT(containers->find(container_info->m_id) != containers->end());
-	(*containers)[container_info->m_id] = container_info;
+	std::lock_guard<std::mutex> addresses_guard(m_addresses_mutex);
+	{
+		auto containers = m_containers.lock();
+		ASSERT(containers->find(container_info->m_id) != containers->end());
+		(*containers)[container_info->m_id] = container_info;
+		update_address(container_info->m_id, container_info->m_container_ip, false);
+		publish_containers(*containers);
+	}
+	publish_addresses();
+}
+
+void sinsp_container_manager::update_address(const std::string& container_id, uint32_t ip, bool removed)
+{
+	auto it = m_addresses_master.m_ip_by_id.find(container_id);
+	if(it != m_addresses_master.m_ip_by_id.end() && it->second != 0)
+	{
+		auto ip_it = m_addresses_master.m_ips.find(htonl(it->second));
+		if(ip_it != m_addresses_master.m_ips.end() && --ip_it->second == 0)
+		{
+			m_addresses_master.m_ips.erase(ip_it);
+		}
+	}
+
+	if(removed)
+	{
+		if(it != m_addresses_master.m_ip_by_id.end())
+		{
+			m_addresses_master.m_ip_by_id.erase(it);
+		}
+		return;
+	}
+
+	m_addresses_master.m_ip_by_id[container_id] = ip;
+	if(ip != 0)
+	{
+		m_addresses_master.m_ips[htonl(ip)]++;
+	}
+}
+
+void sinsp_container_manager::publish_addresses()
+{
+	m_addresses.publish(new container_addresses(m_addresses_master));
+}
+
+void sinsp_container_manager::publish_containers(const container_map& containers)
+{
+	m_published.publish(new map_ptr_t(std::make_shared<const container_map>(containers)));
 }
 
 void sinsp_container_manager::notify_new_container(const sinsp_container_info& container_info)
@@ -345,7 +484,7 @@ void sinsp_container_manager::notify_new_container(const sinsp_container_info& c
 
 void sinsp_container_manager::dump_containers(scap_dumper_t* dumper)
 {
-	for(const auto& it : (*m_containers.lock()))
+	for(const auto& it : (*get_containers()))
 	{
 		sinsp_evt evt;
 		if(container_to_sinsp_event(container_to_json(*it.second), &evt, it.second->get_tinfo(m_inspector)))
@@ -659,8 +798,235 @@ void sinsp_container_manager::set_cri_delay(uint64_t delay_ms)
 #endif
 }
 
+void sinsp_container_manager::set_lookup_concurrency(uint32_t lookup_concurrency)
+{
+#if !defined(MINIMAL_BUILD) && !defined(_WIN32)
+	libsinsp::container_engine::docker_async_source::set_lookup_concurrency(lookup_concurrency);
+#endif
+#if !defined(MINIMAL_BUILD) && defined(HAS_CAPTURE)
+	libsinsp::container_engine::cri::set_lookup_concurrency(lookup_concurrency);
+#endif
+}
+
 void sinsp_container_manager::set_container_labels_max_len(uint32_t max_label_len)
 {
 	sinsp_container_info::m_container_label_max_length = max_label_len;
 }
 
+void sinsp_container_manager::set_snapshot_path(const std::string& path, uint64_t interval_ns)
+{
+	m_snapshot_path = path;
+	m_snapshot_interval_ns = interval_ns;
+}
+
+bool sinsp_container_manager::load_snapshot()
+{
+	if(m_snapshot_path.empty())
+	{
+		return false;
+	}
+
+	std::ifstream in(m_snapshot_path);
+	if(!in)
+	{
+		g_logger.format(sinsp_logger::SEV_DEBUG,
+				"No container snapshot at %s",
+				m_snapshot_path.c_str());
+		return false;
+	}
+
+	std::string line;
+	Json::Value header;
+	if(!std::getline(in, line) ||
+	   !Json::Reader().parse(line, header) ||
+	   !header["container_snapshot"]["version"].isUInt() ||
+	   header["container_snapshot"]["version"].asUInt() != CONTAINER_SNAPSHOT_VERSION)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"Ignoring container snapshot %s: unsupported format",
+				m_snapshot_path.c_str());
+		return false;
+	}
+
+	uint32_t nerrors = 0;
+	std::vector<sinsp_container_info::ptr_t> restored;
+	while(std::getline(in, line))
+	{
+		sinsp_container_info::ptr_t container_info;
+		try
+		{
+			container_info = sinsp_parser::parse_container_json(line, true);
+		}
+		catch(const std::exception&)
+		{
+			nerrors++;
+			continue;
+		}
+
+		if(container_info->m_id.empty() || !container_info->is_successful())
+		{
+			nerrors++;
+			continue;
+		}
+
+		restored.push_back(container_info);
+	}
+
+	//
+	// Add them all, and publish the table and the addresses once
+	//
+	uint32_t nrestored = 0;
+	{
+		std::lock_guard<std::mutex> addresses_guard(m_addresses_mutex);
+		{
+			auto containers = m_containers.lock();
+			for(const auto& container_info : restored)
+			{
+				if(!containers->emplace(container_info->m_id, container_info).second)
+				{
+					continue;
+				}
+				update_address(container_info->m_id, container_info->m_container_ip, false);
+
+				// no lookup status: the engine queries the runtime again
+				// when the first thread of the container shows up, the
+				// restored metadata is only served until the answer arrives
+				m_unvalidated.insert(container_info->m_id);
+				nrestored++;
+			}
+
+			if(nrestored != 0)
+			{
+				publish_containers(*containers);
+			}
+		}
+
+		if(nrestored != 0)
+		{
+			publish_addresses();
+		}
+	}
+
+	g_logger.format(sinsp_logger::SEV_INFO,
+			"Restored %u containers from snapshot %s (%u invalid entries)",
+			nrestored, m_snapshot_path.c_str(), nerrors);
+
+	return true;
+}
+
+std::string sinsp_container_manager::build_snapshot(uint32_t& nsaved)
+{
+	Json::Value header;
+	header["container_snapshot"]["version"] = CONTAINER_SNAPSHOT_VERSION;
+	std::string data = Json::FastWriter().write(header);
+
+	nsaved = 0;
+	for(const auto& it : (*get_containers()))
+	{
+		if(!it.second->is_successful() || m_unvalidated.find(it.first) != m_unvalidated.end())
+		{
+			continue;
+		}
+
+		// FastWriter terminates every document with a newline
+		data += container_to_json(*it.second);
+		nsaved++;
+	}
+
+	return data;
+}
+
+bool sinsp_container_manager::write_snapshot_file(const std::string& path, const std::string& data, uint32_t nsaved)
+{
+	std::string tmp_path = path + ".tmp";
+	{
+		std::ofstream out(tmp_path, std::ofstream::out | std::ofstream::trunc);
+		out.write(data.c_str(), data.size());
+		out.close();
+		if(!out)
+		{
+			g_logger.format(sinsp_logger::SEV_WARNING,
+					"Cannot write container snapshot %s",
+					tmp_path.c_str());
+			::remove(tmp_path.c_str());
+			return false;
+		}
+	}
+
+	if(::rename(tmp_path.c_str(), path.c_str()) != 0)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"Cannot replace container snapshot %s: %s",
+				path.c_str(), strerror(errno));
+		::remove(tmp_path.c_str());
+		return false;
+	}
+
+	g_logger.format(sinsp_logger::SEV_DEBUG,
+			"Saved %u containers to snapshot %s",
+			nsaved, path.c_str());
+
+	return true;
+}
+
+void sinsp_container_manager::wait_snapshot_writer()
+{
+	if(m_snapshot_writer.joinable())
+	{
+		m_snapshot_writer.join();
+	}
+}
+
+bool sinsp_container_manager::write_snapshot()
+{
+	if(m_snapshot_path.empty())
+	{
+		return false;
+	}
+
+	// don't let a pending background write replace this one
+	wait_snapshot_writer();
+
+	uint32_t nsaved;
+	std::string data = build_snapshot(nsaved);
+	return write_snapshot_file(m_snapshot_path, data, nsaved);
+}
+
+void sinsp_container_manager::update_snapshot()
+{
+	if(m_snapshot_path.empty())
+	{
+		return;
+	}
+
+	uint64_t ts = m_inspector->m_lastevent_ts;
+	if(m_last_snapshot_time_ns == 0)
+	{
+		m_last_snapshot_time_ns = ts;
+	}
+	else if(ts > m_last_snapshot_time_ns + m_snapshot_interval_ns)
+	{
+		if(m_snapshot_writing)
+		{
+			// the disk is slower than the interval, try again at the
+			// next event rather than queueing up another copy
+			return;
+		}
+		m_last_snapshot_time_ns = ts;
+		wait_snapshot_writer();
+
+		//
+		// Only rendering the table happens on the event thread, the
+		// (possibly slow) file write and rename are done in the background
+		//
+		uint32_t nsaved;
+		std::string data = build_snapshot(nsaved);
+		std::string path = m_snapshot_path;
+		m_snapshot_writing = true;
+		m_snapshot_writer = std::thread([this, path, data, nsaved]()
+		{
+			write_snapshot_file(path, data, nsaved);
+			m_snapshot_writing = false;
+		});
+	}
+}
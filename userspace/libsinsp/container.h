@@ -17,9 +17,12 @@ limitations under the License.
 
 #pragma once
 
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <thread>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "scap.h"
 
@@ -32,6 +35,8 @@ limitations under the License.
 #include <curl/multi.h>
 #endif
 
+#include "cgroup_cache.h"
+#include "read_copy_update.h"
 #include "container_engine/container_cache_interface.h"
 #include "container_engine/container_engine_base.h"
 #include "container_engine/sinsp_container_type.h"
@@ -41,7 +46,13 @@ class sinsp_container_manager :
 	public libsinsp::container_engine::container_cache_interface
 {
 public:
-	using map_ptr_t = libsinsp::ConstMutexGuard<std::unordered_map<std::string, sinsp_container_info::ptr_t>>;
+	using container_map = std::unordered_map<std::string, sinsp_container_info::ptr_t>;
+
+	//
+	// An immutable snapshot of the containers: it doesn't change, and
+	// stays valid, as long as the caller holds it
+	//
+	using map_ptr_t = std::shared_ptr<const container_map>;
 
 	/**
 	 * Due to how the container manager is architected, it makes it difficult
@@ -59,8 +70,8 @@ public:
 	virtual ~sinsp_container_manager();
 
 	/**
-	 * @brief Get the whole container map (read-only)
-	 * @return the map of container_id -> shared_ptr<container_info>
+	 * @brief Get the whole container map (read-only), without locking
+	 * @return a snapshot of the map of container_id -> shared_ptr<container_info>
 	 */
 	map_ptr_t get_containers() const;
 	bool remove_inactive_containers();
@@ -116,6 +127,37 @@ public:
 	 * it may still be happening in the background asynchronously
 	 */
 	bool resolve_container(sinsp_threadinfo* tinfo, bool query_os_for_missing_info);
+
+	/**
+	 * @brief The cache of the container ids found for thread cgroups,
+	 * e.g. for its hit/miss counters
+	 */
+	const libsinsp::cgroup_cache& get_cgroup_cache() const
+	{
+		return m_cgroup_cache;
+	}
+
+	/**
+	 * @brief The IPv4 addresses of the containers, kept up to date with
+	 * the container table, for lookups that can't take its lock
+	 */
+	struct container_addresses
+	{
+		// by container id, the address in host byte order (0 if unknown)
+		std::unordered_map<std::string, uint32_t> m_ip_by_id;
+		// the non-zero addresses in network byte order, with the
+		// number of containers having each of them
+		std::unordered_map<uint32_t, uint32_t> m_ips;
+	};
+
+	/**
+	 * @brief Read the addresses with a
+	 * read_copy_update<const container_addresses>::read_guard
+	 */
+	const libsinsp::read_copy_update<const container_addresses>& get_container_addresses() const
+	{
+		return m_addresses;
+	}
 	void dump_containers(scap_dumper_t* dumper);
 	std::string get_container_name(sinsp_threadinfo* tinfo) const;
 
@@ -126,7 +168,7 @@ public:
 	void identify_category(sinsp_threadinfo *tinfo);
 
 	bool container_exists(const std::string& container_id) const override{
-		auto containers = m_containers.lock();
+		map_ptr_t containers = get_containers();
 		return containers->find(container_id) != containers->end() ||
 			m_lookups.find(container_id) != m_lookups.end();
 	}
@@ -154,9 +196,51 @@ public:
 	void set_cri_timeout(int64_t timeout_ms);
 	void set_cri_async(bool async);
 	void set_cri_delay(uint64_t delay_ms);
+	void set_lookup_concurrency(uint32_t lookup_concurrency);
 	void set_container_labels_max_len(uint32_t max_label_len);
 	sinsp* get_inspector() { return m_inspector; }
 
+	/**
+	 * @brief Configure the on-disk snapshot of the container table
+	 * @param path the snapshot file, an empty path disables the snapshot
+	 * @param interval_ns how often update_snapshot() rewrites the file
+	 */
+	void set_snapshot_path(const std::string& path, uint64_t interval_ns);
+
+	/**
+	 * @brief Restore the container table from the snapshot file
+	 * @return true if a snapshot was loaded
+	 *
+	 * The restored metadata (name, image, labels...) is served right
+	 * away, but the entries have no lookup status: when a live thread
+	 * first resolves to one of them (see resolve_container()), its
+	 * engine queries the runtime again and the answer replaces the
+	 * restored metadata. Containers nobody resolves are dropped at the
+	 * next inactive container scan and are never written back to the
+	 * snapshot.
+	 */
+	bool load_snapshot();
+
+	/**
+	 * @brief Write the container table to the snapshot file
+	 * @return true if the snapshot was written
+	 *
+	 * Only successful lookups are saved. The file is replaced
+	 * atomically, so a crash while writing leaves the previous
+	 * snapshot in place. The file is written synchronously, after
+	 * waiting for any background write started by update_snapshot().
+	 */
+	bool write_snapshot();
+
+	/**
+	 * @brief Rewrite the snapshot if the configured interval has elapsed
+	 *
+	 * The table is rendered on the calling thread, the file is written
+	 * by a background thread. If the previous write is still running
+	 * the snapshot is postponed.
+	 */
+	void update_snapshot();
+
 	/**
 	 * \brief set the status of an async container metadata lookup
 	 * @param container_id the container id we're looking up
@@ -197,17 +281,47 @@ private:
 	std::string container_to_json(const sinsp_container_info& container_info);
 	bool container_to_sinsp_event(const std::string& json, sinsp_evt* evt, std::shared_ptr<sinsp_threadinfo> tinfo);
 	std::string get_docker_env(const Json::Value &env_vars, const std::string &mti);
+	std::string build_snapshot(uint32_t& nsaved);
+	static bool write_snapshot_file(const std::string& path, const std::string& data, uint32_t nsaved);
+	void wait_snapshot_writer();
+
+	// Update m_addresses_master, under m_addresses_mutex. ip is
+	// ignored when the container is removed.
+	void update_address(const std::string& container_id, uint32_t ip, bool removed);
+	void publish_addresses();
+	// Publish a copy of the containers, under the lock of m_containers
+	void publish_containers(const container_map& containers);
 
 	std::list<std::shared_ptr<libsinsp::container_engine::container_engine_base>> m_container_engines;
 	std::map<sinsp_container_type, std::shared_ptr<libsinsp::container_engine::container_engine_base>> m_container_engine_by_type;
 
 	sinsp* m_inspector;
-	libsinsp::Mutex<std::unordered_map<std::string, std::shared_ptr<const sinsp_container_info>>> m_containers;
+	// the writers update the table under the lock, then publish a copy
+	// of it for the readers. The readers only take a read_guard, and
+	// keep the copy alive past it with the shared_ptr.
+	libsinsp::Mutex<container_map> m_containers;
+	libsinsp::read_copy_update<const map_ptr_t> m_published{new map_ptr_t(std::make_shared<const container_map>())};
 	std::unordered_map<std::string, std::unordered_map<sinsp_container_type, sinsp_container_lookup_state>> m_lookups;
 	uint64_t m_last_flush_time_ns;
 	std::list<new_container_cb> m_new_callbacks;
 	std::list<remove_container_cb> m_remove_callbacks;
 
+	std::string m_snapshot_path;
+	uint64_t m_snapshot_interval_ns;
+	uint64_t m_last_snapshot_time_ns;
+	// ids restored from the snapshot not yet looked up in their runtime
+	std::unordered_set<std::string> m_unvalidated;
+	std::thread m_snapshot_writer;
+	std::atomic<bool> m_snapshot_writing;
+
+	libsinsp::cgroup_cache m_cgroup_cache;
+
+	// the writers update the master copy of the addresses, then publish
+	// a copy of it
+	std::mutex m_addresses_mutex;
+	container_addresses m_addresses_master;
+	libsinsp::read_copy_update<const container_addresses> m_addresses{new container_addresses()};
+
 	// indicates whether we should use only the static container engine, or the other engines.
 	// if true, we expect to have the subsequent bits of metadata as well. If this bool is false,
 	// then the values of those metadata are undefined
@@ -41,6 +41,16 @@ public:
 	virtual bool resolve(sinsp_threadinfo* tinfo,
 			     bool query_os_for_missing_info) = 0;
 
+	/**
+	 * Whether resolve() only looks at the cgroups of the thread to
+	 * decide if it's in a container. The container manager doesn't call
+	 * such engines again for cgroups none of the engines matched.
+	 */
+	virtual bool matches_cgroups_only() const
+	{
+		return true;
+	}
+
 	/**
 	 * Update an existing container with the size of the container layer.
 	 * The size is not requested as the part of the initial request (in resolve)
@@ -46,6 +46,10 @@ namespace {
 bool s_async = true;
 // delay before talking to CRI/cgroups
 uint64_t s_cri_lookup_delay_ms = 500;
+#ifdef CONTAINER_INFO
+// CRI lookups in flight at once
+uint32_t s_cri_lookup_concurrency = 1;
+#endif // CONTAINER_INFO
 
 constexpr const cgroup_layout CRI_CGROUP_LAYOUT[] = {
 	{"/", ""}, // non-systemd containerd
@@ -276,6 +280,11 @@ void cri::set_cri_delay(uint64_t delay_ms)
 {
 	s_cri_lookup_delay_ms = delay_ms;
 }
+
+void cri::set_lookup_concurrency(uint32_t lookup_concurrency)
+{
+	s_cri_lookup_concurrency = lookup_concurrency;
+}
 #endif // CONTAINER_INFO
 
 bool cri::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info)
@@ -333,6 +342,7 @@ bool cri::resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info)
 		if(!m_async_source)
 		{
 			auto async_source = new cri_async_source(cache, m_cri.get(), s_cri_timeout);
+			async_source->set_max_concurrency(s_cri_lookup_concurrency);
 			m_async_source = std::unique_ptr<cri_async_source>(async_source);
 		}
 
@@ -25,6 +25,7 @@ limitations under the License.
 using namespace libsinsp::container_engine;
 
 bool docker_async_source::m_query_image_info = true;
+uint32_t docker_async_source::m_lookup_concurrency = 1;
 
 docker_async_source::docker_async_source(uint64_t max_wait_ms,
 					 uint64_t ttl_ms,
@@ -32,6 +33,7 @@ docker_async_source::docker_async_source(uint64_t max_wait_ms,
 	: async_key_value_source(max_wait_ms, ttl_ms),
 	  m_cache(cache)
 {
+	set_max_concurrency(m_lookup_concurrency);
 }
 
 docker_async_source::~docker_async_source()
@@ -366,6 +368,34 @@ void docker_async_source::parse_health_probes(const Json::Value &config_obj,
 	}
 }
 
+void docker_async_source::set_lookup_concurrency(uint32_t lookup_concurrency)
+{
+	m_lookup_concurrency = lookup_concurrency;
+}
+
+docker_connection& docker_async_source::get_connection()
+{
+	std::lock_guard<std::mutex> guard(m_connections_mutex);
+	uint32_t worker_id = get_worker_id();
+
+	if(worker_id == UINT32_MAX)
+	{
+		worker_id = 0;
+	}
+
+	if(worker_id >= m_connections.size())
+	{
+		m_connections.resize(worker_id + 1);
+	}
+
+	if(!m_connections[worker_id])
+	{
+		m_connections[worker_id].reset(new docker_connection());
+	}
+
+	return *m_connections[worker_id];
+}
+
 void docker_async_source::set_query_image_info(bool query_image_info)
 {
 	g_logger.format(sinsp_logger::SEV_DEBUG,
@@ -391,7 +421,7 @@ void docker_async_source::fetch_image_info(const docker_lookup_request& request,
 			"docker_async url: %s",
 			url.c_str());
 
-	if(!(m_connection.get_docker(request, url, img_json) == docker_connection::RESP_OK))
+	if(!(get_connection().get_docker(request, url, img_json) == docker_connection::RESP_OK))
 	{
 		g_logger.format(sinsp_logger::SEV_ERROR,
 				"docker_async (%s) image (%s): Could not fetch image info",
@@ -435,7 +465,7 @@ void docker_async_source::fetch_image_info_from_list(const docker_lookup_request
 			"docker_async url: %s",
 			url.c_str());
 
-	if(!(m_connection.get_docker(request, url, img_json) == docker_connection::RESP_OK))
+	if(!(get_connection().get_docker(request, url, img_json) == docker_connection::RESP_OK))
 	{
 		g_logger.format(sinsp_logger::SEV_ERROR,
 				"docker_async (%s): Could not fetch image list",
@@ -669,7 +699,7 @@ bool docker_async_source::parse_docker(const docker_lookup_request& request, sin
 		api_request += "?size=true";
 	}
 
-	docker_connection::docker_response resp = m_connection.get_docker(request, api_request, json);
+	docker_connection::docker_response resp = get_connection().get_docker(request, api_request, json);
 
 	switch(resp) {
 	case docker_connection::docker_response::RESP_BAD_REQUEST:
@@ -677,9 +707,9 @@ bool docker_async_source::parse_docker(const docker_lookup_request& request, sin
 				"docker_async (%s): Initial url fetch failed, trying w/o api version",
 				request.container_id.c_str());
 
-		m_connection.set_api_version("");
+		get_connection().set_api_version("");
 		json = "";
-		resp = m_connection.get_docker(request, "/containers/" + request.container_id + "/json", json);
+		resp = get_connection().get_docker(request, "/containers/" + request.container_id + "/json", json);
 		if (resp == docker_connection::docker_response::RESP_OK)
 		{
 			break;
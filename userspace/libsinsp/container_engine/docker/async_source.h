@@ -1,5 +1,9 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "async_key_value_source.h"
 #include "container_info.h"
 
@@ -19,6 +23,7 @@ public:
 
 	static void parse_json_mounts(const Json::Value &mnt_obj, std::vector<sinsp_container_info::container_mount_info> &mounts);
 	static void set_query_image_info(bool query_image_info);
+	static void set_lookup_concurrency(uint32_t lookup_concurrency);
 
 protected:
 	void run_impl();
@@ -26,6 +31,10 @@ protected:
 private:
 	bool parse_docker(const docker_lookup_request& request, sinsp_container_info& container);
 
+	// The connection of the calling async thread: the curl multi handle
+	// of a connection can't be shared between threads
+	docker_connection& get_connection();
+
 	// Look for a pod specification in this container's labels and
 	// if found set spec to the pod spec.
 	bool get_k8s_pod_spec(const Json::Value &config_obj,
@@ -80,8 +89,10 @@ private:
 	void fetch_image_info_from_list(const docker_lookup_request& request, sinsp_container_info& container);
 
 	container_cache_interface *m_cache;
-	docker_connection m_connection;
+	std::mutex m_connections_mutex;
+	std::vector<std::unique_ptr<docker_connection>> m_connections;
 	static bool m_query_image_info;
+	static uint32_t m_lookup_concurrency;
 };
 
 
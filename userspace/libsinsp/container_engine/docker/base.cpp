@@ -53,6 +53,20 @@ docker_base::resolve_impl(sinsp_threadinfo *tinfo, const docker_lookup_request&
 		return false;
 	}
 
+#ifdef HAS_CAPTURE
+	// A container restored from the snapshot has no lookup status: keep
+	// its metadata and refresh it from docker in the background
+	if(query_os_for_missing_info && cache->should_lookup(request.container_id, CT_DOCKER))
+	{
+		g_logger.format(sinsp_logger::SEV_DEBUG,
+				"docker_async (%s): Refreshing restored container info",
+				request.container_id.c_str());
+
+		cache->set_lookup_status(request.container_id, CT_DOCKER, sinsp_container_lookup_state::STARTED);
+		parse_docker_async(request, cache);
+	}
+#endif
+
 	// Returning true will prevent other container engines from
 	// trying to resolve the container, so only return true if we
 	// have complete metadata.
@@ -13,6 +13,11 @@ public:
 
 	// implement container_engine_base
 	bool resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info) override;
+	// containers are found by pid
+	bool matches_cgroups_only() const override
+	{
+		return false;
+	}
 	void update_with_size(const std::string& container_id) override;
 
 private:
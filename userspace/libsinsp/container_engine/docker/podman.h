@@ -15,6 +15,11 @@ private:
 
 	// implement container_engine_base
 	bool resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info) override;
+	// rootless containers depend on the user namespace
+	bool matches_cgroups_only() const override
+	{
+		return false;
+	}
 	void update_with_size(const std::string& container_id) override;
 };
 
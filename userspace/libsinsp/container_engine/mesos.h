@@ -34,6 +34,11 @@ public:
 	{}
 
 	bool resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info) override;
+	// the task id comes from the environment
+	bool matches_cgroups_only() const override
+	{
+		return false;
+	}
 
 	static bool set_mesos_task_id(sinsp_container_info& container, sinsp_threadinfo *tinfo);
 
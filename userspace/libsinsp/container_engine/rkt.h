@@ -34,6 +34,11 @@ public:
 	{}
 
 	bool resolve(sinsp_threadinfo *tinfo, bool query_os_for_missing_info) override;
+	// the pod id comes from the environment
+	bool matches_cgroups_only() const override
+	{
+		return false;
+	}
 
 protected:
 	bool match(container_cache_interface *cache, sinsp_threadinfo *tinfo, sinsp_container_info& container_info,
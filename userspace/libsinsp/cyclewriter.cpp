@@ -17,6 +17,7 @@ limitations under the License.
 #include "sinsp.h"
 #include "sinsp_int.h"
 #include "cyclewriter.h"
+#include "async_dump_writer.h"
 
 cycle_writer::cycle_writer(bool is_live) :
 	m_base_file_name(""),
@@ -43,7 +44,7 @@ cycle_writer::cycle_writer(bool is_live) :
 	this->live = is_live;
 }
 
-bool cycle_writer::setup(string base_file_name, int rollover_mb, int duration_seconds, int file_limit, unsigned long event_limit, scap_dumper_t** dumper)
+bool cycle_writer::setup(string base_file_name, int rollover_mb, int duration_seconds, int file_limit, unsigned long event_limit, libsinsp::async_dump_writer** dumper)
 {
 	if(m_first_consider) 
 	{
@@ -123,7 +124,11 @@ cycle_writer::conclusion cycle_writer::consider(sinsp_evt* evt)
 		}
 	}
 
-	if(m_rollover_mb > 0 && scap_dump_get_offset(*m_dumper) > m_rollover_mb)
+	//
+	// The files are written in the background, so this lags behind
+	// the events by the chunks still in flight to the writer
+	//
+	if(m_rollover_mb > 0 && *m_dumper != NULL && (*m_dumper)->written_bytes() > m_rollover_mb)
 	{
 		m_last_reason = "Maximum File Size Reached";
 		return next_file();
@@ -22,6 +22,11 @@ limitations under the License.
 
 using namespace std;
 
+namespace libsinsp
+{
+class async_dump_writer;
+}
+
 class cycle_writer {
 public:
 	//
@@ -65,7 +70,7 @@ public:
 	// (via a call to consider()), then this will
 	// be locked down and return false.
 	//
-	bool setup(string base_file_name, int rollover_mb, int duration_seconds, int file_limit, unsigned long event_limit, scap_dumper_t** dumper);
+	bool setup(string base_file_name, int rollover_mb, int duration_seconds, int file_limit, unsigned long event_limit, libsinsp::async_dump_writer** dumper);
 	
 	//
 	// Consider file size at the current time
@@ -160,7 +165,7 @@ private:
 	// number of events
 	unsigned long m_event_count; // = 0L
 
-	scap_dumper_t** m_dumper;
+	libsinsp::async_dump_writer** m_dumper;
 
 	bool live;
 
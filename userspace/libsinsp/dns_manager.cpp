@@ -16,13 +16,195 @@ limitations under the License.
 */
 
 #include "dns_manager.h"
+#include <condition_variable>
+#include <list>
+#include <unordered_set>
+
+#if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
+namespace
+{
+//
+// Small pool of threads resolving names concurrently, so that a slow
+// or unresponsive name does not hold up the refresh of all the others
+//
+class dns_resolver_pool
+{
+public:
+	struct result
+	{
+		std::string m_name;
+		uint64_t m_due_ts;
+		uint64_t m_done_ts;
+		std::set<uint32_t> m_v4_addrs;
+		std::set<ipv6addr> m_v6_addrs;
+	};
+
+	dns_resolver_pool(uint32_t num_threads, sinsp_dns_manager::resolve_func_t func):
+		m_resolve_func(func)
+	{
+		for(uint32_t j = 0; j < num_threads; j++)
+		{
+			m_threads.emplace_back(&dns_resolver_pool::run, this);
+		}
+	}
+
+	~dns_resolver_pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_jobs_cond.notify_all();
+		for(auto &t : m_threads)
+		{
+			t.join();
+		}
+	}
+
+	void submit(const std::string &name, uint64_t due_ts)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back(std::make_pair(name, due_ts));
+			++m_pending;
+		}
+		m_jobs_cond.notify_one();
+	}
+
+	uint32_t pending()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_pending;
+	}
+
+	// wait until some results are available, there are no pending
+	// names or the deadline expires
+	void wait(std::chrono::steady_clock::time_point deadline)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_results_cond.wait_until(lock, deadline, [this] { return m_pending == 0 || !m_results.empty(); });
+	}
+
+	void take_results(std::list<result> &results)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		results.splice(results.end(), m_results);
+	}
+
+private:
+	void run()
+	{
+		while(true)
+		{
+			std::pair<std::string, uint64_t> job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_jobs_cond.wait(lock, [this] { return m_stop || !m_jobs.empty(); });
+				if(m_stop)
+				{
+					return;
+				}
+				job = m_jobs.front();
+				m_jobs.pop_front();
+			}
+
+			result res;
+			res.m_name = job.first;
+			res.m_due_ts = job.second;
+			m_resolve_func(res.m_name, res.m_v4_addrs, res.m_v6_addrs);
+			res.m_done_ts = sinsp_utils::get_current_time_ns();
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_results.push_back(std::move(res));
+				--m_pending;
+			}
+			m_results_cond.notify_all();
+		}
+	}
+
+	sinsp_dns_manager::resolve_func_t m_resolve_func;
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_jobs_cond;
+	std::condition_variable m_results_cond;
+	std::list<std::pair<std::string, uint64_t>> m_jobs;
+	std::list<result> m_results;
+	uint32_t m_pending = 0;
+	bool m_stop = false;
+};
+}
+#endif
 
 void sinsp_dns_resolver::refresh(uint64_t erase_timeout, uint64_t base_refresh_timeout, uint64_t max_refresh_timeout, std::future<void> f_exit)
 {
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
 	sinsp_dns_manager &manager = sinsp_dns_manager::get();
+	dns_resolver_pool pool(manager.m_num_resolvers,
+		[&manager](const std::string &name, std::set<uint32_t> &v4_addrs, std::set<ipv6addr> &v6_addrs)
+		{
+			sinsp_dns_manager::dns_info info = manager.resolve(name, 0);
+			v4_addrs.swap(info.m_v4_addrs);
+			v6_addrs.swap(info.m_v6_addrs);
+		});
+
+	// names submitted to the pool whose result has not been applied yet
+	std::unordered_set<std::string> in_flight;
+	// names submitted in the current refresh cycle and not resolved yet
+	std::unordered_set<std::string> submitted;
+
+	auto apply_results = [&](std::list<dns_resolver_pool::result> &results)
+	{
+		uint64_t max_lag = 0;
+		manager.m_erase_mutex.lock();
+		for(auto &res : results)
+		{
+			in_flight.erase(res.m_name);
+			submitted.erase(res.m_name);
+
+			auto it = manager.m_cache.find(res.m_name);
+			if(it == manager.m_cache.end())
+			{
+				continue;
+			}
+			sinsp_dns_manager::dns_info &info = it->second;
+			info.m_last_resolve_ts = res.m_done_ts;
+
+			// check if some v4 or v6 addresses are
+			// changed from the last resolution
+			if(res.m_v4_addrs != info.m_v4_addrs || res.m_v6_addrs != info.m_v6_addrs)
+			{
+				manager.unindex_addrs(res.m_name, info);
+				info.m_v4_addrs.swap(res.m_v4_addrs);
+				info.m_v6_addrs.swap(res.m_v6_addrs);
+				info.m_timeout = base_refresh_timeout;
+				manager.index_addrs(res.m_name, info);
+			}
+			else if(info.m_timeout < max_refresh_timeout)
+			{
+				// double the timeout until 320 secs
+				info.m_timeout <<= 1;
+			}
+
+			if(res.m_done_ts > res.m_due_ts && (res.m_done_ts - res.m_due_ts) > max_lag)
+			{
+				max_lag = res.m_done_ts - res.m_due_ts;
+			}
+			manager.m_refreshes++;
+		}
+		manager.m_erase_mutex.unlock();
+
+		manager.m_last_refresh_lag_ns = max_lag;
+		if(max_lag > manager.m_max_refresh_lag_ns)
+		{
+			manager.m_max_refresh_lag_ns = max_lag;
+		}
+	};
+
 	while(true)
 	{
+		submitted.clear();
+
 		if(!manager.m_cache.empty())
 		{
 			std::list<std::string> to_delete;
@@ -40,24 +222,12 @@ void sinsp_dns_resolver::refresh(uint64_t erase_timeout, uint64_t base_refresh_t
 					// remove the entry if it's hasn't been used for a whole hour
 					to_delete.push_back(name);
 				}
-				else if(ts > (info.m_last_resolve_ts + info.m_timeout))
+				else if(ts > (info.m_last_resolve_ts + info.m_timeout) &&
+					in_flight.find(name) == in_flight.end())
 				{
-					sinsp_dns_manager::dns_info refreshed_info = manager.resolve(name, ts);
-					refreshed_info.m_timeout = base_refresh_timeout;
-					refreshed_info.m_last_resolve_ts = info.m_last_resolve_ts = ts;
-
-					// dns_info::operator!= will check if some
-					// v4 or v6 addresses are changed from the
-					// last resolution
-					if(refreshed_info != info)
-					{
-						info = refreshed_info;
-					}
-					else if(info.m_timeout < max_refresh_timeout)
-					{
-						// double the timeout until 320 secs
-						info.m_timeout <<= 1;
-					}
+					pool.submit(name, info.m_last_resolve_ts + info.m_timeout);
+					in_flight.insert(name);
+					submitted.insert(name);
 				}
 			}
 			if(!to_delete.empty())
@@ -65,12 +235,44 @@ void sinsp_dns_resolver::refresh(uint64_t erase_timeout, uint64_t base_refresh_t
 				manager.m_erase_mutex.lock();
 				for(const auto &name : to_delete)
 				{
-					manager.m_cache.unsafe_erase(name);
+					auto it = manager.m_cache.find(name);
+					if(it != manager.m_cache.end())
+					{
+						manager.unindex_addrs(name, it->second);
+						manager.m_cache.unsafe_erase(it);
+					}
 				}
 				manager.m_erase_mutex.unlock();
 			}
 		}
 
+		//
+		// Apply the resolutions as they come, waiting for the ones
+		// submitted in this cycle, but not past the deadline and
+		// not past the exit request
+		//
+		auto deadline = std::chrono::steady_clock::now() + std::chrono::nanoseconds(manager.m_resolve_deadline);
+		while(true)
+		{
+			std::list<dns_resolver_pool::result> results;
+			pool.take_results(results);
+			if(!results.empty())
+			{
+				apply_results(results);
+			}
+			if(submitted.empty() ||
+			   std::chrono::steady_clock::now() >= deadline ||
+			   f_exit.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			{
+				break;
+			}
+			pool.wait(std::min(deadline, std::chrono::steady_clock::now() + std::chrono::milliseconds(100)));
+		}
+
+		// names from this cycle that missed the deadline; they stay
+		// in flight and their result is applied when it comes
+		manager.m_refresh_timeouts += submitted.size();
+
 		if(f_exit.wait_for(std::chrono::nanoseconds(base_refresh_timeout)) == std::future_status::ready)
 		{
 			break;
@@ -80,10 +282,16 @@ void sinsp_dns_resolver::refresh(uint64_t erase_timeout, uint64_t base_refresh_t
 }
 
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
-inline sinsp_dns_manager::dns_info sinsp_dns_manager::resolve(const std::string &name, uint64_t ts)
+sinsp_dns_manager::dns_info sinsp_dns_manager::resolve(const std::string &name, uint64_t ts)
 {
 	dns_info dinfo;
 
+	if(m_resolve_func)
+	{
+		m_resolve_func(name, dinfo.m_v4_addrs, dinfo.m_v6_addrs);
+		return dinfo;
+	}
+
 	struct addrinfo hints, *result, *rp;
 	memset(&hints, 0, sizeof(struct addrinfo));
 
@@ -110,6 +318,46 @@ inline sinsp_dns_manager::dns_info sinsp_dns_manager::resolve(const std::string
 	}
 	return dinfo;
 }
+
+void sinsp_dns_manager::index_addrs(const std::string &name, const dns_info &info)
+{
+	for(uint32_t addr : info.m_v4_addrs)
+	{
+		m_v4_names[addr].insert(name);
+	}
+	for(const ipv6addr &addr : info.m_v6_addrs)
+	{
+		m_v6_names[addr].insert(name);
+	}
+}
+
+void sinsp_dns_manager::unindex_addrs(const std::string &name, const dns_info &info)
+{
+	for(uint32_t addr : info.m_v4_addrs)
+	{
+		auto it = m_v4_names.find(addr);
+		if(it != m_v4_names.end())
+		{
+			it->second.erase(name);
+			if(it->second.empty())
+			{
+				m_v4_names.erase(it);
+			}
+		}
+	}
+	for(const ipv6addr &addr : info.m_v6_addrs)
+	{
+		auto it = m_v6_names.find(addr);
+		if(it != m_v6_names.end())
+		{
+			it->second.erase(name);
+			if(it->second.empty())
+			{
+				m_v6_names.erase(it);
+			}
+		}
+	}
+}
 #endif
 
 bool sinsp_dns_manager::match(const char *name, int af, void *addr, uint64_t ts)
@@ -121,34 +369,45 @@ bool sinsp_dns_manager::match(const char *name, int af, void *addr, uint64_t ts)
 	}
 
 	string sname = string(name);
+	bool ret = false;
 
 	m_erase_mutex.lock();
 
-	if(m_cache.find(sname) == m_cache.end())
+	auto it = m_cache.find(sname);
+	if(it == m_cache.end())
 	{
+		m_match_misses++;
 		dns_info dinfo = resolve(sname, ts);
 		dinfo.m_timeout = m_base_refresh_timeout;
 		dinfo.m_last_resolve_ts = ts;
-		m_cache[sname] = dinfo;
+		it = m_cache.insert(std::make_pair(sname, dinfo)).first;
+		index_addrs(sname, it->second);
+	}
+	else
+	{
+		m_match_hits++;
 	}
 
-	m_cache[sname].m_last_used_ts = ts;
-	dns_info &dinfo = m_cache[sname];
-
-	m_erase_mutex.unlock();
+	dns_info &dinfo = it->second;
+	dinfo.m_last_used_ts = ts;
 
 	if(af == AF_INET6)
 	{
 		ipv6addr v6;
 		memcpy(v6.m_b, addr, sizeof(ipv6addr));
-		return dinfo.m_v6_addrs.find(v6) != dinfo.m_v6_addrs.end();
+		ret = dinfo.m_v6_addrs.find(v6) != dinfo.m_v6_addrs.end();
 	}
 	else if(af == AF_INET)
 	{
-		return dinfo.m_v4_addrs.find(*(uint32_t *)addr) != dinfo.m_v4_addrs.end();
+		ret = dinfo.m_v4_addrs.find(*(uint32_t *)addr) != dinfo.m_v4_addrs.end();
 	}
-#endif
+
+	m_erase_mutex.unlock();
+
+	return ret;
+#else
 	return false;
+#endif
 }
 
 string sinsp_dns_manager::name_of(int af, void *addr, uint64_t ts)
@@ -158,36 +417,62 @@ string sinsp_dns_manager::name_of(int af, void *addr, uint64_t ts)
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
 	if(!m_cache.empty())
 	{
+		const std::set<std::string> *names = NULL;
+
 		m_erase_mutex.lock();
-		for(auto &it: m_cache)
+		if(af == AF_INET6)
 		{
-			const std::string &name = it.first;
-			sinsp_dns_manager::dns_info &info = it.second;
-
-			if(af == AF_INET6)
+			ipv6addr v6;
+			memcpy(v6.m_b, addr, sizeof(ipv6addr));
+			auto it = m_v6_names.find(v6);
+			if(it != m_v6_names.end())
 			{
-				ipv6addr v6;
-				memcpy(v6.m_b, addr, sizeof(ipv6addr));
-				if (info.m_v6_addrs.find(v6) != info.m_v6_addrs.end())
-				{
-					info.m_last_used_ts = ts;
-					ret = name;
-					break;
-				}
+				names = &it->second;
 			}
-			else if(af == AF_INET && info.m_v4_addrs.find(*(uint32_t *)addr) != info.m_v4_addrs.end())
+		}
+		else if(af == AF_INET)
+		{
+			auto it = m_v4_names.find(*(uint32_t *)addr);
+			if(it != m_v4_names.end())
 			{
-				info.m_last_used_ts = ts;
-				ret = name;
-				break;
+				names = &it->second;
 			}
 		}
+
+		if(names && !names->empty())
+		{
+			ret = *names->begin();
+			auto it = m_cache.find(ret);
+			if(it != m_cache.end())
+			{
+				it->second.m_last_used_ts = ts;
+			}
+			m_name_of_hits++;
+		}
+		else
+		{
+			m_name_of_misses++;
+		}
 		m_erase_mutex.unlock();
 	}
 #endif
 	return ret;
 }
 
+sinsp_dns_manager::dns_stats sinsp_dns_manager::get_stats() const
+{
+	dns_stats stats;
+	stats.m_match_hits = m_match_hits;
+	stats.m_match_misses = m_match_misses;
+	stats.m_name_of_hits = m_name_of_hits;
+	stats.m_name_of_misses = m_name_of_misses;
+	stats.m_refreshes = m_refreshes;
+	stats.m_refresh_timeouts = m_refresh_timeouts;
+	stats.m_last_refresh_lag_ns = m_last_refresh_lag_ns;
+	stats.m_max_refresh_lag_ns = m_max_refresh_lag_ns;
+	return stats;
+}
+
 void sinsp_dns_manager::cleanup()
 {
 	if(m_resolver)
@@ -27,6 +27,11 @@ limitations under the License.
 #include <chrono>
 #include <future>
 #include <mutex>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <set>
+#include <unordered_map>
 #if defined(HAS_CAPTURE) && !defined(CYGWING_AGENT) && !defined(_WIN32)
 #include "tbb/concurrent_unordered_map.h"
 #endif
@@ -41,12 +46,36 @@ struct sinsp_dns_resolver
 class sinsp_dns_manager
 {
 public:
+	//
+	// Resolves a name into its v4 and v6 addresses; the default one
+	// uses getaddrinfo(), tests can install a stub via set_resolve_func()
+	//
+	typedef std::function<void(const std::string &name, std::set<uint32_t> &v4_addrs, std::set<ipv6addr> &v6_addrs)> resolve_func_t;
+
+	//
+	// Lookup and refresh counters
+	//
+	struct dns_stats
+	{
+		uint64_t m_match_hits = 0;
+		uint64_t m_match_misses = 0;
+		uint64_t m_name_of_hits = 0;
+		uint64_t m_name_of_misses = 0;
+		uint64_t m_refreshes = 0;
+		uint64_t m_refresh_timeouts = 0;
+		// max delay between the scheduled and the actual refresh time,
+		// over the last refresh cycle and ever
+		uint64_t m_last_refresh_lag_ns = 0;
+		uint64_t m_max_refresh_lag_ns = 0;
+	};
 
 	bool match(const char *name, int af, void *addr, uint64_t ts);
 	string name_of(int af, void *addr, uint64_t ts);
 
 	void cleanup();
 
+	dns_stats get_stats() const;
+
         static sinsp_dns_manager& get()
         {
             static sinsp_dns_manager instance;
@@ -65,6 +94,21 @@ public:
 	{
 		m_max_refresh_timeout = ns;
 	};
+	// number of threads resolving names concurrently on refresh
+	void set_num_resolvers(uint32_t n)
+	{
+		m_num_resolvers = n ? n : 1;
+	};
+	// how long a refresh cycle waits for resolutions to complete;
+	// late resolutions are applied on the next cycle
+	void set_resolve_deadline(uint64_t ns)
+	{
+		m_resolve_deadline = ns;
+	};
+	void set_resolve_func(resolve_func_t func)
+	{
+		m_resolve_func = func;
+	};
 
 	size_t size()
 	{
@@ -78,9 +122,12 @@ public:
 private:
 
 	sinsp_dns_manager() :
+		m_resolver(NULL),
 		m_erase_timeout(3600 * ONE_SECOND_IN_NS),
 		m_base_refresh_timeout(10 * ONE_SECOND_IN_NS),
-		m_max_refresh_timeout(320 * ONE_SECOND_IN_NS)
+		m_max_refresh_timeout(320 * ONE_SECOND_IN_NS),
+		m_num_resolvers(4),
+		m_resolve_deadline(5 * ONE_SECOND_IN_NS)
 	{};
         sinsp_dns_manager(sinsp_dns_manager const&) = delete;
         void operator=(sinsp_dns_manager const&) = delete;
@@ -104,15 +151,28 @@ private:
 		std::set<ipv6addr> m_v6_addrs;
 	};
 
-	static inline dns_info resolve(const std::string &name, uint64_t ts);
+	dns_info resolve(const std::string &name, uint64_t ts);
+
+	// must be called with m_erase_mutex held
+	void index_addrs(const std::string &name, const dns_info &info);
+	void unindex_addrs(const std::string &name, const dns_info &info);
 
 	typedef tbb::concurrent_unordered_map<std::string, dns_info> c_dns_table;
 	c_dns_table m_cache;
+
+	//
+	// Reverse (address to names) index, maintained along with
+	// m_cache, so name_of() does not have to scan the whole cache
+	//
+	std::unordered_map<uint32_t, std::set<std::string>> m_v4_names;
+	std::map<ipv6addr, std::set<std::string>> m_v6_names;
 #endif
 
 	// tbb concurrent unordered map is not thread-safe for deletions,
 	// so we still need a mutex, but the chances of waiting are really
 	// low, since we will almost never do an erase.
+	// It also protects the address sets and the reverse index, which
+	// are updated by the refresh thread.
 	std::mutex m_erase_mutex;
 
 	// used to let m_resolver know when to terminate
@@ -123,6 +183,18 @@ private:
 	uint64_t m_erase_timeout;
 	uint64_t m_base_refresh_timeout;
 	uint64_t m_max_refresh_timeout;
+	uint32_t m_num_resolvers;
+	uint64_t m_resolve_deadline;
+	resolve_func_t m_resolve_func;
+
+	std::atomic<uint64_t> m_match_hits{0};
+	std::atomic<uint64_t> m_match_misses{0};
+	std::atomic<uint64_t> m_name_of_hits{0};
+	std::atomic<uint64_t> m_name_of_misses{0};
+	std::atomic<uint64_t> m_refreshes{0};
+	std::atomic<uint64_t> m_refresh_timeouts{0};
+	std::atomic<uint64_t> m_last_refresh_lag_ns{0};
+	std::atomic<uint64_t> m_max_refresh_lag_ns{0};
 
 	friend sinsp_dns_resolver;
 };
@@ -27,6 +27,13 @@ sinsp_dumper::sinsp_dumper(sinsp* inspector)
 	m_target_memory_buffer = NULL;
 	m_target_memory_buffer_size = 0;
 	m_nevts = 0;
+	m_ring = NULL;
+	m_ring_size = 0;
+	m_ring_pos = 0;
+	m_max_duration_ns = 0;
+	m_recorded_bytes = 0;
+	m_trigger_end_ts = 0;
+	m_index_block_evts = 0;
 }
 
 sinsp_dumper::sinsp_dumper(sinsp* inspector, uint8_t* target_memory_buffer, uint64_t target_memory_buffer_size)
@@ -35,6 +42,14 @@ sinsp_dumper::sinsp_dumper(sinsp* inspector, uint8_t* target_memory_buffer, uint
 	m_dumper = NULL;
 	m_target_memory_buffer = target_memory_buffer;
 	m_target_memory_buffer_size = target_memory_buffer_size;
+	m_nevts = 0;
+	m_ring = NULL;
+	m_ring_size = 0;
+	m_ring_pos = 0;
+	m_max_duration_ns = 0;
+	m_recorded_bytes = 0;
+	m_trigger_end_ts = 0;
+	m_index_block_evts = 0;
 }
 
 sinsp_dumper::~sinsp_dumper()
@@ -43,6 +58,8 @@ sinsp_dumper::~sinsp_dumper()
 	{
 		scap_dump_close(m_dumper);
 	}
+
+	delete[] m_ring;
 }
 
 void sinsp_dumper::open(const string& filename, bool compress, bool threads_from_sinsp)
@@ -81,6 +98,12 @@ void sinsp_dumper::open(const string& filename, bool compress, bool threads_from
 	m_inspector->m_container_manager.dump_containers(m_dumper);
 
 	m_nevts = 0;
+
+	if(m_index_block_evts != 0 && m_ring == NULL && m_target_memory_buffer == NULL)
+	{
+		m_index.reset(new libsinsp::capture_index(m_index_block_evts));
+		m_index->open(libsinsp::capture_index::default_path(filename));
+	}
 }
 
 void sinsp_dumper::fdopen(int fd, bool compress, bool threads_from_sinsp)
@@ -116,11 +139,20 @@ void sinsp_dumper::fdopen(int fd, bool compress, bool threads_from_sinsp)
 
 void sinsp_dumper::close()
 {
+	uint64_t end_offset = 0;
+
 	if(m_dumper != NULL)
 	{
+		end_offset = scap_dump_ftell(m_dumper);
 		scap_dump_close(m_dumper);
 		m_dumper = NULL;
 	}
+
+	if(m_index != NULL)
+	{
+		std::unique_ptr<libsinsp::capture_index> index = std::move(m_index);
+		index->close(end_offset);
+	}
 }
 
 bool sinsp_dumper::is_open()
@@ -135,12 +167,33 @@ bool sinsp_dumper::written_events()
 
 void sinsp_dumper::dump(sinsp_evt* evt)
 {
+	scap_evt* pdevt = (evt->m_poriginal_evt)? evt->m_poriginal_evt : evt->m_pevt;
+
+	if(m_ring != NULL)
+	{
+		if(m_dumper != NULL && pdevt->ts > m_trigger_end_ts)
+		{
+			close();
+		}
+
+		recorded_event* revt = record(pdevt, evt->m_cpuid);
+
+		if(revt != NULL && m_dumper != NULL &&
+		   scap_dump_raw(m_inspector->m_h, m_dumper, m_ring + revt->m_offset, revt->m_len) != SCAP_SUCCESS)
+		{
+			throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
+		}
+
+		m_nevts++;
+		return;
+	}
+
 	if(m_dumper == NULL)
 	{
 		throw sinsp_exception("dumper not opened yet");
 	}
 
-	scap_evt* pdevt = (evt->m_poriginal_evt)? evt->m_poriginal_evt : evt->m_pevt;
+	uint64_t offset = m_index != NULL ? scap_dump_ftell(m_dumper) : 0;
 
 	int32_t res = scap_dump(m_inspector->m_h,
 		m_dumper, pdevt, evt->m_cpuid, 0);
@@ -150,6 +203,11 @@ void sinsp_dumper::dump(sinsp_evt* evt)
 		throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
 	}
 
+	if(m_index != NULL)
+	{
+		m_index->add(offset, evt);
+	}
+
 	m_nevts++;
 }
 
@@ -194,3 +252,140 @@ void sinsp_dumper::flush()
 
 	scap_dump_flush(m_dumper);
 }
+
+void sinsp_dumper::enable_flight_recorder(uint64_t max_bytes, uint64_t max_duration_ns)
+{
+	if(m_inspector->m_h == NULL)
+	{
+		throw sinsp_exception("can't start flight recorder, inspector not opened yet");
+	}
+
+	if(m_target_memory_buffer != NULL || m_dumper != NULL)
+	{
+		throw sinsp_exception("can't start flight recorder, dumper already in use");
+	}
+
+	if(max_bytes == 0)
+	{
+		throw sinsp_exception("invalid flight recorder size");
+	}
+
+	delete[] m_ring;
+	m_ring = new uint8_t[max_bytes];
+	m_ring_size = max_bytes;
+	m_ring_pos = 0;
+	m_max_duration_ns = max_duration_ns;
+	m_recorded_bytes = 0;
+	m_recorded_events.clear();
+}
+
+void sinsp_dumper::trigger(const string& filename, bool compress, uint64_t post_trigger_ns)
+{
+	if(m_ring == NULL)
+	{
+		throw sinsp_exception("flight recorder not enabled");
+	}
+
+	close();
+
+	//
+	// The tables come from the inspector, so that they describe the
+	// system as it is now, rather than when the oldest recorded event
+	// was captured
+	//
+	open(filename, compress, true);
+
+	for(const auto& revt : m_recorded_events)
+	{
+		if(scap_dump_raw(m_inspector->m_h, m_dumper, m_ring + revt.m_offset, revt.m_len) != SCAP_SUCCESS)
+		{
+			close();
+			throw sinsp_exception(scap_getlasterr(m_inspector->m_h));
+		}
+	}
+
+	if(post_trigger_ns == 0)
+	{
+		close();
+		return;
+	}
+
+	m_trigger_end_ts = m_recorded_events.empty() ?
+		sinsp_utils::get_current_time_ns() + post_trigger_ns :
+		m_recorded_events.back().m_ts + post_trigger_ns;
+}
+
+void sinsp_dumper::enable_index(uint32_t block_evts)
+{
+	m_index_block_evts = block_evts;
+}
+
+uint64_t sinsp_dumper::recorded_events()
+{
+	return m_recorded_events.size();
+}
+
+uint64_t sinsp_dumper::recorded_bytes()
+{
+	return m_recorded_bytes;
+}
+
+sinsp_dumper::recorded_event* sinsp_dumper::record(scap_evt* pevt, uint16_t cpuid)
+{
+	uint32_t len;
+
+	//
+	// Serialize the event where the last one ended, possibly over the
+	// oldest events, which are then discarded: nothing reads the ring
+	// in between
+	//
+	if(scap_dump_to_buffer(m_inspector->m_h, m_ring + m_ring_pos, m_ring_size - m_ring_pos,
+			       pevt, cpuid, 0, &len) != SCAP_SUCCESS)
+	{
+		//
+		// It doesn't fit before the end of the ring: drop the events
+		// there, which the attempt may have overwritten, and wrap around
+		//
+		evict(m_ring_pos, m_ring_size);
+		m_ring_pos = 0;
+
+		if(scap_dump_to_buffer(m_inspector->m_h, m_ring, m_ring_size,
+				       pevt, cpuid, 0, &len) != SCAP_SUCCESS)
+		{
+			// larger than the whole ring
+			evict(0, m_ring_size);
+			return NULL;
+		}
+	}
+
+	evict(m_ring_pos, m_ring_pos + len);
+
+	while(m_max_duration_ns != 0 && !m_recorded_events.empty() &&
+	      m_recorded_events.front().m_ts + m_max_duration_ns < pevt->ts)
+	{
+		m_recorded_bytes -= m_recorded_events.front().m_len;
+		m_recorded_events.pop_front();
+	}
+
+	recorded_event revt = {m_ring_pos, len, pevt->ts};
+	m_recorded_events.push_back(revt);
+	m_recorded_bytes += len;
+	m_ring_pos += len;
+
+	return &m_recorded_events.back();
+}
+
+void sinsp_dumper::evict(uint64_t start, uint64_t end)
+{
+	//
+	// The oldest event is the first one after the write position: if
+	// it's before it in the ring, the space up to the end is free
+	//
+	while(!m_recorded_events.empty() &&
+	      m_recorded_events.front().m_offset >= start &&
+	      m_recorded_events.front().m_offset < end)
+	{
+		m_recorded_bytes -= m_recorded_events.front().m_len;
+		m_recorded_events.pop_front();
+	}
+}
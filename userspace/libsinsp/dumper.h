@@ -17,6 +17,11 @@ limitations under the License.
 
 #pragma once
 
+#include <deque>
+#include <memory>
+
+#include "capture_index.h"
+
 class sinsp;
 class sinsp_evt;
 
@@ -116,6 +121,50 @@ public:
 	*/
 	void dump(sinsp_evt* evt);
 
+	/*!
+	  \brief Puts the dumper in flight recorder mode: instead of being
+	   written to a file, the events passed to dump() are kept in memory,
+	   until \ref trigger() saves them.
+
+	  \param max_bytes Size of the in-memory ring of events. When it's
+	   full, the oldest events are discarded.
+
+	  \param max_duration_ns If not zero, events older than this, relative
+	   to the last event dumped, are discarded too.
+
+	  \note Events are serialized once, in the trace file format, directly
+	   into the ring, and copied as they are to the file on trigger.
+	*/
+	void enable_flight_recorder(uint64_t max_bytes, uint64_t max_duration_ns = 0);
+
+	/*!
+	  \brief Saves the flight recorder history to a file: the thread, fd
+	   and container tables, taken from the inspector at the time of the
+	   call, followed by the recorded events. The events dumped in the
+	   following post_trigger_ns, in event time, are appended to the file,
+	   which is then closed.
+
+	  \note A trigger while the file of a previous one is still open closes
+	   it and starts a new file.
+	*/
+	void trigger(const string& filename, bool compress, uint64_t post_trigger_ns = 0);
+
+	/*!
+	  \brief Return the number of events and bytes currently held by the
+	   flight recorder.
+	*/
+	uint64_t recorded_events();
+	uint64_t recorded_bytes();
+
+	/*!
+	  \brief Writes a side index of the files opened from now on with
+	   \ref open(), next to them (see libsinsp::capture_index), one block
+	   of block_evts events at a time. Zero disables the index.
+
+	  \note The events saved by the flight recorder are not indexed.
+	*/
+	void enable_index(uint32_t block_evts = CAPTURE_INDEX_DEFAULT_BLOCK_EVTS);
+
 	inline uint8_t* get_memory_dump_cur_buf()
 	{
 		return scap_get_memorydumper_curpos(m_dumper);
@@ -127,11 +176,40 @@ public:
 	}
 
 private:
+	//
+	// An event serialized in the flight recorder ring
+	//
+	struct recorded_event
+	{
+		uint64_t m_offset;
+		uint32_t m_len;
+		uint64_t m_ts;
+	};
+
+	recorded_event* record(scap_evt* pevt, uint16_t cpuid);
+	void evict(uint64_t start, uint64_t end);
+
 	sinsp* m_inspector;
 	scap_dumper_t* m_dumper;
 	uint8_t* m_target_memory_buffer;
 	uint64_t m_target_memory_buffer_size;
 	uint64_t m_nevts;
+
+	//
+	// Flight recorder state. The events are laid out in the ring in the
+	// order they are dumped, wrapping around at the end, and
+	// m_recorded_events lists them from the oldest one.
+	//
+	uint8_t* m_ring;
+	uint64_t m_ring_size;
+	uint64_t m_ring_pos;
+	uint64_t m_max_duration_ns;
+	uint64_t m_recorded_bytes;
+	std::deque<recorded_event> m_recorded_events;
+	uint64_t m_trigger_end_ts;
+
+	uint32_t m_index_block_evts;
+	std::unique_ptr<libsinsp::capture_index> m_index;
 };
 
 /*@}*/
@@ -64,6 +64,7 @@ extern sinsp_evttables g_infotables;
 ///////////////////////////////////////////////////////////////////////////////
 sinsp_evt::sinsp_evt() :
 	m_pevt_storage(NULL),
+	m_pevt_storage_size(0),
 	m_paramstr_storage(256), m_resolved_paramstr_storage(1024)
 {
 	m_flags = EF_NONE;
@@ -76,6 +77,7 @@ sinsp_evt::sinsp_evt() :
 
 sinsp_evt::sinsp_evt(sinsp *inspector) :
 	m_pevt_storage(NULL),
+	m_pevt_storage_size(0),
 	m_paramstr_storage(1024), m_resolved_paramstr_storage(1024)
 {
 	m_inspector = inspector;
@@ -2704,13 +2706,17 @@ bool sinsp_evt::evtcpy(sinsp_evt& dest, const sinsp_evt& src)
 
 	if (src.m_pevt != nullptr)
 	{
-		dest.m_pevt_storage = new char[src.m_pevt->len];
+		if(dest.m_pevt_storage == nullptr || dest.m_pevt_storage_size < src.m_pevt->len)
+		{
+			delete[] dest.m_pevt_storage;
+			dest.m_pevt_storage = new char[src.m_pevt->len];
+			dest.m_pevt_storage_size = src.m_pevt->len;
+		}
 		memcpy(dest.m_pevt_storage, src.m_pevt, src.m_pevt->len);
 		dest.m_pevt = (scap_evt*)dest.m_pevt_storage;
 	}
 	else
 	{
-		dest.m_pevt_storage = nullptr;
 		dest.m_pevt = nullptr;
 	}
 
@@ -2747,19 +2753,17 @@ bool sinsp_evt::evtcpy(sinsp_evt& dest, const sinsp_evt& src)
 	dest.m_cpuid = src.m_cpuid;
 	// m_evtnum is used in cached filters and that is safe for reuse
 	dest.m_evtnum = src.m_evtnum;
-	dest.m_flags = src.m_flags;
-	dest.m_params_loaded = src.m_params_loaded;
+	// the parameters point into the event buffer, so they are
+	// reloaded from the copy on first access
+	dest.m_flags = src.m_flags & ~(uint32_t)SINSP_EF_PARAMS_LOADED;
+	dest.m_params_loaded = false;
+	dest.m_params.clear();
 
 	dest.m_iosize = src.m_iosize;
 	dest.m_errorcode = src.m_errorcode;
 	dest.m_rawbuf_str_len = src.m_rawbuf_str_len;
 	dest.m_filtered_out = src.m_filtered_out;
 
-	// vectors
-	dest.m_params = src.m_params;
-	dest.m_paramstr_storage = src.m_paramstr_storage;
-	dest.m_resolved_paramstr_storage = src.m_resolved_paramstr_storage;
-
 	// pointer to an entry in global static table
 	// safe to copy naked ptr
 	dest.m_info = src.m_info;
@@ -2770,7 +2774,14 @@ bool sinsp_evt::evtcpy(sinsp_evt& dest, const sinsp_evt& src)
 	{
 		//m_fdinfo_ref is only used to keep a handle to this
 		// copy of the fdinfo which was copied from the global fdinfo table
-		dest.m_fdinfo_ref.reset(new sinsp_fdinfo_t(*src.m_fdinfo));
+		if(dest.m_fdinfo_ref && dest.m_fdinfo_ref.use_count() == 1)
+		{
+			*dest.m_fdinfo_ref = *src.m_fdinfo;
+		}
+		else
+		{
+			dest.m_fdinfo_ref.reset(new sinsp_fdinfo_t(*src.m_fdinfo));
+		}
 		dest.m_fdinfo = dest.m_fdinfo_ref.get();
 	}
 	dest.m_fdinfo_name_changed = src.m_fdinfo_name_changed;
@@ -37,6 +37,10 @@ namespace test_helpers {
 	class sinsp_mock;
 }
 
+namespace libsinsp {
+	class async_event_processor;
+}
+
 
 ///////////////////////////////////////////////////////////////////////////////
 // Event arguments
@@ -465,6 +469,12 @@ private:
 	int render_fd_json(Json::Value *ret, int64_t fd, const char** resolved_str, sinsp_evt::param_fmt fmt);
 	uint32_t get_dump_flags();
 
+	//
+	// Copy src into dest, so that dest stays valid after src is
+	// recycled. The event buffer and the fdinfo are copied, the
+	// threadinfo is shared (kept alive by a reference). A dest that
+	// already holds a copy reuses its buffers, so events can be pooled.
+	//
 	static bool evtcpy(sinsp_evt& dest, const sinsp_evt& src);
 
 VISIBILITY_PRIVATE
@@ -479,6 +489,7 @@ VISIBILITY_PRIVATE
 	scap_evt* m_pevt;
 	scap_evt* m_poriginal_evt;	// This is used when the original event is replaced by a different one (e.g. in the case of user events)
 	char *m_pevt_storage;           // In some cases an alternate buffer is used to hold m_pevt. This points to that storage.
+	uint32_t m_pevt_storage_size;   // Size of m_pevt_storage when allocated by evtcpy(), so copies can reuse it
 	uint16_t m_cpuid;
 	uint64_t m_evtnum;
 	uint32_t m_flags;
@@ -531,6 +542,7 @@ VISIBILITY_PRIVATE
 	friend class protocol_manager;
 	friend class test_helpers::event_builder;
 	friend class test_helpers::sinsp_mock;
+	friend class libsinsp::async_event_processor;
 };
 
 /*@}*/
@@ -27,6 +27,60 @@ limitations under the License.
 #ifdef HAS_FILTERING
 extern sinsp_filter_check_list g_filterlist;
 
+namespace
+{
+//
+// Quote and escape a string the way Json::FastWriter does. Returns
+// false (leaving out untouched) for strings whose escaping differs
+// between jsoncpp versions, i.e. with non-ASCII or control characters
+// other than the ones with a short escape sequence.
+//
+bool append_json_string(const char* str, const char* end, std::string& out)
+{
+	size_t start = out.size();
+
+	out += '"';
+	for(const char* c = str; c != end; ++c)
+	{
+		switch(*c)
+		{
+		case '"':
+			out += "\\\"";
+			break;
+		case '\\':
+			out += "\\\\";
+			break;
+		case '\b':
+			out += "\\b";
+			break;
+		case '\f':
+			out += "\\f";
+			break;
+		case '\n':
+			out += "\\n";
+			break;
+		case '\r':
+			out += "\\r";
+			break;
+		case '\t':
+			out += "\\t";
+			break;
+		default:
+			if((uint8_t)*c < 0x20 || (uint8_t)*c > 0x7e)
+			{
+				out.resize(start);
+				return false;
+			}
+			out += *c;
+			break;
+		}
+	}
+	out += '"';
+
+	return true;
+}
+}
+
 sinsp_evt_formatter::sinsp_evt_formatter(sinsp* inspector, const string& fmt)
 {
 	m_inspector = inspector;
@@ -157,6 +211,8 @@ void sinsp_evt_formatter::set_format(const string& fmt)
 		m_chks_to_free.push_back(chk);
 		m_tokenlens.push_back(0);
 	}
+
+	compile_json();
 }
 
 bool sinsp_evt_formatter::on_capture_end(OUT string* res)
@@ -193,103 +249,214 @@ bool sinsp_evt_formatter::resolve_tokens(sinsp_evt *evt, map<string,string>& val
 		fi = m_tokens[j].second->get_field_info();
 		if(fi)
 		{
-			values[m_tokens[j].first] = string(str);
+			values[m_tokens[j].first].assign(str);
 		}
 	}
 
 	return retval;
 }
 
-
 bool sinsp_evt_formatter::tostring(sinsp_evt* evt, OUT string* res)
 {
-	bool retval = true;
-	const filtercheck_field_info* fi;
-
-	uint32_t j = 0;
-	vector<sinsp_filter_check*>::iterator it;
 	res->clear();
+	return append(evt, *res);
+}
 
+bool sinsp_evt_formatter::append(sinsp_evt* evt, std::string& out)
+{
 	ASSERT(m_tokenlens.size() == m_tokens.size());
 
+	switch(m_inspector->get_buffer_format())
+	{
+	case sinsp_evt::PF_JSON:
+	case sinsp_evt::PF_JSONEOLS:
+	case sinsp_evt::PF_JSONHEX:
+	case sinsp_evt::PF_JSONHEXASCII:
+	case sinsp_evt::PF_JSONBASE64:
+		return append_json(evt, out);
+	default:
+		return append_text(evt, out);
+	}
+}
+
+bool sinsp_evt_formatter::append_text(sinsp_evt* evt, std::string& out)
+{
+	uint32_t j;
+
 	for(j = 0; j < m_tokens.size(); j++)
 	{
-		if(m_inspector->get_buffer_format() == sinsp_evt::PF_JSON
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONEOLS
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEX
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEXASCII
-		   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONBASE64)
-		{
-			Json::Value json_value = m_tokens[j].second->tojson(evt);
+		char* str = m_tokens[j].second->tostring(evt);
 
-			if(retval == false)
+		if(str == NULL)
+		{
+			if(m_require_all_values)
 			{
-				continue;
+				//
+				// Filterchecks may keep state across events, so
+				// the remaining tokens are still extracted
+				//
+				for(j++; j < m_tokens.size(); j++)
+				{
+					m_tokens[j].second->tostring(evt);
+				}
+				return false;
 			}
-
-			if(json_value == Json::nullValue && m_require_all_values)
+			else
 			{
-				retval = false;
-				continue;
+				str = (char*)"<NA>";
 			}
+		}
 
-			fi = m_tokens[j].second->get_field_info();
+		uint32_t tks = m_tokenlens[j];
 
-			if(fi)
-			{
-				m_root[m_tokens[j].first] = m_tokens[j].second->tojson(evt);
-			}
+		if(tks != 0)
+		{
+			size_t len = strnlen(str, tks);
+			out.append(str, len);
+			out.append(tks - len, ' ');
 		}
 		else
 		{
-			char* str = m_tokens[j].second->tostring(evt);
+			out += str;
+		}
+	}
 
-			if(retval == false)
-			{
-				continue;
-			}
+	return true;
+}
 
-			if(str == NULL)
-			{
-				if(m_require_all_values)
-				{
-					retval = false;
-					continue;
-				}
-				else
-				{
-					str = (char*)"<NA>";
-				}
-			}
+bool sinsp_evt_formatter::append_json(sinsp_evt* evt, std::string& out)
+{
+	bool retval = true;
+	uint32_t j;
 
-			uint32_t tks = m_tokenlens[j];
+	for(j = 0; j < m_tokens.size(); j++)
+	{
+		//
+		// Each token is extracted once per event, and the value that
+		// is checked for null is the one that is written. Before the
+		// output was rendered directly, a field was extracted a second
+		// time to be written, so a filtercheck keeping state across
+		// calls could show a different value than the checked one.
+		//
+		Json::Value json_value = m_tokens[j].second->tojson(evt);
+
+		if(retval == false)
+		{
+			continue;
+		}
 
-			if(tks != 0)
-			{
-				string sstr(str);
-				sstr.resize(tks, ' ');
-				(*res) += sstr;
-			}
-			else
-			{
-				(*res) += str;
-			}
+		if(json_value == Json::nullValue && m_require_all_values)
+		{
+			retval = false;
+			continue;
+		}
+
+		int32_t member = m_json_member_of_token[j];
+		if(member >= 0)
+		{
+			m_json_members[member].m_value.clear();
+			append_json_value(json_value, m_json_members[member].m_value);
+			m_json_members[member].m_set = true;
 		}
 	}
 
-	if(m_inspector->get_buffer_format() == sinsp_evt::PF_JSON
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONEOLS
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEX
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONHEXASCII
-	   || m_inspector->get_buffer_format() == sinsp_evt::PF_JSONBASE64)
+	bool empty = true;
+	for(const auto& member : m_json_members)
 	{
-		(*res) = m_writer.write(m_root);
-		(*res) = res->substr(0, res->size() - 1);
+		if(!member.m_set)
+		{
+			continue;
+		}
+		out += empty ? '{' : ',';
+		out += member.m_key;
+		out += member.m_value;
+		empty = false;
 	}
+	// an object nothing was ever assigned to is written as null
+	out += empty ? "null" : "}";
 
 	return retval;
 }
 
+void sinsp_evt_formatter::compile_json()
+{
+	map<string, int32_t> members;
+	uint32_t j;
+
+	for(j = 0; j < m_tokens.size(); j++)
+	{
+		if(m_tokens[j].second->get_field_info())
+		{
+			members[m_tokens[j].first] = 0;
+		}
+	}
+
+	m_json_members.clear();
+	for(auto& it : members)
+	{
+		json_member member;
+		member.m_key = m_writer.write(Json::Value(it.first));
+		member.m_key.back() = ':';
+		it.second = (int32_t)m_json_members.size();
+		m_json_members.push_back(member);
+	}
+
+	m_json_member_of_token.clear();
+	for(j = 0; j < m_tokens.size(); j++)
+	{
+		if(m_tokens[j].second->get_field_info())
+		{
+			m_json_member_of_token.push_back(members[m_tokens[j].first]);
+		}
+		else
+		{
+			m_json_member_of_token.push_back(-1);
+		}
+	}
+}
+
+void sinsp_evt_formatter::append_json_value(const Json::Value& val, std::string& out)
+{
+	char buf[32];
+
+	//
+	// Write the values whose rendering doesn't depend on the jsoncpp
+	// version directly; anything else (doubles, containers, strings
+	// with non-ASCII or unusual control characters) goes through
+	// Json::FastWriter so the output stays the same as before
+	//
+	switch(val.type())
+	{
+	case Json::nullValue:
+		out += "null";
+		return;
+	case Json::booleanValue:
+		out += val.asBool() ? "true" : "false";
+		return;
+	case Json::intValue:
+		out.append(buf, snprintf(buf, sizeof(buf), "%" PRId64, (int64_t)val.asLargestInt()));
+		return;
+	case Json::uintValue:
+		out.append(buf, snprintf(buf, sizeof(buf), "%" PRIu64, (uint64_t)val.asLargestUInt()));
+		return;
+	case Json::stringValue:
+	{
+		const char* str;
+		const char* end;
+		if(val.getString(&str, &end) && append_json_string(str, end, out))
+		{
+			return;
+		}
+		break;
+	}
+	default:
+		break;
+	}
+
+	const string& doc = m_writer.write(val);
+	out.append(doc, 0, doc.size() - 1);
+}
+
 #else  // HAS_FILTERING
 
 sinsp_evt_formatter::sinsp_evt_formatter(sinsp* inspector, const string& fmt)
@@ -310,6 +477,11 @@ bool sinsp_evt_formatter::tostring(sinsp_evt* evt, OUT string* res)
 {
 	throw sinsp_exception("sinsp_evt_formatter unavailable because it was not compiled in the library");
 }
+
+bool sinsp_evt_formatter::append(sinsp_evt* evt, std::string& out)
+{
+	throw sinsp_exception("sinsp_evt_formatter unavailable because it was not compiled in the library");
+}
 #endif // HAS_FILTERING
 
 sinsp_evt_formatter_cache::sinsp_evt_formatter_cache(sinsp *inspector)
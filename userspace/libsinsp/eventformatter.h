@@ -68,6 +68,20 @@ public:
 	*/
 	bool tostring(sinsp_evt* evt, OUT string* res);
 
+	/*!
+	  \brief Appends the string rendering of the event to a buffer.
+	  Same output as tostring(), but the buffer is not cleared, so a
+	  caller can keep reusing (or batching into) the same string
+	  without reallocating it for every event.
+
+	  \param evt Pointer to the event to be converted into string.
+	  \param out The buffer the rendering is appended to.
+
+	  \return true if the string should be shown (based on the initial *),
+	   false otherwise.
+	*/
+	bool append(sinsp_evt* evt, std::string& out);
+
 	/*!
 	  \brief Fills res with end of capture string rendering of the event.
 	  \param res Pointer to the string that will be filled with the result.
@@ -79,6 +93,10 @@ public:
 
 private:
 	void set_format(const string& fmt);
+	void compile_json();
+	bool append_text(sinsp_evt* evt, std::string& out);
+	bool append_json(sinsp_evt* evt, std::string& out);
+	void append_json_value(const Json::Value& val, std::string& out);
 
 	// vector of (full string of the token, filtercheck) pairs
 	// e.g. ("proc.aname[2], ptr to sinsp_filter_check_thread)
@@ -88,7 +106,22 @@ private:
 	bool m_require_all_values;
 	vector<sinsp_filter_check*> m_chks_to_free;
 
-	Json::Value m_root;
+	//
+	// JSON output is an object with one member per field token,
+	// sorted by name as jsoncpp would write it. Each member keeps
+	// the rendering of its last value: like the Json::Value this
+	// replaces, members that could not be resolved for an event keep
+	// the value of the previous one.
+	//
+	struct json_member
+	{
+		std::string m_key; // quoted name followed by ':'
+		std::string m_value;
+		bool m_set = false;
+	};
+	vector<json_member> m_json_members;
+	// for each token, its index in m_json_members, or -1 for raw strings
+	vector<int32_t> m_json_member_of_token;
 	Json::FastWriter m_writer;
 };
 
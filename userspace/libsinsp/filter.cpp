@@ -31,6 +31,8 @@ limitations under the License.
 
 #include <regex>
 #include <algorithm>
+#include <atomic>
+#include <thread>
 
 #include "sinsp.h"
 #include "sinsp_int.h"
@@ -40,6 +42,8 @@ limitations under the License.
 #include "filter.h"
 #include "filterchecks.h"
 #include "value_parser.h"
+#include "rule_profiler.h"
+#include "filter_optimizer.h"
 #ifndef _WIN32
 #include "arpa/inet.h"
 #endif
@@ -99,6 +103,32 @@ sinsp_filter_check_list::~sinsp_filter_check_list()
 void sinsp_filter_check_list::add_filter_check(sinsp_filter_check* filter_check)
 {
 	m_check_list.push_back(filter_check);
+	index_fields((uint32_t)m_check_list.size() - 1);
+}
+
+void sinsp_filter_check_list::index_fields(uint32_t check_idx)
+{
+	const filter_check_info& info = m_check_list[check_idx]->m_info;
+
+	for(int32_t j = 0; j < info.m_nfields; j++)
+	{
+		field_node* node = &m_fields;
+
+		for(const char* p = info.m_fields[j].m_name; *p != '\0'; p++)
+		{
+			std::unique_ptr<field_node>& child = node->m_children[*p];
+			if(!child)
+			{
+				child.reset(new field_node());
+			}
+			node = child.get();
+		}
+
+		if(node->m_checks.empty() || node->m_checks.back() != check_idx)
+		{
+			node->m_checks.push_back(check_idx);
+		}
+	}
 }
 
 void sinsp_filter_check_list::get_all_fields(OUT vector<const filter_check_info*>* list)
@@ -115,6 +145,65 @@ sinsp_filter_check* sinsp_filter_check_list::new_filter_check_from_fldname(const
 																		   sinsp* inspector,
 																		   bool do_exact_check)
 {
+	//
+	// Collect the checks having a field that's a prefix of the name, and
+	// try them in the order they were added. The names that none of them
+	// parses go through all the checks, since some handle names that are
+	// not fields in a custom way (e.g. with a specific error).
+	//
+	vector<uint32_t> candidates;
+	const field_node* node = &m_fields;
+
+	for(char c : name)
+	{
+		auto it = node->m_children.find(c);
+		if(it == node->m_children.end())
+		{
+			break;
+		}
+
+		node = it->second.get();
+		candidates.insert(candidates.end(), node->m_checks.begin(), node->m_checks.end());
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	for(uint32_t idx : candidates)
+	{
+		//
+		// The name is parsed by a scratch check rather than by the one
+		// in the list, so that threads don't share any state and don't
+		// need the lock. Without alloc_state, parsing reserves nothing
+		// in the inspector.
+		//
+		unique_ptr<sinsp_filter_check> scratch(m_check_list[idx]->allocate_new());
+		scratch->set_inspector(inspector);
+
+		int32_t fldnamelen = scratch->parse_field_name(name.c_str(), false, true);
+
+		if(fldnamelen != -1)
+		{
+			if(do_exact_check && (int32_t)name.size() != fldnamelen)
+			{
+				return NULL;
+			}
+
+			sinsp_filter_check* newchk = m_check_list[idx]->allocate_new();
+			newchk->set_inspector(inspector);
+			return newchk;
+		}
+	}
+
+	return new_filter_check_by_scan(name, inspector, do_exact_check);
+}
+
+sinsp_filter_check* sinsp_filter_check_list::new_filter_check_by_scan(const string& name,
+								      sinsp* inspector,
+								      bool do_exact_check)
+{
+	// the checks of the list are shared
+	std::lock_guard<std::mutex> guard(m_parse_mutex);
 	uint32_t j;
 
 	for(j = 0; j < m_check_list.size(); j++)
@@ -149,6 +238,16 @@ field_not_found:
 	return NULL;
 }
 
+int32_t sinsp_filter_check_list::parse_field_name(sinsp_filter_check* chk,
+						  const char* str,
+						  bool alloc_state,
+						  bool needed_for_filtering)
+{
+	std::lock_guard<std::mutex> guard(m_parse_mutex);
+
+	return chk->parse_field_name(str, alloc_state, needed_for_filtering);
+}
+
 sinsp_filter_check* sinsp_filter_check_list::new_filter_check_from_another(sinsp_filter_check *chk)
 {
 	sinsp_filter_check *newchk = chk->allocate_new();
@@ -1412,6 +1511,16 @@ sinsp_filter::~sinsp_filter()
 {
 }
 
+void sinsp_filter::alloc_state()
+{
+	for(const auto& deferred : m_deferred_state)
+	{
+		g_filterlist.parse_field_name(deferred.first, deferred.second.c_str(), true, true);
+	}
+
+	m_deferred_state.clear();
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // sinsp_filter_compiler implementation
 ///////////////////////////////////////////////////////////////////////////////
@@ -1419,6 +1528,7 @@ sinsp_filter_compiler::sinsp_filter_compiler(sinsp* inspector, const string& flt
 {
 	m_inspector = inspector;
 	m_ttable_only = ttable_only;
+	m_defer_state = false;
 	m_scanpos = -1;
 	m_scansize = 0;
 	m_state = ST_NEED_EXPRESSION;
@@ -1793,7 +1903,19 @@ void sinsp_filter_compiler::parse_check()
 	chk->m_boolop = op;
 	chk->m_cmpop = co;
 
-	chk->parse_field_name((char *)&operand1[0], true, true);
+	if(m_defer_state)
+	{
+		//
+		// The check is private to the compiler, and parsing it
+		// without alloc_state doesn't change the inspector
+		//
+		chk->parse_field_name((char *)&operand1[0], false, true);
+		m_filter->m_deferred_state.emplace_back(chk, string((char *)&operand1[0]));
+	}
+	else
+	{
+		g_filterlist.parse_field_name(chk, (char *)&operand1[0], true, true);
+	}
 
 	if(co == CO_IN || co == CO_INTERSECTS || co == CO_PMATCH)
 	{
@@ -1964,6 +2086,91 @@ sinsp_filter* sinsp_filter_compiler::compile()
 	}
 }
 
+vector<sinsp_filter*> sinsp_filter_compiler::compile_all(sinsp* inspector,
+							  const vector<string>& fltstrs,
+							  uint32_t nthreads,
+							  const vector<string>* names,
+							  bool defer_state)
+{
+	vector<sinsp_filter*> filters(fltstrs.size(), NULL);
+	vector<string> errors(fltstrs.size());
+	atomic<size_t> next_idx(0);
+	atomic<bool> failed(false);
+
+	if(nthreads == 0)
+	{
+		nthreads = thread::hardware_concurrency();
+	}
+	nthreads = (uint32_t)min((size_t)max(nthreads, 1u), fltstrs.size());
+
+	auto worker = [&]()
+	{
+		size_t idx;
+
+		while(!failed && (idx = next_idx++) < fltstrs.size())
+		{
+			try
+			{
+				sinsp_filter_compiler compiler(inspector, fltstrs[idx]);
+				compiler.m_defer_state = true;
+				filters[idx] = compiler.compile();
+			}
+			catch(const sinsp_exception& e)
+			{
+				errors[idx] = e.what();
+				failed = true;
+			}
+		}
+	};
+
+	vector<thread> threads;
+	for(uint32_t j = 1; j < nthreads; j++)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+	for(auto& t : threads)
+	{
+		t.join();
+	}
+
+	//
+	// The state of the checks changes the inspector, so it's
+	// allocated here rather than by the pool
+	//
+	for(size_t j = 0; j < filters.size() && !failed && !defer_state; j++)
+	{
+		try
+		{
+			filters[j]->alloc_state();
+		}
+		catch(const sinsp_exception& e)
+		{
+			errors[j] = e.what();
+			failed = true;
+		}
+	}
+
+	if(failed)
+	{
+		for(sinsp_filter* filter : filters)
+		{
+			delete filter;
+		}
+
+		for(size_t j = 0; j < errors.size(); j++)
+		{
+			if(!errors[j].empty())
+			{
+				string name = names ? (*names)[j] : to_string(j);
+				throw sinsp_exception("filter " + name + ": " + errors[j]);
+			}
+		}
+	}
+
+	return filters;
+}
+
 sinsp_filter* sinsp_filter_compiler::compile_()
 {
 	m_scansize = (uint32_t)m_fltstr.size();
@@ -2110,10 +2317,13 @@ sinsp_evttype_filter::sinsp_evttype_filter()
 
 sinsp_evttype_filter::~sinsp_evttype_filter()
 {
-	for(const auto &val : m_filters)
+	// it holds pieces of the filters
+	m_profiler.reset();
+
+	for(const auto &wrap : m_wrappers)
 	{
-		delete val.second->filter;
-		delete val.second;
+		delete wrap->filter;
+		delete wrap;
 	}
 
 	for(auto &ruleset : m_rulesets)
@@ -2123,111 +2333,96 @@ sinsp_evttype_filter::~sinsp_evttype_filter()
 	m_filters.clear();
 }
 
-sinsp_evttype_filter::ruleset_filters::ruleset_filters()
+sinsp_evttype_filter::ruleset_filters::ruleset_filters():
+	m_evttype_start(PPM_EVENT_MAX + 1, 0),
+	m_syscall_start(PPM_SC_MAX + 1, 0)
 {
-	memset(m_filter_by_evttype, 0, PPM_EVENT_MAX * sizeof(list<filter_wrapper *> *));
-	memset(m_filter_by_syscall, 0, PPM_SC_MAX * sizeof(list<filter_wrapper *> *));
 }
 
 sinsp_evttype_filter::ruleset_filters::~ruleset_filters()
 {
-	for(int i = 0; i < PPM_EVENT_MAX; i++)
+}
+
+bool sinsp_evttype_filter::ruleset_filters::set_enabled(const filter_wrapper *wrap, bool enabled)
+{
+	uint32_t word = wrap->id / 64;
+	uint64_t bit = 1ULL << (wrap->id % 64);
+
+	if(m_enabled.size() <= word)
 	{
-		if(m_filter_by_evttype[i])
-		{
-			delete m_filter_by_evttype[i];
-			m_filter_by_evttype[i] = NULL;
-		}
+		m_enabled.resize(word + 1, 0);
 	}
 
-	for(int i = 0; i < PPM_SC_MAX; i++)
+	if(((m_enabled[word] & bit) != 0) == enabled)
 	{
-		if(m_filter_by_syscall[i])
-		{
-			delete m_filter_by_syscall[i];
-			m_filter_by_syscall[i] = NULL;
-		}
+		return false;
 	}
+
+	m_enabled[word] ^= bit;
+	return true;
 }
 
-void sinsp_evttype_filter::ruleset_filters::add_filter(filter_wrapper *wrap)
+void sinsp_evttype_filter::ruleset_filters::rebuild(const std::vector<filter_wrapper *> &wrappers)
 {
-	for(uint32_t etype = 0; etype < PPM_EVENT_MAX; etype++)
+	//
+	// Count the rules of every event type and syscall code, turn the
+	// counts into start offsets, then place the handles
+	//
+	std::vector<filter_wrapper *> enabled;
+	for(uint32_t id = 0; id < m_enabled.size() * 64 && id < wrappers.size(); id++)
 	{
-		if(wrap->evttypes[etype])
+		if(m_enabled[id / 64] & (1ULL << (id % 64)))
 		{
-			if(!m_filter_by_evttype[etype])
-			{
-				m_filter_by_evttype[etype] = new std::list<filter_wrapper *>();
-			}
-
-			m_filter_by_evttype[etype]->push_back(wrap);
+			enabled.push_back(wrappers[id]);
 		}
 	}
 
-	for(uint32_t syscall = 0; syscall < PPM_SC_MAX; syscall++)
+	m_evttype_start.assign(PPM_EVENT_MAX + 1, 0);
+	m_syscall_start.assign(PPM_SC_MAX + 1, 0);
+	for(const auto &wrap : enabled)
 	{
-		if(wrap->syscalls[syscall])
+		for(uint16_t etype : wrap->evttypes)
 		{
-			if(!m_filter_by_syscall[syscall])
-			{
-				m_filter_by_syscall[syscall] = new std::list<filter_wrapper *>();
-			}
-
-			m_filter_by_syscall[syscall]->push_back(wrap);
+			m_evttype_start[etype + 1]++;
+		}
+		for(uint16_t syscall : wrap->syscalls)
+		{
+			m_syscall_start[syscall + 1]++;
 		}
 	}
-}
 
-void sinsp_evttype_filter::ruleset_filters::remove_filter(filter_wrapper *wrap)
-{
 	for(uint32_t etype = 0; etype < PPM_EVENT_MAX; etype++)
 	{
-		if(wrap->evttypes[etype])
-		{
-			if(m_filter_by_evttype[etype])
-			{
-				m_filter_by_evttype[etype]->erase(std::remove(m_filter_by_evttype[etype]->begin(),
-									      m_filter_by_evttype[etype]->end(),
-									      wrap),
-								  m_filter_by_evttype[etype]->end());
-
-				if(m_filter_by_evttype[etype]->size() == 0)
-				{
-					delete m_filter_by_evttype[etype];
-					m_filter_by_evttype[etype] = NULL;
-				}
-			}
-		}
+		m_evttype_start[etype + 1] += m_evttype_start[etype];
 	}
-
 	for(uint32_t syscall = 0; syscall < PPM_SC_MAX; syscall++)
 	{
-		if(wrap->syscalls[syscall])
-		{
-			if(m_filter_by_syscall[syscall])
-			{
-				m_filter_by_syscall[syscall]->erase(std::remove(m_filter_by_syscall[syscall]->begin(),
-										m_filter_by_syscall[syscall]->end(),
-										wrap),
-								    m_filter_by_syscall[syscall]->end());
+		m_syscall_start[syscall + 1] += m_syscall_start[syscall];
+	}
 
-				if(m_filter_by_syscall[syscall]->size() == 0)
-				{
-					delete m_filter_by_syscall[syscall];
-					m_filter_by_syscall[syscall] = NULL;
-				}
-			}
+	m_evttype_rules.resize(m_evttype_start[PPM_EVENT_MAX]);
+	m_syscall_rules.resize(m_syscall_start[PPM_SC_MAX]);
+
+	std::vector<uint32_t> evttype_pos(m_evttype_start.begin(), m_evttype_start.end() - 1);
+	std::vector<uint32_t> syscall_pos(m_syscall_start.begin(), m_syscall_start.end() - 1);
+	for(const auto &wrap : enabled)
+	{
+		for(uint16_t etype : wrap->evttypes)
+		{
+			m_evttype_rules[evttype_pos[etype]++] = wrap->id;
+		}
+		for(uint16_t syscall : wrap->syscalls)
+		{
+			m_syscall_rules[syscall_pos[syscall]++] = wrap->id;
 		}
 	}
 }
 
-
-bool sinsp_evttype_filter::ruleset_filters::run(sinsp_evt *evt)
+inline void sinsp_evttype_filter::ruleset_filters::rules_for_event(sinsp_evt *evt,
+								   const uint32_t **begin,
+								   const uint32_t **end)
 {
-	list<filter_wrapper *> *filters;
-
- 	uint16_t etype = evt->m_pevt->type;
+	uint16_t etype = evt->m_pevt->type;
 
 	if(etype == PPME_GENERIC_E || etype == PPME_GENERIC_X)
 	{
@@ -2235,20 +2430,53 @@ bool sinsp_evttype_filter::ruleset_filters::run(sinsp_evt *evt)
 		ASSERT(parinfo->m_len == sizeof(uint16_t));
 		uint16_t evid = *(uint16_t *)parinfo->m_val;
 
-		filters = m_filter_by_syscall[evid];
+		if(evid >= PPM_SC_MAX)
+		{
+			*begin = *end = NULL;
+			return;
+		}
+
+		*begin = m_syscall_rules.data() + m_syscall_start[evid];
+		*end = m_syscall_rules.data() + m_syscall_start[evid + 1];
 	}
 	else
 	{
-		filters = m_filter_by_evttype[etype];
+		if(etype >= PPM_EVENT_MAX)
+		{
+			*begin = *end = NULL;
+			return;
+		}
+
+		*begin = m_evttype_rules.data() + m_evttype_start[etype];
+		*end = m_evttype_rules.data() + m_evttype_start[etype + 1];
 	}
+}
 
-	if (!filters) {
-		return false;
+static inline bool run_rule(uint32_t id,
+			    const std::vector<sinsp_filter *> &filters,
+			    libsinsp::rule_profiler *profiler,
+			    sinsp_evt *evt)
+{
+	if(profiler)
+	{
+		return profiler->run(id, filters[id], evt);
 	}
 
-	for (auto &wrap : *filters)
+	return filters[id]->run(evt);
+}
+
+bool sinsp_evttype_filter::ruleset_filters::run(sinsp_evt *evt,
+						const std::vector<sinsp_filter *> &filters,
+						libsinsp::rule_profiler *profiler)
+{
+	const uint32_t *begin;
+	const uint32_t *end;
+
+	rules_for_event(evt, &begin, &end);
+
+	for(const uint32_t *id = begin; id != end; id++)
 	{
-		if(wrap->filter->run(evt))
+		if(run_rule(*id, filters, profiler, evt))
 		{
 			return true;
 		}
@@ -2257,14 +2485,35 @@ bool sinsp_evttype_filter::ruleset_filters::run(sinsp_evt *evt)
 	return false;
 }
 
+uint32_t sinsp_evttype_filter::ruleset_filters::run_all(sinsp_evt *evt,
+						       const std::vector<sinsp_filter *> &filters,
+						       libsinsp::rule_profiler *profiler,
+						       std::vector<uint32_t> &matches)
+{
+	const uint32_t *begin;
+	const uint32_t *end;
+
+	matches.clear();
+	rules_for_event(evt, &begin, &end);
+
+	for(const uint32_t *id = begin; id != end; id++)
+	{
+		if(run_rule(*id, filters, profiler, evt))
+		{
+			matches.push_back(*id);
+		}
+	}
+
+	return (uint32_t)matches.size();
+}
+
 void sinsp_evttype_filter::ruleset_filters::evttypes_for_ruleset(std::vector<bool> &evttypes)
 {
 	evttypes.assign(PPM_EVENT_MAX+1, false);
 
 	for(uint32_t etype = 0; etype < PPM_EVENT_MAX; etype++)
 	{
-		list<filter_wrapper *> *filters = m_filter_by_evttype[etype];
-		if(filters)
+		if(m_evttype_start[etype + 1] != m_evttype_start[etype])
 		{
 			evttypes[etype] = true;
 		}
@@ -2277,15 +2526,13 @@ void sinsp_evttype_filter::ruleset_filters::syscalls_for_ruleset(std::vector<boo
 
 	for(uint32_t evid = 0; evid < PPM_SC_MAX; evid++)
 	{
-		list<filter_wrapper *> *filters = m_filter_by_syscall[evid];
-		if(filters)
+		if(m_syscall_start[evid + 1] != m_syscall_start[evid])
 		{
 			syscalls[evid] = true;
 		}
 	}
 }
 
-
 void sinsp_evttype_filter::add(string &name,
 			       set<uint32_t> &evttypes,
 			       set<uint32_t> &syscalls,
@@ -2294,23 +2541,46 @@ void sinsp_evttype_filter::add(string &name,
 {
 	filter_wrapper *wrap = new filter_wrapper();
 	wrap->filter = filter;
+	wrap->name = name;
+	wrap->id = (uint32_t)m_wrappers.size();
 
 	// If no evttypes or syscalls are specified, the filter is
 	// enabled for all evttypes/syscalls.
-	bool def = ((evttypes.size() == 0 && syscalls.size() == 0) ? true : false);
+	if(evttypes.size() == 0 && syscalls.size() == 0)
+	{
+		for(uint32_t etype = 0; etype < PPM_EVENT_MAX; etype++)
+		{
+			wrap->evttypes.push_back((uint16_t)etype);
+		}
+		for(uint32_t syscall = 0; syscall < PPM_SC_MAX; syscall++)
+		{
+			wrap->syscalls.push_back((uint16_t)syscall);
+		}
+	}
 
-	wrap->evttypes.assign(PPM_EVENT_MAX+1, def);
 	for(auto &evttype : evttypes)
 	{
-		wrap->evttypes[evttype] = true;
+		if(evttype < PPM_EVENT_MAX)
+		{
+			wrap->evttypes.push_back((uint16_t)evttype);
+		}
 	}
 
-	wrap->syscalls.assign(PPM_SC_MAX+1, def);
 	for(auto &syscall : syscalls)
 	{
-		wrap->syscalls[syscall] = true;
+		if(syscall < PPM_SC_MAX)
+		{
+			wrap->syscalls.push_back((uint16_t)syscall);
+		}
 	}
 
+	m_wrappers.push_back(wrap);
+	m_filter_by_id.push_back(filter);
+
+	if(m_profiler)
+	{
+		m_profiler->add_rule(wrap->id, name, filter);
+	}
 	m_filters.insert(pair<string,filter_wrapper *>(name, wrap));
 
 	for(const auto &tag: tags)
@@ -2328,52 +2598,77 @@ void sinsp_evttype_filter::add(string &name,
 	}
 }
 
-void sinsp_evttype_filter::enable(const string &pattern, bool enabled, uint16_t ruleset)
+void sinsp_evttype_filter::add_all(sinsp *inspector,
+				   vector<rule_spec> &rules,
+				   uint32_t nthreads,
+				   bool defer_state)
 {
-	regex re(pattern);
+	vector<string> conditions;
+	vector<string> names;
+	conditions.reserve(rules.size());
+	names.reserve(rules.size());
+	for(const auto &rule : rules)
+	{
+		conditions.push_back(rule.condition);
+		names.push_back(rule.name);
+	}
+
+	vector<sinsp_filter *> filters =
+		sinsp_filter_compiler::compile_all(inspector, conditions, nthreads, &names, defer_state);
+
+	for(size_t j = 0; j < rules.size(); j++)
+	{
+		add(rules[j].name, rules[j].evttypes, rules[j].syscalls, rules[j].tags, filters[j]);
+	}
+}
 
+sinsp_evttype_filter::ruleset_filters *sinsp_evttype_filter::get_ruleset(uint16_t ruleset)
+{
 	while (m_rulesets.size() < (size_t) ruleset + 1)
 	{
 		m_rulesets.push_back(new ruleset_filters());
 	}
 
+	return m_rulesets[ruleset];
+}
+
+void sinsp_evttype_filter::enable(const string &pattern, bool enabled, uint16_t ruleset)
+{
+	regex re(pattern);
+	ruleset_filters *rs = get_ruleset(ruleset);
+	bool changed = false;
+
 	for(const auto &val : m_filters)
 	{
 		if (regex_match(val.first, re))
 		{
-			if(enabled)
-			{
-				m_rulesets[ruleset]->add_filter(val.second);
-			}
-			else
-			{
-				m_rulesets[ruleset]->remove_filter(val.second);
-			}
+			changed |= rs->set_enabled(val.second, enabled);
 		}
 	}
+
+	if(changed)
+	{
+		rs->rebuild(m_wrappers);
+	}
 }
 
 void sinsp_evttype_filter::enable_tags(const set<string> &tags, bool enabled, uint16_t ruleset)
 {
-	while (m_rulesets.size() < (size_t) ruleset + 1)
-	{
-		m_rulesets.push_back(new ruleset_filters());
-	}
+	ruleset_filters *rs = get_ruleset(ruleset);
+	bool changed = false;
 
 	for(const auto &tag : tags)
 	{
 		for(const auto &wrap : m_filter_by_tag[tag])
 		{
-			if(enabled)
-			{
-				m_rulesets[ruleset]->add_filter(wrap);
-			}
-			else
-			{
-				m_rulesets[ruleset]->remove_filter(wrap);
-			}
+			changed |= rs->set_enabled(wrap, enabled);
 		}
 	}
+
+	if(changed)
+	{
+		rs->rebuild(m_wrappers);
+	}
 }
 
 bool sinsp_evttype_filter::run(sinsp_evt *evt, uint16_t ruleset)
@@ -2383,7 +2678,77 @@ bool sinsp_evttype_filter::run(sinsp_evt *evt, uint16_t ruleset)
 		return false;
 	}
 
-	return m_rulesets[ruleset]->run(evt);
+	return m_rulesets[ruleset]->run(evt, m_filter_by_id, m_profiler.get());
+}
+
+uint32_t sinsp_evttype_filter::run_all(sinsp_evt *evt, std::vector<uint32_t> &matches, uint16_t ruleset)
+{
+	if(m_rulesets.size() < (size_t) ruleset + 1)
+	{
+		matches.clear();
+		return 0;
+	}
+
+	return m_rulesets[ruleset]->run_all(evt, m_filter_by_id, m_profiler.get(), matches);
+}
+
+const std::string &sinsp_evttype_filter::get_rule_name(uint32_t id) const
+{
+	return m_wrappers.at(id)->name;
+}
+
+void sinsp_evttype_filter::enable_profiling(uint32_t sampling_ratio)
+{
+	// the proxies of the old profiler go away first
+	m_profiler.reset();
+	m_profiler.reset(new libsinsp::rule_profiler(sampling_ratio));
+
+	for(const auto &wrap : m_wrappers)
+	{
+		m_profiler->add_rule(wrap->id, wrap->name, wrap->filter);
+	}
+}
+
+void sinsp_evttype_filter::disable_profiling()
+{
+	m_profiler.reset();
+}
+
+void sinsp_evttype_filter::alloc_state()
+{
+	for(const auto &filter : m_filter_by_id)
+	{
+		filter->alloc_state();
+	}
+}
+
+bool sinsp_evttype_filter::has_deferred_state() const
+{
+	for(const auto &filter : m_filter_by_id)
+	{
+		if(filter->has_deferred_state())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void sinsp_evttype_filter::optimize()
+{
+	for(const auto &filter : m_filter_by_id)
+	{
+		sinsp_filter_optimizer::optimize(filter);
+	}
+}
+
+void sinsp_evttype_filter::profile_checks(sinsp_filter_optimizer &optimizer)
+{
+	for(const auto &filter : m_filter_by_id)
+	{
+		optimizer.profile(filter);
+	}
 }
 
 void sinsp_evttype_filter::evttypes_for_ruleset(std::vector<bool> &evttypes, uint16_t ruleset)
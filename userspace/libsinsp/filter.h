@@ -17,13 +17,23 @@ limitations under the License.
 
 #pragma once
 
+#include <memory>
 #include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
 #ifdef HAS_FILTERING
 
 #include "gen_filter.h"
 
+namespace libsinsp
+{
+class rule_profiler;
+}
+class sinsp_filter_optimizer;
+class sinsp_filter_check;
+
 /** @defgroup filter Filtering events
  * Filtering infrastructure.
  *  @{
@@ -38,9 +48,34 @@ public:
 	sinsp_filter(sinsp* inspector);
 	~sinsp_filter();
 
+	/*!
+	  \brief Allocates the state of the checks of a filter compiled with
+	  deferred state (thread memory, protocol decoders) in the
+	  inspector. Must be called before the filter runs, on a thread that
+	  can change the inspector: before the capture starts, or on the
+	  thread of sinsp::next().
+
+	 \note Throws a sinsp_exception if the state can't be allocated, e.g.
+	  thread memory once the capture started.
+	*/
+	void alloc_state();
+
+	/*!
+	  \brief Whether alloc_state() still has to be called.
+	*/
+	bool has_deferred_state() const
+	{
+		return !m_deferred_state.empty();
+	}
+
 private:
 	sinsp* m_inspector;
 
+	// the checks parsed without their state, with their field name
+	std::vector<std::pair<sinsp_filter_check*, std::string>> m_deferred_state;
+
+	friend class sinsp_filter_compiler;
+
 	friend class sinsp_evt_formatter;
 };
 
@@ -67,6 +102,34 @@ public:
 
 	sinsp_filter* compile();
 
+	/*!
+	  \brief Compiles independent filter strings on a pool of threads.
+
+	  The pool only parses the strings, and never changes the inspector:
+	  the state of the checks is allocated once all of them compiled, on
+	  the calling thread, which must be able to change the inspector (see
+	  sinsp_filter::alloc_state()). With defer_state, it's left to the
+	  caller, e.g. to compile while the capture runs on another thread.
+
+	  \param inspector Pointer to the inspector instance that will generate the
+	   events to be filtered.
+	  \param fltstrs the filter strings to compile.
+	  \param nthreads the number of threads, 0 to use the number of cores.
+	  \param names optional names of the filters, for the error message.
+	  \param defer_state don't allocate the state of the checks.
+
+	  \return the filters, in the order of the strings.
+
+	 \note If any string is not valid, or the state of its checks can't
+	  be allocated, the filters compiled so far are deleted and a
+	  sinsp_exception is thrown with the error of the first invalid string.
+	*/
+	static std::vector<sinsp_filter*> compile_all(sinsp* inspector,
+						      const std::vector<string>& fltstrs,
+						      uint32_t nthreads = 0,
+						      const std::vector<string>* names = NULL,
+						      bool defer_state = false);
+
 private:
 	enum state
 	{
@@ -89,6 +152,8 @@ private:
 
 	sinsp* m_inspector;
 	bool m_ttable_only;
+	// parse the checks without allocating their state
+	bool m_defer_state;
 
 	string m_fltstr;
 	int32_t m_scanpos;
@@ -120,6 +185,31 @@ public:
 		 std::set<string> &tags,
 		 sinsp_filter* filter);
 
+	struct rule_spec
+	{
+		std::string name;
+		std::string condition;
+		std::set<uint32_t> evttypes;
+		std::set<uint32_t> syscalls;
+		std::set<string> tags;
+	};
+
+	// Compile the conditions of the rules in parallel (see
+	// sinsp_filter_compiler::compile_all()) and add the rules only
+	// once all of them compiled. If any condition is not valid,
+	// none of the rules is added and a sinsp_exception is thrown.
+	// With defer_state, alloc_state() must be called before the
+	// rules run.
+	void add_all(sinsp *inspector,
+		     std::vector<rule_spec> &rules,
+		     uint32_t nthreads = 0,
+		     bool defer_state = false);
+
+	// Allocate the deferred state of the filters of the rules (see
+	// sinsp_filter::alloc_state()).
+	void alloc_state();
+	bool has_deferred_state() const;
+
 	// rulesets are arbitrary numbers and should be managed by the caller.
         // Note that rulesets are used to index into a std::vector so
         // specifying unnecessarily large rulesets will result in
@@ -141,6 +231,36 @@ public:
 	// Match all filters against the provided event.
 	bool run(sinsp_evt *evt, uint16_t ruleset = 0);
 
+	// Match all filters against the provided event, without stopping
+	// at the first match. The handles of the matching rules, in the
+	// order they were added, replace the content of matches. Returns
+	// the number of matches.
+	uint32_t run_all(sinsp_evt *evt, std::vector<uint32_t> &matches, uint16_t ruleset = 0);
+
+	// The name of a rule, from its handle.
+	const std::string &get_rule_name(uint32_t id) const;
+
+	// Profile the evaluations of the rules, timing one every
+	// sampling_ratio (see libsinsp::rule_profiler). Enabling the
+	// profiling again starts a new profile.
+	void enable_profiling(uint32_t sampling_ratio = 100);
+	void disable_profiling();
+
+	// The current profile, NULL if the profiling is disabled.
+	libsinsp::rule_profiler *get_profiler() const
+	{
+		return m_profiler.get();
+	}
+
+	// Reorder the checks of all the rules with the static cost model
+	// of sinsp_filter_optimizer.
+	void optimize();
+
+	// Let the optimizer profile the checks of all the rules, to
+	// reorder them with sinsp_filter_optimizer::optimize_profiled().
+	// The optimizer must go away before this object.
+	void profile_checks(sinsp_filter_optimizer &optimizer);
+
 	// Populate the provided vector, indexed by event type, of the
 	// event types associated with the given ruleset id. For
 	// example, evttypes[10] = true would mean that this ruleset
@@ -157,48 +277,78 @@ private:
 
 	struct filter_wrapper {
 		sinsp_filter *filter;
+		std::string name;
 
-		// Indexes from event type to enabled/disabled.
-		std::vector<bool> evttypes;
+		// The handle of the rule: its index in m_wrappers
+		uint32_t id;
 
-		// Indexes from syscall code to enabled/disabled.
-		std::vector<bool> syscalls;
+		// The event types and syscall codes of the rule, sorted
+		std::vector<uint16_t> evttypes;
+		std::vector<uint16_t> syscalls;
 	};
 
-	// A group of filters all having the same ruleset
+	//
+	// The rules enabled in a ruleset, as a bitset over the rule handles,
+	// and flattened dispatch tables built from it: the handles of the
+	// rules of event type e are m_evttype_rules[m_evttype_start[e]]
+	// up to m_evttype_rules[m_evttype_start[e + 1]], in the order the
+	// rules were added. Same for the syscall codes.
+	//
 	class ruleset_filters {
 	public:
 		ruleset_filters();
 
 		virtual ~ruleset_filters();
 
-		void add_filter(filter_wrapper *wrap);
-		void remove_filter(filter_wrapper *wrap);
+		// Returns whether the enabled status of the rule changed
+		bool set_enabled(const filter_wrapper *wrap, bool enabled);
+
+		// Rebuild the dispatch tables after set_enabled() calls
+		void rebuild(const std::vector<filter_wrapper *> &wrappers);
 
-		bool run(sinsp_evt *evt);
+		bool run(sinsp_evt *evt,
+			 const std::vector<sinsp_filter *> &filters,
+			 libsinsp::rule_profiler *profiler);
+
+		uint32_t run_all(sinsp_evt *evt,
+				 const std::vector<sinsp_filter *> &filters,
+				 libsinsp::rule_profiler *profiler,
+				 std::vector<uint32_t> &matches);
 
 		void evttypes_for_ruleset(std::vector<bool> &evttypes);
 
 		void syscalls_for_ruleset(std::vector<bool> &syscalls);
 
 	private:
-		// Maps from event type to filter. There can be multiple
-		// filters per event type.
-		std::list<filter_wrapper *> *m_filter_by_evttype[PPM_EVENT_MAX];
+		// The range of rule handles for the event
+		inline void rules_for_event(sinsp_evt *evt, const uint32_t **begin, const uint32_t **end);
+
+		std::vector<uint64_t> m_enabled;
 
-		// Maps from syscall number to filter. There can be multiple
-		// filters per syscall number
-		std::list<filter_wrapper *> *m_filter_by_syscall[PPM_SC_MAX];
+		std::vector<uint32_t> m_evttype_start;
+		std::vector<uint32_t> m_evttype_rules;
+		std::vector<uint32_t> m_syscall_start;
+		std::vector<uint32_t> m_syscall_rules;
 	};
 
+	ruleset_filters *get_ruleset(uint16_t ruleset);
+
 	std::vector<ruleset_filters *> m_rulesets;
 
 	// Maps from tag to list of filters having that tag.
 	std::map<std::string, std::list<filter_wrapper *>> m_filter_by_tag;
 
-	// This holds all the filters passed to add(), so they can
-	// be cleaned up.
+	// Maps from name to filter, for enable().
 	map<std::string,filter_wrapper *> m_filters;
+
+	// All the filters passed to add(), indexed by handle, so they
+	// can be cleaned up.
+	std::vector<filter_wrapper *> m_wrappers;
+
+	// The filters of m_wrappers, contiguous for the dispatch.
+	std::vector<sinsp_filter *> m_filter_by_id;
+
+	std::unique_ptr<libsinsp::rule_profiler> m_profiler;
 };
 
 /*@}*/
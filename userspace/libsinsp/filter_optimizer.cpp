@@ -0,0 +1,430 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <algorithm>
+#include <limits>
+
+#include "sinsp.h"
+#include "filterchecks.h"
+#include "filter_optimizer.h"
+#include "rule_profiler.h"
+
+///////////////////////////////////////////////////////////////////////////////
+// check_proxy
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// Stands for a leaf check in the filter tree, and counts its
+// evaluations and results
+//
+class sinsp_filter_optimizer::check_proxy : public gen_event_filter_check_proxy
+{
+public:
+	check_proxy(gen_event_filter_check* check,
+		    gen_event_filter_expression* parent,
+		    uint32_t sampling_ratio):
+		gen_event_filter_check_proxy(check),
+		m_parent(parent),
+		m_static(static_estimate(check)),
+		m_sampling_ratio(sampling_ratio),
+		m_countdown(1)
+	{
+		m_stats = {0, 0, 0, 0};
+	}
+
+	//
+	// Put the wrapped check back in place of the proxy, with its
+	// current position
+	//
+	void restore()
+	{
+		bool found = unlink(m_parent);
+		ASSERT(found);
+		(void)found;
+	}
+
+	bool compare(gen_event* evt)
+	{
+		bool res;
+
+		m_stats.m_evaluations++;
+		if(--m_countdown != 0)
+		{
+			res = m_check->compare(evt);
+		}
+		else
+		{
+			m_countdown = m_sampling_ratio;
+			uint64_t start = libsinsp::rule_profiler::now();
+			res = m_check->compare(evt);
+			m_stats.m_sampled_cost += libsinsp::rule_profiler::now() - start;
+			m_stats.m_sampled++;
+		}
+
+		if(res)
+		{
+			m_stats.m_passed++;
+		}
+
+		return res;
+	}
+
+	//
+	// The optimizer proxy in the chain of proxies starting with chk,
+	// if any
+	//
+	static check_proxy* find(gen_event_filter_check* chk)
+	{
+		gen_event_filter_check_proxy* proxy;
+
+		while((proxy = dynamic_cast<gen_event_filter_check_proxy*>(chk)) != NULL)
+		{
+			check_proxy* own = dynamic_cast<check_proxy*>(proxy);
+			if(own != NULL)
+			{
+				return own;
+			}
+			chk = proxy->inner();
+		}
+
+		return NULL;
+	}
+
+	gen_event_filter_expression* m_parent;
+	estimate m_static;
+	check_stats m_stats;
+
+private:
+	uint32_t m_sampling_ratio;
+	uint32_t m_countdown;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_filter_optimizer
+///////////////////////////////////////////////////////////////////////////////
+
+sinsp_filter_optimizer::sinsp_filter_optimizer(uint32_t sampling_ratio, uint64_t min_evaluations):
+	m_sampling_ratio(sampling_ratio ? sampling_ratio : 1),
+	m_min_evaluations(min_evaluations)
+{
+}
+
+sinsp_filter_optimizer::~sinsp_filter_optimizer()
+{
+	stop();
+}
+
+sinsp_filter_optimizer::estimate sinsp_filter_optimizer::static_estimate(gen_event_filter_check* chk)
+{
+	check_proxy* proxy = check_proxy::find(chk);
+	if(proxy != NULL)
+	{
+		return proxy->m_static;
+	}
+
+	// the proxies of other profilers copy the operators of their check
+	sinsp_filter_check* sinsp_chk = dynamic_cast<sinsp_filter_check*>(gen_event_filter_check_proxy::unwrap(chk));
+	const filtercheck_field_info* info = sinsp_chk ? sinsp_chk->get_field_info() : NULL;
+	if(info == NULL)
+	{
+		return {2, 0.5};
+	}
+
+	//
+	// The cost of getting the value of the field
+	//
+	std::string name = info->m_name;
+	double cost = 1;
+	if(name == "fd.sip.name" || name == "fd.cip.name" ||
+	   name == "fd.lip.name" || name == "fd.rip.name")
+	{
+		// resolved through the DNS manager
+		cost = 50;
+	}
+	else if(name.compare(0, 4, "k8s.") == 0 || name.compare(0, 6, "mesos.") == 0 ||
+		name.compare(0, 9, "marathon.") == 0)
+	{
+		cost = 8;
+	}
+	else if(name == "proc.aname" || name == "proc.apid")
+	{
+		// walks the parents
+		cost = 6;
+	}
+	else if(name.compare(0, 10, "container.") == 0)
+	{
+		cost = 4;
+	}
+	else if(name.compare(0, 3, "fd.") == 0 || name == "evt.arg" || name == "evt.args" ||
+		name == "evt.rawarg" || name == "proc.args")
+	{
+		cost = 3;
+	}
+	else if(name.compare(0, 5, "proc.") == 0 || name.compare(0, 7, "thread.") == 0 ||
+		name.compare(0, 5, "user.") == 0 || name.compare(0, 6, "group.") == 0)
+	{
+		cost = 2;
+	}
+
+	//
+	// The cost of the comparison, and how often it passes
+	//
+	switch(chk->m_cmpop)
+	{
+	case CO_EQ:
+		return {cost, 0.1};
+	case CO_NE:
+		return {cost, 0.9};
+	case CO_EXISTS:
+		return {cost * 0.5, 0.9};
+	case CO_IN:
+	case CO_INTERSECTS:
+		return {cost * 1.5, 0.2};
+	case CO_CONTAINS:
+	case CO_ICONTAINS:
+	case CO_STARTSWITH:
+	case CO_ENDSWITH:
+		return {cost * 2, 0.3};
+	case CO_GLOB:
+	case CO_PMATCH:
+		return {cost * 4, 0.3};
+	default:
+		return {cost, 0.5};
+	}
+}
+
+bool sinsp_filter_optimizer::has_check_ids(gen_event_filter_check* chk)
+{
+	if(chk->get_check_id() != 0)
+	{
+		return true;
+	}
+
+	gen_event_filter_expression* expr = dynamic_cast<gen_event_filter_expression*>(chk);
+	if(expr != NULL)
+	{
+		for(gen_event_filter_check* child : expr->m_checks)
+		{
+			if(has_check_ids(child))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+sinsp_filter_optimizer::estimate sinsp_filter_optimizer::optimize_expression(gen_event_filter_expression* expr,
+									      const leaf_model_t& model)
+{
+	std::vector<gen_event_filter_check*>& checks = expr->m_checks;
+
+	if(checks.empty())
+	{
+		return {0, 1};
+	}
+
+	//
+	// The checks joined by 'and', or by 'or', each maybe negated
+	//
+	bool is_and = checks.size() < 2 || (checks[1]->m_boolop & ~BO_NOT) == BO_AND;
+
+	struct literal
+	{
+		gen_event_filter_check* m_check;
+		bool m_negated;
+		double m_cost;
+		// probability that the literal is true
+		double m_pass_rate;
+		double m_rank;
+	};
+
+	std::vector<literal> literals;
+	for(gen_event_filter_check* chk : checks)
+	{
+		gen_event_filter_expression* subexpr = dynamic_cast<gen_event_filter_expression*>(chk);
+		estimate est = subexpr ? optimize_expression(subexpr, model) : model(chk);
+
+		literal lit;
+		lit.m_check = chk;
+		lit.m_negated = (chk->m_boolop & BO_NOT) != 0;
+		lit.m_cost = est.m_cost;
+		lit.m_pass_rate = lit.m_negated ? 1 - est.m_pass_rate : est.m_pass_rate;
+
+		// the probability that the literal short-circuits the expression
+		double stop_rate = is_and ? 1 - lit.m_pass_rate : lit.m_pass_rate;
+		lit.m_rank = stop_rate > 0 ? lit.m_cost / stop_rate : std::numeric_limits<double>::max();
+		literals.push_back(lit);
+	}
+
+	if(checks.size() >= 2 && !has_check_ids(expr))
+	{
+		std::stable_sort(literals.begin(), literals.end(),
+				 [](const literal& a, const literal& b)
+				 {
+					 return a.m_rank < b.m_rank;
+				 });
+
+		boolop op = is_and ? BO_AND : BO_OR;
+		for(uint32_t j = 0; j < literals.size(); j++)
+		{
+			gen_event_filter_check* chk = literals[j].m_check;
+			if(j == 0)
+			{
+				chk->m_boolop = literals[j].m_negated ? BO_NOT : BO_NONE;
+			}
+			else
+			{
+				chk->m_boolop = (boolop)(op | (literals[j].m_negated ? BO_NOT : 0));
+			}
+			checks[j] = chk;
+		}
+	}
+
+	//
+	// The expected cost of the expression, with the short circuits
+	//
+	estimate res = {0, is_and ? 1.0 : 0.0};
+	double reach = 1;
+	for(const literal& lit : literals)
+	{
+		res.m_cost += reach * lit.m_cost;
+		if(is_and)
+		{
+			reach *= lit.m_pass_rate;
+			res.m_pass_rate *= lit.m_pass_rate;
+		}
+		else
+		{
+			reach *= 1 - lit.m_pass_rate;
+			res.m_pass_rate = 1 - (1 - res.m_pass_rate) * (1 - lit.m_pass_rate);
+		}
+	}
+
+	return res;
+}
+
+void sinsp_filter_optimizer::optimize(gen_event_filter* filter)
+{
+	optimize_expression(filter->m_filter, static_estimate);
+}
+
+void sinsp_filter_optimizer::wrap_leaves(gen_event_filter_expression* expr, profiled_filter& profiled)
+{
+	for(size_t j = 0; j < expr->m_checks.size(); j++)
+	{
+		gen_event_filter_check* chk = expr->m_checks[j];
+
+		gen_event_filter_expression* subexpr = dynamic_cast<gen_event_filter_expression*>(chk);
+		if(subexpr != NULL)
+		{
+			wrap_leaves(subexpr, profiled);
+			continue;
+		}
+
+		check_proxy* proxy = new check_proxy(chk, expr, m_sampling_ratio);
+		expr->m_checks[j] = proxy;
+		profiled.m_proxies.push_back(proxy);
+	}
+}
+
+void sinsp_filter_optimizer::profile(gen_event_filter* filter)
+{
+	profiled_filter profiled;
+	profiled.m_filter = filter;
+	wrap_leaves(filter->m_filter, profiled);
+	m_filters.push_back(profiled);
+}
+
+void sinsp_filter_optimizer::optimize_profiled()
+{
+	for(const auto& profiled : m_filters)
+	{
+		bool enough_stats = true;
+		for(check_proxy* proxy : profiled.m_proxies)
+		{
+			if(proxy->m_stats.m_evaluations < m_min_evaluations || proxy->m_stats.m_sampled == 0)
+			{
+				enough_stats = false;
+				break;
+			}
+		}
+
+		if(!enough_stats)
+		{
+			optimize(profiled.m_filter);
+			continue;
+		}
+
+		optimize_expression(profiled.m_filter->m_filter,
+				    [](gen_event_filter_check* chk)
+				    {
+					    check_proxy* proxy = check_proxy::find(chk);
+					    if(proxy == NULL)
+					    {
+						    return static_estimate(chk);
+					    }
+
+					    const check_stats& stats = proxy->m_stats;
+					    estimate est;
+					    est.m_cost = (double)stats.m_sampled_cost / stats.m_sampled;
+					    est.m_pass_rate = (double)stats.m_passed / stats.m_evaluations;
+					    return est;
+				    });
+	}
+}
+
+void sinsp_filter_optimizer::stop()
+{
+	for(auto& profiled : m_filters)
+	{
+		for(check_proxy* proxy : profiled.m_proxies)
+		{
+			proxy->restore();
+			delete proxy;
+		}
+	}
+
+	m_filters.clear();
+}
+
+void sinsp_filter_optimizer::collect_stats(gen_event_filter_expression* expr, std::vector<check_stats>& stats) const
+{
+	for(gen_event_filter_check* chk : expr->m_checks)
+	{
+		gen_event_filter_expression* subexpr = dynamic_cast<gen_event_filter_expression*>(chk);
+		if(subexpr != NULL)
+		{
+			collect_stats(subexpr, stats);
+			continue;
+		}
+
+		check_proxy* proxy = check_proxy::find(chk);
+		if(proxy != NULL)
+		{
+			stats.push_back(proxy->m_stats);
+		}
+	}
+}
+
+std::vector<sinsp_filter_optimizer::check_stats> sinsp_filter_optimizer::get_stats(gen_event_filter* filter) const
+{
+	std::vector<check_stats> stats;
+	collect_stats(filter->m_filter, stats);
+	return stats;
+}
@@ -0,0 +1,133 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "gen_filter.h"
+
+//
+// Reorders the checks of filter expressions, so that the cheap and
+// selective checks run first and short-circuit the expensive ones.
+//
+// In an expression, all the checks are joined by 'and' (or all by 'or'),
+// possibly negated, so they can be evaluated in any order without
+// changing the result. Sorting them by cost / probability of failing
+// (of passing, for 'or') minimizes the expected cost, assuming
+// independent checks. The cost and the pass rate of a nested expression
+// follow from the ones of its checks.
+//
+// The estimates come either from a static cost model, which knows the
+// usual cost of the fields and of the comparison operators, or from
+// the statistics gathered at runtime after profile().
+//
+// A reordered expression evaluates its checks in another order, so the
+// checks are assumed to have no side effects, which the short-circuit
+// evaluation already requires. An expression is never reordered when
+// any check below it has a check id (see
+// gen_event_filter_check::set_check_id()), since the id reported for an
+// event is the one of the last check that passed.
+//
+class sinsp_filter_optimizer
+{
+public:
+	struct estimate
+	{
+		// in abstract units for the static model, in cycles at runtime
+		double m_cost;
+		// probability that the check is true, before any negation
+		double m_pass_rate;
+	};
+
+	struct check_stats
+	{
+		uint64_t m_evaluations;
+		uint64_t m_passed;
+		// timed evaluations
+		uint64_t m_sampled;
+		uint64_t m_sampled_cost;
+	};
+
+	//
+	// At runtime, one evaluation every sampling_ratio is timed, and the
+	// runtime statistics of a filter are used once each of its checks
+	// ran at least min_evaluations times
+	//
+	sinsp_filter_optimizer(uint32_t sampling_ratio = 64, uint64_t min_evaluations = 1024);
+
+	//
+	// Takes the profiling out of the filters
+	//
+	~sinsp_filter_optimizer();
+
+	//
+	// The static cost model, for a leaf check
+	//
+	static estimate static_estimate(gen_event_filter_check* chk);
+
+	//
+	// Reorder the checks of the filter with the static cost model
+	//
+	static void optimize(gen_event_filter* filter);
+
+	//
+	// Gather the cost and the pass rate of the checks of the filter,
+	// while it runs
+	//
+	void profile(gen_event_filter* filter);
+
+	//
+	// Reorder the checks of the profiled filters, with their runtime
+	// statistics when there are enough of them, with the static model
+	// otherwise. The profiling goes on.
+	//
+	void optimize_profiled();
+
+	//
+	// Take the profiling out of the filters, which keep their order
+	//
+	void stop();
+
+	//
+	// The runtime statistics of the leaf checks of a profiled filter, in
+	// the order the checks are evaluated
+	//
+	std::vector<check_stats> get_stats(gen_event_filter* filter) const;
+
+private:
+	class check_proxy;
+
+	typedef std::function<estimate(gen_event_filter_check*)> leaf_model_t;
+
+	struct profiled_filter
+	{
+		gen_event_filter* m_filter;
+		std::vector<check_proxy*> m_proxies;
+	};
+
+	static estimate optimize_expression(gen_event_filter_expression* expr, const leaf_model_t& model);
+	static bool has_check_ids(gen_event_filter_check* chk);
+	void wrap_leaves(gen_event_filter_expression* expr, profiled_filter& profiled);
+	void collect_stats(gen_event_filter_expression* expr, std::vector<check_stats>& stats) const;
+
+	uint32_t m_sampling_ratio;
+	uint64_t m_min_evaluations;
+	std::vector<profiled_filter> m_filters;
+};
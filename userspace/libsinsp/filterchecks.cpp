@@ -4615,8 +4615,7 @@ uint8_t* sinsp_filter_check_user::extract(sinsp_evt *evt, OUT uint32_t* len, boo
 	// For container events, use the user from the container metadata instead.
 	if(m_field_id == TYPE_NAME && evt->get_type() == PPME_CONTAINER_JSON_E)
 	{
-		const sinsp_container_info::ptr_t container_info =
-			m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+		const sinsp_container_info::ptr_t container_info = tinfo->get_container_info();
 
 		if(!container_info)
 		{
@@ -4920,7 +4919,10 @@ int32_t sinsp_filter_check_tracer::parse_field_name(const char* str, bool alloc_
 		m_field_id == TYPE_RAWPARENTTIME
 		)
 	{
-		m_inspector->request_tracer_state_tracking();
+		if(alloc_state)
+		{
+			m_inspector->request_tracer_state_tracking();
+		}
 		m_needs_state_tracking = true;
 	}
 
@@ -5442,7 +5444,10 @@ int32_t sinsp_filter_check_evtin::parse_field_name(const char* str, bool alloc_s
 	//
 	// All of the fields require state tracking
 	//
-	m_inspector->request_tracer_state_tracking();
+	if(alloc_state)
+	{
+		m_inspector->request_tracer_state_tracking();
+	}
 
 	//
 	// A couple of fields are handled in a custom way
@@ -5950,7 +5955,7 @@ sinsp_filter_check* sinsp_filter_check_syslog::allocate_new()
 int32_t sinsp_filter_check_syslog::parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering)
 {
 	int32_t res = sinsp_filter_check::parse_field_name(str, alloc_state, needed_for_filtering);
-	if(res != -1)
+	if(res != -1 && alloc_state)
 	{
 		m_decoder = (sinsp_decoder_syslog*)m_inspector->require_protodecoder("syslog");
 	}
@@ -6146,8 +6151,7 @@ uint8_t* sinsp_filter_check_container::extract(sinsp_evt *evt, OUT uint32_t* len
 		}
 		else
 		{
-			const sinsp_container_info::ptr_t container_info =
-				m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+			const sinsp_container_info::ptr_t container_info = tinfo->get_container_info();
 			if(!container_info)
 			{
 				return NULL;
@@ -6169,8 +6173,7 @@ uint8_t* sinsp_filter_check_container::extract(sinsp_evt *evt, OUT uint32_t* len
 		}
 		else
 		{
-			const sinsp_container_info::ptr_t container_info =
-				m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+			const sinsp_container_info::ptr_t container_info = tinfo->get_container_info();
 			if(!container_info)
 			{
 				return NULL;
@@ -6195,8 +6198,7 @@ uint8_t* sinsp_filter_check_container::extract(sinsp_evt *evt, OUT uint32_t* len
 		}
 		else
 		{
-			const sinsp_container_info::ptr_t container_info =
-				m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+			const sinsp_container_info::ptr_t container_info = tinfo->get_container_info();
 			if(!container_info)
 			{
 				return NULL;
@@ -6237,8 +6239,7 @@ uint8_t* sinsp_filter_check_container::extract(sinsp_evt *evt, OUT uint32_t* len
 		}
 		else
 		{
-			const sinsp_container_info::ptr_t container_info =
-				m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+			const sinsp_container_info::ptr_t container_info = tinfo->get_container_info();
 			if(!container_info)
 			{
 				return NULL;
@@ -6285,8 +6286,7 @@ uint8_t* sinsp_filter_check_container::extract(sinsp_evt *evt, OUT uint32_t* len
 		}
 		else
 		{
-			const sinsp_container_info::ptr_t container_info =
-				m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+			const sinsp_container_info::ptr_t container_info = tinfo->get_container_info();
 			if(!container_info)
 			{
 				return NULL;
@@ -6312,8 +6312,7 @@ uint8_t* sinsp_filter_check_container::extract(sinsp_evt *evt, OUT uint32_t* len
 		}
 		else
 		{
-			const sinsp_container_info::ptr_t container_info =
-				m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+			const sinsp_container_info::ptr_t container_info = tinfo->get_container_info();
 			if(!container_info)
 			{
 				return NULL;
@@ -6347,8 +6346,7 @@ uint8_t* sinsp_filter_check_container::extract(sinsp_evt *evt, OUT uint32_t* len
 		else
 		{
 
-			const sinsp_container_info::ptr_t container_info =
-				m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+			const sinsp_container_info::ptr_t container_info = tinfo->get_container_info();
 			if(!container_info)
 			{
 				return NULL;
@@ -6390,8 +6388,7 @@ uint8_t* sinsp_filter_check_container::extract(sinsp_evt *evt, OUT uint32_t* len
 		else
 		{
 
-			const sinsp_container_info::ptr_t container_info =
-				m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+			const sinsp_container_info::ptr_t container_info = tinfo->get_container_info();
 			if(!container_info)
 			{
 				return NULL;
@@ -6451,8 +6448,7 @@ uint8_t* sinsp_filter_check_container::extract(sinsp_evt *evt, OUT uint32_t* len
 		}
 		else
 		{
-			const sinsp_container_info::ptr_t container_info =
-				m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+			const sinsp_container_info::ptr_t container_info = tinfo->get_container_info();
 			if(!container_info)
 			{
 				return NULL;
@@ -7438,8 +7434,7 @@ uint8_t* sinsp_filter_check_k8s::extract(sinsp_evt *evt, OUT uint32_t* len, bool
 	}
 	m_tstr.clear();
 	// there is metadata we can pull from the container directly instead of the k8s apiserver
-	const sinsp_container_info::ptr_t container_info =
-		m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+	const sinsp_container_info::ptr_t container_info = tinfo->get_container_info();
 	if(!tinfo->m_container_id.empty() && container_info && !container_info->m_labels.empty())
 	{
 		switch(m_field_id)
@@ -7880,8 +7875,7 @@ mesos_task::ptr_t sinsp_filter_check_mesos::find_task_for_thread(const sinsp_thr
 
 		if(m_inspector && m_inspector->m_mesos_client)
 		{
-			const sinsp_container_info::ptr_t container_info =
-				m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+			const sinsp_container_info::ptr_t container_info = tinfo->get_container_info();
 			if(!container_info || container_info->m_mesos_task_id.empty())
 			{
 				return NULL;
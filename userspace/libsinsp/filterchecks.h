@@ -16,6 +16,9 @@ limitations under the License.
 */
 
 #pragma once
+#include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_set>
 #include <json/json.h>
 #include "filter_value.h"
@@ -30,6 +33,11 @@ limitations under the License.
 
 class sinsp_filter_check_reference;
 
+namespace libsinsp
+{
+class capture_index;
+}
+
 bool flt_compare(cmpop op, ppm_param_type type, void* operand1, void* operand2, uint32_t op1_len = 0, uint32_t op2_len = 0);
 bool flt_compare_avg(cmpop op, ppm_param_type type, void* operand1, void* operand2, uint32_t op1_len, uint32_t op2_len, uint32_t cnt1, uint32_t cnt2);
 bool flt_compare_ipv4net(cmpop op, uint64_t operand1, ipv4net* operand2);
@@ -196,12 +204,16 @@ private:
 friend class sinsp_filter_check_list;
 friend class sinsp_filter_optimizer;
 friend class chk_compare_helper;
+friend class libsinsp::capture_index;
 };
 
 //
 // Global class that stores the list of filtercheck plugins and offers
 // functions to work with it.
 //
+// new_filter_check_from_fldname() can be called from several threads at
+// once, while add_filter_check() can't.
+//
 class sinsp_filter_check_list
 {
 public:
@@ -212,8 +224,33 @@ public:
 	sinsp_filter_check* new_filter_check_from_another(sinsp_filter_check *chk);
 	sinsp_filter_check* new_filter_check_from_fldname(const string& name, sinsp* inspector, bool do_exact_check);
 
+	//
+	// Parse the field name of a check. Parsing with alloc_state can
+	// reserve state in the inspector (thread memory, protocol decoders),
+	// so it's serialized across threads. That only makes it safe
+	// against the other parses, not against a capture running on
+	// another thread (see sinsp_filter::alloc_state()).
+	//
+	int32_t parse_field_name(sinsp_filter_check* chk, const char* str, bool alloc_state, bool needed_for_filtering);
+
 private:
+	//
+	// A trie over the field names of all the checks. A name is only
+	// parsed by the checks having a field that's a prefix of it.
+	//
+	struct field_node
+	{
+		std::map<char, std::unique_ptr<field_node>> m_children;
+		// the checks having a field with this name, by index in m_check_list
+		vector<uint32_t> m_checks;
+	};
+
+	void index_fields(uint32_t check_idx);
+	sinsp_filter_check* new_filter_check_by_scan(const string& name, sinsp* inspector, bool do_exact_check);
+
 	vector<sinsp_filter_check*> m_check_list;
+	field_node m_fields;
+	std::mutex m_parse_mutex;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
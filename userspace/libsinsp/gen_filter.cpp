@@ -58,6 +58,86 @@ int32_t gen_event_filter_check::get_check_id()
 	return m_check_id;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// gen_event_filter_check_proxy implementation
+///////////////////////////////////////////////////////////////////////////////
+gen_event_filter_check_proxy::gen_event_filter_check_proxy(gen_event_filter_check* check):
+	m_check(check)
+{
+	m_boolop = check->m_boolop;
+	m_cmpop = check->m_cmpop;
+}
+
+gen_event_filter_check_proxy::~gen_event_filter_check_proxy()
+{
+	delete m_check;
+}
+
+int32_t gen_event_filter_check_proxy::parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering)
+{
+	return m_check->parse_field_name(str, alloc_state, needed_for_filtering);
+}
+
+void gen_event_filter_check_proxy::add_filter_value(const char* str, uint32_t len, uint32_t i)
+{
+	m_check->add_filter_value(str, len, i);
+}
+
+bool gen_event_filter_check_proxy::compare(gen_event *evt)
+{
+	return m_check->compare(evt);
+}
+
+uint8_t *gen_event_filter_check_proxy::extract(gen_event *evt, uint32_t *len, bool sanitize_strings)
+{
+	return m_check->extract(evt, len, sanitize_strings);
+}
+
+int32_t gen_event_filter_check_proxy::get_check_id()
+{
+	return m_check->get_check_id();
+}
+
+gen_event_filter_check* gen_event_filter_check_proxy::unwrap(gen_event_filter_check* chk)
+{
+	gen_event_filter_check_proxy* proxy;
+
+	while((proxy = dynamic_cast<gen_event_filter_check_proxy*>(chk)) != NULL)
+	{
+		chk = proxy->m_check;
+	}
+
+	return chk;
+}
+
+bool gen_event_filter_check_proxy::unlink(gen_event_filter_expression* expr)
+{
+	for(gen_event_filter_check*& slot : expr->m_checks)
+	{
+		gen_event_filter_check** link = &slot;
+		gen_event_filter_check_proxy* proxy;
+
+		while((proxy = dynamic_cast<gen_event_filter_check_proxy*>(*link)) != NULL)
+		{
+			if(proxy == this)
+			{
+				//
+				// The expression reads the boolean operator of the
+				// head of the chain, which may have been reordered
+				//
+				m_check->m_boolop = m_boolop;
+				*link = m_check;
+				m_check = NULL;
+				return true;
+			}
+
+			link = &proxy->m_check;
+		}
+	}
+
+	return false;
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // gen_event_filter_expression implementation
 ///////////////////////////////////////////////////////////////////////////////
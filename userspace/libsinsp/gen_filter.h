@@ -120,6 +120,51 @@ private:
 
 };
 
+///////////////////////////////////////////////////////////////////////////////
+// Filter check proxy class
+// A proxy stands for a leaf check in the filtering tree, e.g. to profile it,
+// and forwards the calls to it. Proxies can wrap each other, so the slot of a
+// leaf in its expression holds a chain of proxies ending with the real check.
+///////////////////////////////////////////////////////////////////////////////
+
+class gen_event_filter_expression;
+
+class gen_event_filter_check_proxy : public gen_event_filter_check
+{
+public:
+	gen_event_filter_check_proxy(gen_event_filter_check* check);
+	virtual ~gen_event_filter_check_proxy();
+
+	int32_t parse_field_name(const char* str, bool alloc_state, bool needed_for_filtering);
+	void add_filter_value(const char* str, uint32_t len, uint32_t i = 0 );
+	bool compare(gen_event *evt);
+	uint8_t* extract(gen_event *evt, uint32_t* len, bool sanitize_strings = true);
+	int32_t get_check_id();
+
+	//
+	// The wrapped check, possibly another proxy
+	//
+	gen_event_filter_check* inner() const
+	{
+		return m_check;
+	}
+
+	//
+	// The real check at the end of the chain of proxies starting with chk
+	//
+	static gen_event_filter_check* unwrap(gen_event_filter_check* chk);
+
+	//
+	// Take the proxy out of its chain in expr, leaving the wrapped check in
+	// its current position. The proxy no longer owns the wrapped check.
+	// Returns false if the proxy isn't in expr.
+	//
+	bool unlink(gen_event_filter_expression* expr);
+
+protected:
+	gen_event_filter_check* m_check;
+};
+
 ///////////////////////////////////////////////////////////////////////////////
 // Filter expression class
 // A filter expression contains multiple filters connected by boolean expressions,
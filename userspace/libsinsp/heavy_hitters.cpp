@@ -0,0 +1,306 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <algorithm>
+#include <functional>
+
+#include "heavy_hitters.h"
+
+using namespace libsinsp;
+
+namespace
+{
+// the splitmix64 finalizer
+inline uint64_t mix(uint64_t h)
+{
+	h ^= h >> 30;
+	h *= 0xbf58476d1ce4e5b9ULL;
+	h ^= h >> 27;
+	h *= 0x94d049bb133111ebULL;
+	h ^= h >> 31;
+	return h;
+}
+
+uint64_t key_hash(heavy_hitters::key_type type, const std::string& key)
+{
+	if(type == heavy_hitters::KEY_TID)
+	{
+		return mix((uint64_t)std::stoll(key));
+	}
+
+	return mix(std::hash<std::string>()(key));
+}
+
+bool by_count(const heavy_hitters::entry& a, const heavy_hitters::entry& b)
+{
+	return a.m_count > b.m_count;
+}
+}
+
+heavy_hitters::heavy_hitters(uint32_t top_k,
+			     uint32_t width,
+			     uint32_t depth,
+			     uint64_t window_ns):
+	m_top_k(top_k ? top_k : 1),
+	m_width(width ? width : 1),
+	m_depth(depth ? depth : 1),
+	m_window_ns(window_ns ? window_ns : 1),
+	m_window_start_ts(0),
+	m_last_window_ns(0),
+	m_window_num(0),
+	m_report_expiry(60)
+{
+	for(uint32_t j = 0; j < KEY_MAX; j++)
+	{
+		m_trackers[j].m_sketch.resize((size_t)m_width * m_depth, 0);
+		m_trackers[j].m_top.reserve(m_top_k);
+		m_trackers[j].m_rate_limit = -1;
+	}
+}
+
+void heavy_hitters::add(int64_t tid, const std::string& comm, const std::string& container_id, uint64_t ts)
+{
+	if(m_window_start_ts == 0)
+	{
+		m_window_start_ts = ts;
+	}
+	else if(ts >= m_window_start_ts + m_window_ns)
+	{
+		end_window(ts);
+	}
+
+	std::hash<std::string> hasher;
+
+	add(KEY_TID, mix((uint64_t)tid), NULL, tid, ts);
+	add(KEY_COMM, mix(hasher(comm)), &comm, tid, ts);
+	add(KEY_CONTAINER, mix(hasher(container_id)), &container_id, tid, ts);
+}
+
+void heavy_hitters::add(key_type type, uint64_t hash, const std::string* key, int64_t tid, uint64_t ts)
+{
+	tracker& t = m_trackers[type];
+
+	//
+	// Conservative update: only the counters at the minimum are
+	// incremented, which keeps the overestimation of the keys sharing
+	// them lower. The row indexes are derived from two halves of the
+	// hash.
+	//
+	uint32_t h1 = (uint32_t)hash;
+	uint32_t h2 = (uint32_t)(hash >> 32) | 1;
+	uint32_t min = UINT32_MAX;
+
+	for(uint32_t j = 0; j < m_depth; j++)
+	{
+		uint32_t v = t.m_sketch[(size_t)j * m_width + (h1 + j * h2) % m_width];
+		min = v < min ? v : min;
+	}
+
+	uint32_t count = min + 1;
+
+	for(uint32_t j = 0; j < m_depth; j++)
+	{
+		uint32_t& v = t.m_sketch[(size_t)j * m_width + (h1 + j * h2) % m_width];
+		v = v < count ? count : v;
+	}
+
+	//
+	// Keep the top-K. K is small: a linear scan is cheaper than
+	// keeping a heap and an index into it.
+	//
+	candidate* c = NULL;
+	candidate* lowest = NULL;
+
+	for(auto& it : t.m_top)
+	{
+		if(it.m_hash == hash)
+		{
+			c = &it;
+			break;
+		}
+
+		if(lowest == NULL || it.m_count < lowest->m_count)
+		{
+			lowest = &it;
+		}
+	}
+
+	if(c == NULL)
+	{
+		if(t.m_top.size() < m_top_k)
+		{
+			t.m_top.emplace_back();
+			c = &t.m_top.back();
+		}
+		else if(lowest->m_count < count)
+		{
+			c = lowest;
+		}
+		else
+		{
+			return;
+		}
+
+		c->m_hash = hash;
+		c->m_key = key ? *key : std::to_string(tid);
+	}
+
+	c->m_count = count;
+
+	if(t.m_rate_limit >= 0 &&
+	   count > t.m_rate_limit * m_window_ns / 1000000000.0)
+	{
+		auto it = t.m_reported.find(hash);
+
+		if(it != t.m_reported.end() && it->second.m_expiry > m_window_num)
+		{
+			return;
+		}
+
+		uint64_t elapsed = ts > m_window_start_ts ? ts - m_window_start_ts : 0;
+
+		entry offender;
+		offender.m_type = type;
+		offender.m_key = c->m_key;
+		offender.m_count = count;
+		offender.m_rate = count * 1000000000.0 / std::max(elapsed, m_window_ns);
+		offender.m_failures = it != t.m_reported.end() ? it->second.m_failures : 0;
+		m_offenders.push_back(offender);
+
+		// until retry() says otherwise, the suppression worked
+		report& r = t.m_reported[hash];
+		r.m_expiry = m_window_num + m_report_expiry;
+		r.m_failures = 0;
+	}
+}
+
+void heavy_hitters::end_window(uint64_t ts)
+{
+	m_last_window_ns = ts - m_window_start_ts;
+	// windows without events count too
+	m_window_num += m_last_window_ns / m_window_ns;
+	m_window_start_ts = ts;
+
+	for(uint32_t j = 0; j < KEY_MAX; j++)
+	{
+		tracker& t = m_trackers[j];
+
+		std::fill(t.m_sketch.begin(), t.m_sketch.end(), 0);
+		t.m_last_top.swap(t.m_top);
+		t.m_top.clear();
+
+		//
+		// The failures of a key waiting for a retry are kept until
+		// it's been quiet for the report expiry
+		//
+		for(auto it = t.m_reported.begin(); it != t.m_reported.end();)
+		{
+			const report& r = it->second;
+
+			if(r.m_failures == 0 ? r.m_expiry <= m_window_num :
+			   r.m_expiry + m_report_expiry <= m_window_num)
+			{
+				it = t.m_reported.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+}
+
+std::vector<heavy_hitters::entry> heavy_hitters::top(key_type type, uint32_t n) const
+{
+	const tracker& t = m_trackers[type];
+	const std::vector<candidate>& list = m_last_window_ns ? t.m_last_top : t.m_top;
+	double secs = (m_last_window_ns ? m_last_window_ns : m_window_ns) / 1000000000.0;
+	std::vector<entry> res;
+
+	res.reserve(list.size());
+	for(const auto& it : list)
+	{
+		entry e;
+		e.m_type = type;
+		e.m_key = it.m_key;
+		e.m_count = it.m_count;
+		e.m_rate = it.m_count / secs;
+		e.m_failures = 0;
+		res.push_back(e);
+	}
+
+	std::sort(res.begin(), res.end(), by_count);
+
+	if(res.size() > n)
+	{
+		res.resize(n);
+	}
+
+	return res;
+}
+
+void heavy_hitters::set_rate_limit(key_type type, double rate)
+{
+	m_trackers[type].m_rate_limit = rate;
+}
+
+bool heavy_hitters::pop_offender(entry* offender)
+{
+	if(m_offenders.empty())
+	{
+		return false;
+	}
+
+	*offender = m_offenders.front();
+	m_offenders.erase(m_offenders.begin());
+	return true;
+}
+
+void heavy_hitters::forget_tid(int64_t tid)
+{
+	std::unordered_map<uint64_t, report>& reported = m_trackers[KEY_TID].m_reported;
+
+	if(!reported.empty())
+	{
+		reported.erase(mix((uint64_t)tid));
+	}
+}
+
+void heavy_hitters::retry(const entry& offender)
+{
+	tracker& t = m_trackers[offender.m_type];
+	auto it = t.m_reported.find(key_hash(offender.m_type, offender.m_key));
+
+	if(it != t.m_reported.end())
+	{
+		report& r = it->second;
+		uint32_t shift = std::min(offender.m_failures, (uint32_t)31);
+
+		r.m_failures = offender.m_failures + 1;
+		r.m_expiry = m_window_num + std::min((uint64_t)1 << shift, (uint64_t)m_report_expiry);
+	}
+}
+
+void heavy_hitters::set_report_expiry(uint32_t windows)
+{
+	m_report_expiry = windows ? windows : 1;
+}
+
+uint64_t heavy_hitters::get_report_expiry_ns() const
+{
+	return m_report_expiry * m_window_ns;
+}
@@ -0,0 +1,161 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace libsinsp
+{
+
+//
+// Finds the threads, comms and containers generating the most events,
+// in constant memory.
+//
+// Each kind of key has a count-min sketch, with conservative updates,
+// estimating how many events each key generated in the current window
+// of event time, and the top-K keys by estimate. At the end of each
+// window the ranking is saved, so that top() always returns the one of
+// a complete window, and the counts start over.
+//
+// A key whose estimate exceeds the rate limit of its kind (off by
+// default) is reported by pop_offender(), and then not again for a
+// number of windows: it's expected to be suppressed, and to stop
+// generating events. If it's still above the limit afterwards, e.g.
+// because it's a recycled tid, it's reported again. The keys reported
+// are remembered only for those windows, or until forget_tid(). A key
+// whose suppression failed is reported again after retry(), with an
+// exponential backoff. When the tracker is registered with
+// sinsp::register_heavy_hitters(), sinsp counts every event and
+// suppresses the offenders automatically.
+//
+class heavy_hitters
+{
+public:
+	enum key_type
+	{
+		KEY_TID = 0,
+		KEY_COMM = 1,
+		KEY_CONTAINER = 2,
+		KEY_MAX = 3
+	};
+
+	struct entry
+	{
+		key_type m_type;
+		std::string m_key;
+		uint64_t m_count;   // estimated events in the window, never underestimated
+		double m_rate;      // events per second
+		uint32_t m_failures; // failed suppressions since it was first reported
+	};
+
+	heavy_hitters(uint32_t top_k = 16,
+		      uint32_t width = 2048,
+		      uint32_t depth = 4,
+		      uint64_t window_ns = 1000000000);
+
+	//
+	// Count one event. container_id is empty for the host.
+	//
+	void add(int64_t tid, const std::string& comm, const std::string& container_id, uint64_t ts);
+
+	//
+	// The n keys of the given kind with the most events, in the last
+	// complete window (or in the current one, before the first ends)
+	//
+	std::vector<entry> top(key_type type, uint32_t n) const;
+
+	//
+	// Events per second above which a key is reported. Negative values
+	// disable the reporting.
+	//
+	void set_rate_limit(key_type type, double rate);
+
+	//
+	// Return the next key that exceeded its rate limit, false if none
+	//
+	bool pop_offender(entry* offender);
+
+	//
+	// The thread is gone: its tid can be reported again right away,
+	// e.g. once it's recycled
+	//
+	void forget_tid(int64_t tid);
+
+	//
+	// Suppressing the offender failed: report it again if it's still
+	// above the limit, after 1, 2, 4... windows for its consecutive
+	// failures, and at most the report expiry
+	//
+	void retry(const entry& offender);
+
+	//
+	// For how many windows a reported key isn't reported again (60 by
+	// default)
+	//
+	void set_report_expiry(uint32_t windows);
+
+	//
+	// The report expiry in nanoseconds, i.e. for how long a suppression
+	// holds before the key can be reported again
+	//
+	uint64_t get_report_expiry_ns() const;
+
+private:
+	struct candidate
+	{
+		uint64_t m_hash;
+		std::string m_key;
+		uint64_t m_count;
+	};
+
+	struct report
+	{
+		uint64_t m_expiry;    // window at whose end the key can be reported again
+		uint32_t m_failures;  // failed suppressions in a row
+	};
+
+	struct tracker
+	{
+		std::vector<uint32_t> m_sketch;
+		std::vector<candidate> m_top;
+		std::vector<candidate> m_last_top;
+		double m_rate_limit;
+		// hashes of the keys reported
+		std::unordered_map<uint64_t, report> m_reported;
+	};
+
+	void add(key_type type, uint64_t hash, const std::string* key, int64_t tid, uint64_t ts);
+	void end_window(uint64_t ts);
+
+	uint32_t m_top_k;
+	uint32_t m_width;
+	uint32_t m_depth;
+	uint64_t m_window_ns;
+	uint64_t m_window_start_ts;
+	uint64_t m_last_window_ns;
+	uint64_t m_window_num;
+	uint32_t m_report_expiry;
+
+	tracker m_trackers[KEY_MAX];
+	std::vector<entry> m_offenders;
+};
+
+}  // namespace libsinsp
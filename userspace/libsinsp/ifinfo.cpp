@@ -19,7 +19,8 @@ limitations under the License.
 #include "sinsp_int.h"
 
 sinsp_network_interfaces::sinsp_network_interfaces(sinsp* inspector)
-	: m_inspector(inspector)
+	: m_addresses(new interface_addresses()),
+	  m_inspector(inspector)
 {
 	if(inet_pton(AF_INET6, "::1", m_ipv6_loopback_addr.m_b) != 1)
 	{
@@ -228,21 +229,22 @@ bool sinsp_network_interfaces::is_ipv4addr_in_local_machine(uint32_t addr, sinsp
 {
 	if(!tinfo->m_container_id.empty())
 	{
-		const sinsp_container_info::ptr_t container_info =
-			m_inspector->m_container_manager.get_container(tinfo->m_container_id);
+		libsinsp::read_copy_update<const sinsp_container_manager::container_addresses>::read_guard
+			containers(m_inspector->m_container_manager.get_container_addresses());
+		auto it = containers->m_ip_by_id.find(tinfo->m_container_id);
 
 		//
 		// Note: if we don't have container info, any pick we make is arbitrary.
 		// To at least achieve consistency across client and server, we just match the host interface addresses.
 		//
-		if(container_info)
+		if(it != containers->m_ip_by_id.end())
 		{
-			if(container_info->m_container_ip != 0)
+			if(it->second != 0)
 			{
 				//
 				// We have a container info with a valid container IP. Let's use it.
 				//
-				if(addr == htonl(container_info->m_container_ip))
+				if(addr == htonl(it->second))
 				{
 					return true;
 				}
@@ -251,51 +253,21 @@ bool sinsp_network_interfaces::is_ipv4addr_in_local_machine(uint32_t addr, sinsp
 			{
 				//
 				// Container info is valid, but the IP address is zero.
-				// Scan the list of the containers looking for matches.
-				// If no match is found, we just jump to checking the
-				// host interfaces.
+				// Look for the address among the ones of all the
+				// containers. If no match is found, we just jump to
+				// checking the host interfaces.
 				//
-
-				if(!container_info->is_successful())
-				{
-					g_logger.format(sinsp_logger::SEV_DEBUG,
-						"Checking IP address of container %s with incomplete metadata (state=%d)",
-						tinfo->m_container_id.c_str(), container_info->m_lookup_state);
-				}
-
-				const sinsp_container_manager::map_ptr_t clist = m_inspector->m_container_manager.get_containers();
-
-				for(const auto& it : *clist)
+				if(containers->m_ips.find(addr) != containers->m_ips.end())
 				{
-					if(!it.second->is_successful())
-					{
-						g_logger.format(sinsp_logger::SEV_DEBUG,
-							"Checking IP address of container %s with incomplete metadata (in context of %s; state=%d)",
-							it.second->m_id.c_str(), tinfo->m_container_id.c_str(),
-							it.second->m_lookup_state);
-					}
-
-					if(htonl(it.second->m_container_ip) == addr)
-					{
-						return true;
-					}
+					return true;
 				}
 			}
 		}
 	}
 
-	vector<sinsp_ipv4_ifinfo>::iterator it;
-
 	// try to find an interface that has the given IP as address
-	for(it = m_ipv4_interfaces.begin(); it != m_ipv4_interfaces.end(); it++)
-	{
-		if(it->m_addr == addr)
-		{
-			return true;
-		}
-	}
-
-	return false;
+	libsinsp::read_copy_update<const interface_addresses>::read_guard interfaces(m_addresses);
+	return interfaces->m_ipv4.find(addr) != interfaces->m_ipv4.end();
 }
 
 void sinsp_network_interfaces::import_ipv4_ifaddr_list(uint32_t count, scap_ifinfo_ipv4* plist)
@@ -358,18 +330,9 @@ bool sinsp_network_interfaces::is_ipv6addr_in_local_machine(ipv6addr &addr, sins
 		return false;
 	}
 
-	vector<sinsp_ipv6_ifinfo>::iterator it;
-
-	// try to find an interface that has the given IP as address
-	for(it = m_ipv6_interfaces.begin(); it != m_ipv6_interfaces.end(); it++)
-	{
-		if(addr.in_subnet(it->m_net))
-		{
-			return true;
-		}
-	}
-
-	return false;
+	// try to find an interface in the subnet of the given IP
+	libsinsp::read_copy_update<const interface_addresses>::read_guard interfaces(m_addresses);
+	return interfaces->m_ipv6_prefixes.find(ipv6_prefix(addr)) != interfaces->m_ipv6_prefixes.end();
 }
 
 void sinsp_network_interfaces::import_ipv6_ifaddr_list(uint32_t count, scap_ifinfo_ipv6* plist)
@@ -397,20 +360,41 @@ void sinsp_network_interfaces::import_interfaces(scap_addrlist* paddrlist)
 {
 	if(NULL != paddrlist)
 	{
-		clear();
+		m_ipv4_interfaces.clear();
+		m_ipv6_interfaces.clear();
 		import_ipv4_ifaddr_list(paddrlist->n_v4_addrs, paddrlist->v4list);
 		import_ipv6_ifaddr_list(paddrlist->n_v6_addrs, paddrlist->v6list);
+		index_interfaces();
 	}
 }
 
 void sinsp_network_interfaces::import_ipv4_interface(const sinsp_ipv4_ifinfo& ifinfo)
 {
 	m_ipv4_interfaces.push_back(ifinfo);
+	index_interfaces();
 }
 
 void sinsp_network_interfaces::import_ipv6_interface(const sinsp_ipv6_ifinfo& ifinfo)
 {
 	m_ipv6_interfaces.push_back(ifinfo);
+	index_interfaces();
+}
+
+void sinsp_network_interfaces::index_interfaces()
+{
+	interface_addresses* addresses = new interface_addresses();
+
+	for(const auto& it : m_ipv4_interfaces)
+	{
+		addresses->m_ipv4.insert(it.m_addr);
+	}
+
+	for(const auto& it : m_ipv6_interfaces)
+	{
+		addresses->m_ipv6_prefixes.insert(ipv6_prefix(it.m_net));
+	}
+
+	m_addresses.publish(addresses);
 }
 
 vector<sinsp_ipv4_ifinfo>* sinsp_network_interfaces::get_ipv4_list()
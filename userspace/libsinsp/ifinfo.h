@@ -17,7 +17,10 @@ limitations under the License.
 
 #pragma once
 
+#include <unordered_set>
+
 #include "tuples.h"
+#include "read_copy_update.h"
 
 #ifndef VISIBILITY_PRIVATE
 #define VISIBILITY_PRIVATE private:
@@ -76,12 +79,32 @@ public:
 	ipv6addr m_ipv6_loopback_addr;
 
 VISIBILITY_PRIVATE
+	//
+	// The addresses of the interfaces, so that the lookups of the
+	// network filterchecks don't scan the lists. Published again
+	// whenever the lists change.
+	//
+	struct interface_addresses
+	{
+		std::unordered_set<uint32_t> m_ipv4;
+		// the first 64 bits, see ipv6addr::in_subnet()
+		std::unordered_set<uint64_t> m_ipv6_prefixes;
+	};
+
+	static uint64_t ipv6_prefix(const ipv6addr& addr)
+	{
+		return ((uint64_t)addr.m_b[0] << 32) | addr.m_b[1];
+	}
+
+	void index_interfaces();
+
 	uint32_t infer_ipv4_address(uint32_t destination_address);
 	void import_ipv4_ifaddr_list(uint32_t count, scap_ifinfo_ipv4* plist);
 	ipv6addr infer_ipv6_address(ipv6addr &destination_address);
 	void import_ipv6_ifaddr_list(uint32_t count, scap_ifinfo_ipv6* plist);
 	vector<sinsp_ipv4_ifinfo> m_ipv4_interfaces;
 	vector<sinsp_ipv6_ifinfo> m_ipv6_interfaces;
+	libsinsp::read_copy_update<const interface_addresses> m_addresses;
 	sinsp* m_inspector;
 };
 
@@ -89,4 +112,5 @@ void sinsp_network_interfaces::clear()
 {
 	m_ipv4_interfaces.clear();
 	m_ipv6_interfaces.clear();
+	index_interfaces();
 }
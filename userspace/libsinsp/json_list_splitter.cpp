@@ -0,0 +1,255 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+//
+// json_list_splitter.cpp
+//
+
+#include "json_list_splitter.h"
+#include <algorithm>
+
+json_list_splitter::json_list_splitter(callback_t callback,
+	const std::string& list_member,
+	size_t batch_size):
+	m_callback(callback),
+	m_list_member(list_member),
+	m_batch_size(batch_size)
+{
+}
+
+void json_list_splitter::feed(const char* data, size_t len)
+{
+	for(size_t j = 0; j < len; ++j)
+	{
+		on_char(data[j]);
+	}
+	track_buffered();
+}
+
+bool json_list_splitter::finish()
+{
+	bool complete = (m_depth == 0 && m_head.empty() && !m_in_string);
+	reset();
+	return complete;
+}
+
+void json_list_splitter::reset()
+{
+	m_depth = 0;
+	m_in_string = false;
+	m_escape = false;
+	m_expect_key = false;
+	m_capture_key = false;
+	m_list_value_next = false;
+	m_in_list = false;
+	m_list_seen = false;
+	m_item_open = false;
+	m_emitted = false;
+	m_key.clear();
+	m_head.clear();
+	m_batch.clear();
+	m_tail.clear();
+}
+
+void json_list_splitter::append(char c)
+{
+	if(m_in_list)
+	{
+		// first character of a new list element
+		if(!m_item_open)
+		{
+			if(!m_batch.empty())
+			{
+				m_batch.push_back(',');
+			}
+			m_item_open = true;
+		}
+		m_batch.push_back(c);
+	}
+	else if(m_list_seen)
+	{
+		m_tail.push_back(c);
+	}
+	else
+	{
+		m_head.push_back(c);
+	}
+}
+
+void json_list_splitter::on_char(char c)
+{
+	if(m_in_string)
+	{
+		append(c);
+		if(m_escape)
+		{
+			m_escape = false;
+		}
+		else if(c == '\\')
+		{
+			m_escape = true;
+		}
+		else if(c == '"')
+		{
+			m_in_string = false;
+			m_capture_key = false;
+			return;
+		}
+		if(m_capture_key)
+		{
+			m_key.push_back(c);
+		}
+		return;
+	}
+
+	if(c == ' ' || c == '\n' || c == '\r' || c == '\t')
+	{
+		return;
+	}
+
+	// the value of the list member is not an array (eg. null);
+	// the document will be treated as a regular one
+	if(m_list_value_next && c != '[')
+	{
+		m_list_value_next = false;
+	}
+
+	switch(c)
+	{
+	case '"':
+		m_in_string = true;
+		if(m_depth == 1 && m_expect_key && !m_in_list)
+		{
+			m_capture_key = true;
+			m_expect_key = false;
+			m_key.clear();
+		}
+		append(c);
+		break;
+	case '[':
+		if(m_list_value_next)
+		{
+			m_list_value_next = false;
+			m_in_list = true;
+			m_list_seen = true;
+			++m_depth;
+			break;
+		}
+		append(c);
+		++m_depth;
+		break;
+	case '{':
+		append(c);
+		++m_depth;
+		if(m_depth == 1)
+		{
+			m_expect_key = true;
+		}
+		break;
+	case ']':
+		if(m_in_list && m_depth == 2)
+		{
+			end_item();
+			m_in_list = false;
+			--m_depth;
+			break;
+		}
+		// fall through
+	case '}':
+		append(c);
+		if(m_depth) { --m_depth; }
+		if(m_depth == 0)
+		{
+			flush(true);
+		}
+		break;
+	case ',':
+		if(m_in_list && m_depth == 2)
+		{
+			end_item();
+			break;
+		}
+		append(c);
+		if(m_depth == 1)
+		{
+			m_expect_key = true;
+		}
+		break;
+	case ':':
+		append(c);
+		if(m_depth == 1 && !m_list_seen && m_key == m_list_member)
+		{
+			m_list_value_next = true;
+		}
+		break;
+	default:
+		append(c);
+		break;
+	}
+}
+
+void json_list_splitter::end_item()
+{
+	if(m_item_open)
+	{
+		m_item_open = false;
+		++m_item_count;
+		if(m_batch.size() >= m_batch_size)
+		{
+			flush(false);
+		}
+	}
+}
+
+void json_list_splitter::flush(bool last)
+{
+	std::string doc;
+	track_buffered();
+	if(!last)
+	{
+		doc.reserve(m_head.size() + m_batch.size() + 3);
+		doc.append(m_head).append(1, '[').append(m_batch).append("]}");
+		m_batch.clear();
+		m_emitted = true;
+	}
+	else
+	{
+		if(m_list_seen)
+		{
+			if(!m_batch.empty() || !m_emitted)
+			{
+				doc.reserve(m_head.size() + m_batch.size() + m_tail.size() + 2);
+				doc.append(m_head).append(1, '[').append(m_batch).append(1, ']').append(m_tail);
+			}
+		}
+		else
+		{
+			doc.swap(m_head);
+		}
+		reset();
+	}
+
+	if(!doc.empty())
+	{
+		++m_emitted_count;
+		m_callback(std::move(doc));
+	}
+}
+
+void json_list_splitter::track_buffered()
+{
+	m_max_buffered = std::max(m_max_buffered, m_head.size() + m_batch.size() + m_tail.size());
+}
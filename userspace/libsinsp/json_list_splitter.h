@@ -0,0 +1,127 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+//
+// json_list_splitter.h
+//
+// incremental splitter for large JSON list documents
+//
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+//
+// Splits a stream of JSON documents into small, self-contained documents
+// without ever holding a whole (potentially huge) document in memory.
+//
+// Data is fed in arbitrary chunks. When a top-level object contains an
+// array member named like the configured list member (K8s "items"), the
+// array elements are collected into batches of roughly batch_size bytes
+// and every batch is emitted as a copy of the list envelope (all top-level
+// members preceding the array) carrying only that batch, eg.:
+//
+//   {"kind":"PodList","apiVersion":"v1","items":[{pod1},{pod2}]}
+//
+// so that consumers (eg. jq state filters iterating over .items[]) see
+// the same document shape as before, just in smaller pieces. At least one
+// document is emitted for every list, so empty lists are still reported.
+// Documents without the list member are emitted whole when they close.
+//
+// Whitespace outside of strings is dropped, so pretty-printed input is
+// handled the same way as compact one.
+//
+// Memory is bounded by the size of the largest single list element plus
+// the batch size, regardless of the total document size.
+//
+class json_list_splitter
+{
+public:
+	typedef std::function<void(std::string&&)> callback_t;
+
+	json_list_splitter(callback_t callback,
+		const std::string& list_member = "items",
+		size_t batch_size = 256 * 1024);
+
+	// feed the next chunk of the stream
+	void feed(const char* data, size_t len);
+
+	// signals the end of the stream; returns false if the
+	// stream ended in the middle of a document
+	bool finish();
+
+	// discards all partial data and prepares for a new stream
+	void reset();
+
+	// number of list elements seen since construction
+	uint64_t get_item_count() const;
+
+	// number of documents emitted since construction
+	uint64_t get_emitted_count() const;
+
+	// highest number of bytes buffered at any time
+	size_t get_max_buffered() const;
+
+private:
+	void on_char(char c);
+	void append(char c);
+	void end_item();
+	void flush(bool last);
+	void track_buffered();
+
+	callback_t  m_callback;
+	std::string m_list_member;
+	size_t      m_batch_size;
+
+	// parsing state
+	uint32_t    m_depth = 0;
+	bool        m_in_string = false;
+	bool        m_escape = false;
+	bool        m_expect_key = false;
+	bool        m_capture_key = false;
+	bool        m_list_value_next = false;
+	bool        m_in_list = false;
+	bool        m_list_seen = false;
+	bool        m_item_open = false;
+	bool        m_emitted = false;
+
+	// document pieces
+	std::string m_key;
+	std::string m_head;  // envelope up to and including the list member name
+	std::string m_batch; // comma-separated list elements
+	std::string m_tail;  // envelope after the list (including closing brace)
+
+	uint64_t    m_item_count = 0;
+	uint64_t    m_emitted_count = 0;
+	size_t      m_max_buffered = 0;
+};
+
+inline uint64_t json_list_splitter::get_item_count() const
+{
+	return m_item_count;
+}
+
+inline uint64_t json_list_splitter::get_emitted_count() const
+{
+	return m_emitted_count;
+}
+
+inline size_t json_list_splitter::get_max_buffered() const
+{
+	return m_max_buffered;
+}
@@ -335,7 +335,9 @@ void k8s_handler::check_state()
 #if defined(HAS_CAPTURE) && !defined(_WIN32)
 	if(m_collector && m_handler)
 	{
-		if(m_resp_recvd && m_watch && !m_watching)
+		// initial state arrives in batches; do not switch to watch
+		// before the whole state response has been received
+		if(m_resp_recvd && m_watch && !m_watching && !state_fetch_pending())
 		{
 			g_logger.log("k8s_handler (" + m_id + ") switching to watch connection for " +
 						 uri(m_url).to_string(false) + m_path,
@@ -686,6 +688,15 @@ bool k8s_handler::dependency_ready() const
 #endif // HAS_CAPTURE
 }
 
+bool k8s_handler::state_fetch_pending() const
+{
+#if defined(HAS_CAPTURE) && !defined(_WIN32)
+	return m_handler && !m_watching && m_handler->is_fetching_state();
+#else
+	return false;
+#endif // HAS_CAPTURE
+}
+
 void k8s_handler::process_events()
 {
 	if(dependency_ready())
@@ -721,7 +732,10 @@ void k8s_handler::process_events()
 			}
 			evt = m_events.erase(evt);
 		}
-		if(!m_state_built && m_state_processing_started && !m_events.size()) { m_state_built = true; }
+		if(!m_state_built && m_state_processing_started && !m_events.size() && !state_fetch_pending())
+		{
+			m_state_built = true;
+		}
 	}
 }
 
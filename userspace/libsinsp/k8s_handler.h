@@ -151,6 +151,7 @@ private:
 
 	const std::string& translate_name(const std::string& event_name);
 	bool dependency_ready() const;
+	bool state_fetch_pending() const;
 
 	std::string     m_id;
 	std::string     m_machine_id;
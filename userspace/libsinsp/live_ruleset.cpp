@@ -0,0 +1,258 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "live_ruleset.h"
+
+#ifdef HAS_FILTERING
+
+using namespace libsinsp;
+
+live_ruleset::live_ruleset(sinsp_evttype_filter* ruleset):
+	m_ruleset(ruleset),
+	m_generation(0),
+	m_reload_running(false),
+	m_state_pending(false),
+	m_state_ruleset(NULL),
+	m_stopping(false)
+{
+}
+
+live_ruleset::~live_ruleset()
+{
+	{
+		std::lock_guard<std::mutex> guard(m_state_mutex);
+		m_stopping = true;
+		m_state_done.notify_all();
+	}
+
+	wait_reload();
+}
+
+bool live_ruleset::run(sinsp_evt* evt, uint16_t ruleset)
+{
+	if(m_state_pending.load(std::memory_order_relaxed))
+	{
+		alloc_pending_state();
+	}
+
+	read_guard guard(m_ruleset);
+
+	if(guard.get() == NULL)
+	{
+		return false;
+	}
+
+	return guard.get()->run(evt, ruleset);
+}
+
+void live_ruleset::evttypes_for_ruleset(std::vector<bool>& evttypes, uint16_t ruleset)
+{
+	read_guard guard(m_ruleset);
+
+	if(guard.get() == NULL)
+	{
+		evttypes.assign(PPM_EVENT_MAX + 1, false);
+		return;
+	}
+
+	guard.get()->evttypes_for_ruleset(evttypes, ruleset);
+}
+
+void live_ruleset::syscalls_for_ruleset(std::vector<bool>& syscalls, uint16_t ruleset)
+{
+	read_guard guard(m_ruleset);
+
+	if(guard.get() == NULL)
+	{
+		syscalls.assign(PPM_SC_MAX + 1, false);
+		return;
+	}
+
+	guard.get()->syscalls_for_ruleset(syscalls, ruleset);
+}
+
+void live_ruleset::publish(sinsp_evttype_filter* ruleset)
+{
+	m_ruleset.publish(ruleset);
+	m_generation++;
+}
+
+void live_ruleset::reload(builder_t builder, callback_t cb)
+{
+	std::lock_guard<std::mutex> guard(m_reload_mutex);
+
+	if(m_queued_builder)
+	{
+		m_superseded.push_back(m_queued_cb);
+	}
+	m_queued_builder = builder;
+	m_queued_cb = cb;
+
+	if(!m_reload_running)
+	{
+		//
+		// The previous thread is done with the queue, and only has to
+		// exit
+		//
+		if(m_reload_thread.joinable())
+		{
+			m_reload_thread.join();
+		}
+
+		m_reload_running = true;
+		m_reload_thread = std::thread(&live_ruleset::run_reloads, this);
+	}
+}
+
+void live_ruleset::wait_reload()
+{
+	std::unique_lock<std::mutex> lock(m_reload_mutex);
+
+	m_reload_done.wait(lock, [this]() { return !m_reload_running; });
+
+	if(m_reload_thread.joinable())
+	{
+		m_reload_thread.join();
+	}
+}
+
+void live_ruleset::run_reloads()
+{
+	while(true)
+	{
+		builder_t builder;
+		callback_t cb;
+		std::vector<callback_t> superseded;
+
+		{
+			std::lock_guard<std::mutex> guard(m_reload_mutex);
+
+			if(!m_queued_builder)
+			{
+				m_reload_running = false;
+				m_reload_done.notify_all();
+				return;
+			}
+
+			builder.swap(m_queued_builder);
+			cb.swap(m_queued_cb);
+			superseded.swap(m_superseded);
+		}
+
+		for(const auto& superseded_cb : superseded)
+		{
+			if(superseded_cb)
+			{
+				superseded_cb(false, "superseded by a later reload");
+			}
+		}
+
+		build_and_publish(builder, cb);
+	}
+}
+
+void live_ruleset::build_and_publish(const builder_t& builder, const callback_t& cb)
+{
+	sinsp_evttype_filter* ruleset;
+
+	try
+	{
+		ruleset = builder();
+	}
+	catch(const std::exception& e)
+	{
+		if(cb)
+		{
+			cb(false, e.what());
+		}
+		return;
+	}
+	catch(...)
+	{
+		if(cb)
+		{
+			cb(false, "unknown error while building the ruleset");
+		}
+		return;
+	}
+
+	if(ruleset != NULL && ruleset->has_deferred_state())
+	{
+		//
+		// Hand the ruleset over to the thread of the capture, and
+		// wait for its state
+		//
+		std::unique_lock<std::mutex> lock(m_state_mutex);
+		m_state_ruleset = ruleset;
+		m_state_error.clear();
+		m_state_pending = true;
+
+		m_state_done.wait(lock, [this]() { return m_state_ruleset == NULL || m_stopping; });
+
+		std::string error = m_state_error;
+		if(m_state_ruleset != NULL)
+		{
+			m_state_ruleset = NULL;
+			m_state_pending = false;
+			error = "the live ruleset was destroyed before the state of the ruleset was allocated";
+		}
+		lock.unlock();
+
+		if(!error.empty())
+		{
+			delete ruleset;
+			if(cb)
+			{
+				cb(false, error);
+			}
+			return;
+		}
+	}
+
+	publish(ruleset);
+
+	if(cb)
+	{
+		cb(true, "");
+	}
+}
+
+void live_ruleset::alloc_pending_state()
+{
+	std::lock_guard<std::mutex> guard(m_state_mutex);
+
+	if(m_state_ruleset == NULL)
+	{
+		return;
+	}
+
+	try
+	{
+		m_state_ruleset->alloc_state();
+	}
+	catch(const std::exception& e)
+	{
+		// e.g. thread memory, once the capture started
+		m_state_error = e.what();
+	}
+
+	m_state_ruleset = NULL;
+	m_state_pending = false;
+	m_state_done.notify_all();
+}
+
+#endif // HAS_FILTERING
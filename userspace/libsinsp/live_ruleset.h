@@ -0,0 +1,150 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sinsp.h"
+#include "filter.h"
+#include "read_copy_update.h"
+
+#ifdef HAS_FILTERING
+
+namespace libsinsp
+{
+
+//
+// A sinsp_evttype_filter that can be replaced while the event loop runs
+// it, without ever making the event loop wait.
+//
+// The current ruleset is held in a read_copy_update: run() and the
+// other accessors never wait, and publishing a new ruleset waits for
+// the readers of the old one before deleting it. Only the publisher
+// waits, and reload() builds and publishes on a background thread.
+//
+// The readers can run on any number of threads; the rulesets they run
+// must be safe for that, as usual.
+//
+// The state of the checks of a ruleset (thread memory, protocol
+// decoders) changes the inspector, which the capture uses at the same
+// time, so the builders compile with deferred state (see
+// sinsp_evttype_filter::add_all()). The state is then allocated by the
+// next run(), which must be called from the thread of sinsp::next(),
+// and the reload publishes the ruleset once that's done.
+//
+class live_ruleset
+{
+public:
+	typedef std::function<sinsp_evttype_filter*()> builder_t;
+
+	//
+	// Called on the background thread once a reload is done, with the
+	// error of the builder if it threw, or the error allocating the
+	// state of the ruleset
+	//
+	typedef std::function<void(bool successful, const std::string& error)> callback_t;
+
+	//
+	// The ruleset is owned by the live_ruleset, and can be NULL
+	//
+	live_ruleset(sinsp_evttype_filter* ruleset = NULL);
+	~live_ruleset();
+
+	//
+	// Match the current ruleset against the event, after allocating the
+	// state of the ruleset being reloaded, if any
+	//
+	bool run(sinsp_evt* evt, uint16_t ruleset = 0);
+
+	void evttypes_for_ruleset(std::vector<bool>& evttypes, uint16_t ruleset);
+	void syscalls_for_ruleset(std::vector<bool>& syscalls, uint16_t ruleset);
+
+	//
+	// Replace the current ruleset, and delete the old one once no reader
+	// references it. Blocks for that long: don't call it from a reader.
+	// The state of the ruleset must be allocated.
+	//
+	void publish(sinsp_evttype_filter* ruleset);
+
+	//
+	// Build a ruleset with the builder and publish it, on a background
+	// thread. Never waits: while a reload is running, the next one is
+	// queued behind it, and replaces the one already queued, whose
+	// callback reports that it was superseded.
+	//
+	void reload(builder_t builder, callback_t cb = nullptr);
+
+	//
+	// Wait for the reload in progress and the queued one, if any. A
+	// ruleset with deferred state only gets published once run() is
+	// called.
+	//
+	void wait_reload();
+
+	//
+	// The number of rulesets published so far
+	//
+	uint64_t get_generation() const
+	{
+		return m_generation;
+	}
+
+private:
+	typedef read_copy_update<sinsp_evttype_filter>::read_guard read_guard;
+
+	void run_reloads();
+	void build_and_publish(const builder_t& builder, const callback_t& cb);
+	void alloc_pending_state();
+
+	read_copy_update<sinsp_evttype_filter> m_ruleset;
+	std::atomic<uint64_t> m_generation;
+
+	// guards the fields below
+	std::mutex m_reload_mutex;
+	std::condition_variable m_reload_done;
+	std::thread m_reload_thread;
+	// whether m_reload_thread still looks for queued reloads
+	bool m_reload_running;
+	builder_t m_queued_builder;
+	callback_t m_queued_cb;
+	// the callbacks of the queued reloads that were replaced
+	std::vector<callback_t> m_superseded;
+
+	//
+	// The ruleset whose state run() has to allocate, handed over by the
+	// reload thread, which waits for it
+	//
+	std::atomic<bool> m_state_pending;
+	// guards the fields below
+	std::mutex m_state_mutex;
+	std::condition_variable m_state_done;
+	sinsp_evttype_filter* m_state_ruleset;
+	std::string m_state_error;
+	// the reload thread gives up on the handover
+	bool m_stopping;
+};
+
+}  // namespace libsinsp
+
+#endif // HAS_FILTERING
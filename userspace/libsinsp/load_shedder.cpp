@@ -0,0 +1,189 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <cstring>
+
+#include "load_shedder.h"
+#include "sinsp.h"
+#include "sinsp_int.h"
+
+using namespace libsinsp;
+
+load_shedder::load_shedder(double high_watermark,
+			   double low_watermark,
+			   uint64_t check_interval_ns):
+	m_high_watermark(high_watermark),
+	m_low_watermark(low_watermark < high_watermark ? low_watermark : high_watermark),
+	m_check_interval_ns(check_interval_ns),
+	m_next_check_ts(0),
+	m_shedding(false),
+	m_shedding_start_ts(0),
+	m_last_ts(0)
+{
+	m_default_category_budget.m_rate = 0;
+	m_default_category_budget.m_max_burst = 0;
+	m_container_budget.m_rate = -1;
+	m_container_budget.m_max_burst = 0;
+
+	memset(&m_stats, 0, sizeof(m_stats));
+	memset(m_shed_by_type, 0, sizeof(m_shed_by_type));
+}
+
+void load_shedder::set_category_budget(ppm_event_category category, double rate, double max_burst)
+{
+	budget& b = m_category_budgets[category];
+	b.m_rate = rate;
+	b.m_max_burst = max_burst;
+	reset_buckets();
+}
+
+void load_shedder::set_default_category_budget(double rate, double max_burst)
+{
+	m_default_category_budget.m_rate = rate;
+	m_default_category_budget.m_max_burst = max_burst;
+	reset_buckets();
+}
+
+void load_shedder::set_container_budget(double rate, double max_burst)
+{
+	m_container_budget.m_rate = rate;
+	m_container_budget.m_max_burst = max_burst;
+	reset_buckets();
+}
+
+void load_shedder::update_fill_level(double fill_level, uint64_t ts)
+{
+	m_stats.m_fill_level = fill_level;
+	m_next_check_ts = ts + m_check_interval_ns;
+
+	if(ts > m_last_ts)
+	{
+		m_last_ts = ts;
+	}
+
+	if(!m_shedding && fill_level >= m_high_watermark)
+	{
+		g_logger.format(sinsp_logger::SEV_INFO,
+				"load shedding started, buffers %.0f%% full",
+				fill_level * 100);
+
+		m_shedding = true;
+		m_shedding_start_ts = m_last_ts;
+		m_stats.m_n_activations++;
+
+		// every shedding period starts with full buckets
+		reset_buckets();
+	}
+	else if(m_shedding && fill_level <= m_low_watermark)
+	{
+		g_logger.format(sinsp_logger::SEV_INFO,
+				"load shedding stopped, buffers %.0f%% full, %" PRIu64 " events shed so far",
+				fill_level * 100, m_stats.m_n_shed);
+
+		m_shedding = false;
+		m_stats.m_shedding_ns += m_last_ts - m_shedding_start_ts;
+	}
+}
+
+uint64_t load_shedder::get_shed_count(uint16_t evt_type) const
+{
+	if(evt_type >= PPM_EVENT_MAX)
+	{
+		return 0;
+	}
+
+	return m_shed_by_type[evt_type];
+}
+
+bool load_shedder::shed_slow(sinsp_evt* evt, const std::string* container_id)
+{
+	static const std::string host_id;
+
+	//
+	// The event info is set by the parser, which hasn't run yet
+	//
+	uint16_t type = evt->get_type();
+	const ppm_event_info& info = g_infotables.m_event_info[type];
+
+	if((info.flags & (EF_MODIFIES_STATE | EF_CREATES_FD | EF_DESTROYS_FD)) ||
+	   (info.category & EC_INTERNAL))
+	{
+		m_stats.m_n_preserved++;
+		return false;
+	}
+
+	uint64_t ts = evt->get_ts();
+	if(ts > m_last_ts)
+	{
+		m_last_ts = ts;
+	}
+
+	if(container_id == NULL)
+	{
+		container_id = &host_id;
+	}
+
+	//
+	// The buckets are created, full, the first time they are needed in
+	// a shedding period
+	//
+	bool keep = true;
+	auto cb = m_category_budgets.find(info.category);
+	const budget& category_budget = cb != m_category_budgets.end() ? cb->second : m_default_category_budget;
+
+	if(category_budget.m_rate >= 0)
+	{
+		auto it = m_category_buckets.find(info.category);
+		if(it == m_category_buckets.end())
+		{
+			it = m_category_buckets.emplace(info.category, token_bucket()).first;
+			it->second.init(category_budget.m_rate, category_budget.m_max_burst, m_last_ts);
+		}
+
+		keep = it->second.claim(1, m_last_ts);
+	}
+
+	if(keep && m_container_budget.m_rate >= 0)
+	{
+		auto it = m_container_buckets.find(*container_id);
+		if(it == m_container_buckets.end())
+		{
+			it = m_container_buckets.emplace(*container_id, token_bucket()).first;
+			it->second.init(m_container_budget.m_rate, m_container_budget.m_max_burst, m_last_ts);
+		}
+
+		keep = it->second.claim(1, m_last_ts);
+	}
+
+	if(keep)
+	{
+		return false;
+	}
+
+	m_stats.m_n_shed++;
+	m_shed_by_type[type]++;
+	m_shed_by_category[info.category]++;
+	m_shed_by_container[*container_id]++;
+
+	return true;
+}
+
+void load_shedder::reset_buckets()
+{
+	m_category_buckets.clear();
+	m_container_buckets.clear();
+}
@@ -0,0 +1,168 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <unordered_map>
+
+#include "token_bucket.h"
+#include "scap.h"
+
+class sinsp_evt;
+
+namespace libsinsp
+{
+
+//
+// Userspace load shedding, as an alternative to the kernel dropping
+// mode and its fixed sampling ratios.
+//
+// Shedding starts when the fill level of the driver buffers reaches the
+// high watermark, and stops when it goes back to the low watermark.
+// While shedding, each event must get a token from the budget of its
+// category and from the budget of its container (the host being the
+// container with an empty id), or it's dropped before reaching the
+// parser. Events that change the inspector state (EF_MODIFIES_STATE,
+// EF_CREATES_FD, EF_DESTROYS_FD and the internal events) are never shed.
+//
+// Budgets are token buckets, in events per second of event time, with
+// a negative rate meaning no limit. By default only the state changing
+// events survive shedding.
+//
+// Register it with sinsp::register_load_shedder(): sinsp samples the
+// fill level every check interval, during live captures. The fill level
+// can also be set with update_fill_level().
+//
+class load_shedder
+{
+public:
+	struct stats
+	{
+		uint64_t m_n_evts;          // events seen
+		uint64_t m_n_shed;          // events dropped
+		uint64_t m_n_preserved;     // state changing events kept while shedding
+		uint64_t m_n_activations;   // times shedding was turned on
+		uint64_t m_shedding_ns;     // event time spent shedding, up to the last change
+		double m_fill_level;        // last fill level seen
+	};
+
+	load_shedder(double high_watermark = 0.75,
+		     double low_watermark = 0.25,
+		     uint64_t check_interval_ns = 10000000);
+
+	void set_category_budget(ppm_event_category category, double rate, double max_burst);
+
+	//
+	// Budget of the categories without their own
+	//
+	void set_default_category_budget(double rate, double max_burst);
+
+	//
+	// Budget of each container
+	//
+	void set_container_budget(double rate, double max_burst);
+
+	//
+	// Whether the fill level should be sampled again at time ts
+	//
+	inline bool fill_level_due(uint64_t ts) const
+	{
+		return ts >= m_next_check_ts;
+	}
+
+	//
+	// Set the fill level of the driver buffers, between 0 and 1, turning
+	// shedding on or off
+	//
+	void update_fill_level(double fill_level, uint64_t ts);
+
+	inline bool is_shedding() const
+	{
+		return m_shedding;
+	}
+
+	//
+	// Returns true if the event must be dropped. container_id is the
+	// container of the thread, NULL if not known.
+	//
+	inline bool shed(sinsp_evt* evt, const std::string* container_id)
+	{
+		m_stats.m_n_evts++;
+
+		if(!m_shedding)
+		{
+			return false;
+		}
+
+		return shed_slow(evt, container_id);
+	}
+
+	const stats& get_stats() const
+	{
+		return m_stats;
+	}
+
+	//
+	// What was shed, since the creation of the object
+	//
+	uint64_t get_shed_count(uint16_t evt_type) const;
+	const std::map<ppm_event_category, uint64_t>& get_shed_by_category() const
+	{
+		return m_shed_by_category;
+	}
+	const std::unordered_map<std::string, uint64_t>& get_shed_by_container() const
+	{
+		return m_shed_by_container;
+	}
+
+private:
+	struct budget
+	{
+		double m_rate;
+		double m_max_burst;
+	};
+
+	bool shed_slow(sinsp_evt* evt, const std::string* container_id);
+	void reset_buckets();
+
+	double m_high_watermark;
+	double m_low_watermark;
+	uint64_t m_check_interval_ns;
+	uint64_t m_next_check_ts;
+
+	bool m_shedding;
+	uint64_t m_shedding_start_ts;
+
+	// the buckets are fed with a timestamp that never goes back
+	uint64_t m_last_ts;
+
+	std::map<ppm_event_category, budget> m_category_budgets;
+	budget m_default_category_budget;
+	budget m_container_budget;
+
+	std::map<ppm_event_category, token_bucket> m_category_buckets;
+	std::unordered_map<std::string, token_bucket> m_container_buckets;
+
+	stats m_stats;
+	uint64_t m_shed_by_type[PPM_EVENT_MAX];
+	std::map<ppm_event_category, uint64_t> m_shed_by_category;
+	std::unordered_map<std::string, uint64_t> m_shed_by_container;
+};
+
+}  // namespace libsinsp
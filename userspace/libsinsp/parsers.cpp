@@ -4623,262 +4623,269 @@ namespace
 	}
 }
 
-void sinsp_parser::parse_container_json_evt(sinsp_evt *evt)
+std::shared_ptr<sinsp_container_info> sinsp_parser::parse_container_json(const std::string& json, bool from_capture)
 {
-	ASSERT(m_inspector);
+	Json::Value root;
+	if(!Json::Reader().parse(json, root))
+	{
+		std::string errstr;
+		errstr = Json::Reader().getFormattedErrorMessages();
+		throw sinsp_exception("Invalid JSON encountered while parsing container info: " + json + "error=" + errstr);
+	}
 
-	if(evt->m_tinfo_ref != nullptr)
+	auto container_info = std::make_shared<sinsp_container_info>();
+	const Json::Value& container = root["container"];
+	const Json::Value& id = container["id"];
+	if(check_json_val_is_convertible(id, Json::stringValue, "id"))
 	{
-		const auto& container_id = evt->m_tinfo_ref->m_container_id;
-		const auto container = m_inspector->m_container_manager.get_container(container_id);
-		if(container != nullptr && container->is_successful())
-		{
-			SINSP_DEBUG("Ignoring container event for already successful lookup of %s", container_id.c_str());
-			evt->m_filtered_out = true;
-			return;
-		}
+		container_info->m_id = id.asString();
+	}
+	const Json::Value& full_id = container["full_id"];
+	if(check_json_val_is_convertible(full_id, Json::stringValue, "full_id"))
+	{
+		container_info->m_full_id = full_id.asString();
+	}
+	const Json::Value& type = container["type"];
+	if(check_json_val_is_convertible(type, Json::uintValue, "type"))
+	{
+		container_info->m_type = static_cast<sinsp_container_type>(type.asUInt());
+	}
+	const Json::Value& name = container["name"];
+	if(check_json_val_is_convertible(name, Json::stringValue, "name"))
+	{
+		container_info->m_name = name.asString();
 	}
 
-	sinsp_evt_param *parinfo = evt->get_param(0);
-	ASSERT(parinfo);
-	ASSERT(parinfo->m_len > 0);
-	std::string json(parinfo->m_val, parinfo->m_len);
-	SINSP_DEBUG("Parsing Container JSON=%s", json.c_str());
-	Json::Value root;
-	if(Json::Reader().parse(json, root))
+	const Json::Value& is_pod_sandbox = container["is_pod_sandbox"];
+	if(check_json_val_is_convertible(is_pod_sandbox, Json::booleanValue, "is_pod_sandbox"))
 	{
-		auto container_info = std::make_shared<sinsp_container_info>();
-		const Json::Value& container = root["container"];
-		const Json::Value& id = container["id"];
-		if(check_json_val_is_convertible(id, Json::stringValue, "id"))
-		{
-			container_info->m_id = id.asString();
-		}
-		const Json::Value& full_id = container["full_id"];
-		if(check_json_val_is_convertible(full_id, Json::stringValue, "full_id"))
-		{
-			container_info->m_full_id = full_id.asString();
-		}
-		const Json::Value& type = container["type"];
-		if(check_json_val_is_convertible(type, Json::uintValue, "type"))
-		{
-			container_info->m_type = static_cast<sinsp_container_type>(type.asUInt());
-		}
-		const Json::Value& name = container["name"];
-		if(check_json_val_is_convertible(name, Json::stringValue, "name"))
-		{
-			container_info->m_name = name.asString();
-		}
+		container_info->m_is_pod_sandbox = is_pod_sandbox.asBool();
+	}
 
-		const Json::Value& is_pod_sandbox = container["is_pod_sandbox"];
-		if(check_json_val_is_convertible(is_pod_sandbox, Json::booleanValue, "is_pod_sandbox"))
+	const Json::Value& image = container["image"];
+	if(check_json_val_is_convertible(image, Json::stringValue, "image"))
+	{
+		container_info->m_image = image.asString();
+	}
+	const Json::Value& imageid = container["imageid"];
+	if(check_json_val_is_convertible(imageid, Json::stringValue, "imageid"))
+	{
+		container_info->m_imageid = imageid.asString();
+	}
+	const Json::Value& imagerepo = container["imagerepo"];
+	if(check_json_val_is_convertible(imagerepo, Json::stringValue, "imagerepo"))
+	{
+		container_info->m_imagerepo = imagerepo.asString();
+	}
+	const Json::Value& imagetag = container["imagetag"];
+	if(check_json_val_is_convertible(imagetag, Json::stringValue, "imagetag"))
+	{
+		container_info->m_imagetag = imagetag.asString();
+	}
+	const Json::Value& imagedigest = container["imagedigest"];
+	if(check_json_val_is_convertible(imagedigest, Json::stringValue, "imagedigest"))
+	{
+		container_info->m_imagedigest = imagedigest.asString();
+	}
+	const Json::Value& privileged = container["privileged"];
+	if(check_json_val_is_convertible(privileged, Json::booleanValue, "privileged"))
+	{
+		container_info->m_privileged = privileged.asBool();
+	}
+	const Json::Value& lookup_state = container["lookup_state"];
+	if(check_json_val_is_convertible(lookup_state, Json::uintValue, "lookup_state"))
+	{
+		container_info->m_lookup_state = static_cast<sinsp_container_lookup_state>(lookup_state.asUInt());
+		switch(container_info->m_lookup_state)
 		{
-			container_info->m_is_pod_sandbox = is_pod_sandbox.asBool();
+		case sinsp_container_lookup_state::STARTED:
+		case sinsp_container_lookup_state::SUCCESSFUL:
+		case sinsp_container_lookup_state::FAILED:
+			break;
+		default:
+			container_info->m_lookup_state = sinsp_container_lookup_state::SUCCESSFUL;
 		}
 
-		const Json::Value& image = container["image"];
-		if(check_json_val_is_convertible(image, Json::stringValue, "image"))
-		{
-			container_info->m_image = image.asString();
-		}
-		const Json::Value& imageid = container["imageid"];
-		if(check_json_val_is_convertible(imageid, Json::stringValue, "imageid"))
-		{
-			container_info->m_imageid = imageid.asString();
-		}
-		const Json::Value& imagerepo = container["imagerepo"];
-		if(check_json_val_is_convertible(imagerepo, Json::stringValue, "imagerepo"))
-		{
-			container_info->m_imagerepo = imagerepo.asString();
-		}
-		const Json::Value& imagetag = container["imagetag"];
-		if(check_json_val_is_convertible(imagetag, Json::stringValue, "imagetag"))
-		{
-			container_info->m_imagetag = imagetag.asString();
-		}
-		const Json::Value& imagedigest = container["imagedigest"];
-		if(check_json_val_is_convertible(imagedigest, Json::stringValue, "imagedigest"))
-		{
-			container_info->m_imagedigest = imagedigest.asString();
-		}
-		const Json::Value& privileged = container["privileged"];
-		if(check_json_val_is_convertible(privileged, Json::booleanValue, "privileged"))
+		// state == STARTED doesn't make sense in a scap file
+		// as there's no actual lookup that would ever finish
+		if(from_capture && container_info->m_lookup_state == sinsp_container_lookup_state::STARTED)
 		{
-			container_info->m_privileged = privileged.asBool();
-		}
-		const Json::Value& lookup_state = container["lookup_state"];
-		if(check_json_val_is_convertible(lookup_state, Json::uintValue, "lookup_state"))
-		{
-			container_info->m_lookup_state = static_cast<sinsp_container_lookup_state>(lookup_state.asUInt());
-			switch(container_info->m_lookup_state)
-			{
-			case sinsp_container_lookup_state::STARTED:
-			case sinsp_container_lookup_state::SUCCESSFUL:
-			case sinsp_container_lookup_state::FAILED:
-				break;
-			default:
-				container_info->m_lookup_state = sinsp_container_lookup_state::SUCCESSFUL;
-			}
-
-			// state == STARTED doesn't make sense in a scap file
-			// as there's no actual lookup that would ever finish
-			if(!evt->m_tinfo_ref && container_info->m_lookup_state == sinsp_container_lookup_state::STARTED)
-			{
-				SINSP_DEBUG("Rewriting lookup_state = STARTED from scap file to FAILED for container %s",
-					container_info->m_id.c_str());
-				container_info->m_lookup_state = sinsp_container_lookup_state::FAILED;
-			}
+			SINSP_DEBUG("Rewriting lookup_state = STARTED from scap file to FAILED for container %s",
+				container_info->m_id.c_str());
+			container_info->m_lookup_state = sinsp_container_lookup_state::FAILED;
 		}
+	}
 
-		const Json::Value& created_time = container["created_time"];
-		if(check_int64_json_is_convertible(created_time, "created_time"))
-		{
-			container_info->m_created_time = created_time.asInt64();
-		}
+	const Json::Value& created_time = container["created_time"];
+	if(check_int64_json_is_convertible(created_time, "created_time"))
+	{
+		container_info->m_created_time = created_time.asInt64();
+	}
 
 #if !defined(MINIMAL_BUILD) && !defined(_WIN32)
-		libsinsp::container_engine::docker_async_source::parse_json_mounts(container["Mounts"], container_info->m_mounts);
+	libsinsp::container_engine::docker_async_source::parse_json_mounts(container["Mounts"], container_info->m_mounts);
 #endif
 
-		const Json::Value& user = container["User"];
-		if(check_json_val_is_convertible(user, Json::stringValue, "User"))
-		{
-			container_info->m_container_user = user.asString();
-		}
-
-		sinsp_container_info::container_health_probe::parse_health_probes(container, container_info->m_health_probes);
+	const Json::Value& user = container["User"];
+	if(check_json_val_is_convertible(user, Json::stringValue, "User"))
+	{
+		container_info->m_container_user = user.asString();
+	}
 
-		const Json::Value& contip = container["ip"];
-		if(check_json_val_is_convertible(contip, Json::stringValue, "ip"))
-		{
-			uint32_t ip;
+	sinsp_container_info::container_health_probe::parse_health_probes(container, container_info->m_health_probes);
 
-			if(inet_pton(AF_INET, contip.asString().c_str(), &ip) == -1)
-			{
-				throw sinsp_exception("Invalid 'ip' field while parsing container info: " + json);
-			}
+	const Json::Value& contip = container["ip"];
+	if(check_json_val_is_convertible(contip, Json::stringValue, "ip"))
+	{
+		uint32_t ip;
 
-			container_info->m_container_ip = ntohl(ip);
+		if(inet_pton(AF_INET, contip.asString().c_str(), &ip) == -1)
+		{
+			throw sinsp_exception("Invalid 'ip' field while parsing container info: " + json);
 		}
 
-		const Json::Value &port_mappings = container["port_mappings"];
+		container_info->m_container_ip = ntohl(ip);
+	}
+
+	const Json::Value &port_mappings = container["port_mappings"];
 
-		if(check_json_val_is_convertible(port_mappings, Json::arrayValue, "port_mappings"))
+	if(check_json_val_is_convertible(port_mappings, Json::arrayValue, "port_mappings"))
+	{
+		for (Json::Value::ArrayIndex i = 0; i != port_mappings.size(); i++)
 		{
-			for (Json::Value::ArrayIndex i = 0; i != port_mappings.size(); i++)
-			{
-				sinsp_container_info::container_port_mapping map;
-				const Json::Value &host_ip = port_mappings[i]["HostIp"];
-				// We log message for HostIp conversion failure at Warning level
-				if(check_json_val_is_convertible(host_ip, Json::intValue, "HostIp", true)) {
-					map.m_host_ip = host_ip.asInt();
-				}
-				const Json::Value& host_port = port_mappings[i]["HostPort"];
-				// We log message for HostPort conversion failure at Warning level
-				if(check_json_val_is_convertible(host_port, Json::intValue, "HostPort", true)) {
-					map.m_host_port = (uint16_t) host_port.asInt();
-				}
-				const Json::Value& container_port = port_mappings[i]["ContainerPort"];
-				// We log message for ContainerPort conversion failure at Warning level
-				if(check_json_val_is_convertible(container_port, Json::intValue, "ContainerPort", true)) {
-					map.m_container_port = (uint16_t) container_port.asInt();
-				}
-				container_info->m_port_mappings.push_back(map);
+			sinsp_container_info::container_port_mapping map;
+			const Json::Value &host_ip = port_mappings[i]["HostIp"];
+			// We log message for HostIp conversion failure at Warning level
+			if(check_json_val_is_convertible(host_ip, Json::intValue, "HostIp", true)) {
+				map.m_host_ip = host_ip.asInt();
 			}
+			const Json::Value& host_port = port_mappings[i]["HostPort"];
+			// We log message for HostPort conversion failure at Warning level
+			if(check_json_val_is_convertible(host_port, Json::intValue, "HostPort", true)) {
+				map.m_host_port = (uint16_t) host_port.asInt();
+			}
+			const Json::Value& container_port = port_mappings[i]["ContainerPort"];
+			// We log message for ContainerPort conversion failure at Warning level
+			if(check_json_val_is_convertible(container_port, Json::intValue, "ContainerPort", true)) {
+				map.m_container_port = (uint16_t) container_port.asInt();
+			}
+			container_info->m_port_mappings.push_back(map);
 		}
+	}
 
-		vector<string> labels = container["labels"].getMemberNames();
-		for(vector<string>::const_iterator it = labels.begin(); it != labels.end(); ++it)
-		{
-			string val = container["labels"][*it].asString();
-			container_info->m_labels[*it] = val;
-		}
+	vector<string> labels = container["labels"].getMemberNames();
+	for(vector<string>::const_iterator it = labels.begin(); it != labels.end(); ++it)
+	{
+		string val = container["labels"][*it].asString();
+		container_info->m_labels[*it] = val;
+	}
 
-		const Json::Value& env_vars = container["env"];
+	const Json::Value& env_vars = container["env"];
 
-		for(const auto& env_var : env_vars)
+	for(const auto& env_var : env_vars)
+	{
+		if(env_var.isString())
 		{
-			if(env_var.isString())
-			{
-				container_info->m_env.emplace_back(env_var.asString());
-			}
+			container_info->m_env.emplace_back(env_var.asString());
 		}
+	}
 
-		const Json::Value& memory_limit = container["memory_limit"];
-		if(check_int64_json_is_convertible(memory_limit, "memory_limit"))
-		{
-			container_info->m_memory_limit = memory_limit.asInt64();
-		}
+	const Json::Value& memory_limit = container["memory_limit"];
+	if(check_int64_json_is_convertible(memory_limit, "memory_limit"))
+	{
+		container_info->m_memory_limit = memory_limit.asInt64();
+	}
 
-		const Json::Value& swap_limit = container["swap_limit"];
-		if(check_int64_json_is_convertible(swap_limit, "swap_limit"))
-		{
-			container_info->m_swap_limit = swap_limit.asInt64();
-		}
+	const Json::Value& swap_limit = container["swap_limit"];
+	if(check_int64_json_is_convertible(swap_limit, "swap_limit"))
+	{
+		container_info->m_swap_limit = swap_limit.asInt64();
+	}
 
-		const Json::Value& cpu_shares = container["cpu_shares"];
-		if(check_int64_json_is_convertible(cpu_shares, "cpu_shares"))
-		{
-			container_info->m_cpu_shares = cpu_shares.asInt64();
-		}
+	const Json::Value& cpu_shares = container["cpu_shares"];
+	if(check_int64_json_is_convertible(cpu_shares, "cpu_shares"))
+	{
+		container_info->m_cpu_shares = cpu_shares.asInt64();
+	}
 
-		const Json::Value& cpu_quota = container["cpu_quota"];
-		if(check_int64_json_is_convertible(cpu_quota, "cpu_quota"))
-		{
-			container_info->m_cpu_quota = cpu_quota.asInt64();
-		}
+	const Json::Value& cpu_quota = container["cpu_quota"];
+	if(check_int64_json_is_convertible(cpu_quota, "cpu_quota"))
+	{
+		container_info->m_cpu_quota = cpu_quota.asInt64();
+	}
 
-		const Json::Value& cpu_period = container["cpu_period"];
-		if(check_int64_json_is_convertible(cpu_period, "cpu_period"))
-		{
-			container_info->m_cpu_period = cpu_period.asInt64();
-		}
+	const Json::Value& cpu_period = container["cpu_period"];
+	if(check_int64_json_is_convertible(cpu_period, "cpu_period"))
+	{
+		container_info->m_cpu_period = cpu_period.asInt64();
+	}
 
-		const Json::Value& cpuset_cpu_count = container["cpuset_cpu_count"];
-		if(check_json_val_is_convertible(cpuset_cpu_count, Json::intValue, "cpuset_cpu_count"))
-		{
-			container_info->m_cpuset_cpu_count = cpuset_cpu_count.asInt();
-		}
+	const Json::Value& cpuset_cpu_count = container["cpuset_cpu_count"];
+	if(check_json_val_is_convertible(cpuset_cpu_count, Json::intValue, "cpuset_cpu_count"))
+	{
+		container_info->m_cpuset_cpu_count = cpuset_cpu_count.asInt();
+	}
 
-		const Json::Value& mesos_task_id = container["mesos_task_id"];
-		if(check_json_val_is_convertible(mesos_task_id, Json::stringValue, "mesos_task_id"))
-		{
-			container_info->m_mesos_task_id = mesos_task_id.asString();
-		}
+	const Json::Value& mesos_task_id = container["mesos_task_id"];
+	if(check_json_val_is_convertible(mesos_task_id, Json::stringValue, "mesos_task_id"))
+	{
+		container_info->m_mesos_task_id = mesos_task_id.asString();
+	}
 
-		const Json::Value& metadata_deadline = container["metadata_deadline"];
-		if(!metadata_deadline.isNull())
-		{
-			// isConvertibleTo doesn't seem to work on large 64 bit numbers
-			if(metadata_deadline.isUInt64()) {
-				container_info->m_metadata_deadline = metadata_deadline.asUInt64();
-			} else {
-				SINSP_DEBUG("Unable to convert json value for field: %s", "metadata_deadline");
-			}
+	const Json::Value& metadata_deadline = container["metadata_deadline"];
+	if(!metadata_deadline.isNull())
+	{
+		// isConvertibleTo doesn't seem to work on large 64 bit numbers
+		if(metadata_deadline.isUInt64()) {
+			container_info->m_metadata_deadline = metadata_deadline.asUInt64();
+		} else {
+			SINSP_DEBUG("Unable to convert json value for field: %s", "metadata_deadline");
 		}
+	}
 
-		if(!container_info->is_successful())
+	return container_info;
+}
+
+void sinsp_parser::parse_container_json_evt(sinsp_evt *evt)
+{
+	ASSERT(m_inspector);
+
+	if(evt->m_tinfo_ref != nullptr)
+	{
+		const auto& container_id = evt->m_tinfo_ref->m_container_id;
+		const auto container = m_inspector->m_container_manager.get_container(container_id);
+		if(container != nullptr && container->is_successful())
 		{
-			SINSP_DEBUG("Filtering container event for failed lookup of %s (but calling callbacks anyway)", container_info->m_id.c_str());
+			SINSP_DEBUG("Ignoring container event for already successful lookup of %s", container_id.c_str());
 			evt->m_filtered_out = true;
+			return;
 		}
-		evt->m_tinfo_ref = container_info->get_tinfo(m_inspector);
-		evt->m_tinfo = evt->m_tinfo_ref.get();
-		m_inspector->m_container_manager.add_container(container_info, evt->get_thread_info(true));
-		/*
-		SINSP_STR_DEBUG("Container\n-------\nID:" + container_info.m_id +
-		                "\nType: " + std::to_string(container_info.m_type) +
-		                "\nName: " + container_info.m_name +
-		                "\nImage: " + container_info.m_image +
-		                "\nMesos Task ID: " + container_info.m_mesos_task_id);
-		*/
 	}
-	else
+
+	sinsp_evt_param *parinfo = evt->get_param(0);
+	ASSERT(parinfo);
+	ASSERT(parinfo->m_len > 0);
+	std::string json(parinfo->m_val, parinfo->m_len);
+	SINSP_DEBUG("Parsing Container JSON=%s", json.c_str());
+
+	// container events read from a scap file carry no thread
+	auto container_info = parse_container_json(json, evt->m_tinfo_ref == nullptr);
+
+	if(!container_info->is_successful())
 	{
-		std::string errstr;
-		errstr = Json::Reader().getFormattedErrorMessages();
-		throw sinsp_exception("Invalid JSON encountered while parsing container info: " + json + "error=" + errstr);
+		SINSP_DEBUG("Filtering container event for failed lookup of %s (but calling callbacks anyway)", container_info->m_id.c_str());
+		evt->m_filtered_out = true;
 	}
+	evt->m_tinfo_ref = container_info->get_tinfo(m_inspector);
+	evt->m_tinfo = evt->m_tinfo_ref.get();
+	m_inspector->m_container_manager.add_container(container_info, evt->get_thread_info(true));
+	/*
+	SINSP_STR_DEBUG("Container\n-------\nID:" + container_info.m_id +
+	                "\nType: " + std::to_string(container_info.m_type) +
+	                "\nName: " + container_info.m_name +
+	                "\nImage: " + container_info.m_image +
+	                "\nMesos Task ID: " + container_info.m_mesos_task_id);
+	*/
 }
 
 void sinsp_parser::parse_container_evt(sinsp_evt *evt)
@@ -133,6 +133,9 @@ private:
 	void parse_setgid_exit(sinsp_evt* evt);
 	void parse_container_evt(sinsp_evt* evt); // deprecated, only for backward-compatibility
 	void parse_container_json_evt(sinsp_evt *evt);
+	// from_capture: the container comes from a scap file (or any other
+	// source where a pending lookup will never complete)
+	static std::shared_ptr<sinsp_container_info> parse_container_json(const std::string& json, bool from_capture);
 	inline uint32_t parse_tracer(sinsp_evt *evt, int64_t retval);
 	void parse_cpu_hotplug_enter(sinsp_evt* evt);
 	int get_k8s_version(const std::string& json);
@@ -0,0 +1,155 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace libsinsp
+{
+
+//
+// A value that readers use without locks while writers replace it
+// (read-copy-update).
+//
+// The value is an atomic pointer. A reader announces itself in one of
+// two counters, picked by the parity of an epoch, before loading it,
+// and leaves when its read_guard goes away. publish() swaps the
+// pointer, then twice flips the epoch and waits for the readers of the
+// old parity to leave: from then on nobody can reference the old value,
+// which is deleted. Only the writers ever wait, so publish() must not
+// be called while holding a read_guard of the same object.
+//
+template<typename T>
+class read_copy_update
+{
+public:
+	//
+	// A read side critical section: the value stays valid until the
+	// guard goes away
+	//
+	class read_guard
+	{
+	public:
+		read_guard(const read_copy_update& rcu):
+			m_readers(rcu.m_readers[rcu.m_epoch & 1])
+		{
+			//
+			// The increment comes before the load of the value, so a
+			// writer that swapped the pointer before we loaded it
+			// waits for us, and one that didn't gave us the new value
+			//
+			m_readers++;
+			m_value = rcu.m_value;
+		}
+
+		~read_guard()
+		{
+			m_readers--;
+		}
+
+		read_guard(const read_guard&) = delete;
+		read_guard& operator=(const read_guard&) = delete;
+
+		T* get() const
+		{
+			return m_value;
+		}
+
+		T* operator->() const
+		{
+			return m_value;
+		}
+
+	private:
+		std::atomic<uint64_t>& m_readers;
+		T* m_value;
+	};
+
+	//
+	// The value is owned by the object, and can be NULL
+	//
+	read_copy_update(T* value = NULL):
+		m_value(value),
+		m_epoch(0)
+	{
+		m_readers[0] = 0;
+		m_readers[1] = 0;
+	}
+
+	~read_copy_update()
+	{
+		delete m_value.load();
+	}
+
+	read_copy_update(const read_copy_update&) = delete;
+	read_copy_update& operator=(const read_copy_update&) = delete;
+
+	//
+	// Replace the value, and delete the old one once no reader
+	// references it. Blocks for that long.
+	//
+	void publish(T* value)
+	{
+		std::lock_guard<std::mutex> guard(m_publish_mutex);
+
+		T* old = m_value.exchange(value);
+		synchronize();
+		delete old;
+	}
+
+private:
+	void synchronize()
+	{
+		//
+		// A reader that loaded the old value entered one of the counters
+		// before the swap, but it may have read the epoch before an
+		// earlier flip: drain both of them. The readers that enter a
+		// counter after it's drained can only load the new value.
+		//
+		for(uint32_t phase = 0; phase < 2; phase++)
+		{
+			uint32_t old_epoch = m_epoch++;
+			std::atomic<uint64_t>& readers = m_readers[old_epoch & 1];
+
+			for(uint32_t j = 0; readers != 0; j++)
+			{
+				if(j < 100)
+				{
+					std::this_thread::yield();
+				}
+				else
+				{
+					std::this_thread::sleep_for(std::chrono::microseconds(100));
+				}
+			}
+		}
+	}
+
+	std::atomic<T*> m_value;
+	std::atomic<uint32_t> m_epoch;
+	mutable std::atomic<uint64_t> m_readers[2];
+
+	// writers go one at a time
+	std::mutex m_publish_mutex;
+};
+
+}  // namespace libsinsp
@@ -0,0 +1,284 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <algorithm>
+#include <json/json.h>
+
+#include "sinsp.h"
+#include "filterchecks.h"
+#include "rule_profiler.h"
+
+using namespace libsinsp;
+
+///////////////////////////////////////////////////////////////////////////////
+// leaf_proxy
+///////////////////////////////////////////////////////////////////////////////
+
+//
+// Stands for a leaf check in the filter tree, and times it when the
+// evaluation of the rule is sampled
+//
+class rule_profiler::leaf_proxy : public gen_event_filter_check_proxy
+{
+public:
+	leaf_proxy(gen_event_filter_check* check, const bool& sampling, leaf_stats& stats):
+		gen_event_filter_check_proxy(check),
+		m_sampling(sampling),
+		m_stats(stats)
+	{
+	}
+
+	bool compare(gen_event* evt)
+	{
+		if(!m_sampling)
+		{
+			return m_check->compare(evt);
+		}
+
+		uint64_t start = rule_profiler::now();
+		bool res = m_check->compare(evt);
+		m_stats.m_cost += rule_profiler::now() - start;
+		m_stats.m_evaluations++;
+		return res;
+	}
+
+private:
+	const bool& m_sampling;
+	leaf_stats& m_stats;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+// cost_histogram
+///////////////////////////////////////////////////////////////////////////////
+
+rule_profiler::cost_histogram::cost_histogram():
+	m_buckets(NUM_BUCKETS, 0),
+	m_count(0)
+{
+}
+
+uint32_t rule_profiler::cost_histogram::bucket(uint64_t cost)
+{
+	if(cost < SUB_BUCKETS)
+	{
+		return (uint32_t)cost;
+	}
+
+	// the power of 2, then the next 2 bits
+	uint32_t exp = 63;
+	while((cost & (1ULL << exp)) == 0)
+	{
+		exp--;
+	}
+
+	return (exp - 1) * SUB_BUCKETS + (uint32_t)((cost >> (exp - 2)) & (SUB_BUCKETS - 1));
+}
+
+uint64_t rule_profiler::cost_histogram::bucket_upper_bound(uint32_t idx)
+{
+	if(idx < SUB_BUCKETS)
+	{
+		return idx;
+	}
+
+	uint32_t exp = idx / SUB_BUCKETS + 1;
+	uint64_t sub = idx % SUB_BUCKETS;
+
+	// wraps to UINT64_MAX for the last bucket
+	return (1ULL << exp) + ((sub + 1) << (exp - 2)) - 1;
+}
+
+void rule_profiler::cost_histogram::add(uint64_t cost)
+{
+	m_buckets[bucket(cost)]++;
+	m_count++;
+}
+
+uint64_t rule_profiler::cost_histogram::quantile(double q) const
+{
+	if(m_count == 0)
+	{
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t)(q * m_count);
+	if(rank >= m_count)
+	{
+		rank = m_count - 1;
+	}
+
+	uint64_t seen = 0;
+	for(uint32_t j = 0; j < NUM_BUCKETS; j++)
+	{
+		seen += m_buckets[j];
+		if(seen > rank)
+		{
+			return bucket_upper_bound(j);
+		}
+	}
+
+	return bucket_upper_bound(NUM_BUCKETS - 1);
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// rule_profiler
+///////////////////////////////////////////////////////////////////////////////
+
+uint64_t rule_profiler::rule_stats::get_cumulative_cost() const
+{
+	if(m_sampled == 0)
+	{
+		return 0;
+	}
+
+	return (uint64_t)((double)m_sampled_cost * m_evaluations / m_sampled);
+}
+
+rule_profiler::rule_profiler(uint32_t sampling_ratio):
+	m_sampling_ratio(sampling_ratio ? sampling_ratio : 1),
+	m_sampling(false)
+{
+}
+
+rule_profiler::~rule_profiler()
+{
+	//
+	// Put the checks back in the filters, where the proxies are now
+	//
+	for(const auto& installed : m_proxies)
+	{
+		bool found = installed.m_proxy->unlink(installed.m_expr);
+		ASSERT(found);
+		(void)found;
+		delete installed.m_proxy;
+	}
+}
+
+void rule_profiler::add_rule(uint32_t id, const std::string& name, gen_event_filter* filter)
+{
+	if(m_stats.size() <= id)
+	{
+		m_stats.resize(id + 1);
+		m_countdowns.resize(id + 1, 1);
+	}
+
+	rule_stats& stats = m_stats[id];
+	stats.m_name = name;
+	stats.m_evaluations = 0;
+	stats.m_matches = 0;
+	stats.m_sampled = 0;
+	stats.m_sampled_cost = 0;
+
+	wrap_leaves(filter->m_filter, stats);
+}
+
+void rule_profiler::wrap_leaves(gen_event_filter_expression* expr, rule_stats& stats)
+{
+	for(size_t j = 0; j < expr->m_checks.size(); j++)
+	{
+		gen_event_filter_check* chk = expr->m_checks[j];
+
+		gen_event_filter_expression* subexpr = dynamic_cast<gen_event_filter_expression*>(chk);
+		if(subexpr != NULL)
+		{
+			wrap_leaves(subexpr, stats);
+			continue;
+		}
+
+		std::string leaf_name = "unknown";
+		sinsp_filter_check* sinsp_chk = dynamic_cast<sinsp_filter_check*>(gen_event_filter_check_proxy::unwrap(chk));
+		if(sinsp_chk != NULL)
+		{
+			const filtercheck_field_info* info = sinsp_chk->get_field_info();
+			if(info != NULL)
+			{
+				leaf_name = info->m_name;
+			}
+		}
+
+		// the map never moves its values
+		leaf_stats& leaf = stats.m_leaves[leaf_name];
+		leaf.m_evaluations = 0;
+		leaf.m_cost = 0;
+
+		leaf_proxy* proxy = new leaf_proxy(chk, m_sampling, leaf);
+		expr->m_checks[j] = proxy;
+		m_proxies.push_back({expr, proxy});
+	}
+}
+
+void rule_profiler::reset()
+{
+	for(auto& stats : m_stats)
+	{
+		stats.m_evaluations = 0;
+		stats.m_matches = 0;
+		stats.m_sampled = 0;
+		stats.m_sampled_cost = 0;
+		stats.m_costs = cost_histogram();
+
+		for(auto& it : stats.m_leaves)
+		{
+			it.second.m_evaluations = 0;
+			it.second.m_cost = 0;
+		}
+	}
+}
+
+std::string rule_profiler::to_json() const
+{
+	std::vector<const rule_stats*> rules;
+	for(const auto& stats : m_stats)
+	{
+		if(!stats.m_name.empty())
+		{
+			rules.push_back(&stats);
+		}
+	}
+
+	std::stable_sort(rules.begin(), rules.end(),
+			 [](const rule_stats* a, const rule_stats* b)
+			 {
+				 return a->get_cumulative_cost() > b->get_cumulative_cost();
+			 });
+
+	Json::Value root(Json::arrayValue);
+	for(const rule_stats* stats : rules)
+	{
+		Json::Value rule;
+		rule["name"] = stats->m_name;
+		rule["evaluations"] = (Json::UInt64)stats->m_evaluations;
+		rule["matches"] = (Json::UInt64)stats->m_matches;
+		rule["sampled"] = (Json::UInt64)stats->m_sampled;
+		rule["cumulative_cost"] = (Json::UInt64)stats->get_cumulative_cost();
+		rule["p99_cost"] = (Json::UInt64)stats->m_costs.quantile(0.99);
+
+		Json::Value leaves(Json::objectValue);
+		for(const auto& it : stats->m_leaves)
+		{
+			Json::Value leaf;
+			leaf["evaluations"] = (Json::UInt64)it.second.m_evaluations;
+			leaf["cost"] = (Json::UInt64)it.second.m_cost;
+			leaves[it.first] = leaf;
+		}
+		rule["leaves"] = leaves;
+
+		root.append(rule);
+	}
+
+	return Json::FastWriter().write(root);
+}
@@ -0,0 +1,199 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "gen_filter.h"
+
+namespace libsinsp
+{
+
+//
+// Profiles the rules of a sinsp_evttype_filter.
+//
+// Every evaluation of a rule is counted, together with its result, and
+// one evaluation every sampling_ratio is timed, both as a whole and for
+// each leaf check of its filter. The costs are in CPU cycles on x86, and
+// in nanoseconds elsewhere; the cumulative cost of a rule is
+// extrapolated from its timed evaluations.
+//
+// To time the leaf checks, add_rule() wraps them in proxies inside the
+// filter tree. The proxies only forward the calls when the evaluation
+// isn't timed, and are taken out when the profiler is destroyed, in
+// their current position (see sinsp_filter_optimizer). They can wrap the
+// proxies of a sinsp_filter_optimizer, or be wrapped by them.
+//
+class rule_profiler
+{
+public:
+	//
+	// Log-linear histogram of costs: 4 buckets for every power of 2
+	//
+	struct cost_histogram
+	{
+		static const uint32_t SUB_BUCKETS = 4;
+		// the costs below SUB_BUCKETS have their own bucket
+		static const uint32_t NUM_BUCKETS = 63 * SUB_BUCKETS;
+
+		cost_histogram();
+
+		void add(uint64_t cost);
+
+		//
+		// The upper bound of the bucket holding the given quantile,
+		// 0 if the histogram is empty
+		//
+		uint64_t quantile(double q) const;
+
+		static uint32_t bucket(uint64_t cost);
+		static uint64_t bucket_upper_bound(uint32_t idx);
+
+		std::vector<uint64_t> m_buckets;
+		uint64_t m_count;
+	};
+
+	struct leaf_stats
+	{
+		// timed evaluations only
+		uint64_t m_evaluations;
+		uint64_t m_cost;
+	};
+
+	struct rule_stats
+	{
+		std::string m_name;
+		uint64_t m_evaluations;
+		uint64_t m_matches;
+		uint64_t m_sampled;
+		uint64_t m_sampled_cost;
+		cost_histogram m_costs;
+		// by field name
+		std::map<std::string, leaf_stats> m_leaves;
+
+		//
+		// The cost of all the evaluations, extrapolated from the
+		// timed ones
+		//
+		uint64_t get_cumulative_cost() const;
+	};
+
+	rule_profiler(uint32_t sampling_ratio = 100);
+	~rule_profiler();
+
+	//
+	// Profile the rule with the given handle, whose filter is filter
+	//
+	void add_rule(uint32_t id, const std::string& name, gen_event_filter* filter);
+
+	//
+	// Run the filter of a rule added with add_rule()
+	//
+	inline bool run(uint32_t id, gen_event_filter* filter, gen_event* evt)
+	{
+		rule_stats& stats = m_stats[id];
+		stats.m_evaluations++;
+
+		bool res;
+		if(--m_countdowns[id] != 0)
+		{
+			res = filter->run(evt);
+		}
+		else
+		{
+			m_countdowns[id] = m_sampling_ratio;
+			m_sampling = true;
+			uint64_t start = now();
+			res = filter->run(evt);
+			uint64_t cost = now() - start;
+			m_sampling = false;
+
+			stats.m_sampled++;
+			stats.m_sampled_cost += cost;
+			stats.m_costs.add(cost);
+		}
+
+		if(res)
+		{
+			stats.m_matches++;
+		}
+
+		return res;
+	}
+
+	//
+	// The statistics of the rules, by handle. The rules that weren't
+	// added have an empty name.
+	//
+	const std::vector<rule_stats>& get_stats() const
+	{
+		return m_stats;
+	}
+
+	void reset();
+
+	//
+	// The statistics of the rules as a JSON array, most expensive
+	// rules first
+	//
+	std::string to_json() const;
+
+	uint32_t get_sampling_ratio() const
+	{
+		return m_sampling_ratio;
+	}
+
+	static inline uint64_t now()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		return __rdtsc();
+#else
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+	}
+
+private:
+	class leaf_proxy;
+
+	struct installed_proxy
+	{
+		gen_event_filter_expression* m_expr;
+		leaf_proxy* m_proxy;
+	};
+
+	void wrap_leaves(gen_event_filter_expression* expr, rule_stats& stats);
+
+	uint32_t m_sampling_ratio;
+	std::vector<rule_stats> m_stats;
+	// evaluations before the next timed one, by handle
+	std::vector<uint32_t> m_countdowns;
+	// whether the current evaluation is timed
+	bool m_sampling;
+	std::vector<installed_proxy> m_proxies;
+};
+
+}  // namespace libsinsp
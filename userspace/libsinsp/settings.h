@@ -60,6 +60,19 @@ limitations under the License.
 //
 #define DEFAULT_INACTIVE_CONTAINER_SCAN_TIME_S 30
 
+//
+// How often the on-disk container metadata snapshot is rewritten
+// (only used when a snapshot path is configured)
+//
+#define DEFAULT_CONTAINER_SNAPSHOT_INTERVAL_S 60
+
+//
+// Oldest state snapshot loaded at startup: past this much of the
+// process table has usually changed, and scanning /proc again is
+// cheaper than reconciling it
+//
+#define DEFAULT_STATE_SNAPSHOT_MAX_AGE_S 600
+
 //
 // Default snaplen
 //
@@ -110,4 +123,6 @@ static const unsigned MAX_JSON_SIZE_B = 500 * 1024; // 500 kiB
 //
 #define K8S_DATA_MAX_B 100 * 1024 * 1024
 #define K8S_DATA_CHUNK_WAIT_US 1000
+// initial state lists are split into documents of (roughly) this size
+#define K8S_STATE_BATCH_B 256 * 1024
 #define METADATA_DATA_WATCH_FREQ_SEC 1
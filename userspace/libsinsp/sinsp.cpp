@@ -33,6 +33,11 @@ limitations under the License.
 #include "filter.h"
 #include "filterchecks.h"
 #include "cyclewriter.h"
+#include "async_dump_writer.h"
+#include "capture_index.h"
+#include "capture_merger.h"
+#include "heavy_hitters.h"
+#include "load_shedder.h"
 #include "protodecoder.h"
 #include "dns_manager.h"
 
@@ -87,6 +92,15 @@ sinsp::sinsp(bool static_container, const std::string static_id, const std::stri
 	m_inactive_container_scan_time_ns = DEFAULT_INACTIVE_CONTAINER_SCAN_TIME_S * ONE_SECOND_IN_NS;
 	m_cycle_writer = NULL;
 	m_write_cycling = false;
+	m_dump_writer = NULL;
+	m_load_shedder = NULL;
+	m_heavy_hitters = NULL;
+	m_event_source = NULL;
+	m_capture_index = NULL;
+	m_index_block_end = 0;
+	m_index_state_only = false;
+	m_index_state_block = 0;
+	m_index_state_next = 0;
 
 #ifdef HAS_FILTERING
 	m_filter = NULL;
@@ -132,6 +146,12 @@ sinsp::sinsp(bool static_container, const std::string static_id, const std::stri
 
 	m_proc_scan_timeout_ms = SCAP_PROC_SCAN_TIMEOUT_NONE;
 	m_proc_scan_log_interval_ms = SCAP_PROC_SCAN_LOG_NONE;
+	m_ring_buffer_size = SCAP_RING_BUFFER_SIZE_DEFAULT;
+	m_bpf_ringbuf = false;
+	m_state_snapshot_max_age_ms = DEFAULT_STATE_SNAPSHOT_MAX_AGE_S * 1000;
+	m_state_snapshot_loaded = false;
+	m_open_start_ns = 0;
+	m_first_enriched_evt_delay_ns = 0;
 
 	uint32_t evlen = sizeof(scap_evt) + 2 * sizeof(uint16_t) + 2 * sizeof(uint64_t);
 	m_meinfo.m_piscapevt = (scap_evt*)new char[evlen];
@@ -368,8 +388,12 @@ void sinsp::init()
 		}
 
 		//
-		// Rewind, reset the event count, and consume the exact number of events
+		// Rewind, reset the event count, and consume the exact number of
+		// events, without seeking through the index
 		//
+		libsinsp::capture_index* index = m_capture_index;
+		m_capture_index = NULL;
+
 		scap_fseek(m_h, off);
 		scap_event_reset_count(m_h);
 		for(uint32_t j = 0; j < ncnt; j++)
@@ -377,6 +401,10 @@ void sinsp::init()
 			sinsp_evt* tevt;
 			next(&tevt);
 		}
+
+		m_capture_index = index;
+		m_index_block_end = 0;
+		m_index_state_only = false;
 	}
 
 	if(is_capture() || m_filter_proc_table_when_saving == true)
@@ -455,11 +483,19 @@ void sinsp::open_live_common(uint32_t timeout_ms, scap_mode_t mode)
 
 	g_logger.log("starting live capture");
 
+	m_open_start_ns = sinsp_utils::get_current_time_ns();
+
 	//
 	// Reset the thread manager
 	//
 	m_thread_manager->clear();
 
+	//
+	// Restore the container table before the /proc scan resolves
+	// the containers of the existing threads
+	//
+	m_container_manager.load_snapshot();
+
 	//
 	// Start the capture
 	//
@@ -473,6 +509,10 @@ void sinsp::open_live_common(uint32_t timeout_ms, scap_mode_t mode)
 	oargs.debug_log_fn = &sinsp_scap_debug_log_fn;
 	oargs.proc_scan_timeout_ms = m_proc_scan_timeout_ms;
 	oargs.proc_scan_log_interval_ms = m_proc_scan_log_interval_ms;
+	oargs.ring_buffer_size = m_ring_buffer_size;
+	oargs.bpf_ringbuf = m_bpf_ringbuf;
+	oargs.state_snapshot = m_state_snapshot_path.empty() ? NULL : m_state_snapshot_path.c_str();
+	oargs.state_snapshot_max_age_ms = m_state_snapshot_max_age_ms;
 
 	if(!m_filter_proc_table_when_saving)
 	{
@@ -505,6 +545,8 @@ void sinsp::open_live_common(uint32_t timeout_ms, scap_mode_t mode)
 	scap_set_refresh_proc_table_when_saving(m_h, !m_filter_proc_table_when_saving);
 
 	init();
+
+	init_state_snapshot();
 }
 
 void sinsp::open(uint32_t timeout_ms)
@@ -524,11 +566,18 @@ void sinsp::open_nodriver()
 
 	g_logger.log("starting optimized sinsp");
 
+	m_open_start_ns = sinsp_utils::get_current_time_ns();
+
 	//
 	// Reset the thread manager
 	//
 	m_thread_manager->clear();
 
+	//
+	// Restore the container table, as in live captures
+	//
+	m_container_manager.load_snapshot();
+
 	//
 	// Start the capture
 	//
@@ -547,6 +596,10 @@ void sinsp::open_nodriver()
 	oargs.debug_log_fn = &sinsp_scap_debug_log_fn;
 	oargs.proc_scan_timeout_ms = m_proc_scan_timeout_ms;
 	oargs.proc_scan_log_interval_ms = m_proc_scan_log_interval_ms;
+	oargs.ring_buffer_size = m_ring_buffer_size;
+	oargs.bpf_ringbuf = m_bpf_ringbuf;
+	oargs.state_snapshot = m_state_snapshot_path.empty() ? NULL : m_state_snapshot_path.c_str();
+	oargs.state_snapshot_max_age_ms = m_state_snapshot_max_age_ms;
 
 	int32_t scap_rc;
 	m_h = scap_open(oargs, error, &scap_rc);
@@ -559,6 +612,8 @@ void sinsp::open_nodriver()
 	scap_set_refresh_proc_table_when_saving(m_h, !m_filter_proc_table_when_saving);
 
 	init();
+
+	init_state_snapshot();
 }
 
 int64_t sinsp::get_file_size(const std::string& fname, char *error)
@@ -692,6 +747,10 @@ void sinsp::open_int()
 	oargs.debug_log_fn = &sinsp_scap_debug_log_fn;
 	oargs.proc_scan_timeout_ms = m_proc_scan_timeout_ms;
 	oargs.proc_scan_log_interval_ms = m_proc_scan_log_interval_ms;
+	oargs.ring_buffer_size = m_ring_buffer_size;
+	oargs.bpf_ringbuf = m_bpf_ringbuf;
+	oargs.state_snapshot = NULL;
+	oargs.state_snapshot_max_age_ms = 0;
 
 	int32_t scap_rc;
 	m_h = scap_open(oargs, error, &scap_rc);
@@ -747,6 +806,11 @@ void sinsp::close()
 {
 	if(m_h)
 	{
+		if(is_live() || is_nodriver())
+		{
+			m_container_manager.write_snapshot();
+			write_state_snapshot();
+		}
 		scap_close(m_h);
 		m_h = NULL;
 	}
@@ -757,8 +821,20 @@ void sinsp::close()
 		m_dumper = NULL;
 	}
 
+	if(NULL != m_dump_writer)
+	{
+		//
+		// Waits for the pending data to be written
+		//
+		delete m_dump_writer;
+		m_dump_writer = NULL;
+	}
+
 	m_is_dumping = false;
 
+	// the container ids are meaningless to the next capture
+	m_suppressed_containers.clear();
+
 	if(NULL != m_network_interfaces)
 	{
 		delete m_network_interfaces;
@@ -787,6 +863,18 @@ void sinsp::autodump_start(const string& dump_filename, bool compress)
 		throw sinsp_exception("inspector not opened yet");
 	}
 
+	if(m_write_cycling)
+	{
+		if(m_dump_writer == NULL)
+		{
+			m_dump_writer = new libsinsp::async_dump_writer(this);
+		}
+
+		m_dump_writer->open(dump_filename, compress);
+		m_is_dumping = true;
+		return;
+	}
+
 	if(compress)
 	{
 		m_dumper = scap_dump_open(m_h, dump_filename.c_str(), SCAP_COMPRESSION_GZIP, false);
@@ -825,6 +913,11 @@ void sinsp::autodump_stop()
 		m_dumper = NULL;
 	}
 
+	if(m_dump_writer != NULL)
+	{
+		m_dump_writer->close();
+	}
+
 	m_is_dumping = false;
 }
 
@@ -933,6 +1026,171 @@ void sinsp::import_thread_table()
 	}
 }
 
+//
+// Add the threads of table that are not known yet, e.g. the ones of
+// the next file of a rolled capture
+//
+void sinsp::merge_thread_table(scap_threadinfo* table)
+{
+	scap_threadinfo *pi;
+	scap_threadinfo *tpi;
+	uint32_t nadded = 0;
+
+	HASH_ITER(hh, table, pi, tpi)
+	{
+		if(m_thread_manager->find_thread(pi->tid, true) != nullptr)
+		{
+			continue;
+		}
+
+		sinsp_threadinfo* newti = build_threadinfo();
+		newti->init(pi);
+		m_thread_manager->add_thread(newti, true);
+		nadded++;
+	}
+
+	if(nadded != 0)
+	{
+		m_thread_manager->recreate_child_dependencies();
+	}
+}
+
+void sinsp::set_capture_index(libsinsp::capture_index* index)
+{
+	m_capture_index = index;
+	m_index_block_end = 0;
+	m_index_state_only = false;
+}
+
+//
+// Called before reading each event. When the current block of the index
+// is over, seek to the next block that can match, or to the first event
+// changing the state of a block that can't, or past the indexed part of
+// the file if there's none.
+//
+void sinsp::seek_index_block()
+{
+	uint64_t pos = scap_ftell(m_h);
+
+	if(m_index_state_only)
+	{
+		if(seek_index_state_event(pos))
+		{
+			return;
+		}
+		pos = m_index_block_end;
+	}
+	else if(pos < m_index_block_end)
+	{
+		return;
+	}
+
+	const std::vector<libsinsp::capture_index::block>& blocks = m_capture_index->get_blocks();
+	uint64_t end_offset = m_capture_index->get_end_offset();
+	gen_event_filter_check* filter = NULL;
+#ifdef HAS_FILTERING
+	if(m_filter != NULL)
+	{
+		filter = m_filter->m_filter;
+	}
+#endif
+
+	int32_t j = m_capture_index->find_block(pos);
+	if(j < 0)
+	{
+		// before the first block
+		m_index_block_end = blocks.empty() ? UINT64_MAX : blocks[0].m_offset;
+		return;
+	}
+
+	if(end_offset != 0 && pos >= end_offset)
+	{
+		// after the indexed part of the file
+		m_index_block_end = UINT64_MAX;
+		return;
+	}
+
+	while((uint32_t)j < blocks.size() && !m_capture_index->may_match(blocks[j], filter))
+	{
+		//
+		// The threads, fds and containers of the block may be needed
+		// by the events of the next ones: parse the events changing
+		// them, but don't return them. The last block of an index
+		// that wasn't closed may be partial, it's read entirely below.
+		//
+		const std::vector<uint64_t>& offsets = blocks[j].m_state_offsets;
+		if(!offsets.empty() && offsets.back() >= pos &&
+		   ((uint32_t)j + 1 < blocks.size() || end_offset != 0))
+		{
+			m_index_state_only = true;
+			m_index_state_block = j;
+			m_index_state_next = 0;
+			break;
+		}
+
+		j++;
+	}
+
+	if((uint32_t)j == blocks.size())
+	{
+		if(end_offset == 0)
+		{
+			//
+			// The index wasn't closed: the last block may be missing
+			// events, read it anyway
+			//
+			j = (int32_t)blocks.size() - 1;
+		}
+		else
+		{
+			if(end_offset > pos)
+			{
+				scap_fseek(m_h, end_offset);
+			}
+			m_index_block_end = UINT64_MAX;
+			return;
+		}
+	}
+
+	m_index_block_end = (uint32_t)j + 1 < blocks.size() ? blocks[j + 1].m_offset :
+		end_offset != 0 ? end_offset : UINT64_MAX;
+
+	if(m_index_state_only)
+	{
+		seek_index_state_event(pos);
+	}
+	else if(blocks[j].m_offset > pos)
+	{
+		scap_fseek(m_h, blocks[j].m_offset);
+	}
+}
+
+//
+// In a block read only for its state, seek to the next event changing
+// the state, or to the end of the block after the last one
+//
+bool sinsp::seek_index_state_event(uint64_t pos)
+{
+	const std::vector<uint64_t>& offsets = m_capture_index->get_blocks()[m_index_state_block].m_state_offsets;
+
+	while(m_index_state_next < offsets.size())
+	{
+		uint64_t offset = offsets[m_index_state_next++];
+		if(offset >= pos)
+		{
+			if(offset > pos)
+			{
+				scap_fseek(m_h, offset);
+			}
+			return true;
+		}
+	}
+
+	m_index_state_only = false;
+	scap_fseek(m_h, m_index_block_end);
+	return false;
+}
+
 void sinsp::import_ifaddr_list()
 {
 	m_network_interfaces = new sinsp_network_interfaces(this);
@@ -1171,7 +1429,19 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		//
 		// Get the event from libscap
 		//
-		res = scap_next(m_h, &(evt->m_pevt), &(evt->m_cpuid));
+		if(m_capture_index != NULL && m_event_source == NULL && is_capture())
+		{
+			seek_index_block();
+		}
+
+		if(m_event_source != NULL)
+		{
+			res = m_event_source->next(&(evt->m_pevt), &(evt->m_cpuid));
+		}
+		else
+		{
+			res = scap_next(m_h, &(evt->m_pevt), &(evt->m_cpuid));
+		}
 
 		if(res != SCAP_SUCCESS)
 		{
@@ -1198,6 +1468,10 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 				return SCAP_TIMEOUT;
 
 			}
+			else if(m_event_source != NULL)
+			{
+				m_lasterr = m_event_source->get_lasterr();
+			}
 			else
 			{
 				m_lasterr = scap_getlasterr(m_h);
@@ -1281,6 +1555,7 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 	if(!is_capture())
 	{
 		m_container_manager.remove_inactive_containers();
+		m_container_manager.update_snapshot();
 
 #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
 		update_k8s_state();
@@ -1316,6 +1591,36 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 		m_fds_to_remove->clear();
 	}
 
+	//
+	// Shed the load before the state engine, which still sees all the
+	// events that change the state
+	//
+	if(m_load_shedder != NULL && evt == &m_evt)
+	{
+		if(m_load_shedder->fill_level_due(ts) && is_live())
+		{
+			uint64_t buf_size = scap_get_buf_size(m_h);
+
+			if(buf_size != 0)
+			{
+				m_load_shedder->update_fill_level((double)scap_max_buf_used(m_h) / buf_size, ts);
+			}
+		}
+
+		// the thread is only looked up while shedding
+		threadinfo_map_t::ptr_t tinfo;
+		if(m_load_shedder->is_shedding())
+		{
+			tinfo = m_thread_manager->find_thread(evt->get_tid(), true);
+		}
+
+		if(m_load_shedder->shed(evt, tinfo ? &tinfo->m_container_id : NULL))
+		{
+			*puevt = NULL;
+			return SCAP_TIMEOUT;
+		}
+	}
+
 #ifdef SIMULATE_DROP_MODE
 	bool sd = false;
 	bool sw = false;
@@ -1346,10 +1651,87 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 	m_parser->process_event(evt);
 #endif
 
+	if(!m_state_reconcile_tids.empty())
+	{
+		reconcile_state_snapshot(evt);
+	}
+
+	if(m_first_enriched_evt_delay_ns == 0 && m_open_start_ns != 0 &&
+	   (is_live() || is_nodriver()))
+	{
+		check_first_enriched_event(evt);
+	}
+
+	if(m_heavy_hitters != NULL && evt->m_tinfo != NULL)
+	{
+		libsinsp::heavy_hitters::entry offender;
+
+		m_heavy_hitters->add(evt->m_tinfo->m_tid, evt->m_tinfo->m_comm, evt->m_tinfo->m_container_id, ts);
+
+		while(m_heavy_hitters->pop_offender(&offender))
+		{
+			// an offender whose suppression keeps failing is only
+			// warned about the first time
+			sinsp_logger::severity sev = offender.m_failures == 0 ?
+				sinsp_logger::SEV_WARNING : sinsp_logger::SEV_DEBUG;
+
+			g_logger.format(sev,
+					"suppressing %s %s, %.0f events per second",
+					offender.m_type == libsinsp::heavy_hitters::KEY_TID ? "thread" :
+					offender.m_type == libsinsp::heavy_hitters::KEY_COMM ? "comm" : "container",
+					offender.m_key.c_str(), offender.m_rate);
+
+			switch(offender.m_type)
+			{
+			case libsinsp::heavy_hitters::KEY_TID:
+				if(!suppress_events_tid(std::stoll(offender.m_key)))
+				{
+					g_logger.format(sev,
+							"cannot suppress thread %s (attempt %u)",
+							offender.m_key.c_str(), offender.m_failures + 1);
+					m_heavy_hitters->retry(offender);
+				}
+				break;
+			case libsinsp::heavy_hitters::KEY_COMM:
+				if(!suppress_heavy_hitter_comm(offender.m_key, sev))
+				{
+					m_heavy_hitters->retry(offender);
+				}
+				break;
+			case libsinsp::heavy_hitters::KEY_CONTAINER:
+				// never blind the host
+				if(!offender.m_key.empty())
+				{
+					// lifted when the tracker could report it again,
+					// so that it's suppressed only while it's hot
+					suppress_events_container(offender.m_key,
+								  ts + m_heavy_hitters->get_report_expiry_ns());
+				}
+				break;
+			default:
+				break;
+			}
+		}
+	}
+
+	if(m_index_state_only)
+	{
+		*puevt = NULL;
+		return SCAP_TIMEOUT;
+	}
+
+	if(!m_suppressed_containers.empty() &&
+	   evt->m_tinfo != NULL &&
+	   check_suppressed_container(evt->m_tinfo->m_container_id, ts))
+	{
+		*puevt = NULL;
+		return SCAP_TIMEOUT;
+	}
+
 	//
 	// If needed, dump the event to file
 	//
-	if(NULL != m_dumper)
+	if(NULL != m_dumper || (NULL != m_dump_writer && m_dump_writer->is_open()))
 	{
 
 #if defined(HAS_FILTERING) && defined(HAS_CAPTURE_FILTERING)
@@ -1385,11 +1767,18 @@ int32_t sinsp::next(OUT sinsp_evt **puevt)
 
 		scap_evt* pdevt = (evt->m_poriginal_evt)? evt->m_poriginal_evt : evt->m_pevt;
 
-		res = scap_dump(m_h, m_dumper, pdevt, evt->m_cpuid, dflags);
-
-		if(SCAP_SUCCESS != res)
+		if(m_dump_writer != NULL && m_dump_writer->is_open())
 		{
-			throw sinsp_exception(scap_getlasterr(m_h));
+			m_dump_writer->dump(pdevt, evt->m_cpuid, dflags);
+		}
+		else
+		{
+			res = scap_dump(m_h, m_dumper, pdevt, evt->m_cpuid, dflags);
+
+			if(SCAP_SUCCESS != res)
+			{
+				throw sinsp_exception(scap_getlasterr(m_h));
+			}
 		}
 	}
 
@@ -1490,11 +1879,85 @@ bool sinsp::suppress_events_comm(const std::string &comm)
 	return true;
 }
 
+bool sinsp::suppress_heavy_hitter_comm(const std::string &comm, sinsp_logger::severity sev)
+{
+	//
+	// A suppressed comm only affects the processes spawned from now on:
+	// the ones already running with it are suppressed by tid
+	//
+	bool res = suppress_events_comm(comm);
+
+	if(!res)
+	{
+		g_logger.format(sev,
+				"cannot suppress comm %s (%zu comms already suppressed, at most %d)",
+				comm.c_str(), m_suppressed_comms.size(), SCAP_MAX_SUPPRESSED_COMMS);
+	}
+
+	std::vector<int64_t> tids;
+	m_thread_manager->get_threads()->loop([&] (sinsp_threadinfo& tinfo) {
+		if(tinfo.m_comm == comm)
+		{
+			tids.push_back(tinfo.m_tid);
+		}
+		return true;
+	});
+
+	for(int64_t tid : tids)
+	{
+		if(!suppress_events_tid(tid))
+		{
+			g_logger.format(sev,
+					"cannot suppress thread %" PRId64 " of comm %s",
+					tid, comm.c_str());
+		}
+	}
+
+	return res;
+}
+
 bool sinsp::check_suppressed(int64_t tid)
 {
 	return scap_check_suppressed_tid(m_h, tid);
 }
 
+bool sinsp::suppress_events_tid(int64_t tid)
+{
+	if(m_h == NULL)
+	{
+		return false;
+	}
+
+	return scap_suppress_tid(m_h, tid) == SCAP_SUCCESS;
+}
+
+void sinsp::suppress_events_container(const std::string& container_id, uint64_t expiry_ts)
+{
+	m_suppressed_containers[container_id] = expiry_ts;
+}
+
+bool sinsp::unsuppress_events_container(const std::string& container_id)
+{
+	return m_suppressed_containers.erase(container_id) != 0;
+}
+
+bool sinsp::check_suppressed_container(const std::string& container_id, uint64_t ts)
+{
+	auto it = m_suppressed_containers.find(container_id);
+	if(it == m_suppressed_containers.end())
+	{
+		return false;
+	}
+
+	if(ts < it->second)
+	{
+		return true;
+	}
+
+	m_suppressed_containers.erase(it);
+	return false;
+}
+
 void sinsp::add_suppressed_comms(scap_open_args &oargs)
 {
 	uint32_t i = 0;
@@ -1545,11 +2008,21 @@ void sinsp::set_cri_delay(uint64_t delay_ms)
 	m_container_manager.set_cri_delay(delay_ms);
 }
 
+void sinsp::set_container_lookup_concurrency(uint32_t lookup_concurrency)
+{
+	m_container_manager.set_lookup_concurrency(lookup_concurrency);
+}
+
 void sinsp::set_container_labels_max_len(uint32_t max_label_len)
 {
 	m_container_manager.set_container_labels_max_len(max_label_len);
 }
 
+void sinsp::set_container_snapshot(const std::string& path, uint64_t interval_ms)
+{
+	m_container_manager.set_snapshot_path(path, interval_ms * 1000000);
+}
+
 void sinsp::set_snaplen(uint32_t snaplen)
 {
 	//
@@ -1955,7 +2428,7 @@ bool sinsp::setup_cycle_writer(string base_file_name, int rollover_mb, int durat
 		m_write_cycling = true;
 	}
 
-	return m_cycle_writer->setup(base_file_name, rollover_mb, duration_seconds, file_limit, event_limit, &m_dumper);
+	return m_cycle_writer->setup(base_file_name, rollover_mb, duration_seconds, file_limit, event_limit, &m_dump_writer);
 }
 
 double sinsp::get_read_progress()
@@ -2418,6 +2891,180 @@ void sinsp::set_proc_scan_log_interval_ms(uint64_t val)
 	m_proc_scan_log_interval_ms = val;
 }
 
+void sinsp::set_ring_buffer_size(uint32_t val)
+{
+	m_ring_buffer_size = val;
+}
+
+void sinsp::set_bpf_ringbuf(bool val)
+{
+	m_bpf_ringbuf = val;
+}
+
+void sinsp::set_state_snapshot(const std::string& path, uint64_t max_age_ms)
+{
+	m_state_snapshot_path = path;
+	m_state_snapshot_max_age_ms = max_age_ms;
+	set_container_snapshot(path.empty() ? path : path + ".containers");
+}
+
+void sinsp::init_state_snapshot()
+{
+	m_state_snapshot_loaded = scap_state_snapshot_loaded(m_h);
+	m_state_reconcile_tids.clear();
+	m_first_enriched_evt_delay_ns = 0;
+
+	if(!m_state_snapshot_loaded)
+	{
+		return;
+	}
+
+	m_thread_manager->get_threads()->loop([&] (sinsp_threadinfo& tinfo) {
+		m_state_reconcile_tids.push_back(tinfo.m_tid);
+		return true;
+	});
+
+	g_logger.format(sinsp_logger::SEV_INFO,
+			"Restored %zu threads from state snapshot %s",
+			m_state_reconcile_tids.size(), m_state_snapshot_path.c_str());
+}
+
+void sinsp::write_state_snapshot()
+{
+	if(m_state_snapshot_path.empty())
+	{
+		return;
+	}
+
+	//
+	// The snapshot is a capture file without events, written aside and
+	// renamed so that a crash never leaves a truncated one behind
+	//
+	std::string tmp_path = m_state_snapshot_path + ".tmp";
+	scap_dumper_t* dumper = scap_state_snapshot_open(m_h, tmp_path.c_str());
+	if(dumper == NULL)
+	{
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"Cannot write state snapshot %s: %s",
+				tmp_path.c_str(), scap_getlasterr(m_h));
+		return;
+	}
+
+	try
+	{
+		m_thread_manager->dump_threads_to_file(dumper);
+	}
+	catch(const sinsp_exception& e)
+	{
+		scap_dump_close(dumper);
+		unlink(tmp_path.c_str());
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"Cannot write state snapshot %s: %s",
+				tmp_path.c_str(), e.what());
+		return;
+	}
+
+	scap_dump_close(dumper);
+
+	if(rename(tmp_path.c_str(), m_state_snapshot_path.c_str()) != 0)
+	{
+		unlink(tmp_path.c_str());
+		g_logger.format(sinsp_logger::SEV_WARNING,
+				"Cannot write state snapshot %s: %s",
+				m_state_snapshot_path.c_str(), strerror(errno));
+		return;
+	}
+
+	g_logger.format(sinsp_logger::SEV_INFO,
+			"Saved %u threads to state snapshot %s",
+			m_thread_manager->get_thread_count(), m_state_snapshot_path.c_str());
+}
+
+void sinsp::reconcile_state_snapshot(sinsp_evt* evt)
+{
+	//
+	// One restored thread per event, so that the checks against /proc
+	// never stall the event loop
+	//
+	int64_t tid = m_state_reconcile_tids.back();
+	m_state_reconcile_tids.pop_back();
+
+	//
+	// The event points to its thread, and possibly to an entry of the
+	// fd table of its process: check them later
+	//
+	if(evt->m_tinfo != NULL &&
+	   (tid == evt->m_tinfo->m_tid || tid == evt->m_tinfo->m_pid))
+	{
+		m_state_reconcile_tids.push_front(tid);
+		return;
+	}
+
+	threadinfo_map_t::ptr_t tinfo = m_thread_manager->find_thread(tid, true);
+	if(tinfo == nullptr)
+	{
+		// already gone
+	}
+	else if(!scap_is_thread_alive(m_h, tinfo->m_pid, tid, tinfo->m_comm.c_str()))
+	{
+		m_thread_manager->remove_thread(tid, false);
+	}
+	else if(tinfo->is_main_thread())
+	{
+		//
+		// The process may have opened and closed fds while we weren't
+		// looking: replace the restored fd table with the one in /proc
+		//
+		scap_threadinfo* scap_proc = scap_proc_read_fds(m_h, tid, true);
+		if(scap_proc != NULL)
+		{
+			scap_fdinfo* fdi;
+			scap_fdinfo* tfdi;
+			sinsp_fdinfo_t fdinfo;
+
+			tinfo->m_fdtable.clear();
+			tinfo->m_fdtable.reset_cache();
+			HASH_ITER(hh, scap_proc->fdlist, fdi, tfdi)
+			{
+				tinfo->add_fd_from_scap(fdi, &fdinfo);
+			}
+			scap_proc_free(m_h, scap_proc);
+		}
+	}
+
+	if(m_state_reconcile_tids.empty())
+	{
+		g_logger.log("state snapshot reconciled with /proc", sinsp_logger::SEV_DEBUG);
+	}
+}
+
+void sinsp::check_first_enriched_event(sinsp_evt* evt)
+{
+	sinsp_threadinfo* tinfo = evt->m_tinfo;
+
+	if(tinfo == NULL || tinfo->m_exe.empty())
+	{
+		return;
+	}
+
+	if(!tinfo->m_container_id.empty() &&
+	   m_container_manager.get_container(tinfo->m_container_id) == nullptr)
+	{
+		return;
+	}
+
+	m_first_enriched_evt_delay_ns = sinsp_utils::get_current_time_ns() - m_open_start_ns;
+	if(m_first_enriched_evt_delay_ns == 0)
+	{
+		m_first_enriched_evt_delay_ns = 1;
+	}
+
+	g_logger.format(sinsp_logger::SEV_INFO,
+			"First enriched event %" PRIu64 " ms after the open (state snapshot %s)",
+			m_first_enriched_evt_delay_ns / 1000000,
+			m_state_snapshot_loaded ? "used" : "not used");
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Note: this is defined here so we can inline it in sinso::next
 ///////////////////////////////////////////////////////////////////////////////
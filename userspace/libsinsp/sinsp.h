@@ -58,8 +58,10 @@ limitations under the License.
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <map>
 #include <queue>
+#include <deque>
 #include <vector>
 #include <set>
 #include <list>
@@ -102,6 +104,15 @@ class sinsp_parser;
 class sinsp_analyzer;
 class sinsp_filter;
 class cycle_writer;
+namespace libsinsp
+{
+class async_dump_writer;
+class capture_index;
+class capture_merger;
+class raw_event_source;
+class heavy_hitters;
+class load_shedder;
+}
 class sinsp_protodecoder;
 #if !defined(CYGWING_AGENT) && !defined(MINIMAL_BUILD)
 class k8s;
@@ -426,6 +437,62 @@ public:
 	 */
 	void set_proc_scan_log_interval_ms(uint64_t val);
 
+	/*!
+	 * \brief sets the size in bytes of each per-CPU ring buffer of the live
+	 *        captures opened from now on: a power of two.
+	 *        Value of SCAP_RING_BUFFER_SIZE_DEFAULT (default) means the size
+	 *        chosen by the driver.
+	 */
+	void set_ring_buffer_size(uint32_t val);
+
+	/*!
+	 * \brief when true, the live captures opened from now on with the
+	 *        BPF probe use the ring buffer shared by all the CPUs instead
+	 *        of the per-CPU perf buffers. Requires kernel 5.8 or later.
+	 *        The events of a thread are still in timestamp order, but
+	 *        events of different CPUs can be slightly out of order,
+	 *        since they are in the order they were submitted.
+	 */
+	void set_bpf_ringbuf(bool val);
+
+	/*!
+	 * \brief keep the thread, fd, user and interface tables in a
+	 *        snapshot file across restarts.
+	 *
+	 * \param path the snapshot file. An empty path (the default) disables
+	 *        the snapshot.
+	 * \param max_age_ms the snapshot is not loaded if it was written more
+	 *        than this ago, 0 means no limit.
+	 *
+	 * \note The snapshot is written by close() and loaded by the live and
+	 *       nodriver opens, which then skip the /proc scan. A snapshot
+	 *       written before the last reboot is never loaded. The restored
+	 *       threads are checked against /proc one per event: the dead ones
+	 *       are removed, and the fd tables of the live processes are read
+	 *       again from /proc. The container table goes to
+	 *       path.containers, see set_container_snapshot().
+	 */
+	void set_state_snapshot(const std::string& path,
+				uint64_t max_age_ms = DEFAULT_STATE_SNAPSHOT_MAX_AGE_S * 1000);
+
+	/*!
+	 * \brief true if the tables of the current capture were loaded from
+	 *        the state snapshot.
+	 */
+	bool is_state_snapshot_loaded() const
+	{
+		return m_state_snapshot_loaded;
+	}
+
+	/*!
+	 * \brief the time between the open and the first event whose thread
+	 *        and container were fully known, 0 if there wasn't one yet.
+	 */
+	uint64_t get_time_to_first_enriched_event_ns() const
+	{
+		return m_first_enriched_evt_delay_ns;
+	}
+
 
 	/*!
 	  \brief Start writing the captured events to file.
@@ -448,6 +515,10 @@ public:
 
  	/*!
 	  \brief Cycles the file pointer to a new capture file
+
+	  \note when \ref setup_cycle_writer() is used, the files are
+	   compressed, written, closed and created by a background thread;
+	   write errors are reported by the following calls to \ref next().
 	*/
 	void autodump_next_file();
 
@@ -557,6 +628,8 @@ public:
 	  \brief registers external event processor.
 	  After this, callbacks on libsinsp::event_processor will happen at
 	  the appropriate times. This registration must happen before calling open.
+	  To run a processor on its own thread, register a
+	  libsinsp::async_event_processor wrapping it.
 	*/
 	void register_external_event_processor(libsinsp::event_processor& processor)
 	{
@@ -568,6 +641,42 @@ public:
 		return m_external_event_processor;
 	}
 
+	/*!
+	  \brief registers a load shedder, that drops the events exceeding
+	  its budgets, before they are parsed, whenever the driver buffers
+	  get too full. The shedder must outlive the inspector, or be
+	  unregistered by passing NULL.
+	*/
+	void register_load_shedder(libsinsp::load_shedder* shedder)
+	{
+		m_load_shedder = shedder;
+	}
+
+	/*!
+	  \brief registers a heavy-hitter tracker, that counts the events
+	  of each thread, comm and container after they are parsed. The
+	  keys exceeding its rate limits are suppressed: threads with
+	  suppress_events_tid(), comms with suppress_events_comm() (and the
+	  threads already running with the comm with suppress_events_tid())
+	  and containers other than the host with suppress_events_container(),
+	  until the tracker could report them again (see
+	  heavy_hitters::set_report_expiry()).
+	  The tracker must outlive the inspector, or be unregistered by
+	  passing NULL.
+	*/
+	void register_heavy_hitters(libsinsp::heavy_hitters* hh)
+	{
+		m_heavy_hitters = hh;
+	}
+
+	/*!
+	  \brief uses the side index of the capture file being read to seek
+	  over the blocks of events that can't match the filter of the
+	  inspector, or the query of the index. The index must outlive the
+	  inspector, or be unregistered by passing NULL.
+	*/
+	void set_capture_index(libsinsp::capture_index* index);
+
 	/*!
 	  \brief Return the event and system call information tables.
 
@@ -935,6 +1044,19 @@ public:
 
 	bool check_suppressed(int64_t tid);
 
+	// Stop returning the events of the thread, see scap_suppress_tid()
+	bool suppress_events_tid(int64_t tid);
+
+	// Stop returning the events of the threads in the container until
+	// expiry_ts (forever by default), or until it's unsuppressed or
+	// removed. The events are still parsed, so that the state stays
+	// consistent.
+	void suppress_events_container(const std::string& container_id, uint64_t expiry_ts = UINT64_MAX);
+
+	// Return the events of the threads in the container again. Returns
+	// false if it wasn't suppressed.
+	bool unsuppress_events_container(const std::string& container_id);
+
 	void set_docker_socket_path(std::string socket_path);
 	void set_query_docker_image_info(bool query_image_info);
 
@@ -950,6 +1072,28 @@ public:
 	void set_cri_delay(uint64_t delay_ms);
 	void set_container_labels_max_len(uint32_t max_label_len);
 
+	/*!
+	  \brief Set how many metadata lookups each container engine (docker,
+	   CRI) runs at once. The default is 1. It must be called before the
+	   first container is looked up.
+	*/
+	void set_container_lookup_concurrency(uint32_t lookup_concurrency);
+
+	/*!
+	  \brief Keep an on-disk snapshot of the container metadata table.
+
+	  \param path the snapshot file. An empty path (the default) disables
+	   the snapshot.
+	  \param interval_ms how often the snapshot is rewritten during a
+	   live capture.
+
+	  \note The snapshot is loaded when a live capture is opened, so that
+	   container.* fields resolve immediately after a restart instead of
+	   waiting for every container runtime to be queried again.
+	*/
+	void set_container_snapshot(const std::string& path,
+				    uint64_t interval_ms = DEFAULT_CONTAINER_SNAPSHOT_INTERVAL_S * 1000);
+
 	uint64_t get_lastevent_ts() const { return m_lastevent_ts; }
 
 VISIBILITY_PROTECTED
@@ -974,6 +1118,9 @@ private:
 	void open_live_common(uint32_t timeout_ms, scap_mode_t mode);
 	void init();
 	void import_thread_table();
+	void merge_thread_table(scap_threadinfo* table);
+	void seek_index_block();
+	bool seek_index_state_event(uint64_t pos);
 	void import_ifaddr_list();
 	void import_user_list();
 	void add_protodecoders();
@@ -1013,6 +1160,20 @@ private:
 		scap_fseek(m_h, filepos);
 	}
 
+	void init_state_snapshot();
+	void write_state_snapshot();
+	void reconcile_state_snapshot(sinsp_evt* evt);
+	void check_first_enriched_event(sinsp_evt* evt);
+
+	// Suppress a heavy-hitter comm, and the threads that already have it,
+	// logging the failures with the given severity. False if the comm
+	// itself couldn't be suppressed.
+	bool suppress_heavy_hitter_comm(const std::string &comm, sinsp_logger::severity sev);
+
+	// Whether the events of the container are suppressed at ts. An
+	// expired suppression is lifted.
+	bool check_suppressed_container(const std::string& container_id, uint64_t ts);
+
 	void add_suppressed_comms(scap_open_args &oargs);
 
 	bool increased_snaplen_port_range_set() const
@@ -1176,10 +1337,35 @@ public:
 	unordered_map<uint32_t, scap_groupinfo*> m_grouplist;
 
 	//
-	// The cycle-writer for files
+	// The cycle-writer for files. When cycling, the files are written
+	// by m_dump_writer rather than m_dumper, so that rolling over
+	// doesn't block the event loop.
 	//
 	cycle_writer* m_cycle_writer;
 	bool m_write_cycling;
+	libsinsp::async_dump_writer* m_dump_writer;
+
+	libsinsp::load_shedder* m_load_shedder;
+	libsinsp::heavy_hitters* m_heavy_hitters;
+
+	//
+	// When set, the events come from here rather than from m_h, which
+	// only provides the tables of the capture
+	//
+	libsinsp::raw_event_source* m_event_source;
+
+	//
+	// Side index of the capture, the file position where the current
+	// block of the index ends, and whether that block is only read for
+	// the state it changes, from its m_index_state_next-th such event
+	//
+	libsinsp::capture_index* m_capture_index;
+	uint64_t m_index_block_end;
+	bool m_index_state_only;
+	int32_t m_index_state_block;
+	uint32_t m_index_state_next;
+	// container id -> timestamp at which the suppression is lifted
+	std::unordered_map<std::string, uint64_t> m_suppressed_containers;
 
 #ifdef SIMULATE_DROP_MODE
 	//
@@ -1236,6 +1422,19 @@ public:
 	//
 	uint64_t m_proc_scan_timeout_ms;
 	uint64_t m_proc_scan_log_interval_ms;
+	uint32_t m_ring_buffer_size;
+	bool m_bpf_ringbuf;
+
+	//
+	// State snapshot. m_state_reconcile_tids holds the restored threads
+	// still to be checked against /proc.
+	//
+	std::string m_state_snapshot_path;
+	uint64_t m_state_snapshot_max_age_ms;
+	bool m_state_snapshot_loaded;
+	std::deque<int64_t> m_state_reconcile_tids;
+	uint64_t m_open_start_ns;
+	uint64_t m_first_enriched_evt_delay_ns;
 
 	// Any thread with a comm in this set will not have its events
 	// returned in sinsp::next()
@@ -1250,6 +1449,9 @@ public:
 	friend class sinsp_thread_manager;
 	friend class sinsp_container_manager;
 	friend class sinsp_dumper;
+	friend class libsinsp::async_dump_writer;
+	friend class libsinsp::capture_index;
+	friend class libsinsp::capture_merger;
 	friend class sinsp_analyzer_fd_listener;
 	friend class sinsp_chisel;
 	friend class sinsp_tracerparser;
@@ -35,6 +35,7 @@ limitations under the License.
 #include "sinsp_auth.h"
 #include "http_reason.h"
 #include "json_query.h"
+#include "json_list_splitter.h"
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/socket.h>
@@ -99,6 +100,8 @@ public:
 			m_http_version(http_version),
 			m_data_limit(data_limit),
 			m_fetching_state(fetching_state),
+			m_state_splitter([this](std::string&& json) { m_json.emplace_back(std::move(json)); },
+				"items", K8S_STATE_BATCH_B),
 			m_data_max_b(data_max_b),
 			m_data_chunk_wait_us(data_chunk_wait_us)
 
@@ -231,6 +234,12 @@ public:
 		return m_wants_send;
 	}
 
+	// true until the initial state response has been fully received
+	bool is_fetching_state() const
+	{
+		return m_fetching_state;
+	}
+
 	void send_request()
 	{
 		m_wants_send = false; // no matter what happens, this is a one-shot
@@ -1458,6 +1467,7 @@ private:
 	{
 		std::string* m_data_buf = nullptr;
 		std::vector<std::string>* m_json = nullptr;
+		json_list_splitter* m_state_splitter = nullptr;
 		int* m_http_response = nullptr;
 		bool* m_msg_completed = nullptr;
 		bool* m_fetching_state = nullptr;
@@ -1472,17 +1482,23 @@ private:
 				if(data && len)
 				{
 					http_parser_data* parser_data = (http_parser_data*) parser->data;
-					if(parser_data->m_data_buf && parser_data->m_json)
+					if(parser_data->m_data_buf && parser_data->m_json && parser_data->m_state_splitter)
 					{
-						parser_data->m_data_buf->append(data, len);
-						// only try to parse this JSON if we are certain it is not pretty-printed
-						// since this logic relies on JSONs in the stream being delimited by newlines
-						// (and having no newlines themselves), pretty-printed JSONs can not be
-						// handled here, but must be handled in the http_msg_completed_callback()
+						// initial state may be huge (eg. all pods in a large cluster) and it may
+						// also be pretty-printed, so it is not buffered whole, but tokenized as it
+						// arrives and split into small list documents, which are posted as soon as
+						// they are complete
+						// watch JSONs in the stream are delimited by newlines (and have no newlines
+						// themselves), so they are simply split on newlines
 						if(parser_data->m_fetching_state)
 						{
-							if(!*(parser_data->m_fetching_state))
+							if(*(parser_data->m_fetching_state))
 							{
+								parser_data->m_state_splitter->feed(data, len);
+							}
+							else
+							{
+								parser_data->m_data_buf->append(data, len);
 								std::string::size_type pos = parser_data->m_data_buf->find('\n');
 								while(pos != std::string::npos)
 								{
@@ -1491,14 +1507,6 @@ private:
 									pos = parser_data->m_data_buf->find('\n');
 								}
 							}
-							/*else
-							{
-								if(g_logger.get_severity() >= sinsp_logger::SEV_TRACE)
-								{
-									g_logger.log("Socket handler (http_body_callback) data received, will be parsed on response end:" +
-												 *parser_data->m_data_buf, sinsp_logger::SEV_TRACE);
-								}
-							}*/
 						}
 					}
 					else { throw sinsp_exception("Socket handler (http_body_callback): http or json buffer is null."); }
@@ -1519,23 +1527,16 @@ private:
 			{
 				if(*(parser_data->m_fetching_state))
 				{
-					std::string* buf = parser_data->m_data_buf;
-					if(buf)
+					json_list_splitter* splitter = parser_data->m_state_splitter;
+					if(splitter)
 					{
-						std::string::size_type pos = buf->rfind('\n');
-						if(pos != std::string::npos)
-						{
-							buf->erase(std::remove_if(buf->begin(), buf->end(), [](char c){return c == '\n' || c == '\r';}), buf->end());
-							parser_data->m_json->emplace_back(std::move(*buf));
-							buf->clear();
-						}
-						else
+						if(!splitter->finish())
 						{
-							g_logger.log("Initial state fetch completed, but no newline found!", sinsp_logger::SEV_ERROR);
+							g_logger.log("Initial state fetch completed, but JSON is incomplete!", sinsp_logger::SEV_ERROR);
 						}
 						*(parser_data->m_fetching_state) = false;
 					}
-					else { throw sinsp_exception("Socket handler (http_msg_completed_callback): parser data m_data_buf is null."); }
+					else { throw sinsp_exception("Socket handler (http_msg_completed_callback): parser data m_state_splitter is null."); }
 				}
 			}
 			else { throw sinsp_exception("Socket handler (http_msg_completed_callback): parser data m_data_buf is null."); }
@@ -1567,6 +1568,8 @@ private:
 		}
 		m_http_parser_data.m_data_buf = &m_data_buf;
 		m_http_parser_data.m_json = &m_json;
+		m_http_parser_data.m_state_splitter = &m_state_splitter;
+		m_state_splitter.reset();
 		m_http_parser_data.m_http_response = &m_http_response;
 		m_http_parser_data.m_msg_completed = &m_msg_completed;
 		m_http_parser_data.m_fetching_state = &m_fetching_state;
@@ -1632,9 +1635,11 @@ private:
 	// some cluster-level URIs (eg. /api) do not honor this parameter;
 	//
 	// this flag is true by default and it remains true until the first state http
-	// request for this handler is completed, at which point all newlines are purged
-	// from the string and the purged buffer is posted for further processing
+	// request for this handler is completed; while it is true, data is fed to the
+	// state splitter, which tokenizes it (so newlines do not matter) and posts the
+	// state in small batches, without ever buffering the whole response
 	bool                     m_fetching_state = true;
+	json_list_splitter       m_state_splitter;
 
 	uint32_t m_data_max_b;
 	uint32_t m_data_chunk_wait_us;
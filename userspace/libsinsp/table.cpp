@@ -71,6 +71,139 @@ typedef struct table_row_cmp
 	bool m_ascending;
 }table_row_cmp;
 
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_table_map implementation
+///////////////////////////////////////////////////////////////////////////////
+#define SINSP_TABLE_MAP_INITIAL_SLOTS 1024
+
+sinsp_table_map::sinsp_table_map()
+{
+	m_slots.resize(SINSP_TABLE_MAP_INITIAL_SLOTS);
+	m_mask = SINSP_TABLE_MAP_INITIAL_SLOTS - 1;
+}
+
+uint32_t sinsp_table_map::hash(const uint8_t* val, uint32_t len)
+{
+	//
+	// 64 bit FNV-1a, folded to 32 bits so that the high bits, which are
+	// the best mixed ones, end up in the slot index too
+	//
+	uint64_t h = 14695981039346656037ULL;
+
+	for(uint32_t j = 0; j < len; j++)
+	{
+		h ^= val[j];
+		h *= 1099511628211ULL;
+	}
+
+	return (uint32_t)(h ^ (h >> 32));
+}
+
+sinsp_table_map::slot* sinsp_table_map::lookup(const sinsp_table_field& key, uint32_t hash)
+{
+	uint32_t pos = hash & m_mask;
+
+	while(true)
+	{
+		slot* s = &m_slots[pos];
+
+		if(s->m_row == 0)
+		{
+			return s;
+		}
+
+		if(s->m_hash == hash)
+		{
+			row* r = &m_rows[s->m_row - 1];
+
+			if(r->m_key.m_len == key.m_len &&
+				memcmp(r->m_key.m_val, key.m_val, key.m_len) == 0)
+			{
+				return s;
+			}
+		}
+
+		pos = (pos + 1) & m_mask;
+	}
+}
+
+sinsp_table_map::row* sinsp_table_map::find(const sinsp_table_field& key)
+{
+	slot* s = lookup(key, hash(key.m_val, key.m_len));
+
+	if(s->m_row == 0)
+	{
+		return NULL;
+	}
+
+	return &m_rows[s->m_row - 1];
+}
+
+sinsp_table_map::row* sinsp_table_map::get(const sinsp_table_field& key)
+{
+	uint32_t h = hash(key.m_val, key.m_len);
+	slot* s = lookup(key, h);
+
+	if(s->m_row != 0)
+	{
+		return &m_rows[s->m_row - 1];
+	}
+
+	//
+	// Keep the load factor below 1/2, so that probe sequences stay short
+	//
+	if((m_rows.size() + 1) * 2 > m_slots.size())
+	{
+		grow();
+		s = lookup(key, h);
+	}
+
+	row r;
+	r.m_key = key;
+	r.m_vals = NULL;
+	r.m_hash = h;
+	m_rows.push_back(r);
+
+	s->m_hash = h;
+	s->m_row = (uint32_t)m_rows.size();
+
+	return &m_rows.back();
+}
+
+void sinsp_table_map::grow()
+{
+	uint32_t nslots = (uint32_t)m_slots.size() * 2;
+
+	m_slots.assign(nslots, slot());
+	m_mask = nslots - 1;
+
+	for(uint32_t j = 0; j < m_rows.size(); j++)
+	{
+		uint32_t pos = m_rows[j].m_hash & m_mask;
+
+		while(m_slots[pos].m_row != 0)
+		{
+			pos = (pos + 1) & m_mask;
+		}
+
+		m_slots[pos].m_hash = m_rows[j].m_hash;
+		m_slots[pos].m_row = j + 1;
+	}
+}
+
+void sinsp_table_map::clear()
+{
+	if(m_rows.size() != 0)
+	{
+		m_slots.assign(m_slots.size(), slot());
+		m_rows.clear();
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// sinsp_table implementation
+///////////////////////////////////////////////////////////////////////////////
+
 sinsp_table::sinsp_table(sinsp* inspector, tabletype type, uint64_t refresh_interval_ns, 
 	sinsp_table::output_type output_type, uint32_t json_first_row, uint32_t json_last_row)
 {
@@ -97,6 +230,7 @@ sinsp_table::sinsp_table(sinsp* inspector, tabletype type, uint64_t refresh_inte
 	m_types = &m_premerge_types;
 	m_table = &m_premerge_table;
 	m_extractors = &m_premerge_extractors;
+	m_aggregations = &m_premerge_aggregations;
 	m_filter = NULL;
 	m_use_defaults = false;
 	m_zero_u64 = 0;
@@ -105,6 +239,15 @@ sinsp_table::sinsp_table(sinsp* inspector, tabletype type, uint64_t refresh_inte
 	m_sample_data = NULL;
 	m_json_first_row = json_first_row;
 	m_json_last_row = json_last_row;
+
+	if(m_output_type == sinsp_table::OT_JSON && m_json_last_row != 0)
+	{
+		m_sorting_limit = m_json_last_row + 1;
+	}
+	else
+	{
+		m_sorting_limit = 0;
+	}
 }
 
 sinsp_table::~sinsp_table()
@@ -243,6 +386,7 @@ void sinsp_table::configure(vector<sinsp_view_column_info>* entries, const strin
 	{
 		m_premerge_types.push_back((*it)->get_field_info()->m_type);
 		m_premerge_legend.push_back(*(*it)->get_field_info());
+		m_premerge_aggregations.push_back((*it)->m_aggregation);
 	}
 
 	m_premerge_vals_array_sz = (m_n_fields - 1) * sizeof(sinsp_table_field);
@@ -336,6 +480,7 @@ void sinsp_table::configure(vector<sinsp_view_column_info>* entries, const strin
 	{
 		m_postmerge_types.push_back((*it)->get_field_info()->m_type);
 		m_postmerge_legend.push_back(*(*it)->get_field_info());
+		m_postmerge_aggregations.push_back((*it)->m_merge_aggregation);
 	}
 
 	m_postmerge_vals_array_sz = (m_n_postmerge_fields - 1) * sizeof(sinsp_table_field);
@@ -347,51 +492,45 @@ void sinsp_table::add_row(bool merging)
 
 	sinsp_table_field key(m_fld_pointers[0].m_val, 
 		m_fld_pointers[0].m_len,
-		m_fld_pointers[0].m_cnt);
+		1);
 
 	if(m_type == sinsp_table::TT_TABLE)
 	{
 		//
 		// This is a table. Do a proper key lookup and update the entry
 		//
-		auto it = m_table->find(key);
+		sinsp_table_map::row* row = m_table->get(key);
 
-		if(it == m_table->end())
+		if(row->m_vals == NULL)
 		{
 			//
-			// New entry
+			// New entry. The values have already been copied into the
+			// buffer, with their lengths, by process_event() or, when
+			// merging, by the premerge rows.
 			//
-			key.m_val = key.m_val;
-			key.m_cnt = 1;
 			m_vals = (sinsp_table_field*)m_buffer->reserve(m_vals_array_sz);
 
 			for(j = 1; j < m_n_fields; j++)
 			{
-				uint32_t vlen = get_field_len(j);
 				m_vals[j - 1].m_val = m_fld_pointers[j].m_val;
-				m_vals[j - 1].m_len = vlen;
+				m_vals[j - 1].m_len = m_fld_pointers[j].m_len;
 				m_vals[j - 1].m_cnt = m_fld_pointers[j].m_cnt;
 			}
 
-			(*m_table)[key] = m_vals;
+			row->m_vals = m_vals;
 		}
 		else
 		{
 			//
 			// Existing entry
 			//
-			m_vals = it->second;
+			m_vals = row->m_vals;
+			sinsp_field_aggregation* aggregations = m_aggregations->data();
+			ASSERT(merging == (m_aggregations == &m_postmerge_aggregations));
 
 			for(j = 1; j < m_n_fields; j++)
 			{
-				if(merging)
-				{
-					add_fields(j, &m_fld_pointers[j], m_postmerge_extractors[j]->m_merge_aggregation);
-				}
-				else
-				{
-					add_fields(j, &m_fld_pointers[j], m_premerge_extractors[j]->m_aggregation);
-				}
+				add_fields(j, &m_fld_pointers[j], aggregations[j]);
 			}
 		}
 	}
@@ -563,6 +702,7 @@ void sinsp_table::flush(sinsp_evt* evt)
 				m_vals_array_sz = m_postmerge_vals_array_sz;
 				m_fld_pointers = m_postmerge_fld_pointers;
 				m_extractors = &m_postmerge_extractors;
+				m_aggregations = &m_postmerge_aggregations;
 			}
 
 			//
@@ -719,7 +859,7 @@ void sinsp_table::filter_sample()
 
 	m_filtered_sample_data.clear();
 
-	for(auto it : m_full_sample_data)
+	for(auto& it : m_full_sample_data)
 	{
 		for(uint32_t j = 0; j < it.m_values.size(); j++)
 		{
@@ -830,9 +970,23 @@ void sinsp_table::sort_sample()
 		uint32_t tyid = m_do_merging? m_sorting_col + 2 : m_sorting_col + 1;
 		cc.m_type = m_premerge_types[tyid];
 
-		sort(m_sample_data->begin(),
-			m_sample_data->end(),
-			cc);
+		if(m_sorting_limit != 0 && m_sorting_limit < m_sample_data->size())
+		{
+			//
+			// Only the top rows are going to be used, don't waste time
+			// ordering the rest of the sample
+			//
+			partial_sort(m_sample_data->begin(),
+				m_sample_data->begin() + m_sorting_limit,
+				m_sample_data->end(),
+				cc);
+		}
+		else
+		{
+			sort(m_sample_data->begin(),
+				m_sample_data->end(),
+				cc);
+		}
 	}
 }
 
@@ -894,6 +1048,7 @@ vector<sinsp_sample_row>* sinsp_table::get_sample(uint64_t time_delta)
 	m_vals_array_sz = m_premerge_vals_array_sz;
 	m_fld_pointers = m_premerge_fld_pointers;
 	m_extractors = &m_premerge_extractors;
+	m_aggregations = &m_premerge_aggregations;
 
 	return m_sample_data;
 }
@@ -974,8 +1129,6 @@ void sinsp_table::create_sample()
 	if(m_type == sinsp_table::TT_TABLE)
 	{
 		uint32_t j;
-		m_full_sample_data.clear();
-		sinsp_sample_row row;
 
 		//
 		// If merging is on, perform the merge and switch to the merged table 
@@ -994,15 +1147,15 @@ void sinsp_table::create_sample()
 					uint32_t col = m_groupby_columns[j];
 					if(col == 0)
 					{
-						pfld->m_val = it->first.m_val;
-						pfld->m_len = it->first.m_len;
-						pfld->m_cnt = it->first.m_cnt;
+						pfld->m_val = it->m_key.m_val;
+						pfld->m_len = it->m_key.m_len;
+						pfld->m_cnt = it->m_key.m_cnt;
 					}
 					else
 					{
-						pfld->m_val = it->second[col - 1].m_val;
-						pfld->m_len = it->second[col - 1].m_len;
-						pfld->m_cnt = it->second[col - 1].m_cnt;
+						pfld->m_val = it->m_vals[col - 1].m_val;
+						pfld->m_len = it->m_vals[col - 1].m_len;
+						pfld->m_cnt = it->m_vals[col - 1].m_cnt;
 					}
 				}
 
@@ -1015,21 +1168,16 @@ void sinsp_table::create_sample()
 		}
 
 		//
-		// Emit the table
+		// Emit the table. The rows of the previous sample are reused,
+		// so that their value vectors don't need to be reallocated.
 		//
-		for(auto it = m_table->begin(); it != m_table->end(); ++it)
-		{
-			row.m_key = it->first;
+		m_full_sample_data.resize(m_table->size());
 
-			row.m_values.clear();
-
-			sinsp_table_field* fields = it->second;
-			for(j = 0; j < m_n_fields - 1; j++)
-			{
-				row.m_values.push_back(fields[j]);
-			}
-
-			m_full_sample_data.push_back(row);
+		auto row = m_full_sample_data.begin();
+		for(auto it = m_table->begin(); it != m_table->end(); ++it, ++row)
+		{
+			row->m_key = it->m_key;
+			row->m_values.assign(it->m_vals, it->m_vals + m_n_fields - 1);
 		}
 	}
 	else
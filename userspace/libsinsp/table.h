@@ -122,21 +122,76 @@ private:
 	uint32_t m_storage_len;
 };
 
-struct sinsp_table_field_hasher
+//
+// Open addressing hash table mapping the keys of a sinsp_table to their
+// values. It doesn't own any data: the key bytes and the value arrays
+// live in the sinsp_table_buffer arena of the table, so the map only
+// stores pointers to them.
+//
+// Rows are kept in a dense vector, in insertion order, and the probe
+// array only contains the row index and the key hash, so lookups
+// rarely need to touch the key bytes and iterating over the rows is a
+// linear scan. clear() keeps the allocated memory, since the same
+// table is refilled at every sample.
+//
+class sinsp_table_map
 {
-  size_t operator()(const sinsp_table_field& k) const
-  {
-	  size_t h = 0;
-	  uint8_t* s = k.m_val;
-	  uint32_t len = k.m_len;
-
-	  while(--len)
-	  {
-		  h = h * 101 + (unsigned) *s++;
-	  }
-
-	  return h;  
-  }
+public:
+	struct row
+	{
+		sinsp_table_field m_key;
+		sinsp_table_field* m_vals;
+		uint32_t m_hash;
+	};
+
+	typedef vector<row>::iterator iterator;
+
+	sinsp_table_map();
+
+	//
+	// Returns the row with the given key, or NULL if it's not there
+	//
+	row* find(const sinsp_table_field& key);
+
+	//
+	// Returns the row with the given key, adding it if it's not there.
+	// New rows have m_vals set to NULL. The key is not copied, so its
+	// data must outlive the row.
+	//
+	row* get(const sinsp_table_field& key);
+
+	void clear();
+
+	uint32_t size() const
+	{
+		return (uint32_t)m_rows.size();
+	}
+
+	iterator begin()
+	{
+		return m_rows.begin();
+	}
+
+	iterator end()
+	{
+		return m_rows.end();
+	}
+
+	static uint32_t hash(const uint8_t* val, uint32_t len);
+
+private:
+	struct slot
+	{
+		uint32_t m_hash;
+		uint32_t m_row;		// index in m_rows + 1, 0 if the slot is empty
+	};
+
+	inline slot* lookup(const sinsp_table_field& key, uint32_t hash);
+	void grow();
+
+	vector<slot> m_slots;
+	vector<row> m_rows;
+	uint32_t m_mask;
 };
 
 class sinsp_table_buffer
@@ -247,6 +302,16 @@ public:
 	//
 	sinsp_table_field* search_in_sample(string text);
 	void sort_sample();
+	//
+	// Only sort the first limit rows of the sample (0, the default, means
+	// all of them). The remaining rows are still part of the sample, in no
+	// particular order. JSON output that stops at a given row sets this
+	// automatically.
+	//
+	void set_sorting_limit(uint32_t limit)
+	{
+		m_sorting_limit = limit;
+	}
 	vector<sinsp_sample_row>* get_sample(uint64_t time_delta);
 	vector<filtercheck_field_info>* get_legend()
 	{
@@ -313,9 +378,9 @@ private:
 	void print_json(vector<sinsp_sample_row>* sample_data, uint64_t time_delta);
 
 	sinsp* m_inspector;
-	unordered_map<sinsp_table_field, sinsp_table_field*, sinsp_table_field_hasher>* m_table;
-	unordered_map<sinsp_table_field, sinsp_table_field*, sinsp_table_field_hasher> m_premerge_table;
-	unordered_map<sinsp_table_field, sinsp_table_field*, sinsp_table_field_hasher> m_merge_table;
+	sinsp_table_map* m_table;
+	sinsp_table_map m_premerge_table;
+	sinsp_table_map m_merge_table;
 	vector<filtercheck_field_info> m_premerge_legend;
 	vector<sinsp_filter_check*> m_premerge_extractors;
 	vector<sinsp_filter_check*> m_postmerge_extractors;
@@ -323,6 +388,13 @@ private:
 	vector<sinsp_filter_check*> m_chks_to_free;
 	vector<ppm_param_type> m_premerge_types;
 	vector<ppm_param_type> m_postmerge_types;
+	//
+	// Aggregation of each column, copied out of the extractors so that
+	// add_row() can walk them without touching the filter checks
+	//
+	vector<sinsp_field_aggregation>* m_aggregations;
+	vector<sinsp_field_aggregation> m_premerge_aggregations;
+	vector<sinsp_field_aggregation> m_postmerge_aggregations;
 	bool m_is_key_present;
 	bool m_is_groupby_key_present;
 	vector<uint32_t> m_groupby_columns;
@@ -345,6 +417,7 @@ private:
 	vector<sinsp_sample_row>* m_sample_data;
 	sinsp_table_field* m_vals;
 	int32_t m_sorting_col;
+	uint32_t m_sorting_limit;
 	bool m_just_sorted;
 	bool m_is_sorting_ascending;
 	bool m_do_merging;
@@ -0,0 +1,121 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// the test times the synchronous dumper, which needs the scap handle
+#define VISIBILITY_PRIVATE
+
+#include "async_dump_writer.h"
+#include "capture_test_utils.h"
+#include <gtest.h>
+
+namespace
+{
+std::string file_name(int n)
+{
+	return capture_file_name("async_dump_writer", n);
+}
+
+// the writer takes scap events, all with the same timestamp here
+scap_evt* scap_event(generic_event& evt, uint16_t native_id)
+{
+	return evt.get(native_id, 1234567890)->m_pevt;
+}
+}
+
+TEST(async_dump_writer, rollover)
+{
+	sinsp inspector;
+	generic_event evt;
+	const uint16_t nevts = 20000;
+
+	inspector.open_nodriver();
+
+	//
+	// The synchronous rollover: close the file and open a new one,
+	// scanning /proc for the tables
+	//
+	uint64_t start = sinsp_utils::get_current_time_ns();
+	scap_dumper_t* dumper = scap_dump_open(inspector.m_h, file_name(0).c_str(), SCAP_COMPRESSION_GZIP, false);
+	ASSERT_NE(nullptr, dumper);
+	scap_dump_close(dumper);
+	uint64_t sync_open_ns = sinsp_utils::get_current_time_ns() - start;
+
+	{
+		// small chunks, so that most of them are written in the background
+		libsinsp::async_dump_writer writer(&inspector, 4096, 4);
+
+		EXPECT_THROW(writer.dump(scap_event(evt, 0), 0, 0), sinsp_exception);
+
+		writer.open(file_name(1), true);
+		for(uint16_t j = 0; j < nevts; j++)
+		{
+			writer.dump(scap_event(evt, j), 0, 0);
+		}
+
+		writer.open(file_name(2), false);
+		for(uint16_t j = 0; j < nevts; j++)
+		{
+			writer.dump(scap_event(evt, nevts - j), 1, 0);
+		}
+
+		writer.flush();
+		EXPECT_GT(writer.written_bytes(), 0);
+
+		libsinsp::async_dump_writer::stats stats = writer.get_stats();
+		EXPECT_EQ(2u, stats.m_n_files);
+		EXPECT_GT(stats.m_n_chunks, 2u);
+
+		RecordProperty("sync_rollover_us", (int)(sync_open_ns / 1000));
+		RecordProperty("async_rollover_us", (int)(stats.m_max_open_ns / 1000));
+	}
+
+	inspector.close();
+
+	std::vector<uint16_t> evts = read_events(file_name(1));
+	ASSERT_EQ(nevts, evts.size());
+	for(uint16_t j = 0; j < nevts; j++)
+	{
+		ASSERT_EQ(j, evts[j]);
+	}
+
+	evts = read_events(file_name(2));
+	ASSERT_EQ(nevts, evts.size());
+	for(uint16_t j = 0; j < nevts; j++)
+	{
+		ASSERT_EQ(nevts - j, evts[j]);
+	}
+
+	for(int j = 0; j < 3; j++)
+	{
+		unlink(file_name(j).c_str());
+	}
+}
+
+TEST(async_dump_writer, open_error)
+{
+	sinsp inspector;
+	generic_event evt;
+
+	inspector.open_nodriver();
+
+	libsinsp::async_dump_writer writer(&inspector);
+	writer.open("/nonexistent/async_dump_writer_test", true);
+
+	// the error is reported by the writer thread
+	EXPECT_THROW(writer.flush(), sinsp_exception);
+	EXPECT_THROW(writer.dump(scap_event(evt, 0), 0, 0), sinsp_exception);
+}
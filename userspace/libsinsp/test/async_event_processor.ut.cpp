@@ -0,0 +1,257 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// the test builds events by hand
+#define VISIBILITY_PRIVATE
+
+#include "async_event_processor.h"
+#include "capture_test_utils.h"
+#include "container_test_utils.h"
+#include <gtest.h>
+#include <mutex>
+#include <condition_variable>
+
+using namespace libsinsp;
+
+namespace
+{
+//
+// Records the evtnum and first parameter of every event, and the
+// thread and fd it refers to, optionally waiting for a gate to open
+// before processing each one
+//
+class recording_processor : public event_processor
+{
+public:
+	void on_capture_start() override {}
+	void add_chisel_metric(statsd_metric* metric) override {}
+
+	void process_event(sinsp_evt* evt, event_return rc) override
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond.wait(lock, [this]() { return m_open; });
+		if(evt)
+		{
+			m_evtnums.push_back(evt->get_num());
+			m_values.push_back(std::string(evt->get_param(0)->m_val));
+			if(evt->m_tinfo != NULL)
+			{
+				m_comms.push_back(evt->m_tinfo->m_comm);
+				m_cwds.push_back(evt->m_tinfo->get_cwd());
+
+				sinsp_threadinfo* main_tinfo = evt->m_tinfo->get_main_thread();
+				sinsp_threadinfo* ptinfo = main_tinfo ? main_tinfo->get_parent_thread() : NULL;
+				m_parent_comms.push_back(ptinfo ? ptinfo->m_comm : "");
+
+				sinsp_container_info::ptr_t container = evt->m_tinfo->get_container_info();
+				m_container_names.push_back(container ? container->m_name : "");
+			}
+			if(evt->m_fdinfo != NULL)
+			{
+				m_fdnames.push_back(evt->m_fdinfo->m_name);
+			}
+		}
+		else
+		{
+			m_returns.push_back(rc);
+		}
+	}
+
+	void set_open(bool open)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_open = open;
+		m_cond.notify_all();
+	}
+
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	bool m_open = true;
+	std::vector<uint64_t> m_evtnums;
+	std::vector<std::string> m_values;
+	std::vector<std::string> m_comms;
+	std::vector<std::string> m_cwds;
+	std::vector<std::string> m_parent_comms;
+	std::vector<std::string> m_container_names;
+	std::vector<std::string> m_fdnames;
+	std::vector<event_return> m_returns;
+};
+
+//
+// The event numbered num, in the single event that is reused for every
+// one, like the one sinsp::next() hands out
+//
+sinsp_evt* next(container_json_event& source, uint64_t num)
+{
+	source.set_json("evt" + std::to_string(num), num);
+	sinsp_evt* evt = source.get(num);
+	// parameters are loaded from the event buffer, which is reused
+	evt->get_param(0);
+	return evt;
+}
+}
+
+TEST(async_event_processor, block)
+{
+	sinsp inspector;
+	container_json_event source(&inspector);
+	recording_processor processor;
+	async_event_processor async(processor, 4, async_event_processor::BP_BLOCK);
+
+	for(uint64_t j = 0; j < 100; j++)
+	{
+		async.process_event(next(source, j), EVENT_RETURN_NONE);
+	}
+	async.process_event(NULL, EVENT_RETURN_EOF);
+	async.flush();
+
+	ASSERT_EQ(100u, processor.m_evtnums.size());
+	for(uint64_t j = 0; j < 100; j++)
+	{
+		EXPECT_EQ(j, processor.m_evtnums[j]);
+		EXPECT_EQ("evt" + std::to_string(j), processor.m_values[j]);
+	}
+	ASSERT_EQ(1u, processor.m_returns.size());
+	EXPECT_EQ(EVENT_RETURN_EOF, processor.m_returns[0]);
+
+	async_event_processor::stats stats = async.get_stats();
+	EXPECT_EQ(100u, stats.m_n_enqueued);
+	EXPECT_EQ(100u, stats.m_n_processed);
+	EXPECT_EQ(0u, stats.m_n_dropped);
+	EXPECT_LE(stats.m_max_queue_depth, 4u);
+}
+
+TEST(async_event_processor, drop)
+{
+	sinsp inspector;
+	container_json_event source(&inspector);
+	recording_processor processor;
+	async_event_processor async(processor, 4, async_event_processor::BP_DROP);
+
+	processor.set_open(false);
+	for(uint64_t j = 0; j < 100; j++)
+	{
+		async.process_event(next(source, j), EVENT_RETURN_NONE);
+	}
+	// timeouts are dropped too when the queue is full
+	async.process_event(NULL, EVENT_RETURN_TIMEOUT);
+
+	async_event_processor::stats stats = async.get_stats();
+	// the worker may already hold one event
+	EXPECT_GE(stats.m_n_enqueued, 4u);
+	EXPECT_LE(stats.m_n_enqueued, 5u);
+	EXPECT_EQ(100u, stats.m_n_enqueued + stats.m_n_dropped);
+	EXPECT_EQ(4u, stats.m_queue_depth);
+
+	processor.set_open(true);
+	async.flush();
+	EXPECT_EQ(stats.m_n_enqueued, processor.m_evtnums.size());
+	EXPECT_EQ(0u, processor.m_evtnums[0]);
+	EXPECT_TRUE(processor.m_returns.empty());
+}
+
+TEST(async_event_processor, sample)
+{
+	sinsp inspector;
+	container_json_event source(&inspector);
+	recording_processor processor;
+	async_event_processor async(processor, 100, async_event_processor::BP_SAMPLE, 10);
+
+	processor.set_open(false);
+	for(uint64_t j = 0; j < 150; j++)
+	{
+		async.process_event(next(source, j), EVENT_RETURN_NONE);
+	}
+
+	// half of the queue fills up, then one event every 10 is queued
+	async_event_processor::stats stats = async.get_stats();
+	EXPECT_EQ(150u, stats.m_n_enqueued + stats.m_n_sampled_out + stats.m_n_dropped);
+	EXPECT_GE(stats.m_n_enqueued, 55u);
+	EXPECT_LE(stats.m_n_enqueued, 61u);
+	EXPECT_EQ(0u, stats.m_n_dropped);
+
+	processor.set_open(true);
+	async.stop();
+	EXPECT_EQ(stats.m_n_enqueued, processor.m_evtnums.size());
+	for(size_t j = 1; j < processor.m_evtnums.size(); j++)
+	{
+		EXPECT_LT(processor.m_evtnums[j - 1], processor.m_evtnums[j]);
+	}
+}
+
+TEST(async_event_processor, thread_snapshot)
+{
+	sinsp inspector;
+
+	inspector.m_container_manager.add_container(make_container("c0ffee"), nullptr);
+
+	sinsp_threadinfo* ptinfo = new sinsp_threadinfo(&inspector);
+	ptinfo->m_tid = 50;
+	ptinfo->m_pid = 50;
+	ptinfo->m_comm = "shell";
+	inspector.m_thread_manager->add_thread(ptinfo, false);
+
+	sinsp_threadinfo* main_tinfo = new sinsp_threadinfo(&inspector);
+	main_tinfo->m_tid = 100;
+	main_tinfo->m_pid = 100;
+	main_tinfo->m_ptid = 50;
+	main_tinfo->m_comm = "main";
+	main_tinfo->m_cwd = "/old/";
+	main_tinfo->m_container_id = "c0ffee";
+	inspector.m_thread_manager->add_thread(main_tinfo, false);
+
+	sinsp_threadinfo* tinfo = new sinsp_threadinfo(&inspector);
+	tinfo->m_tid = 101;
+	tinfo->m_pid = 100;
+	tinfo->m_comm = "worker";
+	tinfo->m_container_id = "c0ffee";
+	sinsp_fdinfo_t fdinfo;
+	fdinfo.m_type = SCAP_FD_FILE_V2;
+	fdinfo.m_name = "/tmp/old";
+	sinsp_fdinfo_t* live_fdinfo = tinfo->add_fd(3, &fdinfo);
+	inspector.m_thread_manager->add_thread(tinfo, false);
+
+	container_json_event source(&inspector);
+	recording_processor processor;
+	async_event_processor async(processor, 4, async_event_processor::BP_BLOCK);
+
+	processor.set_open(false);
+	sinsp_evt* evt = next(source, 0);
+	evt->m_tinfo = tinfo;
+	evt->m_fdinfo = live_fdinfo;
+	async.process_event(evt, EVENT_RETURN_NONE);
+
+	// the capture thread keeps updating the live state
+	tinfo->m_comm = "renamed";
+	main_tinfo->m_cwd = "/new/";
+	live_fdinfo->m_name = "/tmp/new";
+	inspector.m_thread_manager->remove_thread(50, true);
+	auto renamed = std::make_shared<sinsp_container_info>(*make_container("c0ffee"));
+	renamed->m_name = "renamed";
+	inspector.m_container_manager.add_container(renamed, nullptr);
+
+	processor.set_open(true);
+	async.flush();
+
+	ASSERT_EQ(1u, processor.m_comms.size());
+	EXPECT_EQ("worker", processor.m_comms[0]);
+	EXPECT_EQ("/old/", processor.m_cwds[0]);
+	ASSERT_EQ(1u, processor.m_fdnames.size());
+	EXPECT_EQ("/tmp/old", processor.m_fdnames[0]);
+	EXPECT_EQ("shell", processor.m_parent_comms[0]);
+	EXPECT_EQ("name-c0ffee", processor.m_container_names[0]);
+}
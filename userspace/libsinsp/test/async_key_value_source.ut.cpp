@@ -0,0 +1,120 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "async_key_value_source.h"
+#include <gtest.h>
+
+namespace
+{
+//
+// Looks up the length of its keys, slowly
+//
+class slow_source : public sysdig::async_key_value_source<std::string, size_t>
+{
+public:
+	slow_source():
+		async_key_value_source(NO_WAIT_LOOKUP, 10000),
+		m_in_flight(0),
+		m_max_in_flight(0)
+	{
+	}
+
+	~slow_source()
+	{
+		stop();
+	}
+
+	std::atomic<uint32_t> m_in_flight;
+	std::atomic<uint32_t> m_max_in_flight;
+
+protected:
+	void run_impl() override
+	{
+		std::string key;
+
+		while(dequeue_next_key(key))
+		{
+			EXPECT_LT(get_worker_id(), get_max_concurrency());
+
+			uint32_t n = ++m_in_flight;
+			uint32_t max = m_max_in_flight;
+			while(n > max && !m_max_in_flight.compare_exchange_weak(max, n))
+			{
+			}
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+			m_in_flight--;
+			store_value(key, key.size());
+		}
+	}
+};
+}
+
+TEST(async_key_value_source, concurrent_lookups)
+{
+	slow_source source;
+	source.set_max_concurrency(4);
+
+	std::mutex mtx;
+	std::map<std::string, size_t> results;
+	auto cb = [&](const std::string& key, const size_t& value)
+	{
+		std::lock_guard<std::mutex> guard(mtx);
+		results[key] = value;
+	};
+
+	for(uint32_t j = 0; j < 8; j++)
+	{
+		size_t value;
+		EXPECT_FALSE(source.lookup(std::string(j + 1, 'x'), value, cb));
+	}
+
+	for(uint32_t j = 0; j < 100; j++)
+	{
+		{
+			std::lock_guard<std::mutex> guard(mtx);
+			if(results.size() == 8)
+			{
+				break;
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	}
+
+	std::lock_guard<std::mutex> guard(mtx);
+	ASSERT_EQ(8u, results.size());
+	for(const auto& it : results)
+	{
+		EXPECT_EQ(it.first.size(), it.second);
+	}
+
+	EXPECT_GT(source.m_max_in_flight, 1u);
+	EXPECT_LE(source.m_max_in_flight, 4u);
+
+	auto lookup_latency = source.get_lookup_latency();
+	EXPECT_EQ(8u, lookup_latency.m_count);
+	EXPECT_GE(lookup_latency.m_max_ms, 50u);
+	EXPECT_EQ(0u, lookup_latency.m_buckets[0]);
+	uint64_t total = 0;
+	for(uint64_t count : lookup_latency.m_buckets)
+	{
+		total += count;
+	}
+	EXPECT_EQ(8u, total);
+	EXPECT_EQ(8u, source.get_queue_latency().m_count);
+}
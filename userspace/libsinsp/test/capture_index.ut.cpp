@@ -0,0 +1,580 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// the test builds events by hand
+#define VISIBILITY_PRIVATE
+
+#include "capture_index.h"
+#include "capture_test_utils.h"
+#include <gtest.h>
+
+using libsinsp::capture_index;
+
+namespace
+{
+std::string file_name()
+{
+	return capture_file_name("capture_index");
+}
+
+//
+// Write a capture with 100 PPME_GENERIC_E events, the j-th one from tid
+// 1000 + j / 10 at (j + 1) microseconds, indexed in blocks of 10
+//
+void write_capture(const std::string& name)
+{
+	sinsp inspector;
+	inspector.open_nodriver();
+	generic_event evt(&inspector);
+
+	sinsp_dumper dumper(&inspector);
+	dumper.enable_index(10);
+	dumper.open(name, false, true);
+	for(uint16_t j = 0; j < 100; j++)
+	{
+		dumper.dump(evt.get(j, (j + 1) * 1000, 1000 + j / 10));
+	}
+	dumper.close();
+	inspector.close();
+}
+
+//
+// The timestamps of the events returned by an open inspector
+//
+std::vector<uint64_t> read_timestamps(sinsp& inspector)
+{
+	std::vector<uint64_t> res;
+
+	while(true)
+	{
+		sinsp_evt* evt;
+		int32_t rc = inspector.next(&evt);
+
+		if(rc == SCAP_EOF)
+		{
+			break;
+		}
+
+		EXPECT_NE(SCAP_FAILURE, rc);
+		if(rc == SCAP_SUCCESS)
+		{
+			res.push_back(evt->get_ts());
+		}
+	}
+
+	return res;
+}
+
+//
+// Writes the events of a thread, one microsecond apart
+//
+class syscall_writer
+{
+public:
+	syscall_writer(sinsp* inspector, sinsp_dumper* dumper):
+		m_inspector(inspector),
+		m_dumper(dumper),
+		m_generic(inspector),
+		m_ts(0),
+		m_nevts(0)
+	{
+	}
+
+	void dump(sinsp_evt* evt)
+	{
+		m_dumper->dump(evt);
+		m_nevts++;
+	}
+
+	uint64_t next_ts()
+	{
+		m_ts += 1000;
+		return m_ts;
+	}
+
+	void open(int64_t tid, int64_t fd, const std::string& path)
+	{
+		uint32_t zero = 0;
+		param_event enter(m_inspector, PPME_SYSCALL_OPEN_E);
+		param_event exit(m_inspector, PPME_SYSCALL_OPEN_X);
+		exit.add(fd).add(path).add(zero).add(zero).add(zero);
+
+		dump(enter.get(next_ts(), tid));
+		dump(exit.get(next_ts(), tid));
+	}
+
+	void close(int64_t tid, int64_t fd)
+	{
+		int64_t res = 0;
+		param_event enter(m_inspector, PPME_SYSCALL_CLOSE_E);
+		param_event exit(m_inspector, PPME_SYSCALL_CLOSE_X);
+		enter.add(fd);
+		exit.add(res);
+
+		dump(enter.get(next_ts(), tid));
+		dump(exit.get(next_ts(), tid));
+	}
+
+	void io(int64_t tid, uint16_t type, int64_t fd)
+	{
+		uint32_t size = 4;
+		int64_t res = 4;
+		param_event enter(m_inspector, type);
+		param_event exit(m_inspector, type + 1);
+		enter.add(fd).add(size);
+		exit.add(res).add("data", 4);
+
+		dump(enter.get(next_ts(), tid));
+		dump(exit.get(next_ts(), tid));
+	}
+
+	//
+	// A file opened, read and written, among other syscalls, then
+	// closed: one in seven events changes the state
+	//
+	void file_cycle(int64_t tid, int64_t fd, const std::string& path)
+	{
+		open(tid, fd, path);
+		for(uint32_t j = 0; j < 3; j++)
+		{
+			io(tid, PPME_SYSCALL_READ_E, fd);
+			io(tid, PPME_SYSCALL_WRITE_E, fd);
+			for(uint32_t k = 0; k < 4; k++)
+			{
+				dump(m_generic.get((uint16_t)k, next_ts(), tid));
+			}
+		}
+		close(tid, fd);
+	}
+
+	uint64_t get_nevts() const
+	{
+		return m_nevts;
+	}
+
+private:
+	sinsp* m_inspector;
+	sinsp_dumper* m_dumper;
+	generic_event m_generic;
+	uint64_t m_ts;
+	uint64_t m_nevts;
+};
+}
+
+TEST(capture_index, write_and_build)
+{
+	std::string name = file_name();
+	write_capture(name);
+
+	capture_index index;
+	index.load(capture_index::default_path(name));
+
+	const std::vector<capture_index::block>& blocks = index.get_blocks();
+	ASSERT_EQ(10u, blocks.size());
+	EXPECT_NE(0u, index.get_end_offset());
+
+	for(uint32_t j = 0; j < blocks.size(); j++)
+	{
+		EXPECT_EQ(10u, blocks[j].m_nevts);
+		EXPECT_EQ((j * 10 + 1) * 1000, blocks[j].m_start_ts);
+		EXPECT_EQ((j * 10 + 10) * 1000, blocks[j].m_end_ts);
+		ASSERT_EQ(1u, blocks[j].m_tids.size());
+		EXPECT_EQ(1000 + j, blocks[j].m_tids[0]);
+		if(j != 0)
+		{
+			EXPECT_GT(blocks[j].m_offset, blocks[j - 1].m_offset);
+			EXPECT_EQ((int32_t)j, index.find_block(blocks[j].m_offset + 1));
+		}
+	}
+	EXPECT_EQ(-1, index.find_block(blocks[0].m_offset - 1));
+
+	//
+	// Building the index from the capture gives the same blocks
+	//
+	std::string built_name = name + ".built";
+	capture_index::build(name, built_name, 10);
+
+	capture_index built;
+	built.load(built_name);
+	ASSERT_EQ(blocks.size(), built.get_blocks().size());
+	EXPECT_EQ(index.get_end_offset(), built.get_end_offset());
+	for(uint32_t j = 0; j < blocks.size(); j++)
+	{
+		EXPECT_EQ(blocks[j].m_offset, built.get_blocks()[j].m_offset);
+		EXPECT_EQ(blocks[j].m_start_ts, built.get_blocks()[j].m_start_ts);
+		EXPECT_EQ(blocks[j].m_evttypes, built.get_blocks()[j].m_evttypes);
+	}
+
+	remove(name.c_str());
+	remove(capture_index::default_path(name).c_str());
+	remove(built_name.c_str());
+}
+
+TEST(capture_index, skip_blocks)
+{
+	std::string name = file_name();
+	write_capture(name);
+
+	capture_index index;
+	index.load(capture_index::default_path(name));
+
+	//
+	// With a filter on the time, only the blocks that can match are
+	// read, and the filter keeps the matching events of those
+	//
+	{
+		sinsp inspector;
+		inspector.set_capture_index(&index);
+		inspector.open(name);
+		inspector.set_filter("evt.rawtime >= 45000 and evt.rawtime < 62000");
+
+		std::vector<uint16_t> ids = read_events(inspector);
+		ASSERT_EQ(17u, ids.size());
+		EXPECT_EQ(44, ids.front());
+		EXPECT_EQ(60, ids.back());
+		inspector.close();
+	}
+
+	//
+	// With a query on the threads, whole blocks of other threads are
+	// skipped without a filter
+	//
+	{
+		capture_index::query q;
+		q.m_tids.insert(1002);
+		q.m_tids.insert(1007);
+		index.set_query(q);
+
+		sinsp inspector;
+		inspector.set_capture_index(&index);
+		inspector.open(name);
+
+		std::vector<uint16_t> ids = read_events(inspector);
+		ASSERT_EQ(20u, ids.size());
+		EXPECT_EQ(20, ids[0]);
+		EXPECT_EQ(29, ids[9]);
+		EXPECT_EQ(70, ids[10]);
+		EXPECT_EQ(79, ids[19]);
+		inspector.close();
+	}
+
+	//
+	// A filter that can't match any block reads nothing
+	//
+	{
+		index.clear_query();
+
+		sinsp inspector;
+		inspector.set_capture_index(&index);
+		inspector.open(name);
+		inspector.set_filter("evt.type = open or thread.tid = 5");
+
+		EXPECT_TRUE(read_events(inspector).empty());
+		inspector.close();
+	}
+
+	remove(name.c_str());
+	remove(capture_index::default_path(name).c_str());
+}
+
+TEST(capture_index, state_of_skipped_blocks)
+{
+	std::string name = file_name();
+	std::string index_name = capture_index::default_path(name);
+	int64_t parent = getpid();
+	int64_t child = 2000000000;
+
+	//
+	// The parent clones a first child in an lxc container, for which a
+	// container event is added when reading the capture, and generates
+	// events 1-8. Then it clones the child in the same container and
+	// generates events 10-18, which leaves the container out of that
+	// block. Events 19-28 are from the child.
+	//
+	{
+		sinsp inspector;
+		inspector.open_nodriver();
+		generic_event evt(&inspector);
+		clone_event first_clone(&inspector, parent, child + 1, "/lxc/web");
+		clone_event clone(&inspector, parent, child, "/lxc/web");
+
+		sinsp_dumper dumper(&inspector);
+		dumper.open(name, false, true);
+		for(uint16_t j = 0; j < 29; j++)
+		{
+			uint64_t ts = (j + 1) * 1000;
+
+			if(j == 0)
+			{
+				dumper.dump(first_clone.get(ts));
+			}
+			else if(j == 9)
+			{
+				dumper.dump(clone.get(ts));
+			}
+			else
+			{
+				dumper.dump(evt.get(j, ts, j < 19 ? parent : child));
+			}
+		}
+		dumper.close();
+		inspector.close();
+	}
+
+	capture_index::build(name, index_name, 10);
+
+	capture_index index;
+	index.load(index_name);
+	const std::vector<capture_index::block>& blocks = index.get_blocks();
+	ASSERT_EQ(3u, blocks.size());
+	EXPECT_EQ(1u, blocks[0].m_state_offsets.size());
+	EXPECT_EQ(1u, blocks[1].m_state_offsets.size());
+	EXPECT_TRUE(blocks[2].m_state_offsets.empty());
+	EXPECT_EQ(std::vector<std::string>({""}), blocks[1].m_containers);
+	EXPECT_EQ(std::vector<std::string>({"web"}), blocks[2].m_containers);
+
+	//
+	// The block of the clone can't match, but the clone is replayed: the
+	// child is found in its container
+	//
+	{
+		sinsp inspector;
+		inspector.set_capture_index(&index);
+		inspector.open(name);
+		inspector.set_filter("container.id = web");
+
+		std::vector<uint16_t> ids = read_events(inspector);
+		ASSERT_EQ(10u, ids.size());
+		EXPECT_EQ(19, ids.front());
+		EXPECT_EQ(28, ids.back());
+		inspector.close();
+	}
+
+	//
+	// Without a filter, the events of the blocks read only for their
+	// state are not returned
+	//
+	{
+		capture_index::query q;
+		q.m_containers.insert("web");
+		index.set_query(q);
+
+		sinsp inspector;
+		inspector.set_capture_index(&index);
+		inspector.open(name);
+
+		std::vector<uint16_t> ids = read_events(inspector);
+		ASSERT_EQ(18u, ids.size());
+		EXPECT_EQ(1, ids.front());
+		EXPECT_EQ(8, ids[7]);
+		EXPECT_EQ(19, ids[8]);
+		EXPECT_EQ(28, ids.back());
+		inspector.close();
+	}
+
+	remove(name.c_str());
+	remove(index_name.c_str());
+}
+
+TEST(capture_index, state_events_of_skipped_blocks)
+{
+	std::string name = file_name();
+	std::string index_name = capture_index::default_path(name);
+	int64_t parent = getpid();
+	int64_t child = 2000000000;
+	uint64_t nevts;
+
+	//
+	// A host process goes through its files. Along the way it opens a
+	// log and clones a child in an lxc container, which inherits the
+	// log and writes to it near the end of the capture.
+	//
+	{
+		sinsp inspector;
+		inspector.open_nodriver();
+		sinsp_dumper dumper(&inspector);
+		dumper.open(name, false, true);
+		syscall_writer writer(&inspector, &dumper);
+		clone_event clone(&inspector, parent, child, "/lxc/web");
+
+		for(uint32_t j = 0; j < 10; j++)
+		{
+			writer.file_cycle(parent, 10, "/tmp/host." + std::to_string(j));
+		}
+		writer.open(parent, 5, "/data/log");
+		for(uint32_t j = 10; j < 20; j++)
+		{
+			writer.file_cycle(parent, 10, "/tmp/host." + std::to_string(j));
+		}
+		writer.dump(clone.get(writer.next_ts()));
+		for(uint32_t j = 20; j < 30; j++)
+		{
+			writer.file_cycle(parent, 10, "/tmp/host." + std::to_string(j));
+		}
+		for(uint32_t j = 0; j < 5; j++)
+		{
+			writer.io(child, PPME_SYSCALL_WRITE_E, 5);
+		}
+		for(uint32_t j = 30; j < 35; j++)
+		{
+			writer.file_cycle(parent, 10, "/tmp/host." + std::to_string(j));
+		}
+
+		nevts = writer.get_nevts();
+		dumper.close();
+		inspector.close();
+	}
+
+	capture_index::build(name, index_name, 50);
+
+	capture_index index;
+	index.load(index_name);
+	capture_index::query q;
+	q.m_containers.insert("web");
+	index.set_query(q);
+
+	//
+	// The writes of the child to the log, found by a full read
+	//
+	std::vector<uint64_t> expected;
+	{
+		sinsp inspector;
+		inspector.open(name);
+		inspector.set_filter("container.id = web and fd.name = /data/log");
+		expected = read_timestamps(inspector);
+		inspector.close();
+	}
+	ASSERT_EQ(10u, expected.size());
+
+	//
+	// With the index, only the events changing the state are read in
+	// the blocks of the host, and the open of the log and the clone are
+	// among them
+	//
+	sinsp inspector;
+	inspector.set_capture_index(&index);
+	inspector.open(name);
+	inspector.set_filter("fd.name = /data/log");
+	EXPECT_EQ(expected, read_timestamps(inspector));
+
+	uint64_t nread = 0;
+	for(const auto& b : index.get_blocks())
+	{
+		nread += index.may_match(b, NULL) ? b.m_nevts : b.m_state_offsets.size();
+	}
+	// the container event of the clone is generated, not read
+	EXPECT_EQ(nread, inspector.get_num_events() + 1);
+	// every block has events changing the state, yet most are skipped
+	EXPECT_LT(inspector.get_num_events() * 3, nevts);
+	inspector.close();
+
+	remove(name.c_str());
+	remove(index_name.c_str());
+}
+
+TEST(capture_index, events_without_thread_info)
+{
+	std::string name = file_name();
+	int64_t parent = getpid();
+	int64_t child = 2000000000;
+
+	//
+	// The parent clones a child in an lxc container, which generates
+	// events 1-29. The index is written with the capture, by an
+	// inspector that doesn't know the child: its events have no thread
+	// info when indexed, and are in the container when read.
+	//
+	{
+		sinsp inspector;
+		inspector.open_nodriver();
+		generic_event evt(&inspector);
+		clone_event clone(&inspector, parent, child, "/lxc/web");
+
+		sinsp_dumper dumper(&inspector);
+		dumper.enable_index(10);
+		dumper.open(name, false, true);
+		dumper.dump(clone.get(1000));
+		for(uint16_t j = 1; j < 30; j++)
+		{
+			dumper.dump(evt.get(j, (j + 1) * 1000, child));
+		}
+		dumper.close();
+		inspector.close();
+	}
+
+	capture_index index;
+	index.load(capture_index::default_path(name));
+	const std::vector<capture_index::block>& blocks = index.get_blocks();
+	ASSERT_EQ(3u, blocks.size());
+	EXPECT_EQ(std::vector<std::string>({CAPTURE_INDEX_NO_THREAD_INFO}), blocks[2].m_containers);
+
+	//
+	// The blocks of the child can't be skipped, whatever the container
+	//
+	for(const std::string& filter : {"not container.id = host", "not container.id in (host, db)",
+					 "container.id = web", "container.id = host"})
+	{
+		sinsp unindexed;
+		unindexed.open(name);
+		unindexed.set_filter(filter);
+		std::vector<uint16_t> expected = read_events(unindexed);
+		unindexed.close();
+
+		sinsp inspector;
+		inspector.set_capture_index(&index);
+		inspector.open(name);
+		inspector.set_filter(filter);
+		EXPECT_EQ(expected, read_events(inspector)) << filter;
+		inspector.close();
+	}
+
+	{
+		sinsp inspector;
+		inspector.set_capture_index(&index);
+		inspector.open(name);
+		inspector.set_filter("not container.id = host");
+
+		std::vector<uint16_t> ids = read_events(inspector);
+		ASSERT_EQ(29u, ids.size());
+		EXPECT_EQ(1, ids.front());
+		EXPECT_EQ(29, ids.back());
+		inspector.close();
+	}
+
+	//
+	// Same for a query on the container
+	//
+	{
+		capture_index::query q;
+		q.m_containers.insert("web");
+		index.set_query(q);
+
+		sinsp unindexed;
+		unindexed.open(name);
+		std::vector<uint16_t> expected = read_events(unindexed);
+		unindexed.close();
+
+		sinsp inspector;
+		inspector.set_capture_index(&index);
+		inspector.open(name);
+		EXPECT_EQ(expected, read_events(inspector));
+		inspector.close();
+	}
+
+	remove(name.c_str());
+	remove(capture_index::default_path(name).c_str());
+}
@@ -0,0 +1,134 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// the test builds events by hand
+#define VISIBILITY_PRIVATE
+
+#include "capture_merger.h"
+#include "capture_test_utils.h"
+#include <gtest.h>
+
+using libsinsp::capture_merger;
+
+namespace
+{
+std::string file_name(uint32_t idx)
+{
+	return capture_file_name("capture_merger", idx);
+}
+
+//
+// Write a capture with a PPME_GENERIC_E event for every nativeID from
+// first to last, stepping by step, each at nativeID microseconds
+//
+void write_capture(const std::string& name, uint16_t first, uint16_t last, uint16_t step)
+{
+	sinsp inspector;
+	inspector.open_nodriver();
+	generic_event evt(&inspector);
+
+	sinsp_dumper dumper(&inspector);
+	dumper.open(name, false, true);
+	for(uint32_t j = first; j <= last; j += step)
+	{
+		dumper.dump(evt.get((uint16_t)j, (j + 1) * 1000));
+	}
+	dumper.close();
+	inspector.close();
+}
+
+// the nativeIDs of the PPME_GENERIC_E events, and their file
+std::vector<std::pair<uint16_t, uint32_t>> read_events(capture_merger& merger)
+{
+	std::vector<std::pair<uint16_t, uint32_t>> res;
+
+	while(true)
+	{
+		sinsp_evt* evt;
+		int32_t rc = merger.next(&evt);
+
+		if(rc == SCAP_EOF)
+		{
+			break;
+		}
+
+		EXPECT_NE(SCAP_FAILURE, rc);
+		if(rc == SCAP_SUCCESS && evt->get_type() == PPME_GENERIC_E)
+		{
+			res.emplace_back(generic_event_id(evt), merger.get_file_idx());
+		}
+	}
+
+	return res;
+}
+}
+
+TEST(capture_merger, per_file)
+{
+	// enough events for a few read-ahead chunks
+	write_capture(file_name(0), 0, 9998, 2);
+	write_capture(file_name(1), 1, 9999, 2);
+
+	capture_merger merger({file_name(0), file_name(1)}, capture_merger::STATE_PER_FILE, 0);
+	ASSERT_NE(merger.get_inspector(0), merger.get_inspector(1));
+	merger.open();
+
+	std::vector<std::pair<uint16_t, uint32_t>> evts = read_events(merger);
+	ASSERT_EQ(10000u, evts.size());
+	for(uint32_t j = 0; j < evts.size(); j++)
+	{
+		ASSERT_EQ(j, evts[j].first);
+		ASSERT_EQ(j % 2, evts[j].second);
+	}
+	merger.close();
+
+	unlink(file_name(0).c_str());
+	unlink(file_name(1).c_str());
+}
+
+TEST(capture_merger, shared_state)
+{
+	// rolled files, the second one starting where the first one ends
+	write_capture(file_name(0), 0, 99, 1);
+	write_capture(file_name(1), 100, 199, 1);
+	write_capture(file_name(2), 200, 299, 1);
+
+	capture_merger merger({file_name(2), file_name(0), file_name(1)}, capture_merger::STATE_SHARED);
+	ASSERT_EQ(merger.get_inspector(0), merger.get_inspector(2));
+	merger.open();
+
+	std::vector<std::pair<uint16_t, uint32_t>> evts = read_events(merger);
+	ASSERT_EQ(300u, evts.size());
+	for(uint32_t j = 0; j < evts.size(); j++)
+	{
+		ASSERT_EQ(j, evts[j].first);
+		ASSERT_EQ((j / 100 + 1) % 3, evts[j].second);
+	}
+	EXPECT_NE(nullptr, merger.get_inspector(0)->get_thread_ref(getpid()));
+	merger.close();
+
+	for(uint32_t j = 0; j < 3; j++)
+	{
+		unlink(file_name(j).c_str());
+	}
+}
+
+TEST(capture_merger, missing_file)
+{
+	capture_merger merger({"/nonexistent.scap"});
+	EXPECT_THROW(merger.open(), sinsp_exception);
+}
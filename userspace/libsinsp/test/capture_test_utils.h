@@ -0,0 +1,296 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+//
+// Helpers for the tests that write and read captures. The tests build
+// events by hand, so they include this after defining VISIBILITY_PRIVATE.
+//
+
+#include "sinsp.h"
+#include <gtest.h>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+//
+// A file in /tmp named after the test and the process, so that parallel
+// runs don't collide
+//
+inline std::string capture_file_name(const std::string& test, uint32_t idx = 0)
+{
+	return "/tmp/" + test + "_test." + std::to_string(getpid()) + "." + std::to_string(idx);
+}
+
+//
+// A PPME_GENERIC_E event, whose nativeID parameter identifies it
+//
+class generic_event
+{
+public:
+	generic_event(sinsp* inspector = NULL):
+		m_storage(sizeof(scap_evt) + 2 * sizeof(uint16_t) + 2 * sizeof(uint16_t))
+	{
+		scap_evt* scapevt = (scap_evt*)m_storage.data();
+		scapevt->ts = 0;
+		scapevt->tid = -1;
+		scapevt->len = (uint32_t)m_storage.size();
+		scapevt->type = PPME_GENERIC_E;
+		scapevt->nparams = 2;
+
+		uint16_t* lens = (uint16_t*)(m_storage.data() + sizeof(struct ppm_evt_hdr));
+		lens[0] = sizeof(uint16_t);
+		lens[1] = sizeof(uint16_t);
+		lens[2] = PPM_SC_UNKNOWN;
+
+		m_evt.m_pevt = scapevt;
+		m_evt.m_poriginal_evt = NULL;
+		m_evt.m_cpuid = 0;
+		m_evt.m_inspector = inspector;
+	}
+
+	sinsp_evt* get(uint16_t native_id, uint64_t ts, int64_t tid = -1)
+	{
+		uint16_t* lens = (uint16_t*)(m_storage.data() + sizeof(struct ppm_evt_hdr));
+		lens[3] = native_id;
+		m_evt.m_pevt->ts = ts;
+		m_evt.m_pevt->tid = tid;
+		return &m_evt;
+	}
+
+private:
+	std::vector<char> m_storage;
+	sinsp_evt m_evt;
+};
+
+inline uint16_t generic_event_id(sinsp_evt* evt)
+{
+	return *(uint16_t*)evt->get_param(1)->m_val;
+}
+
+//
+// An event of any type, whose parameters are added in the order of the
+// event table
+//
+class param_event
+{
+public:
+	param_event(sinsp* inspector, uint16_t type):
+		m_type(type)
+	{
+		m_evt.m_pevt = NULL;
+		m_evt.m_poriginal_evt = NULL;
+		m_evt.m_cpuid = 0;
+		m_evt.m_inspector = inspector;
+	}
+
+	param_event& add(const void* val, size_t len)
+	{
+		m_lens.push_back((uint16_t)len);
+		m_vals.insert(m_vals.end(), (const char*)val, (const char*)val + len);
+		m_storage.clear();
+		return *this;
+	}
+
+	// strings are stored with their terminator
+	param_event& add(const char* val)
+	{
+		return add(val, strlen(val) + 1);
+	}
+
+	param_event& add(const std::string& val)
+	{
+		return add(val.c_str(), val.size() + 1);
+	}
+
+	template<typename T>
+	param_event& add(T val)
+	{
+		return add(&val, sizeof(val));
+	}
+
+	sinsp_evt* get(uint64_t ts, int64_t tid)
+	{
+		if(m_storage.empty())
+		{
+			build();
+		}
+
+		m_evt.m_pevt->ts = ts;
+		m_evt.m_pevt->tid = tid;
+		return &m_evt;
+	}
+
+private:
+	void build()
+	{
+		size_t lens_size = m_lens.size() * sizeof(uint16_t);
+
+		m_storage.resize(sizeof(scap_evt) + lens_size + m_vals.size());
+		scap_evt* scapevt = (scap_evt*)m_storage.data();
+		scapevt->len = (uint32_t)m_storage.size();
+		scapevt->type = m_type;
+		scapevt->nparams = (uint32_t)m_lens.size();
+		memcpy(m_storage.data() + sizeof(struct ppm_evt_hdr), m_lens.data(), lens_size);
+		memcpy(m_storage.data() + sizeof(struct ppm_evt_hdr) + lens_size, m_vals.data(), m_vals.size());
+
+		m_evt.m_pevt = scapevt;
+	}
+
+	uint16_t m_type;
+	std::vector<uint16_t> m_lens;
+	std::vector<char> m_vals;
+	std::vector<char> m_storage;
+	sinsp_evt m_evt;
+};
+
+//
+// A PPME_SYSCALL_CLONE_20_X event returning in the parent, whose child
+// is in the container named by its cpuset cgroup, e.g. /lxc/web
+//
+class clone_event : public param_event
+{
+public:
+	clone_event(sinsp* inspector, int64_t parent, int64_t child, const std::string& cgroup):
+		param_event(inspector, PPME_SYSCALL_CLONE_20_X),
+		m_parent(parent)
+	{
+		uint32_t zero32 = 0;
+		uint64_t zero64 = 0;
+		int64_t fdlimit = 1024;
+
+		add(child);                              // res
+		add("/bin/worker");                      // exe
+		add("");                                 // args
+		add(parent);                             // tid
+		add(parent);                             // pid
+		add(parent);                             // ptid
+		add("/");                                // cwd
+		add(fdlimit);
+		add(zero64);                             // pgft_maj
+		add(zero64);                             // pgft_min
+		add(zero32);                             // vm_size
+		add(zero32);                             // vm_rss
+		add(zero32);                             // vm_swap
+		add("worker");                           // comm
+		add("cpuset=" + cgroup);                 // cgroups
+		add(zero32);                             // flags
+		add(zero32);                             // uid
+		add(zero32);                             // gid
+		add(parent);                             // vtid
+		add(parent);                             // vpid
+	}
+
+	sinsp_evt* get(uint64_t ts)
+	{
+		return param_event::get(ts, m_parent);
+	}
+
+private:
+	int64_t m_parent;
+};
+
+//
+// A PPME_CONTAINER_JSON_E event whose number and cpu can be changed,
+// e.g. to feed rules and tables keyed by evt.num. It can be filtered
+// and formatted without any thread or fd state.
+//
+class container_json_event
+{
+public:
+	container_json_event(sinsp* inspector, const std::string& json = "{}")
+	{
+		m_evt.m_cpuid = 0;
+		m_evt.m_evtnum = 0;
+		m_evt.m_inspector = inspector;
+		// rewriting a short json keeps the event where it is
+		m_storage.reserve(sizeof(scap_evt) + sizeof(uint16_t) + 64);
+		set_json(json, 1234567890);
+	}
+
+	sinsp_evt* get(uint64_t num, uint16_t cpu = 0)
+	{
+		m_evt.m_evtnum = num;
+		m_evt.m_cpuid = cpu;
+		return &m_evt;
+	}
+
+	//
+	// Rewrites the event in place with another json parameter, like
+	// sinsp::next() reuses its event for the next one
+	//
+	void set_json(const std::string& json, uint64_t ts)
+	{
+		m_storage.assign(sizeof(scap_evt) + sizeof(uint16_t) + json.size() + 1, 0);
+
+		scap_evt* scapevt = (scap_evt*)m_storage.data();
+		scapevt->ts = ts;
+		scapevt->tid = -1;
+		scapevt->len = (uint32_t)m_storage.size();
+		scapevt->type = PPME_CONTAINER_JSON_E;
+		scapevt->nparams = 1;
+
+		uint16_t* lens = (uint16_t*)(m_storage.data() + sizeof(struct ppm_evt_hdr));
+		*lens = (uint16_t)json.size() + 1;
+		memcpy((char*)lens + sizeof(uint16_t), json.c_str(), *lens);
+
+		m_evt.m_pevt = scapevt;
+		m_evt.init();
+	}
+
+private:
+	std::vector<char> m_storage;
+	sinsp_evt m_evt;
+};
+
+//
+// The nativeIDs of the PPME_GENERIC_E events of an open inspector
+//
+inline std::vector<uint16_t> read_events(sinsp& inspector)
+{
+	std::vector<uint16_t> res;
+
+	while(true)
+	{
+		sinsp_evt* evt;
+		int32_t rc = inspector.next(&evt);
+
+		if(rc == SCAP_EOF)
+		{
+			break;
+		}
+
+		EXPECT_NE(SCAP_FAILURE, rc);
+		if(rc == SCAP_SUCCESS && evt->get_type() == PPME_GENERIC_E)
+		{
+			res.push_back(generic_event_id(evt));
+		}
+	}
+
+	return res;
+}
+
+inline std::vector<uint16_t> read_events(const std::string& name)
+{
+	sinsp inspector;
+	inspector.open(name);
+	std::vector<uint16_t> res = read_events(inspector);
+	inspector.close();
+	return res;
+}
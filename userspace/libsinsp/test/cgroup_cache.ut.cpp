@@ -0,0 +1,92 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "cgroup_cache.h"
+#include "sinsp.h"
+#include <gtest.h>
+
+using libsinsp::cgroup_cache;
+
+namespace
+{
+cgroup_cache::cgroups_t make_cgroups(const std::string& path)
+{
+	return {{"cpu", path}, {"memory", path}};
+}
+}
+
+TEST(cgroup_cache, lru)
+{
+	cgroup_cache cache(2);
+	auto a = make_cgroups("/lxc/a");
+	auto b = make_cgroups("/lxc/b");
+	auto c = make_cgroups("/user.slice");
+
+	EXPECT_EQ(nullptr, cache.find(a));
+	cache.insert(a, "a");
+	cache.insert(b, "b");
+
+	const std::string* id = cache.find(a);
+	ASSERT_NE(nullptr, id);
+	EXPECT_EQ("a", *id);
+
+	// b is the least recently used
+	cache.insert(c, "");
+	EXPECT_EQ(2u, cache.size());
+	EXPECT_EQ(nullptr, cache.find(b));
+	ASSERT_NE(nullptr, cache.find(c));
+	EXPECT_EQ("", *cache.find(c));
+
+	cache.remove_container("a");
+	EXPECT_EQ(nullptr, cache.find(a));
+	EXPECT_EQ(1u, cache.size());
+
+	EXPECT_EQ(3u, cache.get_hits());
+	EXPECT_EQ(3u, cache.get_misses());
+}
+
+TEST(cgroup_cache, resolve_container)
+{
+	sinsp inspector;
+	sinsp_container_manager manager(&inspector);
+
+	sinsp_threadinfo container_thread(&inspector);
+	container_thread.m_cgroups = make_cgroups("/lxc/c0ffee");
+	sinsp_threadinfo host_thread(&inspector);
+	host_thread.m_cgroups = make_cgroups("/user.slice/user-1000.slice");
+
+	EXPECT_TRUE(manager.resolve_container(&container_thread, false));
+	EXPECT_EQ("c0ffee", container_thread.m_container_id);
+	EXPECT_FALSE(manager.resolve_container(&host_thread, false));
+	EXPECT_EQ("", host_thread.m_container_id);
+	EXPECT_EQ(0u, manager.get_cgroup_cache().get_hits());
+	EXPECT_EQ(2u, manager.get_cgroup_cache().size());
+
+	// the threads forked in the same cgroups hit the cache
+	for(uint32_t j = 0; j < 10; j++)
+	{
+		container_thread.m_container_id = "";
+		EXPECT_TRUE(manager.resolve_container(&container_thread, false));
+		EXPECT_EQ("c0ffee", container_thread.m_container_id);
+
+		EXPECT_FALSE(manager.resolve_container(&host_thread, false));
+		EXPECT_EQ("", host_thread.m_container_id);
+	}
+
+	EXPECT_EQ(20u, manager.get_cgroup_cache().get_hits());
+	EXPECT_EQ(2u, manager.get_cgroup_cache().get_misses());
+}
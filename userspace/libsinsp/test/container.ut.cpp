@@ -0,0 +1,160 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include "container_test_utils.h"
+#include <gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+TEST(container, snapshot)
+{
+	sinsp inspector;
+	sinsp_container_manager manager(&inspector);
+
+	manager.add_container(make_container("aaaaaaaaaaaa", 1), nullptr);
+	sinsp_container_manager::map_ptr_t before = manager.get_containers();
+
+	manager.replace_container(make_container("aaaaaaaaaaaa", 2));
+	manager.add_container(make_container("bbbbbbbbbbbb", 3), nullptr);
+
+	// a snapshot doesn't see the later changes
+	ASSERT_EQ(1u, before->size());
+	EXPECT_EQ(1u, before->at("aaaaaaaaaaaa")->m_container_ip);
+
+	EXPECT_EQ(2u, manager.get_containers()->size());
+	EXPECT_EQ(2u, manager.get_container("aaaaaaaaaaaa")->m_container_ip);
+	EXPECT_EQ(3u, manager.get_container("bbbbbbbbbbbb")->m_container_ip);
+	EXPECT_TRUE(manager.container_exists("bbbbbbbbbbbb"));
+	EXPECT_EQ(nullptr, manager.get_container("cccccccccccc"));
+}
+
+namespace
+{
+const uint32_t n_writers = 2;
+
+struct churn_stats
+{
+	uint64_t m_reads;
+	uint64_t m_writes;
+	uint64_t m_max_read_ns;
+};
+
+//
+// The event thread looks up containers while engine threads keep
+// updating others, n_ids each, until each writer made max_writes
+// updates or for max_duration. Only the event thread adds containers, so the ones of
+// the writers are added up front.
+//
+churn_stats run_churn(sinsp_container_manager& manager, uint32_t n_ids, uint32_t max_writes, std::chrono::milliseconds max_duration)
+{
+	for(uint32_t j = 0; j < n_ids; j++)
+	{
+		manager.add_container(make_container("reader-" + std::to_string(j), j + 1), nullptr);
+		for(uint32_t w = 0; w < n_writers; w++)
+		{
+			manager.add_container(make_container("writer-" + std::to_string(w) + "-" + std::to_string(j), 0), nullptr);
+		}
+	}
+
+	std::atomic<bool> stop(false);
+	std::atomic<uint64_t> nwrites(0);
+	std::atomic<uint32_t> ndone(0);
+	std::vector<std::thread> writers;
+	for(uint32_t w = 0; w < n_writers; w++)
+	{
+		writers.emplace_back([&, w]()
+		{
+			for(uint32_t j = 0; !stop && j < max_writes; j++)
+			{
+				std::string id = "writer-" + std::to_string(w) + "-" + std::to_string(j % n_ids);
+				manager.replace_container(make_container(id, j));
+				nwrites++;
+			}
+			ndone++;
+		});
+	}
+
+	churn_stats stats = {0, 0, 0};
+	auto start = std::chrono::steady_clock::now();
+	while(ndone < n_writers && std::chrono::steady_clock::now() - start < max_duration)
+	{
+		for(uint32_t j = 0; j < n_ids; j++)
+		{
+			auto read_start = std::chrono::steady_clock::now();
+			sinsp_container_info::ptr_t container = manager.get_container("reader-" + std::to_string(j));
+			uint64_t read_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - read_start).count();
+
+			EXPECT_NE(nullptr, container);
+			if(container)
+			{
+				EXPECT_EQ(j + 1, container->m_container_ip);
+			}
+			stats.m_max_read_ns = std::max(stats.m_max_read_ns, read_ns);
+			stats.m_reads++;
+		}
+	}
+
+	stop = true;
+	for(auto& writer : writers)
+	{
+		writer.join();
+	}
+
+	stats.m_writes = nwrites;
+	return stats;
+}
+}
+
+TEST(container, churn)
+{
+	const uint32_t n_ids = 32;
+	const uint32_t max_writes = 4 * n_ids;
+	sinsp inspector;
+	sinsp_container_manager manager(&inspector);
+
+	churn_stats stats = run_churn(manager, n_ids, max_writes, std::chrono::seconds(30));
+	ASSERT_EQ(n_writers * max_writes, stats.m_writes);
+
+	// every writer's container has its last update
+	EXPECT_EQ(n_ids * (1 + n_writers), manager.get_containers()->size());
+	for(uint32_t w = 0; w < n_writers; w++)
+	{
+		for(uint32_t j = 0; j < n_ids; j++)
+		{
+			sinsp_container_info::ptr_t container = manager.get_container("writer-" + std::to_string(w) + "-" + std::to_string(j));
+			ASSERT_NE(nullptr, container);
+			EXPECT_EQ(max_writes - n_ids + j, container->m_container_ip);
+		}
+	}
+}
+
+TEST(container, DISABLED_churn)
+{
+	const uint32_t n_ids = 256;
+	sinsp inspector;
+	sinsp_container_manager manager(&inspector);
+
+	churn_stats stats = run_churn(manager, n_ids, UINT32_MAX, std::chrono::milliseconds(500));
+
+	EXPECT_EQ(n_ids * (1 + n_writers), manager.get_containers()->size());
+	RecordProperty("reads", std::to_string(stats.m_reads));
+	RecordProperty("writes", std::to_string(stats.m_writes));
+	RecordProperty("max_read_ns", std::to_string(stats.m_max_read_ns));
+}
@@ -0,0 +1,188 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#define VISIBILITY_PRIVATE
+
+#include "sinsp.h"
+#include "container_test_utils.h"
+#include <gtest.h>
+#include <fstream>
+#include <vector>
+#include <unistd.h>
+
+namespace
+{
+std::string snapshot_path()
+{
+	return "/tmp/container_snapshot_test." + std::to_string(getpid());
+}
+}
+
+TEST(container_snapshot, round_trip)
+{
+	std::string path = snapshot_path();
+	sinsp inspector;
+
+	sinsp_container_manager writer(&inspector);
+	writer.set_snapshot_path(path, ONE_SECOND_IN_NS);
+	writer.add_container(make_container("aaaaaaaaaaaa"), nullptr);
+	writer.add_container(make_container("bbbbbbbbbbbb", 0, sinsp_container_lookup_state::FAILED), nullptr);
+	ASSERT_TRUE(writer.write_snapshot());
+
+	sinsp_container_manager reader(&inspector);
+	reader.set_snapshot_path(path, ONE_SECOND_IN_NS);
+	ASSERT_TRUE(reader.load_snapshot());
+
+	auto restored = reader.get_container("aaaaaaaaaaaa");
+	ASSERT_NE(nullptr, restored);
+	EXPECT_TRUE(restored->is_successful());
+	EXPECT_EQ("name-aaaaaaaaaaaa", restored->m_name);
+	EXPECT_EQ("image:aaaaaaaaaaaa", restored->m_image);
+	EXPECT_EQ("aaaaaaaaaaaa", restored->m_labels.at("app"));
+	// the runtime is asked again when a thread of the container shows up
+	EXPECT_TRUE(reader.should_lookup("aaaaaaaaaaaa", CT_DOCKER));
+
+	// failed lookups are not persisted
+	EXPECT_EQ(nullptr, reader.get_container("bbbbbbbbbbbb"));
+
+	// restored containers not seen on a live thread are not written back
+	ASSERT_TRUE(reader.write_snapshot());
+	sinsp_container_manager empty(&inspector);
+	empty.set_snapshot_path(path, ONE_SECOND_IN_NS);
+	ASSERT_TRUE(empty.load_snapshot());
+	EXPECT_EQ(0u, empty.get_containers()->size());
+
+	unlink(path.c_str());
+}
+
+TEST(container_snapshot, refresh_from_runtime)
+{
+	std::string path = snapshot_path();
+	sinsp inspector;
+
+	{
+		auto container = std::make_shared<sinsp_container_info>(*make_container("web"));
+		container->m_type = CT_LXC;
+		sinsp_container_manager writer(&inspector);
+		writer.set_snapshot_path(path, ONE_SECOND_IN_NS);
+		writer.add_container(container, nullptr);
+		ASSERT_TRUE(writer.write_snapshot());
+	}
+
+	sinsp_container_manager manager(&inspector);
+	manager.set_snapshot_path(path, ONE_SECOND_IN_NS);
+	ASSERT_TRUE(manager.load_snapshot());
+
+	std::vector<sinsp_container_info> announced;
+	manager.subscribe_on_new_container([&announced](const sinsp_container_info& container_info, sinsp_threadinfo*)
+	{
+		announced.push_back(container_info);
+	});
+
+	// the restored metadata is served until the runtime answers
+	ASSERT_NE(nullptr, manager.get_container("web"));
+	EXPECT_EQ("name-web", manager.get_container("web")->m_name);
+
+	sinsp_threadinfo tinfo(&inspector);
+	tinfo.m_tid = tinfo.m_pid = 42;
+	tinfo.m_cgroups.emplace_back("cpuset", "/lxc/web");
+	EXPECT_TRUE(manager.resolve_container(&tinfo, true));
+	EXPECT_EQ("web", tinfo.m_container_id);
+
+	// the container is announced once, with what the runtime reported
+	ASSERT_EQ(1u, announced.size());
+	EXPECT_EQ("web", announced[0].m_name);
+	EXPECT_EQ("", announced[0].m_image);
+	EXPECT_TRUE(announced[0].m_labels.empty());
+
+	auto refreshed = manager.get_container("web");
+	ASSERT_NE(nullptr, refreshed);
+	EXPECT_EQ("web", refreshed->m_name);
+	EXPECT_EQ("", refreshed->m_image);
+	EXPECT_FALSE(manager.should_lookup("web", CT_LXC));
+
+	// a second thread does not announce it again
+	sinsp_threadinfo other(&inspector);
+	other.m_tid = other.m_pid = 43;
+	other.m_cgroups = tinfo.m_cgroups;
+	EXPECT_TRUE(manager.resolve_container(&other, true));
+	EXPECT_EQ(1u, announced.size());
+
+	unlink(path.c_str());
+}
+
+TEST(container_snapshot, periodic_write)
+{
+	std::string path = snapshot_path();
+	unlink(path.c_str());
+	sinsp inspector;
+
+	{
+		sinsp_container_manager writer(&inspector);
+		writer.set_snapshot_path(path, ONE_SECOND_IN_NS);
+		writer.add_container(make_container("aaaaaaaaaaaa"), nullptr);
+
+		// the first call only starts the interval
+		inspector.m_lastevent_ts = ONE_SECOND_IN_NS;
+		writer.update_snapshot();
+		inspector.m_lastevent_ts = 2 * ONE_SECOND_IN_NS;
+		writer.update_snapshot();
+		EXPECT_NE(0, access(path.c_str(), F_OK));
+
+		// the write is started here, and completed before the
+		// manager goes away
+		inspector.m_lastevent_ts = 3 * ONE_SECOND_IN_NS;
+		writer.update_snapshot();
+	}
+
+	sinsp_container_manager reader(&inspector);
+	reader.set_snapshot_path(path, ONE_SECOND_IN_NS);
+	ASSERT_TRUE(reader.load_snapshot());
+	EXPECT_NE(nullptr, reader.get_container("aaaaaaaaaaaa"));
+
+	unlink(path.c_str());
+}
+
+TEST(container_snapshot, invalid_file)
+{
+	std::string path = snapshot_path();
+	sinsp inspector;
+	sinsp_container_manager manager(&inspector);
+
+	EXPECT_FALSE(manager.load_snapshot());
+
+	manager.set_snapshot_path(path, ONE_SECOND_IN_NS);
+	unlink(path.c_str());
+	EXPECT_FALSE(manager.load_snapshot());
+
+	{
+		std::ofstream out(path);
+		out << "{\"container_snapshot\":{\"version\":999}}\n";
+	}
+	EXPECT_FALSE(manager.load_snapshot());
+
+	{
+		std::ofstream out(path);
+		out << "{\"container_snapshot\":{\"version\":1}}\n"
+		    << "not json\n"
+		    << "{\"container\":{\"id\":\"cccccccccccc\",\"type\":0,\"lookup_state\":1}}\n";
+	}
+	EXPECT_TRUE(manager.load_snapshot());
+	EXPECT_NE(nullptr, manager.get_container("cccccccccccc"));
+
+	unlink(path.c_str());
+}
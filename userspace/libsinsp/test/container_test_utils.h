@@ -0,0 +1,40 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#pragma once
+
+#include "sinsp.h"
+#include <memory>
+#include <string>
+
+//
+// A docker container whose name, image and labels are derived from its id
+//
+inline sinsp_container_info::ptr_t make_container(const std::string& id,
+						  uint32_t ip = 0,
+						  sinsp_container_lookup_state state = sinsp_container_lookup_state::SUCCESSFUL)
+{
+	auto container = std::make_shared<sinsp_container_info>();
+	container->m_id = id;
+	container->m_type = CT_DOCKER;
+	container->m_name = "name-" + id;
+	container->m_image = "image:" + id;
+	container->m_labels["app"] = id;
+	container->m_container_ip = ip;
+	container->m_lookup_state = state;
+	return container;
+}
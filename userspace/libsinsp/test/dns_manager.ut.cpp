@@ -0,0 +1,88 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "dns_manager.h"
+#include <gtest.h>
+#include <arpa/inet.h>
+
+namespace
+{
+std::mutex g_addrs_mutex;
+std::map<std::string, uint32_t> g_addrs;
+
+void stub_resolve(const std::string &name, std::set<uint32_t> &v4_addrs, std::set<ipv6addr> &v6_addrs)
+{
+	std::lock_guard<std::mutex> lock(g_addrs_mutex);
+	auto it = g_addrs.find(name);
+	if(it != g_addrs.end())
+	{
+		v4_addrs.insert(it->second);
+	}
+}
+
+void set_addr(const std::string &name, const char *addr)
+{
+	std::lock_guard<std::mutex> lock(g_addrs_mutex);
+	g_addrs[name] = inet_addr(addr);
+}
+}
+
+TEST(dns_manager_test, reverse_lookup_and_refresh)
+{
+	sinsp_dns_manager &manager = sinsp_dns_manager::get();
+	manager.cleanup();
+	manager.set_resolve_func(stub_resolve);
+	manager.set_base_refresh_timeout(ONE_SECOND_IN_NS / 100);
+	manager.set_max_refresh_timeout(ONE_SECOND_IN_NS / 100);
+	manager.set_num_resolvers(2);
+
+	set_addr("one.test", "10.0.0.1");
+	set_addr("two.test", "10.0.0.2");
+
+	uint32_t addr1 = inet_addr("10.0.0.1");
+	uint32_t addr2 = inet_addr("10.0.0.2");
+	uint32_t addr3 = inet_addr("10.0.0.3");
+	uint64_t ts = sinsp_utils::get_current_time_ns();
+
+	sinsp_dns_manager::dns_stats before = manager.get_stats();
+	EXPECT_TRUE(manager.match("one.test", AF_INET, &addr1, ts));
+	EXPECT_FALSE(manager.match("one.test", AF_INET, &addr2, ts));
+	EXPECT_TRUE(manager.match("two.test", AF_INET, &addr2, ts));
+	sinsp_dns_manager::dns_stats after = manager.get_stats();
+	EXPECT_EQ(before.m_match_misses + 2, after.m_match_misses);
+	EXPECT_EQ(before.m_match_hits + 1, after.m_match_hits);
+
+	EXPECT_EQ("one.test", manager.name_of(AF_INET, &addr1, ts));
+	EXPECT_EQ("two.test", manager.name_of(AF_INET, &addr2, ts));
+	EXPECT_EQ("", manager.name_of(AF_INET, &addr3, ts));
+
+	// the refresh thread must pick up the new address
+	// and update the reverse index accordingly
+	set_addr("two.test", "10.0.0.3");
+	std::string name;
+	for(int j = 0; j < 500 && name.empty(); j++)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		name = manager.name_of(AF_INET, &addr3, sinsp_utils::get_current_time_ns());
+	}
+	EXPECT_EQ("two.test", name);
+	EXPECT_EQ("", manager.name_of(AF_INET, &addr2, sinsp_utils::get_current_time_ns()));
+	EXPECT_GT(manager.get_stats().m_refreshes, before.m_refreshes);
+
+	manager.cleanup();
+	manager.set_resolve_func(nullptr);
+}
@@ -0,0 +1,315 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// the test builds events by hand
+#define VISIBILITY_PRIVATE
+
+#include "capture_test_utils.h"
+#include "scap_savefile.h"
+#include <gtest.h>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+std::string file_name()
+{
+	return capture_file_name("dumper");
+}
+
+// the event with the given nativeID, one millisecond after the previous one
+sinsp_evt* event(generic_event& evt, uint16_t idx)
+{
+	return evt.get(idx, (idx + 1) * ONE_SECOND_IN_NS / 1000);
+}
+}
+
+TEST(dumper, flight_recorder)
+{
+	sinsp inspector;
+	inspector.open_nodriver();
+	generic_event evt(&inspector);
+	const uint64_t ring_size = 4096;
+
+	sinsp_dumper dumper(&inspector);
+	EXPECT_THROW(dumper.trigger(file_name(), false), sinsp_exception);
+	dumper.enable_flight_recorder(ring_size);
+
+	for(uint16_t j = 0; j < 1000; j++)
+	{
+		dumper.dump(event(evt, j));
+		ASSERT_LE(dumper.recorded_bytes(), ring_size);
+	}
+
+	uint64_t nrecorded = dumper.recorded_events();
+	EXPECT_GT(nrecorded, 10u);
+	EXPECT_FALSE(dumper.is_open());
+
+	// the 10 following events are in the post-trigger window
+	dumper.trigger(file_name(), true, 10 * ONE_SECOND_IN_NS / 1000);
+	EXPECT_TRUE(dumper.is_open());
+	for(uint16_t j = 1000; j < 1100; j++)
+	{
+		dumper.dump(event(evt, j));
+	}
+	EXPECT_FALSE(dumper.is_open());
+	inspector.close();
+
+	std::vector<uint16_t> evts = read_events(file_name());
+	ASSERT_EQ(nrecorded + 10, evts.size());
+	for(uint32_t j = 0; j < evts.size(); j++)
+	{
+		ASSERT_EQ(1010 - evts.size() + j, evts[j]);
+	}
+
+	unlink(file_name().c_str());
+}
+
+TEST(dumper, flight_recorder_duration)
+{
+	sinsp inspector;
+	inspector.open_nodriver();
+	generic_event evt(&inspector);
+
+	sinsp_dumper dumper(&inspector);
+	dumper.enable_flight_recorder(1024 * 1024, 5 * ONE_SECOND_IN_NS / 1000);
+
+	for(uint16_t j = 0; j < 1000; j++)
+	{
+		dumper.dump(event(evt, j));
+	}
+
+	// the last event, and the ones up to 5ms before it
+	EXPECT_EQ(6u, dumper.recorded_events());
+
+	dumper.trigger(file_name(), false);
+	EXPECT_FALSE(dumper.is_open());
+	inspector.close();
+
+	std::vector<uint16_t> evts = read_events(file_name());
+	ASSERT_EQ(6u, evts.size());
+	EXPECT_EQ(994, evts[0]);
+	EXPECT_EQ(999, evts[5]);
+
+	unlink(file_name().c_str());
+}
+
+namespace
+{
+//
+// Write a compressed capture with nthreads threads of nfds fds each
+//
+void write_state(const std::string& name, uint32_t nthreads, uint32_t nfds)
+{
+	sinsp inspector;
+	inspector.open_nodriver();
+
+	for(uint32_t j = 0; j < nthreads; j++)
+	{
+		sinsp_threadinfo* tinfo = new sinsp_threadinfo(&inspector);
+		tinfo->m_tid = 4000000 + j;
+		tinfo->m_pid = tinfo->m_tid;
+		tinfo->m_ptid = 1;
+		tinfo->m_comm = "worker";
+		tinfo->m_exe = "/usr/bin/worker";
+		tinfo->m_exepath = "/usr/bin/worker";
+		tinfo->m_args.push_back("--id=" + std::to_string(j));
+		tinfo->m_cwd = "/var/lib/worker/";
+
+		for(uint32_t k = 0; k < nfds; k++)
+		{
+			sinsp_fdinfo_t fdinfo;
+			fdinfo.m_type = SCAP_FD_FILE_V2;
+			fdinfo.m_name = "/var/lib/worker/data." + std::to_string(k);
+			tinfo->add_fd(k + 3, &fdinfo);
+		}
+
+		inspector.m_thread_manager->add_thread(tinfo, false);
+	}
+
+	generic_event evt(&inspector);
+	sinsp_dumper dumper(&inspector);
+	dumper.open(name, true, true);
+	dumper.dump(event(evt, 0));
+	dumper.close();
+	inspector.close();
+}
+
+//
+// Check the last thread written by write_state() and its fds
+//
+void check_state(sinsp& inspector, uint32_t nthreads, uint32_t nfds)
+{
+	EXPECT_GE(inspector.m_thread_manager->get_thread_count(), nthreads);
+	threadinfo_map_t::ptr_t tinfo = inspector.get_thread_ref(4000000 + nthreads - 1);
+	ASSERT_NE(nullptr, tinfo);
+	EXPECT_EQ("/usr/bin/worker", tinfo->m_exepath);
+	ASSERT_EQ(1u, tinfo->m_args.size());
+	EXPECT_EQ("--id=" + std::to_string(nthreads - 1), tinfo->m_args[0]);
+	for(uint32_t k = 0; k < nfds; k++)
+	{
+		sinsp_fdinfo_t* fdinfo = tinfo->get_fd(k + 3);
+		ASSERT_NE(nullptr, fdinfo);
+		EXPECT_EQ("/var/lib/worker/data." + std::to_string(k), fdinfo->m_name);
+	}
+	EXPECT_EQ(nullptr, tinfo->get_fd(nfds + 3));
+}
+
+//
+// Open a capture with libscap alone, return the result
+//
+int32_t scap_open_file(const std::string& name)
+{
+	char error[SCAP_LASTERR_SIZE];
+	int32_t rc = SCAP_FAILURE;
+	scap_t* h = scap_open_offline(name.c_str(), error, &rc);
+
+	if(h != NULL)
+	{
+		scap_close(h);
+		return SCAP_SUCCESS;
+	}
+
+	EXPECT_NE(SCAP_SUCCESS, rc);
+	return rc;
+}
+}
+
+TEST(dumper, state)
+{
+	std::string name = file_name();
+	write_state(name, 100, 20);
+
+	sinsp inspector;
+	inspector.open(name);
+	check_state(inspector, 100, 20);
+	inspector.close();
+
+	unlink(name.c_str());
+}
+
+//
+// Reading the thread and fd tables of a large capture. A benchmark, run
+// it with --gtest_also_run_disabled_tests
+//
+TEST(dumper, DISABLED_large_state)
+{
+	const uint32_t nthreads = 10000;
+	const uint32_t nfds = 20;
+	std::string name = file_name();
+	write_state(name, nthreads, nfds);
+
+	// the tables parsed by libscap alone, then imported by sinsp
+	auto start = std::chrono::steady_clock::now();
+	char error[SCAP_LASTERR_SIZE];
+	int32_t rc;
+	scap_t* h = scap_open_offline(name.c_str(), error, &rc);
+	ASSERT_NE(nullptr, h) << error;
+	uint64_t scap_open_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - start).count();
+	scap_close(h);
+
+	start = std::chrono::steady_clock::now();
+	sinsp inspector;
+	inspector.open(name);
+	uint64_t open_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::steady_clock::now() - start).count();
+
+	check_state(inspector, nthreads, nfds);
+	inspector.close();
+
+	RecordProperty("scap_open_ms", std::to_string(scap_open_ms));
+	RecordProperty("open_ms", std::to_string(open_ms));
+	unlink(name.c_str());
+}
+
+//
+// A process list block that is cut short, or whose lengths don't match
+// its content, fails the open
+//
+TEST(dumper, corrupted_proclist)
+{
+	std::string name = file_name();
+
+	{
+		sinsp inspector;
+		inspector.open_nodriver();
+		generic_event evt(&inspector);
+		sinsp_dumper dumper(&inspector);
+		dumper.open(name, false, true);
+		dumper.dump(event(evt, 0));
+		dumper.close();
+		inspector.close();
+	}
+
+	std::string data;
+	{
+		std::ifstream in(name, std::ios::binary);
+		data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+	}
+	ASSERT_EQ(SCAP_SUCCESS, scap_open_file(name));
+
+	// the uncompressed file is a sequence of blocks, find the first
+	// process list with entries
+	size_t pl = 0;
+	block_header bh;
+	while(true)
+	{
+		ASSERT_LE(pl + sizeof(bh), data.size());
+		memcpy(&bh, data.data() + pl, sizeof(bh));
+		if(bh.block_type == PL_BLOCK_TYPE_V9 && bh.block_total_length > sizeof(bh) + 4)
+		{
+			break;
+		}
+		pl += bh.block_total_length;
+	}
+
+	auto write_corrupted = [&name, &data](size_t len, size_t offset, uint32_t val)
+	{
+		std::string corrupted = data.substr(0, len);
+		memcpy(&corrupted[offset], &val, sizeof(val));
+		std::ofstream out(name, std::ios::binary | std::ios::trunc);
+		out.write(corrupted.data(), corrupted.size());
+	};
+	size_t len_offset = pl + sizeof(uint32_t);
+	size_t sub_len_offset = pl + sizeof(block_header);
+	uint32_t sub_len;
+	memcpy(&sub_len, data.data() + sub_len_offset, sizeof(sub_len));
+
+	// the file ends in the middle of the block
+	write_corrupted(pl + bh.block_total_length / 2, len_offset, bh.block_total_length);
+	EXPECT_EQ(SCAP_FAILURE, scap_open_file(name));
+
+	// the block length goes past the end of the file
+	write_corrupted(data.size(), len_offset, (uint32_t)data.size() * 2);
+	EXPECT_EQ(SCAP_FAILURE, scap_open_file(name));
+
+	// the block length is shorter than its header
+	write_corrupted(data.size(), len_offset, 4);
+	EXPECT_EQ(SCAP_FAILURE, scap_open_file(name));
+
+	// the first entry is longer than the block
+	write_corrupted(data.size(), sub_len_offset, bh.block_total_length);
+	EXPECT_EQ(SCAP_FAILURE, scap_open_file(name));
+
+	// the first entry is shorter than its fields
+	write_corrupted(data.size(), sub_len_offset, sub_len / 2);
+	EXPECT_EQ(SCAP_FAILURE, scap_open_file(name));
+
+	unlink(name.c_str());
+}
@@ -0,0 +1,105 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// the test builds events by hand
+#define VISIBILITY_PRIVATE
+
+#include "capture_test_utils.h"
+#include <gtest.h>
+
+namespace
+{
+std::string format(sinsp& inspector, const std::string& fmt, sinsp_evt* evt, bool* shown = NULL)
+{
+	sinsp_evt_formatter formatter(&inspector, fmt);
+	std::string res;
+	bool ret = formatter.tostring(evt, &res);
+	if(shown)
+	{
+		*shown = ret;
+	}
+	return res;
+}
+}
+
+TEST(eventformatter, text)
+{
+	sinsp inspector;
+	container_json_event evt(&inspector, "{\"a\":\"b\\tc\"}");
+	bool shown;
+
+	EXPECT_EQ("42 container cpu=3 >", format(inspector, "%evt.num %evt.type cpu=%evt.cpu %evt.dir", evt.get(42, 3), &shown));
+	EXPECT_TRUE(shown);
+	EXPECT_EQ("[contai][42    ]", format(inspector, "[%6evt.type][%6evt.num]", evt.get(42, 3)));
+
+	format(inspector, "%evt.num %proc.name", evt.get(42, 3), &shown);
+	EXPECT_FALSE(shown);
+	EXPECT_EQ("42 <NA>", format(inspector, "*%evt.num %proc.name", evt.get(42, 3), &shown));
+	EXPECT_TRUE(shown);
+}
+
+TEST(eventformatter, json)
+{
+	sinsp inspector;
+	inspector.set_buffer_format(sinsp_evt::PF_JSON);
+	container_json_event evt(&inspector, "{\"a\":\"b\\tc\\u00e9\"}");
+	bool shown;
+
+	// members are sorted by name, raw strings are dropped
+	EXPECT_EQ("{\"evt.cpu\":3,\"evt.num\":42,\"evt.type\":\"container\"}",
+		  format(inspector, "%evt.type %evt.num text %evt.cpu %evt.num", evt.get(42, 3), &shown));
+	EXPECT_TRUE(shown);
+
+	EXPECT_EQ("{\"evt.rawarg.json\":\"{\\\"a\\\":\\\"b\\\\tc\\\\u00e9\\\"}\"}",
+		  format(inspector, "%evt.rawarg.json", evt.get(42, 3)));
+
+	EXPECT_EQ("{\"evt.num\":42,\"proc.name\":null}", format(inspector, "*%evt.num %proc.name", evt.get(42, 3), &shown));
+	EXPECT_TRUE(shown);
+
+	EXPECT_EQ("null", format(inspector, "%proc.name %evt.num", evt.get(42, 3), &shown));
+	EXPECT_FALSE(shown);
+
+	EXPECT_EQ("null", format(inspector, "just text", evt.get(42, 3)));
+}
+
+TEST(eventformatter, json_non_ascii)
+{
+	sinsp inspector;
+	inspector.set_buffer_format(sinsp_evt::PF_JSON);
+	container_json_event evt(&inspector, "caf\xc3\xa9\x01");
+
+	// must match what jsoncpp itself produces for the same value
+	Json::Value expected;
+	expected["evt.rawarg.json"] = "caf\xc3\xa9\x01";
+	std::string doc = Json::FastWriter().write(expected);
+	doc.pop_back();
+
+	EXPECT_EQ(doc, format(inspector, "%evt.rawarg.json", evt.get(42, 3)));
+}
+
+TEST(eventformatter, append_reuses_buffer)
+{
+	sinsp inspector;
+	container_json_event evt(&inspector, "{}");
+	sinsp_evt_formatter formatter(&inspector, "%evt.num %evt.type");
+
+	std::string out = "prefix:";
+	EXPECT_TRUE(formatter.append(evt.get(42, 3), out));
+	out += '\n';
+	EXPECT_TRUE(formatter.append(evt.get(42, 3), out));
+	EXPECT_EQ("prefix:42 container\n42 container", out);
+}
@@ -0,0 +1,674 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// the test builds events by hand
+#define VISIBILITY_PRIVATE
+
+#include "sinsp.h"
+#include "filter.h"
+#include "filterchecks.h"
+#include "parsers.h"
+#include "filter_optimizer.h"
+#include "rule_profiler.h"
+#include "capture_test_utils.h"
+#include <gtest.h>
+#include <chrono>
+
+extern sinsp_filter_check_list g_filterlist;
+
+namespace
+{
+//
+// Rules in the shape of the usual ones, each one a bit different
+//
+std::vector<std::string> make_conditions(uint32_t n)
+{
+	std::vector<std::string> res;
+
+	for(uint32_t j = 0; j < n; j++)
+	{
+		res.push_back("(evt.type in (open, openat, execve) and evt.dir = <) and "
+			      "(proc.name = proc" + std::to_string(j) + " or proc.pname startswith p" + std::to_string(j) + ") and "
+			      "not fd.name pmatch (/etc, /usr/lib) and "
+			      "container.id != host and user.uid >= " + std::to_string(j));
+	}
+
+	return res;
+}
+
+//
+// nrules rules on PPME_CONTAINER_JSON_E, the j-th one matching the
+// event numbered j modulo 10, tagged with j modulo 16
+//
+void add_num_rules(sinsp* inspector, sinsp_evttype_filter& ruleset, uint32_t nrules)
+{
+	std::vector<sinsp_evttype_filter::rule_spec> rules(nrules);
+
+	for(uint32_t j = 0; j < nrules; j++)
+	{
+		rules[j].name = "rule" + std::to_string(j);
+		rules[j].condition = "evt.num = " + std::to_string(j % 10);
+		rules[j].evttypes.insert(PPME_CONTAINER_JSON_E);
+		rules[j].evttypes.insert(PPME_SYSCALL_OPEN_X);
+		rules[j].tags.insert("tag" + std::to_string(j % 16));
+	}
+
+	ruleset.add_all(inspector, rules);
+}
+
+// the fields of the checks of an expression, in evaluation order
+std::vector<std::string> check_fields(gen_event_filter_expression* expr)
+{
+	std::vector<std::string> res;
+
+	for(gen_event_filter_check* chk : expr->m_checks)
+	{
+		sinsp_filter_check* sinsp_chk = dynamic_cast<sinsp_filter_check*>(chk);
+		res.push_back(sinsp_chk ? sinsp_chk->get_field_info()->m_name : "()");
+	}
+
+	return res;
+}
+
+int64_t load_ms(sinsp* inspector, uint32_t nrules, uint32_t nthreads)
+{
+	std::vector<sinsp_evttype_filter::rule_spec> rules;
+	std::vector<std::string> conditions = make_conditions(nrules);
+
+	for(uint32_t j = 0; j < nrules; j++)
+	{
+		sinsp_evttype_filter::rule_spec rule;
+		rule.name = "rule" + std::to_string(j);
+		rule.condition = conditions[j];
+		rules.push_back(rule);
+	}
+
+	sinsp_evttype_filter ruleset;
+	auto start = std::chrono::steady_clock::now();
+	ruleset.add_all(inspector, rules, nthreads);
+	auto end = std::chrono::steady_clock::now();
+
+	return std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+}
+}
+
+TEST(filter, field_lookup)
+{
+	sinsp inspector;
+	std::vector<const filter_check_info*> checks;
+	g_filterlist.get_all_fields(&checks);
+
+	//
+	// Every field name is found, and gives a check of the class that
+	// defines it first
+	//
+	std::map<std::string, std::string> first_check;
+	for(const filter_check_info* info : checks)
+	{
+		for(int32_t j = 0; j < info->m_nfields; j++)
+		{
+			const filtercheck_field_info& field = info->m_fields[j];
+			if(field.m_flags & EPF_REQUIRES_ARGUMENT)
+			{
+				continue;
+			}
+			first_check.insert({field.m_name, info->m_name});
+		}
+	}
+
+	for(const auto& it : first_check)
+	{
+		sinsp_filter_check* chk = g_filterlist.new_filter_check_from_fldname(it.first, &inspector, true);
+		ASSERT_NE(nullptr, chk) << it.first;
+		EXPECT_EQ(it.second, chk->get_fields()->m_name) << it.first;
+		delete chk;
+	}
+
+	//
+	// Names with arguments match with a prefix only
+	//
+	sinsp_filter_check* chk = g_filterlist.new_filter_check_from_fldname("proc.aname[2]", &inspector, false);
+	ASSERT_NE(nullptr, chk);
+	delete chk;
+	EXPECT_EQ(nullptr, g_filterlist.new_filter_check_from_fldname("proc.namex", &inspector, true));
+	EXPECT_EQ(nullptr, g_filterlist.new_filter_check_from_fldname("nosuchclass.field", &inspector, true));
+}
+
+TEST(filter, compile_all)
+{
+	sinsp inspector;
+	std::vector<std::string> conditions = make_conditions(50);
+
+	std::vector<sinsp_filter*> filters = sinsp_filter_compiler::compile_all(&inspector, conditions, 4);
+	ASSERT_EQ(conditions.size(), filters.size());
+	for(sinsp_filter* filter : filters)
+	{
+		EXPECT_NE(nullptr, filter);
+		delete filter;
+	}
+
+	//
+	// A single bad rule adds none of them
+	//
+	std::vector<sinsp_evttype_filter::rule_spec> rules(3);
+	rules[0].name = "good";
+	rules[0].condition = conditions[0];
+	rules[1].name = "bad";
+	rules[1].condition = "proc.name = a and";
+	rules[2].name = "unknown";
+	rules[2].condition = "proc.nosuchfield = a";
+
+	sinsp_evttype_filter ruleset;
+	try
+	{
+		ruleset.add_all(&inspector, rules, 2);
+		FAIL() << "the rules were added";
+	}
+	catch(const sinsp_exception& e)
+	{
+		EXPECT_EQ(0u, std::string(e.what()).find("filter bad: "));
+	}
+
+	std::vector<bool> evttypes;
+	ruleset.enable(".*", true);
+	ruleset.evttypes_for_ruleset(evttypes, 0);
+	EXPECT_EQ(evttypes.end(), std::find(evttypes.begin(), evttypes.end(), true));
+}
+
+//
+// Compiling in parallel gives the same filters as compiling serially
+//
+TEST(filter, compile_all_parallel)
+{
+	sinsp inspector;
+	container_json_event evt(&inspector);
+	std::vector<std::string> conditions;
+
+	for(uint32_t j = 0; j < 40; j++)
+	{
+		conditions.push_back("evt.num = " + std::to_string(j % 10) +
+				     " or (evt.num > " + std::to_string(j) + " and evt.type = container)");
+	}
+
+	std::vector<sinsp_filter*> serial = sinsp_filter_compiler::compile_all(&inspector, conditions, 1);
+	std::vector<sinsp_filter*> parallel = sinsp_filter_compiler::compile_all(&inspector, conditions, 4);
+	ASSERT_EQ(conditions.size(), serial.size());
+	ASSERT_EQ(conditions.size(), parallel.size());
+
+	for(uint32_t j = 0; j < conditions.size(); j++)
+	{
+		ASSERT_NE(nullptr, serial[j]);
+		ASSERT_NE(nullptr, parallel[j]);
+
+		uint32_t nmatches = 0;
+		for(uint64_t num = 0; num < 50; num++)
+		{
+			bool match = serial[j]->run(evt.get(num));
+			EXPECT_EQ(match, parallel[j]->run(evt.get(num))) << conditions[j] << " on event " << num;
+			nmatches += match;
+		}
+		// the event numbered j % 10 and the ones past j
+		EXPECT_EQ(50 - j, nmatches) << conditions[j];
+
+		delete serial[j];
+		delete parallel[j];
+	}
+}
+
+//
+// The pool doesn't change the inspector: the protocol decoders of the
+// checks are registered once all the filters compiled, or by
+// alloc_state() with deferred state
+//
+TEST(filter, compile_all_state)
+{
+	sinsp inspector;
+	container_json_event evt(&inspector);
+	std::vector<std::string> conditions(8, "evt.num = 3 or syslog.facility exists");
+	// the syslog decoder watches the opened files
+	auto num_decoders = [&]() { return inspector.m_parser->m_open_callbacks.size(); };
+
+	size_t before = num_decoders();
+	std::vector<sinsp_filter*> deferred = sinsp_filter_compiler::compile_all(&inspector, conditions, 4, NULL, true);
+	EXPECT_EQ(before, num_decoders());
+
+	for(sinsp_filter* filter : deferred)
+	{
+		EXPECT_TRUE(filter->has_deferred_state());
+		filter->alloc_state();
+		EXPECT_FALSE(filter->has_deferred_state());
+	}
+	EXPECT_EQ(before + 1, num_decoders());
+
+	std::vector<sinsp_filter*> allocated = sinsp_filter_compiler::compile_all(&inspector, conditions, 4);
+	EXPECT_EQ(before + 1, num_decoders());
+
+	for(size_t j = 0; j < conditions.size(); j++)
+	{
+		EXPECT_FALSE(allocated[j]->has_deferred_state());
+		EXPECT_TRUE(deferred[j]->run(evt.get(3)));
+		EXPECT_FALSE(deferred[j]->run(evt.get(4)));
+		EXPECT_FALSE(allocated[j]->run(evt.get(4)));
+		delete deferred[j];
+		delete allocated[j];
+	}
+}
+
+//
+// A benchmark, run it with --gtest_also_run_disabled_tests
+//
+TEST(filter, DISABLED_load_time)
+{
+	sinsp inspector;
+
+	for(uint32_t nrules : {100, 1000, 3000})
+	{
+		std::string n = std::to_string(nrules);
+		RecordProperty("serial_" + n + "_rules_ms", (int)load_ms(&inspector, nrules, 1));
+		RecordProperty("parallel_" + n + "_rules_ms", (int)load_ms(&inspector, nrules, 0));
+	}
+}
+
+TEST(filter, evttype_dispatch)
+{
+	sinsp inspector;
+	sinsp_evttype_filter ruleset;
+	add_num_rules(&inspector, ruleset, 40);
+	container_json_event evt(&inspector);
+
+	std::vector<uint32_t> matches;
+	EXPECT_EQ(0u, ruleset.run_all(evt.get(3), matches));
+	EXPECT_FALSE(ruleset.run(evt.get(3)));
+
+	//
+	// All the matching rules are returned, in the order they were added
+	//
+	ruleset.enable("rule.*", true);
+	ruleset.enable("rule.*", true);
+	EXPECT_TRUE(ruleset.run(evt.get(3)));
+	ASSERT_EQ(4u, ruleset.run_all(evt.get(3), matches));
+	EXPECT_EQ("rule3", ruleset.get_rule_name(matches[0]));
+	EXPECT_EQ("rule13", ruleset.get_rule_name(matches[1]));
+	EXPECT_EQ("rule23", ruleset.get_rule_name(matches[2]));
+	EXPECT_EQ("rule33", ruleset.get_rule_name(matches[3]));
+
+	ruleset.enable("rule1.*", false);
+	ASSERT_EQ(3u, ruleset.run_all(evt.get(3), matches));
+	EXPECT_EQ("rule3", ruleset.get_rule_name(matches[0]));
+	EXPECT_EQ("rule23", ruleset.get_rule_name(matches[1]));
+
+	std::vector<bool> evttypes;
+	ruleset.evttypes_for_ruleset(evttypes, 0);
+	EXPECT_EQ(2, std::count(evttypes.begin(), evttypes.end(), true));
+	EXPECT_TRUE(evttypes[PPME_CONTAINER_JSON_E]);
+	EXPECT_TRUE(evttypes[PPME_SYSCALL_OPEN_X]);
+
+	//
+	// The rulesets are independent
+	//
+	ruleset.enable_tags({"tag3", "tag7"}, true, 2);
+	ASSERT_EQ(2u, ruleset.run_all(evt.get(3), matches, 2));
+	EXPECT_EQ("rule3", ruleset.get_rule_name(matches[0]));
+	EXPECT_EQ("rule23", ruleset.get_rule_name(matches[1]));
+	ASSERT_EQ(1u, ruleset.run_all(evt.get(5), matches, 2));
+	EXPECT_EQ("rule35", ruleset.get_rule_name(matches[0]));
+	EXPECT_EQ(0u, ruleset.run_all(evt.get(3), matches, 1));
+	EXPECT_EQ(3u, ruleset.run_all(evt.get(3), matches, 0));
+}
+
+//
+// Each ruleset runs the rules of its tag, in the order they were added
+//
+TEST(filter, evttype_dispatch_rulesets)
+{
+	sinsp inspector;
+	sinsp_evttype_filter ruleset;
+	add_num_rules(&inspector, ruleset, 100);
+	container_json_event evt(&inspector);
+
+	for(uint16_t j = 0; j < 16; j++)
+	{
+		ruleset.enable_tags({"tag" + std::to_string(j)}, true, j);
+	}
+
+	std::vector<uint32_t> matches;
+	for(uint16_t j = 0; j < 16; j++)
+	{
+		for(uint64_t num = 0; num < 10; num++)
+		{
+			std::vector<std::string> expected;
+			for(uint32_t k = 0; k < 100; k++)
+			{
+				if(k % 10 == num && k % 16 == j)
+				{
+					expected.push_back("rule" + std::to_string(k));
+				}
+			}
+
+			ASSERT_EQ(expected.size(), ruleset.run_all(evt.get(num), matches, j));
+			std::vector<std::string> names;
+			for(uint32_t m : matches)
+			{
+				names.push_back(ruleset.get_rule_name(m));
+			}
+			EXPECT_EQ(expected, names) << "ruleset " << j << ", event " << num;
+		}
+	}
+
+	// a ruleset with no enabled rule
+	EXPECT_EQ(0u, ruleset.run_all(evt.get(0), matches, 16));
+}
+
+//
+// A benchmark, run it with --gtest_also_run_disabled_tests
+//
+TEST(filter, DISABLED_evttype_dispatch_time)
+{
+	sinsp inspector;
+	sinsp_evttype_filter ruleset;
+	add_num_rules(&inspector, ruleset, 1000);
+	container_json_event evt(&inspector);
+
+	for(uint16_t nrulesets : {1, 16})
+	{
+		for(uint16_t j = 0; j < nrulesets; j++)
+		{
+			ruleset.enable_tags({"tag" + std::to_string(j)}, true, j);
+		}
+
+		std::vector<uint32_t> matches;
+		uint64_t nmatches = 0;
+		auto start = std::chrono::steady_clock::now();
+		for(uint64_t num = 0; num < 10000; num++)
+		{
+			for(uint16_t j = 0; j < nrulesets; j++)
+			{
+				nmatches += ruleset.run_all(evt.get(num % 10), matches, j);
+			}
+		}
+		auto end = std::chrono::steady_clock::now();
+
+		// every rule matches one event in ten, in the ruleset of its tag
+		uint64_t nrules = 1000 / 16 * nrulesets + std::min(1000 % 16, (int)nrulesets);
+		EXPECT_EQ(nrules * 10000 / 10, nmatches);
+		RecordProperty(std::to_string(nrulesets) + "_rulesets_ms",
+			       (int)std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count());
+	}
+}
+
+TEST(filter, rule_profiler)
+{
+	sinsp inspector;
+	sinsp_evttype_filter ruleset;
+	add_num_rules(&inspector, ruleset, 10);
+
+	std::vector<sinsp_evttype_filter::rule_spec> rules(1);
+	rules[0].name = "two_fields";
+	rules[0].condition = "evt.num < 5 and (evt.cpu = 0 or evt.num = 7)";
+	rules[0].evttypes.insert(PPME_CONTAINER_JSON_E);
+	ruleset.add_all(&inspector, rules);
+
+	ruleset.enable(".*", true);
+	ruleset.enable_profiling(2);
+	container_json_event evt(&inspector);
+
+	std::vector<uint32_t> matches;
+	for(uint64_t num = 0; num < 100; num++)
+	{
+		ruleset.run_all(evt.get(num % 10), matches);
+	}
+
+	const auto& stats = ruleset.get_profiler()->get_stats();
+	ASSERT_EQ(11u, stats.size());
+	for(uint32_t j = 0; j < 10; j++)
+	{
+		EXPECT_EQ("rule" + std::to_string(j), stats[j].m_name);
+		EXPECT_EQ(100u, stats[j].m_evaluations);
+		EXPECT_EQ(10u, stats[j].m_matches);
+		EXPECT_EQ(50u, stats[j].m_sampled);
+		EXPECT_EQ(50u, stats[j].m_costs.m_count);
+		ASSERT_EQ(1u, stats[j].m_leaves.size());
+		EXPECT_EQ(50u, stats[j].m_leaves.at("evt.num").m_evaluations);
+	}
+
+	//
+	// The timed evaluations are the ones of the even event numbers, and
+	// evt.cpu only runs when evt.num < 5
+	//
+	const auto& two_fields = stats[10];
+	EXPECT_EQ(50u, two_fields.m_matches);
+	ASSERT_EQ(2u, two_fields.m_leaves.size());
+	EXPECT_EQ(50u, two_fields.m_leaves.at("evt.num").m_evaluations);
+	EXPECT_EQ(30u, two_fields.m_leaves.at("evt.cpu").m_evaluations);
+	EXPECT_GE(two_fields.m_costs.quantile(0.99), two_fields.m_costs.quantile(0.5));
+	EXPECT_GE(two_fields.get_cumulative_cost(), two_fields.m_sampled_cost);
+
+	Json::Value profile;
+	ASSERT_TRUE(Json::Reader().parse(ruleset.get_profiler()->to_json(), profile));
+	ASSERT_EQ(11u, profile.size());
+	for(const auto& rule : profile)
+	{
+		EXPECT_EQ(100u, rule["evaluations"].asUInt64());
+		EXPECT_TRUE(rule.isMember("p99_cost"));
+	}
+
+	//
+	// Without the profiler, the filters are back as they were
+	//
+	ruleset.disable_profiling();
+	EXPECT_EQ(nullptr, ruleset.get_profiler());
+	ASSERT_EQ(2u, ruleset.run_all(evt.get(3), matches));
+	EXPECT_EQ("rule3", ruleset.get_rule_name(matches[0]));
+	EXPECT_EQ("two_fields", ruleset.get_rule_name(matches[1]));
+}
+
+TEST(filter, cost_histogram)
+{
+	libsinsp::rule_profiler::cost_histogram hist;
+	EXPECT_EQ(0u, hist.quantile(0.99));
+
+	for(uint64_t cost = 1; cost <= 1000; cost++)
+	{
+		hist.add(cost);
+	}
+
+	// within the 25% resolution of the buckets
+	EXPECT_GE(hist.quantile(0.99), 990u);
+	EXPECT_LE(hist.quantile(0.99), 990u * 5 / 4);
+	EXPECT_GE(hist.quantile(0.5), 500u);
+	EXPECT_LE(hist.quantile(0.5), 500u * 5 / 4);
+
+	for(uint32_t idx = 1; idx < libsinsp::rule_profiler::cost_histogram::NUM_BUCKETS; idx++)
+	{
+		uint64_t bound = libsinsp::rule_profiler::cost_histogram::bucket_upper_bound(idx);
+		EXPECT_EQ(idx, libsinsp::rule_profiler::cost_histogram::bucket(bound));
+		EXPECT_EQ(idx, libsinsp::rule_profiler::cost_histogram::bucket(libsinsp::rule_profiler::cost_histogram::bucket_upper_bound(idx - 1) + 1));
+	}
+}
+
+TEST(filter, optimizer_static)
+{
+	sinsp inspector;
+	const std::string fltstr = "fd.sip.name = a or (not evt.num = 3 and (evt.cpu = 1 or evt.num < 5) and proc.name pmatch (/x, /y) and evt.num != 7) or not evt.num > 2";
+
+	std::unique_ptr<sinsp_filter> original(sinsp_filter_compiler(&inspector, fltstr).compile());
+	std::unique_ptr<sinsp_filter> optimized(sinsp_filter_compiler(&inspector, fltstr).compile());
+	sinsp_filter_optimizer::optimize(optimized.get());
+
+	//
+	// The DNS lookup goes last, and the cheap checks most likely to
+	// short-circuit the 'and' go first
+	//
+	gen_event_filter_expression* root = optimized->m_filter;
+	EXPECT_EQ(std::vector<std::string>({"evt.num", "()", "fd.sip.name"}), check_fields(root));
+	EXPECT_EQ(BO_NOT, root->m_checks[0]->m_boolop);
+	EXPECT_EQ(BO_OR, root->m_checks[1]->m_boolop);
+	EXPECT_EQ(BO_OR, root->m_checks[2]->m_boolop);
+
+	gen_event_filter_expression* sub = dynamic_cast<gen_event_filter_expression*>(root->m_checks[1]);
+	ASSERT_NE(nullptr, sub);
+	EXPECT_EQ(std::vector<std::string>({"()", "evt.num", "evt.num", "proc.name"}), check_fields(sub));
+	EXPECT_EQ(BO_NONE, sub->m_checks[0]->m_boolop);
+	EXPECT_EQ(BO_ANDNOT, sub->m_checks[1]->m_boolop);
+	EXPECT_EQ(CO_EQ, sub->m_checks[1]->m_cmpop);
+	EXPECT_EQ(BO_AND, sub->m_checks[2]->m_boolop);
+	EXPECT_EQ(CO_NE, sub->m_checks[2]->m_cmpop);
+
+	gen_event_filter_expression* subsub = dynamic_cast<gen_event_filter_expression*>(sub->m_checks[0]);
+	ASSERT_NE(nullptr, subsub);
+	EXPECT_EQ(CO_LT, subsub->m_checks[0]->m_cmpop);
+	EXPECT_EQ(BO_NONE, subsub->m_checks[0]->m_boolop);
+	EXPECT_EQ(BO_OR, subsub->m_checks[1]->m_boolop);
+
+	container_json_event evt(&inspector);
+	for(uint64_t num = 0; num < 10; num++)
+	{
+		for(uint16_t cpu = 0; cpu < 2; cpu++)
+		{
+			sinsp_evt* e = evt.get(num);
+			e->m_cpuid = cpu;
+			EXPECT_EQ(original->run(e), optimized->run(e)) << num << " " << cpu;
+		}
+	}
+
+	//
+	// The expressions with a check id keep their order
+	//
+	std::unique_ptr<sinsp_filter> with_id(sinsp_filter_compiler(&inspector, "fd.sip.name = a and evt.num = 3").compile());
+	with_id->m_filter->m_checks[0]->set_check_id(5);
+	sinsp_filter_optimizer::optimize(with_id.get());
+	EXPECT_EQ(std::vector<std::string>({"fd.sip.name", "evt.num"}), check_fields(with_id->m_filter));
+}
+
+TEST(filter, optimizer_runtime)
+{
+	sinsp inspector;
+	sinsp_evttype_filter ruleset;
+
+	std::vector<sinsp_evttype_filter::rule_spec> rules(1);
+	rules[0].name = "rule";
+	rules[0].condition = "evt.num != 3 and evt.cpu = 0";
+	rules[0].evttypes.insert(PPME_CONTAINER_JSON_E);
+	ruleset.add_all(&inspector, rules);
+	ruleset.enable(".*", true);
+
+	container_json_event evt(&inspector);
+	{
+		sinsp_filter_optimizer optimizer(4, 100);
+		ruleset.profile_checks(optimizer);
+
+		// not enough statistics yet: the static model puts evt.cpu first
+		optimizer.optimize_profiled();
+
+		//
+		// evt.cpu always passes and evt.num != 3 mostly fails, so the
+		// runtime statistics put evt.num first
+		//
+		uint32_t nmatches = 0;
+		for(uint64_t j = 0; j < 1000; j++)
+		{
+			nmatches += ruleset.run(evt.get(j % 10 == 0 ? 4 : 3));
+		}
+		EXPECT_EQ(100u, nmatches);
+
+		optimizer.optimize_profiled();
+		nmatches = 0;
+		for(uint64_t j = 0; j < 1000; j++)
+		{
+			nmatches += ruleset.run(evt.get(j % 10 == 0 ? 4 : 3));
+		}
+		EXPECT_EQ(100u, nmatches);
+	}
+
+	//
+	// The order stays once the optimizer is gone: run the filter again
+	// through a profiler to look at the checks
+	//
+	ruleset.enable_profiling(1);
+	std::vector<uint32_t> matches;
+	ruleset.run_all(evt.get(3), matches);
+	const auto& leaves = ruleset.get_profiler()->get_stats()[0].m_leaves;
+	EXPECT_EQ(1u, leaves.at("evt.num").m_evaluations);
+	EXPECT_EQ(0u, leaves.at("evt.cpu").m_evaluations);
+}
+
+TEST(filter, optimizer_with_profiler)
+{
+	sinsp inspector;
+	sinsp_evttype_filter ruleset;
+
+	std::vector<sinsp_evttype_filter::rule_spec> rules(1);
+	rules[0].name = "rule";
+	rules[0].condition = "evt.num != 3 and evt.cpu = 0";
+	rules[0].evttypes.insert(PPME_CONTAINER_JSON_E);
+	ruleset.add_all(&inspector, rules);
+	ruleset.enable(".*", true);
+
+	container_json_event evt(&inspector);
+	auto run = [&]()
+	{
+		uint32_t nmatches = 0;
+		for(uint64_t j = 0; j < 1000; j++)
+		{
+			nmatches += ruleset.run(evt.get(j % 10 == 0 ? 4 : 3));
+		}
+		return nmatches;
+	};
+
+	//
+	// The profiler wraps the proxies of the optimizer, which go away
+	// first
+	//
+	{
+		sinsp_filter_optimizer optimizer(4, 100);
+		ruleset.profile_checks(optimizer);
+		ruleset.enable_profiling(1);
+
+		EXPECT_EQ(100u, run());
+		optimizer.optimize_profiled();
+		EXPECT_EQ(100u, run());
+
+		const auto& leaves = ruleset.get_profiler()->get_stats()[0].m_leaves;
+		ASSERT_EQ(2u, leaves.size());
+		EXPECT_EQ(2000u, leaves.at("evt.num").m_evaluations);
+	}
+
+	EXPECT_EQ(100u, run());
+	ruleset.disable_profiling();
+	EXPECT_EQ(100u, run());
+
+	//
+	// The optimizer wraps the proxies of the profiler, and goes away
+	// first
+	//
+	ruleset.enable_profiling(1);
+	{
+		sinsp_filter_optimizer optimizer(4, 100);
+		ruleset.profile_checks(optimizer);
+
+		EXPECT_EQ(100u, run());
+		optimizer.optimize_profiled();
+		EXPECT_EQ(100u, run());
+	}
+
+	EXPECT_EQ(100u, run());
+	const auto& leaves = ruleset.get_profiler()->get_stats()[0].m_leaves;
+	ASSERT_EQ(2u, leaves.size());
+	EXPECT_EQ(3000u, leaves.at("evt.num").m_evaluations);
+	ruleset.disable_profiling();
+	EXPECT_EQ(100u, run());
+}
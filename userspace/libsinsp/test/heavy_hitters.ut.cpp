@@ -0,0 +1,303 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// the test suppresses comms the way sinsp::next() does
+#define VISIBILITY_PRIVATE
+
+#include "sinsp.h"
+#include "heavy_hitters.h"
+#include "container_test_utils.h"
+#include <gtest.h>
+#include <unistd.h>
+
+using libsinsp::heavy_hitters;
+
+TEST(heavy_hitters, top)
+{
+	// a small sketch, so that the keys collide
+	heavy_hitters hh(4, 64, 4);
+	uint64_t ts = 1000000000;
+	std::string comms[] = {"noisy", "busy", "idle"};
+	std::string host;
+	std::string container = "c0ffee";
+
+	//
+	// 1000 events from tid 10, 500 from tid 20, and one from each of
+	// 1000 other threads, all in the first half of the window
+	//
+	for(uint32_t j = 0; j < 1000; j++)
+	{
+		hh.add(10, comms[0], container, ts + j);
+		if(j % 2 == 0)
+		{
+			hh.add(20, comms[1], host, ts + j);
+		}
+		hh.add(1000 + j, comms[2], host, ts + j);
+	}
+
+	// before the end of the first window, the current one is returned
+	std::vector<heavy_hitters::entry> top = hh.top(heavy_hitters::KEY_TID, 2);
+	ASSERT_EQ(2u, top.size());
+	EXPECT_EQ("10", top[0].m_key);
+	EXPECT_GE(top[0].m_count, 1000u);
+	EXPECT_EQ("20", top[1].m_key);
+	EXPECT_GE(top[1].m_count, 500u);
+
+	// the window ends with the first event after it
+	hh.add(30, comms[2], host, ts + 1000000000);
+
+	top = hh.top(heavy_hitters::KEY_COMM, 10);
+	ASSERT_EQ(3u, top.size());
+	EXPECT_EQ("noisy", top[0].m_key);
+	EXPECT_EQ("idle", top[1].m_key);
+	EXPECT_EQ(1000u, top[1].m_count);
+	EXPECT_EQ("busy", top[2].m_key);
+	EXPECT_DOUBLE_EQ(500.0, top[2].m_rate);
+
+	top = hh.top(heavy_hitters::KEY_CONTAINER, 10);
+	ASSERT_EQ(2u, top.size());
+	EXPECT_EQ("", top[0].m_key);
+	EXPECT_EQ(1500u, top[0].m_count);
+	EXPECT_EQ(container, top[1].m_key);
+
+	heavy_hitters::entry offender;
+	EXPECT_FALSE(hh.pop_offender(&offender));
+}
+
+TEST(heavy_hitters, rate_limit)
+{
+	heavy_hitters hh;
+	uint64_t ts = 1000000000;
+	std::string comm = "noisy";
+	std::string container = "c0ffee";
+	heavy_hitters::entry offender;
+
+	hh.set_rate_limit(heavy_hitters::KEY_TID, 100);
+	hh.set_rate_limit(heavy_hitters::KEY_CONTAINER, 150);
+
+	for(uint32_t j = 0; j < 100; j++)
+	{
+		hh.add(10, comm, container, ts + j);
+	}
+	EXPECT_FALSE(hh.pop_offender(&offender));
+
+	hh.add(10, comm, container, ts + 100);
+	ASSERT_TRUE(hh.pop_offender(&offender));
+	EXPECT_EQ(heavy_hitters::KEY_TID, offender.m_type);
+	EXPECT_EQ("10", offender.m_key);
+	EXPECT_EQ(101u, offender.m_count);
+	EXPECT_FALSE(hh.pop_offender(&offender));
+
+	// reported once
+	for(uint32_t j = 0; j < 100; j++)
+	{
+		hh.add(10, comm, container, ts + 200 + j);
+	}
+	ASSERT_TRUE(hh.pop_offender(&offender));
+	EXPECT_EQ(heavy_hitters::KEY_CONTAINER, offender.m_type);
+	EXPECT_EQ(container, offender.m_key);
+	EXPECT_FALSE(hh.pop_offender(&offender));
+
+	// and not again in the next windows
+	for(uint32_t j = 0; j <= 100; j++)
+	{
+		hh.add(10, comm, container, ts + 1000000000 + j);
+	}
+	EXPECT_FALSE(hh.pop_offender(&offender));
+
+	// other keys still are
+	for(uint32_t j = 0; j <= 100; j++)
+	{
+		hh.add(11, comm, container, ts + 1000000200 + j);
+	}
+	ASSERT_TRUE(hh.pop_offender(&offender));
+	EXPECT_EQ(heavy_hitters::KEY_TID, offender.m_type);
+	EXPECT_EQ("11", offender.m_key);
+	EXPECT_FALSE(hh.pop_offender(&offender));
+}
+
+TEST(heavy_hitters, report_again)
+{
+	heavy_hitters hh;
+	uint64_t ts = 1000000000;
+	std::string comm = "noisy";
+	std::string host;
+	heavy_hitters::entry offender;
+
+	hh.set_rate_limit(heavy_hitters::KEY_TID, 100);
+	hh.set_rate_limit(heavy_hitters::KEY_COMM, 100);
+	hh.set_report_expiry(3);
+
+	// 101 events of tid 10, over the limit of both the tid and the comm
+	auto burst = [&](uint64_t start)
+	{
+		for(uint32_t j = 0; j <= 100; j++)
+		{
+			hh.add(10, comm, host, start + j);
+		}
+	};
+
+	burst(ts);
+	ASSERT_TRUE(hh.pop_offender(&offender));
+	EXPECT_EQ(heavy_hitters::KEY_TID, offender.m_type);
+	ASSERT_TRUE(hh.pop_offender(&offender));
+	EXPECT_EQ(heavy_hitters::KEY_COMM, offender.m_type);
+	EXPECT_FALSE(hh.pop_offender(&offender));
+
+	// suppressing the comm failed: it's reported again in the next window
+	hh.retry(offender);
+	burst(ts + 200);
+	EXPECT_FALSE(hh.pop_offender(&offender));
+	burst(ts + 1000000000);
+	ASSERT_TRUE(hh.pop_offender(&offender));
+	EXPECT_EQ(heavy_hitters::KEY_COMM, offender.m_type);
+	EXPECT_FALSE(hh.pop_offender(&offender));
+
+	// the thread exited and its tid was recycled
+	hh.forget_tid(10);
+	burst(ts + 1000000200);
+	ASSERT_TRUE(hh.pop_offender(&offender));
+	EXPECT_EQ(heavy_hitters::KEY_TID, offender.m_type);
+	EXPECT_EQ("10", offender.m_key);
+	EXPECT_FALSE(hh.pop_offender(&offender));
+
+	// both were reported in window 1, and expire 3 windows later, even
+	// if some of them had no events
+	burst(ts + 3000000000);
+	EXPECT_FALSE(hh.pop_offender(&offender));
+	burst(ts + 4000000000);
+	ASSERT_TRUE(hh.pop_offender(&offender));
+	EXPECT_EQ(heavy_hitters::KEY_TID, offender.m_type);
+	ASSERT_TRUE(hh.pop_offender(&offender));
+	EXPECT_EQ(heavy_hitters::KEY_COMM, offender.m_type);
+	EXPECT_FALSE(hh.pop_offender(&offender));
+}
+
+TEST(heavy_hitters, retry_backoff)
+{
+	heavy_hitters hh;
+	uint64_t ts = 1000000000;
+	std::string comm = "noisy";
+	std::string host;
+	heavy_hitters::entry offender;
+
+	hh.set_rate_limit(heavy_hitters::KEY_COMM, 100);
+	hh.set_report_expiry(8);
+
+	//
+	// The suppression of the comm always fails: it's reported in the
+	// windows 1, 2, 4 and 8 windows apart, the report expiry
+	//
+	std::vector<uint64_t> windows;
+	std::vector<uint32_t> failures;
+	for(uint64_t w = 0; w < 24; w++)
+	{
+		for(uint32_t j = 0; j <= 100; j++)
+		{
+			hh.add(10, comm, host, ts + w * 1000000000 + j);
+		}
+
+		while(hh.pop_offender(&offender))
+		{
+			windows.push_back(w);
+			failures.push_back(offender.m_failures);
+			hh.retry(offender);
+		}
+	}
+
+	EXPECT_EQ(std::vector<uint64_t>({0, 1, 3, 7, 15, 23}), windows);
+	EXPECT_EQ(std::vector<uint32_t>({0, 1, 2, 3, 4, 5}), failures);
+
+	//
+	// This time the suppression works, so the next time the comm is
+	// noisy, after the report expiry, it's a fresh offender
+	//
+	for(uint32_t j = 0; j <= 100; j++)
+	{
+		hh.add(10, comm, host, ts + 31000000000 + j);
+	}
+	ASSERT_TRUE(hh.pop_offender(&offender));
+	EXPECT_EQ(6u, offender.m_failures);
+	for(uint32_t j = 0; j <= 100; j++)
+	{
+		hh.add(10, comm, host, ts + 39000000000 + j);
+	}
+	ASSERT_TRUE(hh.pop_offender(&offender));
+	EXPECT_EQ(0u, offender.m_failures);
+}
+
+TEST(heavy_hitters, suppress_comm)
+{
+	sinsp inspector;
+	inspector.open_nodriver();
+
+	auto tinfo = inspector.get_thread_ref(getpid());
+	ASSERT_NE(nullptr, tinfo);
+	ASSERT_FALSE(inspector.check_suppressed(getpid()));
+
+	// the comm table is full, the running threads are suppressed anyway
+	for(uint32_t j = 0; j < SCAP_MAX_SUPPRESSED_COMMS; j++)
+	{
+		inspector.suppress_events_comm("comm" + std::to_string(j));
+	}
+	EXPECT_FALSE(inspector.suppress_events_comm(tinfo->m_comm));
+
+	EXPECT_FALSE(inspector.suppress_heavy_hitter_comm(tinfo->m_comm, sinsp_logger::SEV_WARNING));
+	EXPECT_TRUE(inspector.check_suppressed(getpid()));
+
+	inspector.close();
+}
+
+TEST(heavy_hitters, unsuppress_container)
+{
+	sinsp inspector;
+	inspector.open_nodriver();
+
+	heavy_hitters hh;
+	hh.set_report_expiry(5);
+	EXPECT_EQ(5 * 1000000000ULL, hh.get_report_expiry_ns());
+
+	// the suppression expires with the report
+	uint64_t ts = 1000000000;
+	inspector.suppress_events_container("c0ffee", ts + hh.get_report_expiry_ns());
+	EXPECT_TRUE(inspector.check_suppressed_container("c0ffee", ts));
+	EXPECT_FALSE(inspector.check_suppressed_container("decade", ts));
+	EXPECT_TRUE(inspector.check_suppressed_container("c0ffee", ts + hh.get_report_expiry_ns() - 1));
+	EXPECT_FALSE(inspector.check_suppressed_container("c0ffee", ts + hh.get_report_expiry_ns()));
+	EXPECT_TRUE(inspector.m_suppressed_containers.empty());
+
+	// or when it's lifted
+	inspector.suppress_events_container("c0ffee");
+	EXPECT_TRUE(inspector.check_suppressed_container("c0ffee", UINT64_MAX - 1));
+	EXPECT_TRUE(inspector.unsuppress_events_container("c0ffee"));
+	EXPECT_FALSE(inspector.unsuppress_events_container("c0ffee"));
+	EXPECT_FALSE(inspector.check_suppressed_container("c0ffee", ts));
+
+	// or when the container goes away, since its id can come back
+	inspector.m_container_manager.add_container(make_container("c0ffee"), nullptr);
+	inspector.suppress_events_container("c0ffee");
+	inspector.m_lastevent_ts = ts;
+	EXPECT_FALSE(inspector.m_container_manager.remove_inactive_containers());
+	inspector.m_lastevent_ts += inspector.m_inactive_container_scan_time_ns + 31 * ONE_SECOND_IN_NS;
+	EXPECT_TRUE(inspector.m_container_manager.remove_inactive_containers());
+	EXPECT_FALSE(inspector.check_suppressed_container("c0ffee", ts));
+
+	// or when the capture is closed
+	inspector.suppress_events_container("c0ffee");
+	inspector.close();
+	EXPECT_TRUE(inspector.m_suppressed_containers.empty());
+}
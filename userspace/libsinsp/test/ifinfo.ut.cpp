@@ -0,0 +1,94 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "sinsp.h"
+#include "container_test_utils.h"
+#include <gtest.h>
+#include <arpa/inet.h>
+
+namespace
+{
+uint32_t ipv4(const char* addr)
+{
+	return inet_addr(addr);
+}
+}
+
+TEST(ifinfo, local_ipv4_addresses)
+{
+	sinsp inspector;
+	sinsp_network_interfaces interfaces(&inspector);
+	interfaces.import_ipv4_interface(sinsp_ipv4_ifinfo(ipv4("192.168.1.10"), ipv4("255.255.255.0"), 0, "eth0"));
+
+	sinsp_threadinfo host_thread(&inspector);
+	sinsp_threadinfo container_thread(&inspector);
+	container_thread.m_container_id = "aaaaaaaaaaaa";
+	sinsp_threadinfo shared_thread(&inspector);
+	shared_thread.m_container_id = "bbbbbbbbbbbb";
+
+	EXPECT_TRUE(interfaces.is_ipv4addr_in_local_machine(ipv4("192.168.1.10"), &host_thread));
+	EXPECT_FALSE(interfaces.is_ipv4addr_in_local_machine(ipv4("192.168.1.11"), &host_thread));
+	// unknown containers only match the host interfaces
+	EXPECT_TRUE(interfaces.is_ipv4addr_in_local_machine(ipv4("192.168.1.10"), &container_thread));
+	EXPECT_FALSE(interfaces.is_ipv4addr_in_local_machine(ipv4("172.17.0.2"), &container_thread));
+
+	// the container ips are in host order
+	inspector.m_container_manager.add_container(make_container("aaaaaaaaaaaa", ntohl(ipv4("172.17.0.2"))), nullptr);
+	inspector.m_container_manager.add_container(make_container("bbbbbbbbbbbb", 0), nullptr);
+	inspector.m_container_manager.add_container(make_container("cccccccccccc", ntohl(ipv4("172.17.0.3"))), nullptr);
+
+	EXPECT_TRUE(interfaces.is_ipv4addr_in_local_machine(ipv4("172.17.0.2"), &container_thread));
+	EXPECT_FALSE(interfaces.is_ipv4addr_in_local_machine(ipv4("172.17.0.3"), &container_thread));
+	EXPECT_TRUE(interfaces.is_ipv4addr_in_local_machine(ipv4("192.168.1.10"), &container_thread));
+	EXPECT_FALSE(interfaces.is_ipv4addr_in_local_machine(ipv4("172.17.0.2"), &host_thread));
+
+	// a container without an ip matches the ones of all the containers
+	EXPECT_TRUE(interfaces.is_ipv4addr_in_local_machine(ipv4("172.17.0.2"), &shared_thread));
+	EXPECT_TRUE(interfaces.is_ipv4addr_in_local_machine(ipv4("172.17.0.3"), &shared_thread));
+	EXPECT_FALSE(interfaces.is_ipv4addr_in_local_machine(ipv4("172.17.0.4"), &shared_thread));
+
+	// a container that changes its ip
+	inspector.m_container_manager.add_container(make_container("cccccccccccc", ntohl(ipv4("172.17.0.4"))), nullptr);
+	EXPECT_FALSE(interfaces.is_ipv4addr_in_local_machine(ipv4("172.17.0.3"), &shared_thread));
+	EXPECT_TRUE(interfaces.is_ipv4addr_in_local_machine(ipv4("172.17.0.4"), &shared_thread));
+
+	interfaces.clear();
+	EXPECT_FALSE(interfaces.is_ipv4addr_in_local_machine(ipv4("192.168.1.10"), &host_thread));
+}
+
+TEST(ifinfo, local_ipv6_addresses)
+{
+	sinsp inspector;
+	sinsp_network_interfaces interfaces(&inspector);
+
+	sinsp_ipv6_ifinfo eth0;
+	ASSERT_EQ(1, inet_pton(AF_INET6, "fd00:1:2:3::10", eth0.m_net.m_b));
+	eth0.m_name = "eth0";
+	interfaces.import_ipv6_interface(eth0);
+
+	sinsp_threadinfo host_thread(&inspector);
+	sinsp_threadinfo container_thread(&inspector);
+	container_thread.m_container_id = "aaaaaaaaaaaa";
+
+	ipv6addr addr;
+	ASSERT_EQ(1, inet_pton(AF_INET6, "fd00:1:2:3::20", addr.m_b));
+	EXPECT_TRUE(interfaces.is_ipv6addr_in_local_machine(addr, &host_thread));
+	EXPECT_FALSE(interfaces.is_ipv6addr_in_local_machine(addr, &container_thread));
+
+	ASSERT_EQ(1, inet_pton(AF_INET6, "fd00:1:2:4::10", addr.m_b));
+	EXPECT_FALSE(interfaces.is_ipv6addr_in_local_machine(addr, &host_thread));
+}
@@ -0,0 +1,113 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include <gtest.h>
+#include <json_list_splitter.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+struct collector
+{
+	json_list_splitter m_splitter;
+	std::vector<std::string> m_docs;
+
+	collector(size_t batch_size):
+		m_splitter([this](std::string&& doc) { m_docs.emplace_back(std::move(doc)); },
+			   "items", batch_size)
+	{
+	}
+
+	// feed the input one byte at a time to exercise chunk boundaries
+	void feed(const std::string& data)
+	{
+		for(char c : data)
+		{
+			m_splitter.feed(&c, 1);
+		}
+	}
+};
+}
+
+TEST(json_list_splitter_test, list_batches)
+{
+	collector c(1);
+	c.feed("{\"kind\": \"PodList\",\n \"apiVersion\": \"v1\",\n \"items\": [\n"
+	       "  {\"name\": \"a, ]}\\\"\"},\n  {\"name\": \"b\", \"ports\": [1, 2]}\n ]\n}\n");
+	ASSERT_TRUE(c.m_splitter.finish());
+	ASSERT_EQ(2u, c.m_docs.size());
+	EXPECT_EQ("{\"kind\":\"PodList\",\"apiVersion\":\"v1\",\"items\":[{\"name\":\"a, ]}\\\"\"}]}", c.m_docs[0]);
+	EXPECT_EQ("{\"kind\":\"PodList\",\"apiVersion\":\"v1\",\"items\":[{\"name\":\"b\",\"ports\":[1,2]}]}", c.m_docs[1]);
+	EXPECT_EQ(2u, c.m_splitter.get_item_count());
+}
+
+TEST(json_list_splitter_test, single_batch)
+{
+	collector c(1024);
+	c.feed("{\"kind\":\"NodeList\",\"items\":[{\"a\":1},{\"b\":2}],\"extra\":true}");
+	ASSERT_EQ(1u, c.m_docs.size());
+	EXPECT_EQ("{\"kind\":\"NodeList\",\"items\":[{\"a\":1},{\"b\":2}],\"extra\":true}", c.m_docs[0]);
+}
+
+TEST(json_list_splitter_test, empty_and_null_list)
+{
+	collector c(1);
+	c.feed("{\"kind\":\"PodList\",\"items\":[]}");
+	c.feed("{\"kind\":\"PodList\",\"items\":null}");
+	ASSERT_EQ(2u, c.m_docs.size());
+	EXPECT_EQ("{\"kind\":\"PodList\",\"items\":[]}", c.m_docs[0]);
+	EXPECT_EQ("{\"kind\":\"PodList\",\"items\":null}", c.m_docs[1]);
+	EXPECT_EQ(0u, c.m_splitter.get_item_count());
+}
+
+TEST(json_list_splitter_test, non_list_documents)
+{
+	collector c(1);
+	c.feed("{\"kind\":\"APIVersions\",\"versions\":[\"v1\"],\"nested\":{\"items\":[1,2]}}\n[1,2]\n");
+	ASSERT_EQ(2u, c.m_docs.size());
+	EXPECT_EQ("{\"kind\":\"APIVersions\",\"versions\":[\"v1\"],\"nested\":{\"items\":[1,2]}}", c.m_docs[0]);
+	EXPECT_EQ("[1,2]", c.m_docs[1]);
+}
+
+TEST(json_list_splitter_test, bounded_buffering)
+{
+	collector c(64);
+	std::string item = "{\"name\":\"0123456789012345678901234567890123456789\"}";
+	c.feed("{\"kind\":\"PodList\",\"items\":[");
+	for(int j = 0; j < 10000; ++j)
+	{
+		c.feed(j ? "," + item : item);
+	}
+	c.feed("]}");
+	ASSERT_TRUE(c.m_splitter.finish());
+	EXPECT_EQ(10000u, c.m_splitter.get_item_count());
+	// two 51-byte items fill a 64-byte batch
+	EXPECT_EQ(5000u, c.m_docs.size());
+	EXPECT_LT(c.m_splitter.get_max_buffered(), 256u);
+}
+
+TEST(json_list_splitter_test, incomplete)
+{
+	collector c(1);
+	c.feed("{\"kind\":\"PodList\",\"items\":[{\"a\":");
+	ASSERT_FALSE(c.m_splitter.finish());
+	c.feed("{\"b\":1}");
+	ASSERT_TRUE(c.m_splitter.finish());
+	ASSERT_EQ(1u, c.m_docs.size());
+	EXPECT_EQ("{\"b\":1}", c.m_docs[0]);
+}
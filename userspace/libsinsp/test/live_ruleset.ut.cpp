@@ -0,0 +1,273 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// the test builds events by hand
+#define VISIBILITY_PRIVATE
+
+#include "live_ruleset.h"
+#include "capture_test_utils.h"
+#include "parsers.h"
+#include <gtest.h>
+#include <mutex>
+#include <new>
+
+using libsinsp::live_ruleset;
+
+namespace
+{
+std::atomic<uint32_t> s_deleted(0);
+
+class counted_ruleset : public sinsp_evttype_filter
+{
+public:
+	~counted_ruleset()
+	{
+		s_deleted++;
+	}
+};
+
+//
+// A ruleset matching the PPME_CONTAINER_JSON_E events numbered num
+//
+sinsp_evttype_filter* build(sinsp* inspector, uint64_t num)
+{
+	std::vector<sinsp_evttype_filter::rule_spec> rules(1);
+	rules[0].name = "num";
+	rules[0].condition = "evt.num = " + std::to_string(num);
+	rules[0].evttypes.insert(PPME_CONTAINER_JSON_E);
+
+	counted_ruleset* ruleset = new counted_ruleset();
+	ruleset->add_all(inspector, rules);
+	ruleset->enable(".*", true);
+	return ruleset;
+}
+
+}
+
+TEST(live_ruleset, reload_while_running)
+{
+	sinsp inspector;
+	s_deleted = 0;
+
+	{
+		live_ruleset live(build(&inspector, 0));
+
+		//
+		// The event loop keeps running the rules while they're replaced
+		//
+		std::atomic<bool> stop(false);
+		std::vector<uint64_t> matches(10, 0);
+		std::thread reader([&]()
+		{
+			container_json_event evt(&inspector);
+
+			// until the last rules matched once
+			while(!stop || matches[9] == 0)
+			{
+				for(uint64_t num = 0; num < matches.size(); num++)
+				{
+					if(live.run(evt.get(num)))
+					{
+						matches[num]++;
+					}
+				}
+			}
+		});
+
+		for(uint64_t num = 1; num < 10; num++)
+		{
+			bool reloaded = false;
+			live.reload([&inspector, num]() { return build(&inspector, num); },
+				    [&reloaded](bool successful, const std::string& error)
+				    {
+					    EXPECT_TRUE(successful);
+					    reloaded = successful;
+				    });
+			live.wait_reload();
+			EXPECT_TRUE(reloaded);
+			EXPECT_EQ(num, live.get_generation());
+			EXPECT_EQ(num, s_deleted);
+		}
+
+		stop = true;
+		reader.join();
+		EXPECT_NE(0u, matches[9]);
+
+		//
+		// A failed build leaves the current rules in place
+		//
+		std::string reload_error;
+		live.reload([&inspector]()
+			    {
+				    std::unique_ptr<sinsp_evttype_filter> ruleset(new sinsp_evttype_filter());
+				    std::vector<sinsp_evttype_filter::rule_spec> rules(1);
+				    rules[0].name = "bad";
+				    rules[0].condition = "evt.num =";
+				    ruleset->add_all(&inspector, rules);
+				    return ruleset.release();
+			    },
+			    [&reload_error](bool successful, const std::string& error)
+			    {
+				    EXPECT_FALSE(successful);
+				    reload_error = error;
+			    });
+		live.wait_reload();
+		EXPECT_NE("", reload_error);
+		EXPECT_EQ(9u, live.get_generation());
+
+		container_json_event evt(&inspector);
+		EXPECT_TRUE(live.run(evt.get(9)));
+		EXPECT_FALSE(live.run(evt.get(0)));
+	}
+
+	EXPECT_EQ(10u, s_deleted);
+}
+
+TEST(live_ruleset, reload_while_building)
+{
+	sinsp inspector;
+	live_ruleset live(build(&inspector, 0));
+
+	//
+	// The first build doesn't end until the other reloads are queued,
+	// which must not wait for it
+	//
+	std::mutex building;
+	std::unique_lock<std::mutex> hold(building);
+	std::mutex results_mutex;
+	std::vector<std::string> results;
+	auto cb = [&](const std::string& name)
+	{
+		return [&, name](bool successful, const std::string& error)
+		{
+			std::lock_guard<std::mutex> guard(results_mutex);
+			results.push_back(name + (successful ? "" : ": " + error));
+		};
+	};
+
+	std::atomic<bool> started(false);
+	live.reload([&]()
+		    {
+			    started = true;
+			    std::lock_guard<std::mutex> guard(building);
+			    return build(&inspector, 1);
+		    },
+		    cb("first"));
+	while(!started)
+	{
+		std::this_thread::yield();
+	}
+
+	for(uint64_t num = 2; num < 5; num++)
+	{
+		live.reload([&inspector, num]() { return build(&inspector, num); },
+			    cb("build" + std::to_string(num)));
+	}
+
+	hold.unlock();
+	live.wait_reload();
+
+	//
+	// The last reload wins over the ones queued before it
+	//
+	EXPECT_EQ(std::vector<std::string>({"first",
+					    "build2: superseded by a later reload",
+					    "build3: superseded by a later reload",
+					    "build4"}),
+		  results);
+	EXPECT_EQ(2u, live.get_generation());
+
+	container_json_event evt(&inspector);
+	EXPECT_TRUE(live.run(evt.get(4)));
+
+	//
+	// Any exception of the builder is reported
+	//
+	results.clear();
+	live.reload([]() -> sinsp_evttype_filter* { throw std::bad_alloc(); }, cb("bad_alloc"));
+	live.wait_reload();
+	live.reload([]() -> sinsp_evttype_filter* { throw 42; }, cb("int"));
+	live.wait_reload();
+	ASSERT_EQ(2u, results.size());
+	EXPECT_EQ(0u, results[0].find("bad_alloc: "));
+	EXPECT_EQ("int: unknown error while building the ruleset", results[1]);
+	EXPECT_EQ(2u, live.get_generation());
+	EXPECT_TRUE(live.run(evt.get(4)));
+}
+
+//
+// The protocol decoder of a reloaded ruleset is registered by the
+// thread running the rules, while it runs them
+//
+TEST(live_ruleset, reload_with_state)
+{
+	sinsp inspector;
+	live_ruleset live(build(&inspector, 0));
+	// the syslog decoder watches the opened files
+	size_t decoders = inspector.m_parser->m_open_callbacks.size();
+
+	std::atomic<bool> stop(false);
+	std::atomic<uint64_t> matches(0);
+	std::thread reader([&]()
+	{
+		container_json_event evt(&inspector);
+
+		while(!stop)
+		{
+			matches += live.run(evt.get(5));
+		}
+	});
+
+	bool reloaded = false;
+	size_t decoders_after_build = 0;
+	live.reload([&]()
+		    {
+			    std::vector<sinsp_evttype_filter::rule_spec> rules(1);
+			    rules[0].name = "syslog";
+			    rules[0].condition = "evt.num = 5 and not syslog.facility exists";
+			    rules[0].evttypes.insert(PPME_CONTAINER_JSON_E);
+
+			    sinsp_evttype_filter* ruleset = new sinsp_evttype_filter();
+			    ruleset->add_all(&inspector, rules, 2, true);
+			    ruleset->enable(".*", true);
+			    decoders_after_build = inspector.m_parser->m_open_callbacks.size();
+			    return ruleset;
+		    },
+		    [&](bool successful, const std::string& error)
+		    {
+			    EXPECT_TRUE(successful) << error;
+			    reloaded = successful;
+		    });
+	live.wait_reload();
+
+	EXPECT_TRUE(reloaded);
+	EXPECT_EQ(decoders, decoders_after_build);
+	EXPECT_EQ(1u, live.get_generation());
+
+	// until the new rules matched
+	while(matches == 0)
+	{
+		std::this_thread::yield();
+	}
+	stop = true;
+	reader.join();
+
+	EXPECT_EQ(decoders + 1, inspector.m_parser->m_open_callbacks.size());
+	container_json_event evt(&inspector);
+	EXPECT_TRUE(live.run(evt.get(5)));
+	EXPECT_FALSE(live.run(evt.get(0)));
+}
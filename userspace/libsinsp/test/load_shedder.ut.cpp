@@ -0,0 +1,146 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// the test builds events by hand
+#define VISIBILITY_PRIVATE
+
+#include "load_shedder.h"
+#include "sinsp.h"
+#include <gtest.h>
+
+namespace
+{
+//
+// An event without parameters: the shedder only looks at the header
+//
+class test_event
+{
+public:
+	test_event(sinsp* inspector):
+		m_evt(inspector)
+	{
+		memset(&m_hdr, 0, sizeof(m_hdr));
+		m_hdr.len = sizeof(m_hdr);
+		m_evt.m_pevt = &m_hdr;
+	}
+
+	sinsp_evt* get(uint16_t type, uint64_t ts)
+	{
+		m_hdr.type = type;
+		m_hdr.ts = ts;
+		return &m_evt;
+	}
+
+private:
+	scap_evt m_hdr;
+	sinsp_evt m_evt;
+};
+}
+
+TEST(load_shedder, hysteresis)
+{
+	sinsp inspector;
+	test_event evt(&inspector);
+	libsinsp::load_shedder shedder(0.75, 0.25, 1000);
+	uint64_t ts = 1000000000;
+
+	EXPECT_FALSE(shedder.shed(evt.get(PPME_GENERIC_E, ts), NULL));
+
+	EXPECT_TRUE(shedder.fill_level_due(ts));
+	shedder.update_fill_level(0.5, ts);
+	EXPECT_FALSE(shedder.fill_level_due(ts + 999));
+	EXPECT_TRUE(shedder.fill_level_due(ts + 1000));
+	EXPECT_FALSE(shedder.is_shedding());
+
+	shedder.update_fill_level(0.8, ts);
+	EXPECT_TRUE(shedder.is_shedding());
+
+	// by default, only the events that change the state survive
+	EXPECT_TRUE(shedder.shed(evt.get(PPME_GENERIC_E, ts), NULL));
+	EXPECT_TRUE(shedder.shed(evt.get(PPME_SYSCALL_READ_E, ts), NULL));
+	EXPECT_FALSE(shedder.shed(evt.get(PPME_SYSCALL_CHDIR_E, ts), NULL));
+	EXPECT_FALSE(shedder.shed(evt.get(PPME_SYSCALL_OPEN_X, ts), NULL));
+	EXPECT_FALSE(shedder.shed(evt.get(PPME_CONTAINER_JSON_E, ts), NULL));
+
+	shedder.update_fill_level(0.5, ts + 1000);
+	EXPECT_TRUE(shedder.is_shedding());
+	shedder.update_fill_level(0.2, ts + 2000);
+	EXPECT_FALSE(shedder.is_shedding());
+	EXPECT_FALSE(shedder.shed(evt.get(PPME_GENERIC_E, ts + 2000), NULL));
+
+	const libsinsp::load_shedder::stats& stats = shedder.get_stats();
+	EXPECT_EQ(7u, stats.m_n_evts);
+	EXPECT_EQ(2u, stats.m_n_shed);
+	EXPECT_EQ(3u, stats.m_n_preserved);
+	EXPECT_EQ(1u, stats.m_n_activations);
+	EXPECT_EQ(2000u, stats.m_shedding_ns);
+
+	EXPECT_EQ(1u, shedder.get_shed_count(PPME_GENERIC_E));
+	EXPECT_EQ(1u, shedder.get_shed_count(PPME_SYSCALL_READ_E));
+	EXPECT_EQ(0u, shedder.get_shed_count(PPME_SYSCALL_CHDIR_E));
+	EXPECT_EQ(1u, shedder.get_shed_by_category().at(EC_OTHER));
+	EXPECT_EQ(1u, shedder.get_shed_by_category().at(EC_IO_READ));
+	EXPECT_EQ(2u, shedder.get_shed_by_container().at(""));
+}
+
+TEST(load_shedder, budgets)
+{
+	sinsp inspector;
+	test_event evt(&inspector);
+	libsinsp::load_shedder shedder;
+	uint64_t ts = 1000000000;
+	std::string c1 = "c1";
+	std::string c2 = "c2";
+
+	// 1000 reads per second with bursts of 10, unlimited generic events,
+	// 100 events per second with bursts of 5 for each container
+	shedder.set_category_budget(EC_IO_READ, 1000, 10);
+	shedder.set_category_budget(EC_OTHER, -1, 0);
+	shedder.update_fill_level(1, ts);
+	ASSERT_TRUE(shedder.is_shedding());
+
+	uint32_t kept = 0;
+	for(uint32_t j = 0; j < 20; j++)
+	{
+		kept += !shedder.shed(evt.get(PPME_SYSCALL_READ_E, ts), NULL);
+	}
+	EXPECT_EQ(10u, kept);
+
+	// a millisecond later, one more token
+	EXPECT_FALSE(shedder.shed(evt.get(PPME_SYSCALL_READ_E, ts + 1000000), NULL));
+	EXPECT_TRUE(shedder.shed(evt.get(PPME_SYSCALL_READ_E, ts + 1000000), NULL));
+
+	for(uint32_t j = 0; j < 100; j++)
+	{
+		EXPECT_FALSE(shedder.shed(evt.get(PPME_GENERIC_E, ts + 1000000), NULL));
+	}
+
+	shedder.set_container_budget(100, 5);
+	ts += 1000000;
+
+	kept = 0;
+	for(uint32_t j = 0; j < 10; j++)
+	{
+		kept += !shedder.shed(evt.get(PPME_GENERIC_E, ts), &c1);
+		kept += !shedder.shed(evt.get(PPME_GENERIC_E, ts), &c2);
+	}
+	EXPECT_EQ(10u, kept);
+	EXPECT_EQ(5u, shedder.get_shed_by_container().at(c1));
+	EXPECT_EQ(5u, shedder.get_shed_by_container().at(c2));
+	EXPECT_EQ(10u, shedder.get_shed_count(PPME_GENERIC_E));
+	EXPECT_EQ(11u, shedder.get_shed_count(PPME_SYSCALL_READ_E));
+}
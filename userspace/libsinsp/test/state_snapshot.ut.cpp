@@ -0,0 +1,230 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// the tests drive the reconciliation by hand
+#define VISIBILITY_PRIVATE
+
+#include "sinsp.h"
+#include "dumper.h"
+#include <gtest.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace
+{
+std::string snapshot_path()
+{
+	return "/tmp/state_snapshot_test." + std::to_string(getpid());
+}
+
+void remove_snapshot(const std::string& path)
+{
+	unlink(path.c_str());
+	unlink((path + ".containers").c_str());
+}
+
+// check all the restored threads against /proc
+void reconcile(sinsp& inspector)
+{
+	sinsp_evt evt;
+	while(!inspector.m_state_reconcile_tids.empty())
+	{
+		inspector.reconcile_state_snapshot(&evt);
+	}
+}
+
+int open_udp_socket()
+{
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if(fd < 0)
+	{
+		return fd;
+	}
+
+	struct sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+//
+// The time from the open to the first event on this process, once
+// its thread is fully known. nodriver captures only return events
+// without a thread, so the event is made up.
+//
+uint64_t time_to_first_enriched_event_ns(const std::string& path, bool* loaded)
+{
+	sinsp inspector;
+	inspector.set_state_snapshot(path);
+	inspector.open_nodriver();
+	*loaded = inspector.is_state_snapshot_loaded();
+
+	sinsp_evt evt;
+	evt.m_tinfo = inspector.get_thread_ref(getpid(), false).get();
+	inspector.check_first_enriched_event(&evt);
+	uint64_t res = inspector.get_time_to_first_enriched_event_ns();
+	inspector.close();
+
+	return res;
+}
+}
+
+TEST(state_snapshot, warm_restart)
+{
+	std::string path = snapshot_path();
+	unlink(path.c_str());
+
+	{
+		sinsp inspector;
+		inspector.set_state_snapshot(path);
+		inspector.open_nodriver();
+		EXPECT_FALSE(inspector.is_state_snapshot_loaded());
+		inspector.close();
+	}
+	ASSERT_EQ(0, access(path.c_str(), R_OK));
+
+	{
+		sinsp inspector;
+		inspector.set_state_snapshot(path);
+		inspector.open_nodriver();
+		EXPECT_TRUE(inspector.is_state_snapshot_loaded());
+
+		auto tinfo = inspector.get_thread_ref(getpid());
+		ASSERT_NE(nullptr, tinfo);
+		EXPECT_FALSE(tinfo->m_exe.empty());
+		inspector.close();
+	}
+
+	// a broken snapshot falls back to the /proc scan
+	ASSERT_EQ(0, truncate(path.c_str(), 10));
+	{
+		sinsp inspector;
+		inspector.set_state_snapshot(path);
+		inspector.open_nodriver();
+		EXPECT_FALSE(inspector.is_state_snapshot_loaded());
+		EXPECT_NE(nullptr, inspector.get_thread_ref(getpid()));
+	}
+
+	remove_snapshot(path);
+}
+
+TEST(state_snapshot, stale)
+{
+	std::string path = snapshot_path();
+	remove_snapshot(path);
+
+	{
+		sinsp inspector;
+		inspector.set_state_snapshot(path);
+		inspector.open_nodriver();
+		inspector.close();
+	}
+
+	// too old
+	usleep(20 * 1000);
+	{
+		sinsp inspector;
+		inspector.set_state_snapshot(path, 10);
+		inspector.open_nodriver();
+		EXPECT_FALSE(inspector.is_state_snapshot_loaded());
+		EXPECT_NE(nullptr, inspector.get_thread_ref(getpid()));
+	}
+
+	// a plain capture file doesn't carry the boot id
+	{
+		sinsp inspector;
+		inspector.open_nodriver();
+		sinsp_dumper dumper(&inspector);
+		dumper.open(path, false, true);
+		dumper.close();
+		inspector.close();
+	}
+	{
+		sinsp inspector;
+		inspector.set_state_snapshot(path);
+		inspector.open_nodriver();
+		EXPECT_FALSE(inspector.is_state_snapshot_loaded());
+	}
+
+	remove_snapshot(path);
+}
+
+TEST(state_snapshot, fd_rescan)
+{
+	std::string path = snapshot_path();
+	remove_snapshot(path);
+
+	int closed_fd = open_udp_socket();
+	ASSERT_GE(closed_fd, 0);
+	{
+		sinsp inspector;
+		inspector.set_state_snapshot(path);
+		inspector.open_nodriver();
+		ASSERT_NE(nullptr, inspector.get_thread_ref(getpid())->get_fd(closed_fd));
+		inspector.close();
+	}
+
+	// the fds change while nobody is looking
+	int opened_fd = open_udp_socket();
+	ASSERT_GE(opened_fd, 0);
+	close(closed_fd);
+
+	{
+		sinsp inspector;
+		inspector.set_state_snapshot(path);
+		inspector.open_nodriver();
+		ASSERT_TRUE(inspector.is_state_snapshot_loaded());
+
+		auto tinfo = inspector.get_thread_ref(getpid());
+		ASSERT_NE(nullptr, tinfo);
+		EXPECT_NE(nullptr, tinfo->get_fd(closed_fd));
+		EXPECT_EQ(nullptr, tinfo->get_fd(opened_fd));
+
+		reconcile(inspector);
+		EXPECT_EQ(nullptr, tinfo->get_fd(closed_fd));
+		EXPECT_NE(nullptr, tinfo->get_fd(opened_fd));
+	}
+
+	close(opened_fd);
+	remove_snapshot(path);
+}
+
+// A benchmark, run it with --gtest_also_run_disabled_tests
+TEST(state_snapshot, DISABLED_time_to_first_enriched_event)
+{
+	std::string path = snapshot_path();
+	remove_snapshot(path);
+	bool loaded;
+
+	uint64_t cold_ns = time_to_first_enriched_event_ns(path, &loaded);
+	ASSERT_FALSE(loaded);
+	uint64_t warm_ns = time_to_first_enriched_event_ns(path, &loaded);
+	ASSERT_TRUE(loaded);
+
+	RecordProperty("without_snapshot_us", (int)(cold_ns / 1000));
+	RecordProperty("with_snapshot_us", (int)(warm_ns / 1000));
+
+	remove_snapshot(path);
+}
@@ -0,0 +1,242 @@
+/*
+Copyright (C) 2021 The Falco Authors.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+// the test builds events by hand
+#define VISIBILITY_PRIVATE
+
+#include "sinsp.h"
+#include "table.h"
+#include "capture_test_utils.h"
+#include <gtest.h>
+#include <chrono>
+#include <set>
+
+namespace
+{
+sinsp_view_column_info column(const std::string& field, uint32_t flags,
+			      sinsp_field_aggregation aggregation,
+			      sinsp_field_aggregation groupby_aggregation = A_NONE)
+{
+	return sinsp_view_column_info(field, field, "", 10, flags,
+				      aggregation, groupby_aggregation,
+				      std::vector<std::string>(), "");
+}
+
+uint64_t u64(const sinsp_table_field& fld)
+{
+	return *(uint64_t*)fld.m_val;
+}
+}
+
+TEST(table, map)
+{
+	sinsp_table_map map;
+	std::vector<uint64_t> keys;
+	const uint32_t nkeys = 100000;
+
+	for(uint64_t j = 0; j < nkeys; j++)
+	{
+		keys.push_back(j * 7919);
+	}
+
+	for(uint32_t j = 0; j < nkeys; j++)
+	{
+		sinsp_table_field key((uint8_t*)&keys[j], sizeof(uint64_t), 1);
+		sinsp_table_map::row* row = map.get(key);
+		ASSERT_EQ(NULL, row->m_vals);
+		row->m_vals = (sinsp_table_field*)&keys[j];
+	}
+
+	ASSERT_EQ(nkeys, map.size());
+
+	for(uint32_t j = 0; j < nkeys; j++)
+	{
+		uint64_t k = keys[j];
+		sinsp_table_field key((uint8_t*)&k, sizeof(uint64_t), 1);
+		sinsp_table_map::row* row = map.find(key);
+		ASSERT_NE(nullptr, row);
+		ASSERT_EQ((sinsp_table_field*)&keys[j], row->m_vals);
+		ASSERT_EQ(row, map.get(key));
+	}
+
+	// same bytes, different length
+	sinsp_table_field short_key((uint8_t*)&keys[1], sizeof(uint32_t), 1);
+	EXPECT_EQ(nullptr, map.find(short_key));
+
+	// rows are kept in insertion order
+	uint32_t j = 0;
+	for(auto it = map.begin(); it != map.end(); ++it, ++j)
+	{
+		EXPECT_EQ(keys[j], u64(it->m_key));
+	}
+
+	map.clear();
+	EXPECT_EQ(0u, map.size());
+	sinsp_table_field key((uint8_t*)&keys[1], sizeof(uint64_t), 1);
+	EXPECT_EQ(nullptr, map.find(key));
+}
+
+TEST(table, groupby)
+{
+	sinsp inspector;
+	container_json_event evt(&inspector);
+	std::vector<sinsp_view_column_info> columns = {
+		column("evt.num", TEF_IS_KEY, A_NONE),
+		column("evt.cpu", TEF_IS_GROUPBY_KEY, A_NONE),
+		column("evt.count", 0, A_SUM, A_SUM),
+		column("evt.num", 0, A_MAX, A_MAX),
+	};
+	sinsp_table table(&inspector, sinsp_table::TT_TABLE, ONE_SECOND_IN_NS,
+			  sinsp_table::OT_CURSES, 0, 0);
+	table.configure(&columns, "evt.type=container", false, 0);
+
+	table.flush(evt.get(0));
+	for(uint64_t j = 1; j <= 1000; j++)
+	{
+		// every key twice
+		table.process_event(evt.get(j, j % 4));
+		table.process_event(evt.get(j, j % 4));
+	}
+	table.flush(evt.get(0));
+
+	table.set_sorting_col(2);
+	std::vector<sinsp_sample_row>* sample = table.get_sample(ONE_SECOND_IN_NS);
+	ASSERT_EQ(4u, sample->size());
+	for(auto& row : *sample)
+	{
+		ASSERT_EQ(2u, row.m_values.size());
+		EXPECT_EQ(500u, *(uint32_t*)row.m_values[0].m_val);
+		EXPECT_EQ(1000u - (4 - *(uint16_t*)row.m_key.m_val) % 4, u64(row.m_values[1]));
+	}
+
+	// descending order by max evt.num
+	EXPECT_EQ(0u, *(uint16_t*)sample->at(0).m_key.m_val);
+	EXPECT_EQ(1u, *(uint16_t*)sample->at(3).m_key.m_val);
+}
+
+//
+// With a sorting limit only the top rows of the sample are in order,
+// and they are the same rows a full sort puts first
+//
+TEST(table, sorting_limit)
+{
+	sinsp inspector;
+	container_json_event evt(&inspector);
+	std::vector<sinsp_view_column_info> columns = {
+		column("evt.num", TEF_IS_KEY, A_NONE),
+		column("evt.num", 0, A_MAX),
+	};
+	sinsp_table table(&inspector, sinsp_table::TT_TABLE, ONE_SECOND_IN_NS,
+			  sinsp_table::OT_CURSES, 0, 0);
+	table.configure(&columns, "evt.type=container", false, 0);
+	const uint64_t nkeys = 1000;
+
+	table.flush(evt.get(0));
+	for(uint64_t j = 1; j <= nkeys; j++)
+	{
+		// not in key order, so that the sort has something to do
+		table.process_event(evt.get((j * 7919) % nkeys + 1));
+	}
+	table.flush(evt.get(0));
+
+	table.set_sorting_col(1);
+	table.set_sorting_limit(10);
+	std::vector<sinsp_sample_row>* sample = table.get_sample(ONE_SECOND_IN_NS);
+
+	// the rows past the limit are still in the sample
+	ASSERT_EQ(nkeys, sample->size());
+	for(uint32_t j = 0; j < 10; j++)
+	{
+		EXPECT_EQ(nkeys - j, u64(sample->at(j).m_key));
+		EXPECT_EQ(nkeys - j, u64(sample->at(j).m_values[0]));
+	}
+
+	std::set<uint64_t> rest;
+	for(uint32_t j = 10; j < nkeys; j++)
+	{
+		rest.insert(u64(sample->at(j).m_key));
+	}
+	EXPECT_EQ(nkeys - 10, rest.size());
+	EXPECT_EQ(1u, *rest.begin());
+	EXPECT_EQ(nkeys - 10, *rest.rbegin());
+
+	// no limit, the whole sample is sorted
+	table.set_sorting_limit(0);
+	sample = table.get_sample(ONE_SECOND_IN_NS);
+	ASSERT_EQ(nkeys, sample->size());
+	for(uint32_t j = 0; j < nkeys; j++)
+	{
+		ASSERT_EQ(nkeys - j, u64(sample->at(j).m_key));
+	}
+}
+
+//
+// A benchmark, run it with --gtest_also_run_disabled_tests
+//
+// Aggregates 1M distinct keys, then sorts the sample keeping only the
+// top 10 rows. The time taken by the aggregation and by the sort is
+// recorded in the test properties (eg. --gtest_output=xml).
+//
+TEST(table, DISABLED_one_million_keys)
+{
+	sinsp inspector;
+	container_json_event evt(&inspector);
+	std::vector<sinsp_view_column_info> columns = {
+		column("evt.num", TEF_IS_KEY, A_NONE),
+		column("evt.count", 0, A_SUM),
+		column("evt.num", 0, A_MAX),
+	};
+	sinsp_table table(&inspector, sinsp_table::TT_TABLE, ONE_SECOND_IN_NS,
+			  sinsp_table::OT_CURSES, 0, 0);
+	table.configure(&columns, "evt.type=container", false, 0);
+	const uint64_t nkeys = 1000000;
+
+	table.flush(evt.get(0));
+
+	auto start = std::chrono::steady_clock::now();
+	for(uint64_t j = 1; j <= nkeys; j++)
+	{
+		table.process_event(evt.get(j));
+	}
+	// hit every key again, to exercise the aggregation of existing rows
+	for(uint64_t j = 1; j <= nkeys; j++)
+	{
+		table.process_event(evt.get(j));
+	}
+	table.flush(evt.get(0));
+	auto aggregated = std::chrono::steady_clock::now();
+
+	table.set_sorting_col(2);
+	table.set_sorting_limit(10);
+	std::vector<sinsp_sample_row>* sample = table.get_sample(ONE_SECOND_IN_NS);
+	auto sorted = std::chrono::steady_clock::now();
+
+	RecordProperty("aggregation_ms",
+		       (int)std::chrono::duration_cast<std::chrono::milliseconds>(aggregated - start).count());
+	RecordProperty("sort_ms",
+		       (int)std::chrono::duration_cast<std::chrono::milliseconds>(sorted - aggregated).count());
+
+	ASSERT_EQ(nkeys, sample->size());
+	for(uint32_t j = 0; j < 10; j++)
+	{
+		const sinsp_sample_row& row = sample->at(j);
+		EXPECT_EQ(nkeys - j, u64(row.m_key));
+		EXPECT_EQ(2u, *(uint32_t*)row.m_values[0].m_val);
+		EXPECT_EQ(nkeys - j, u64(row.m_values[1]));
+	}
+	EXPECT_EQ(0, table.get_row_from_key(&sample->at(0).m_key));
+}
@@ -26,6 +26,7 @@ limitations under the License.
 #include "sinsp_int.h"
 #include "protodecoder.h"
 #include "tracers.h"
+#include "heavy_hitters.h"
 
 #ifdef HAS_ANALYZER
 #include "tracer_emitter.h"
@@ -89,6 +90,9 @@ void sinsp_threadinfo::init()
 	m_category = CAT_NONE;
 	m_blprogram = NULL;
 	m_loginuid = 0;
+	m_is_snapshot = false;
+	m_parent_snapshot.reset();
+	m_container_snapshot.reset();
 }
 
 sinsp_threadinfo::~sinsp_threadinfo()
@@ -112,6 +116,76 @@ sinsp_threadinfo::~sinsp_threadinfo()
 	}
 }
 
+void sinsp_threadinfo::copy_process_state(const sinsp_threadinfo& src,
+					  const std::shared_ptr<sinsp_threadinfo>& main_thread)
+{
+	m_tid = src.m_tid;
+	m_pid = src.m_pid;
+	m_ptid = src.m_ptid;
+	m_sid = src.m_sid;
+	m_comm = src.m_comm;
+	m_exe = src.m_exe;
+	m_exepath = src.m_exepath;
+	m_args = src.m_args;
+	m_env = src.m_env;
+	m_cgroups = src.m_cgroups;
+	m_container_id = src.m_container_id;
+	m_flags = src.m_flags;
+	m_fdlimit = src.m_fdlimit;
+	m_uid = src.m_uid;
+	m_gid = src.m_gid;
+	m_nchilds = src.m_nchilds;
+	m_vmsize_kb = src.m_vmsize_kb;
+	m_vmrss_kb = src.m_vmrss_kb;
+	m_vmswap_kb = src.m_vmswap_kb;
+	m_pfmajor = src.m_pfmajor;
+	m_pfminor = src.m_pfminor;
+	m_vtid = src.m_vtid;
+	m_vpid = src.m_vpid;
+	m_vpgid = src.m_vpgid;
+	m_root = src.m_root;
+	m_program_hash = src.m_program_hash;
+	m_program_hash_scripts = src.m_program_hash_scripts;
+	m_tty = src.m_tty;
+	m_loginuid = src.m_loginuid;
+	m_category = src.m_category;
+	m_lastevent_fd = src.m_lastevent_fd;
+	m_lastevent_ts = src.m_lastevent_ts;
+	m_prevevent_ts = src.m_prevevent_ts;
+	m_lastaccess_ts = src.m_lastaccess_ts;
+	m_clone_ts = src.m_clone_ts;
+#ifdef HAS_FILTERING
+	m_last_latency_entertime = src.m_last_latency_entertime;
+	m_latency = src.m_latency;
+#endif
+	m_cwd = src.m_cwd;
+	m_lastevent_type = src.m_lastevent_type;
+	m_lastevent_category = src.m_lastevent_category;
+	m_parent_loop_detected = src.m_parent_loop_detected;
+	m_main_thread = main_thread;
+	m_is_snapshot = false;
+	m_parent_snapshot.reset();
+	m_container_snapshot.reset();
+}
+
+void sinsp_threadinfo::set_snapshot_state(const std::shared_ptr<sinsp_threadinfo>& parent,
+					  const std::shared_ptr<const sinsp_container_info>& container)
+{
+	m_is_snapshot = true;
+	m_parent_snapshot = parent;
+	m_container_snapshot = container;
+}
+
+std::shared_ptr<const sinsp_container_info> sinsp_threadinfo::get_container_info() const
+{
+	if(m_is_snapshot)
+	{
+		return m_container_snapshot;
+	}
+
+	return m_inspector->m_container_manager.get_container(m_container_id);
+}
+
 void sinsp_threadinfo::fix_sockets_coming_from_proc()
 {
 	unordered_map<int64_t, sinsp_fdinfo_t>::iterator it;
@@ -666,6 +740,11 @@ void sinsp_threadinfo::set_cgroups(const char* cgroups, size_t len)
 
 sinsp_threadinfo* sinsp_threadinfo::get_parent_thread()
 {
+	if(m_is_snapshot)
+	{
+		return m_parent_snapshot.get();
+	}
+
 	return &*m_inspector->get_thread_ref(m_ptid, false, true);
 }
 
@@ -1377,6 +1456,11 @@ void sinsp_thread_manager::remove_thread(int64_t tid, bool force)
 
 		m_threadtable.erase(tid);
 
+		if(m_inspector->m_heavy_hitters != NULL)
+		{
+			m_inspector->m_heavy_hitters->forget_tid(tid);
+		}
+
 		//
 		// If the thread has a nonzero refcount, it means that we are forcing the removal
 		// of a main process or program that some child refer to.
@@ -36,6 +36,7 @@ struct iovec {
 #include "fdinfo.h"
 #include "internal_metrics.h"
 
+class sinsp_container_info;
 class sinsp_delays_info;
 class sinsp_tracerparser;
 class blprogram;
@@ -102,6 +103,32 @@ public:
 	*/
 	std::string get_env(const std::string& name);
 
+	/*!
+	  \brief Copy the process state (ids, names, arguments, environment,
+	  cgroups, cwd...) of another thread into this one, so that it can be
+	  read while the original keeps being updated. The fd table and the
+	  parsers' per-thread state are not copied.
+	  \param main_thread if set, used as the main thread of the copy
+	  instead of looking it up in the thread table.
+	*/
+	void copy_process_state(const sinsp_threadinfo& src,
+				const std::shared_ptr<sinsp_threadinfo>& main_thread = nullptr);
+
+	/*!
+	  \brief Make a copy (see copy_process_state()) independent from the
+	  inspector tables: get_parent_thread() and get_container_info()
+	  return the given parent and container instead of looking them up,
+	  and get_main_thread() only returns the main thread of the copy.
+	*/
+	void set_snapshot_state(const std::shared_ptr<sinsp_threadinfo>& parent,
+				const std::shared_ptr<const sinsp_container_info>& container);
+
+	/*!
+	  \brief Get the container of this thread, NULL for the host or when
+	  the container is unknown.
+	*/
+	std::shared_ptr<const sinsp_container_info> get_container_info() const;
+
 	/*!
 	  \brief Return true if this is a process' main thread.
 	*/
@@ -137,6 +164,10 @@ public:
 				//
 				// Yes, this is a child thread. Find the process root thread.
 				//
+				if(m_is_snapshot)
+				{
+					return NULL;
+				}
 				auto ptinfo = lookup_thread();
 				if (!ptinfo)
 				{
@@ -441,6 +472,11 @@ VISIBILITY_PRIVATE
 	bool m_parent_loop_detected;
 	blprogram* m_blprogram;
 
+	// set by set_snapshot_state()
+	bool m_is_snapshot;
+	std::shared_ptr<sinsp_threadinfo> m_parent_snapshot;
+	std::shared_ptr<const sinsp_container_info> m_container_snapshot;
+
 	friend class sinsp;
 	friend class sinsp_parser;
 	friend class sinsp_analyzer;